@@ -0,0 +1,667 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "tinystd_jobs.h"
+#include "tinystd_stdlib.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <new>
+
+namespace tinystd {
+
+static_assert(sizeof(std::atomic<i64>) == sizeof(i64), "tinystd::job_counter requires lock-free 64-bit atomics");
+static_assert(sizeof(std::atomic<void*>) == sizeof(void*), "tinystd::job_counter requires lock-free pointer atomics");
+
+static std::atomic<i64>& counter_value(job_counter& c)              { return *reinterpret_cast<std::atomic<i64>*>(&c.m_value); }
+static const std::atomic<i64>& counter_value(const job_counter& c)  { return *reinterpret_cast<const std::atomic<i64>*>(&c.m_value); }
+static std::atomic<void*>& counter_parked(job_counter& c)           { return *reinterpret_cast<std::atomic<void*>*>(&c.m_parked); }
+
+namespace {
+/// Queue the jobs parked on c again, called by whoever brought c to done
+void release_parked(job_counter& c);
+}
+
+bool job_counter::done() const noexcept
+{
+    return counter_value(*this).load(std::memory_order_acquire) <= 0;
+}
+
+
+void job_counter::add(i64 n) noexcept
+{
+    if (counter_value(*this).fetch_add(n, std::memory_order_seq_cst) + n <= 0)
+        release_parked(*this);
+}
+
+
+namespace {
+
+struct job_entry {
+    job                 j{};
+    job_counter*        signal{};
+    const job_counter*  after{};
+};
+
+
+/// A job parked on the counter it waits for, the counter links them through next
+struct parked_job {
+    job_entry           e{};
+    job_system::impl*   system{};
+    parked_job*         next{};
+};
+
+
+void* default_allocate(void*, size_t size, size_t)  { return tinystd::malloc(size); }
+void  default_free(void*, void* ptr)                { tinystd::free(ptr); }
+
+
+/// Deque slot, every field is atomic (relaxed) as in the paper: a thief may read a slot while the owner
+/// overwrites it, its CAS on top then fails and the torn copy is thrown away
+struct work_slot {
+    std::atomic<job_fn>             fn{};
+    std::atomic<void*>              data{};
+    std::atomic<u32>                begin{};
+    std::atomic<u32>                end{};
+    std::atomic<job_counter*>       signal{};
+    std::atomic<const job_counter*> after{};
+
+    void store(const job_entry& e)
+    {
+        fn.store(e.j.fn, std::memory_order_relaxed);
+        data.store(e.j.data, std::memory_order_relaxed);
+        begin.store(e.j.begin, std::memory_order_relaxed);
+        end.store(e.j.end, std::memory_order_relaxed);
+        signal.store(e.signal, std::memory_order_relaxed);
+        after.store(e.after, std::memory_order_relaxed);
+    }
+
+    job_entry load() const
+    {
+        return {{fn.load(std::memory_order_relaxed), data.load(std::memory_order_relaxed),
+                 begin.load(std::memory_order_relaxed), end.load(std::memory_order_relaxed)},
+                signal.load(std::memory_order_relaxed), after.load(std::memory_order_relaxed)};
+    }
+};
+
+
+/// Chase-Lev work stealing deque with a fixed capacity buffer (Le et al. 2013, "Correct and Efficient
+/// Work-Stealing for Weak Memory Models"). push/pop are owner only, steal can be called from any thread.
+struct work_deque {
+    std::atomic<i64>                top{};
+    u8                              pad[64]{};  // keep thieves and the owner on separate cache lines
+    std::atomic<i64>                bottom{};
+    work_slot*                      buffer{};
+    i64                             mask{};
+
+    bool push(const job_entry& e)
+    {
+        const i64 b = bottom.load(std::memory_order_relaxed);
+        const i64 t = top.load(std::memory_order_acquire);
+        if (b - t > mask)
+            return false;
+        buffer[b & mask].store(e);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool pop(job_entry& e)
+    {
+        const i64 b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        i64 t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        e = buffer[b & mask].load();
+        if (t == b) {
+            // last element, race against thieves
+            const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool steal(job_entry& e)
+    {
+        i64 t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const i64 b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+        e = buffer[t & mask].load();
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+};
+
+
+thread_local const job_system::impl*    tls_system{};
+thread_local u32                        tls_worker{~0u};
+
+}
+
+
+struct job_system::impl {
+    job_allocator                   alloc{};
+    u32                             worker_count{};
+    work_deque*                     deques{};
+    std::thread*                    threads{};
+
+    /// Jobs submitted by threads that are not workers
+    std::mutex                      shared_mutex{};
+    job_entry*                      shared{};
+    u32                             shared_head{};
+    std::atomic<u32>                shared_size{};
+    u32                             shared_capacity{};
+
+    /// Nodes of parked jobs, allocated in chunks and reused
+    struct node_chunk {
+        node_chunk*                 next{};
+        parked_job                  nodes[64]{};
+    };
+    std::mutex                      node_mutex{};
+    parked_job*                     free_nodes{};
+    node_chunk*                     node_chunks{};
+
+    std::atomic<i64>                pending{};
+    std::atomic<u32>                sleeping{};
+    std::atomic<bool>               quit{};
+    std::mutex                      sleep_mutex{};
+    std::condition_variable         sleep_cv{};
+
+    bool take(u32 worker, job_entry& e)
+    {
+        if (pending.load(std::memory_order_acquire) <= 0)
+            return false;
+        bool found = deques[worker].pop(e);
+        for (u32 i = 1; !found && i < worker_count; ++i)
+            found = deques[(worker + i) % worker_count].steal(e);
+        if (!found && shared_size) {
+            std::lock_guard<std::mutex> lock{shared_mutex};
+            if (shared_size) {
+                e = shared[shared_head];
+                shared_head = (shared_head + 1) % shared_capacity;
+                --shared_size;
+                found = true;
+            }
+        }
+        if (found)
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        return found;
+    }
+
+    void execute(u32 worker, const job_entry& e)
+    {
+        e.j.fn(e.j.data, e.j.begin, e.j.end, worker);
+        if (e.signal && counter_value(*e.signal).fetch_sub(1, std::memory_order_seq_cst) <= 1)
+            release_parked(*e.signal);
+    }
+
+    /// Execute e, or park it on its dependency if that is not done yet
+    void dispatch(u32 worker, const job_entry& e)
+    {
+        if (e.after && !e.after->done())
+            park(e);
+        else
+            execute(worker, e);
+    }
+
+    /// Run one job if there is one
+    bool run_one(u32 worker)
+    {
+        job_entry e{};
+        if (!take(worker, e))
+            return false;
+        dispatch(worker, e);
+        return true;
+    }
+
+    void push_shared(const job_entry& e)
+    {
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock{shared_mutex};
+                if (shared_size < shared_capacity) {
+                    pending.fetch_add(1, std::memory_order_seq_cst);
+                    shared[(shared_head + shared_size++) % shared_capacity] = e;
+                    return;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    /// Push e on the dependency it waits for, the pusher checks the counter again afterwards, so either it or
+    /// the thread that brings the counter to done (both exchange the list) queues e again
+    void park(const job_entry& e)
+    {
+        auto& after = const_cast<job_counter&>(*e.after);
+        parked_job* p{};
+        {
+            std::lock_guard<std::mutex> lock{node_mutex};
+            if (!free_nodes) {
+                auto* chunk = new (alloc.allocate(alloc.user, sizeof(node_chunk), alignof(node_chunk))) node_chunk{};
+                chunk->next = node_chunks;
+                node_chunks = chunk;
+                for (auto& n: chunk->nodes) {
+                    n.next = free_nodes;
+                    free_nodes = &n;
+                }
+            }
+            p = free_nodes;
+            free_nodes = p->next;
+        }
+        p->e = e;
+        p->system = this;
+
+        auto& head = counter_parked(after);
+        void* h = head.load(std::memory_order_relaxed);
+        do {
+            p->next = (parked_job*)h;
+        } while (!head.compare_exchange_weak(h, p, std::memory_order_seq_cst, std::memory_order_relaxed));
+        if (counter_value(after).load(std::memory_order_seq_cst) <= 0)
+            release_parked(after);
+    }
+
+    /// Queue a parked job whose dependency got done, on the deque of the calling thread if it is a worker
+    void requeue(const job_entry& e)
+    {
+        const u32 worker = tls_system == this ? tls_worker : ~0u;
+        if (worker != ~0u) {
+            pending.fetch_add(1, std::memory_order_seq_cst);
+            if (!deques[worker].push(e)) {
+                pending.fetch_sub(1, std::memory_order_seq_cst);
+                dispatch(worker, e);
+                return;
+            }
+        }
+        else {
+            push_shared(e);
+        }
+        wake(1);
+    }
+
+    void free_node(parked_job* p)
+    {
+        std::lock_guard<std::mutex> lock{node_mutex};
+        p->next = free_nodes;
+        free_nodes = p;
+    }
+
+    void wake(u32 count)
+    {
+        if (!sleeping.load(std::memory_order_seq_cst))
+            return;
+        std::lock_guard<std::mutex> lock{sleep_mutex};
+        if (count > 1) sleep_cv.notify_all();
+        else sleep_cv.notify_one();
+    }
+
+    void worker_main(u32 worker)
+    {
+        tls_system = this;
+        tls_worker = worker;
+        u32 idle = 0;
+        while (!quit.load(std::memory_order_acquire)) {
+            if (run_one(worker)) {
+                idle = 0;
+                continue;
+            }
+            if (++idle < 64) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock{sleep_mutex};
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            sleep_cv.wait_for(lock, std::chrono::milliseconds(1), [this]{
+                return pending.load(std::memory_order_seq_cst) > 0 || quit.load(std::memory_order_acquire);
+            });
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+            idle = 0;
+        }
+        tls_system = {};
+        tls_worker = ~0u;
+    }
+};
+
+
+namespace {
+
+void release_parked(job_counter& c)
+{
+    auto& head = counter_parked(c);
+    if (!head.load(std::memory_order_seq_cst))
+        return;
+    auto* p = (parked_job*)head.exchange(nullptr, std::memory_order_seq_cst);
+    while (p) {
+        parked_job* next = p->next;
+        job_system::impl* system = p->system;
+        const job_entry e = p->e;
+        system->free_node(p);
+        system->requeue(e);
+        p = next;
+    }
+}
+
+}
+
+
+job_system job_system::create(const job_system_desc& desc) noexcept
+{
+    job_allocator alloc = desc.alloc;
+    if (!alloc.allocate || !alloc.free) {
+        alloc.allocate = default_allocate;
+        alloc.free = default_free;
+    }
+
+    u32 workers = desc.worker_count ? desc.worker_count : std::thread::hardware_concurrency();
+    if (!workers) workers = 1;
+    u32 capacity = 2;
+    while (capacity < desc.queue_capacity) capacity *= 2;
+
+    job_system sys{};
+    sys.m_impl = new (alloc.allocate(alloc.user, sizeof(impl), alignof(impl))) impl{};
+    auto& s = *sys.m_impl;
+    s.alloc = alloc;
+    s.worker_count = workers;
+    s.deques = (work_deque*)alloc.allocate(alloc.user, workers * sizeof(work_deque), alignof(work_deque));
+    for (u32 i = 0; i < workers; ++i) {
+        auto* d = new (s.deques + i) work_deque{};
+        d->buffer = (work_slot*)alloc.allocate(alloc.user, capacity * sizeof(work_slot), alignof(work_slot));
+        for (u32 j = 0; j < capacity; ++j)
+            new (d->buffer + j) work_slot{};
+        d->mask = capacity - 1;
+    }
+    s.shared_capacity = capacity;
+    s.shared = (job_entry*)alloc.allocate(alloc.user, capacity * sizeof(job_entry), alignof(job_entry));
+
+    tls_system = sys.m_impl;
+    tls_worker = 0;
+    if (workers > 1) {
+        s.threads = (std::thread*)alloc.allocate(alloc.user, workers * sizeof(std::thread), alignof(std::thread));
+        for (u32 i = 1; i < workers; ++i)
+            new (s.threads + i) std::thread{[&s, i]{ s.worker_main(i); }};
+    }
+    return sys;
+}
+
+
+void job_system::destroy() noexcept
+{
+    if (!m_impl) return;
+    auto& s = *m_impl;
+    const job_allocator alloc = s.alloc;
+
+    s.quit.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock{s.sleep_mutex};
+        s.sleep_cv.notify_all();
+    }
+    for (u32 i = 1; i < s.worker_count; ++i) {
+        s.threads[i].join();
+        s.threads[i].~thread();
+    }
+    if (s.threads) alloc.free(alloc.user, s.threads);
+    for (u32 i = 0; i < s.worker_count; ++i) {
+        alloc.free(alloc.user, s.deques[i].buffer);
+        s.deques[i].~work_deque();
+    }
+    alloc.free(alloc.user, s.deques);
+    alloc.free(alloc.user, s.shared);
+    while (s.node_chunks) {
+        auto* next = s.node_chunks->next;
+        alloc.free(alloc.user, s.node_chunks);
+        s.node_chunks = next;
+    }
+    if (tls_system == m_impl) {
+        tls_system = {};
+        tls_worker = ~0u;
+    }
+    s.~impl();
+    alloc.free(alloc.user, m_impl);
+    m_impl = {};
+}
+
+
+u32 job_system::worker_count() const noexcept
+{
+    return m_impl->worker_count;
+}
+
+
+u32 job_system::current_worker() const noexcept
+{
+    return tls_system == m_impl ? tls_worker : ~0u;
+}
+
+
+void job_system::run(span<const job> jobs, job_counter* signal, const job_counter* after) noexcept
+{
+    auto& s = *m_impl;
+    if (signal)
+        counter_value(*signal).fetch_add(i64(jobs.size()), std::memory_order_acq_rel);
+
+    const u32 worker = current_worker();
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const job_entry e{jobs[i], signal, after};
+        if (worker != ~0u) {
+            // count the job before it becomes visible so pending never goes negative
+            s.pending.fetch_add(1, std::memory_order_seq_cst);
+            if (!s.deques[worker].push(e)) {
+                s.pending.fetch_sub(1, std::memory_order_seq_cst);
+                s.dispatch(worker, e);
+            }
+            continue;
+        }
+        s.push_shared(e);
+    }
+    s.wake(u32(jobs.size()));
+}
+
+
+void job_system::wait(const job_counter& counter) noexcept
+{
+    auto& s = *m_impl;
+    const u32 worker = current_worker();
+    while (!counter.done()) {
+        if (worker == ~0u || !s.run_one(worker))
+            std::this_thread::yield();
+    }
+}
+
+
+void job_system::parallel_for(u32 count, u32 batch, job_fn fn, void* data) noexcept
+{
+    if (!count) return;
+    if (!batch) batch = 1;
+
+    enum { JOB_CHUNK = 64 };
+    job jobs[JOB_CHUNK]{};
+    job_counter counter{};
+    u32 n = 0;
+    for (u32 begin = 0; begin < count; begin += batch) {
+        jobs[n++] = {fn, data, begin, (count - begin) < batch ? count : begin + batch};
+        if (n == JOB_CHUNK) {
+            run({jobs, n}, &counter);
+            n = 0;
+        }
+    }
+    if (n) run({jobs, n}, &counter);
+    wait(counter);
+}
+
+
+//region mpsc_queue
+
+struct mpsc_queue::impl {
+    job_allocator                   alloc{};
+    std::atomic<u64>                tail{};
+    u8                              pad[64]{};  // keep producers and the consumer on separate cache lines
+    u64                             head{};
+    u8*                             cells{};
+    u64                             mask{};
+    u32                             entry_size{};
+    u32                             cell_size{};
+
+    std::atomic<u64>& sequence(u64 pos) { return *reinterpret_cast<std::atomic<u64>*>(cells + (pos & mask) * cell_size); }
+    u8* entry(u64 pos)                  { return cells + (pos & mask) * cell_size + sizeof(u64); }
+};
+
+
+mpsc_queue mpsc_queue::create(u32 capacity, u32 entry_size, const job_allocator& desc_alloc) noexcept
+{
+    job_allocator alloc = desc_alloc;
+    if (!alloc.allocate || !alloc.free) {
+        alloc.allocate = default_allocate;
+        alloc.free = default_free;
+    }
+    u32 size = 2;
+    while (size < capacity) size *= 2;
+
+    mpsc_queue q{};
+    q.m_impl = new (alloc.allocate(alloc.user, sizeof(impl), alignof(impl))) impl{};
+    auto& s = *q.m_impl;
+    s.alloc = alloc;
+    s.mask = size - 1;
+    s.entry_size = entry_size;
+    s.cell_size = u32(sizeof(u64) + ((entry_size + 7) & ~7u));
+    s.cells = (u8*)alloc.allocate(alloc.user, size_t(size) * s.cell_size, alignof(u64));
+    for (u64 i = 0; i < size; ++i)
+        new (&s.sequence(i)) std::atomic<u64>{i};
+    return q;
+}
+
+
+void mpsc_queue::destroy() noexcept
+{
+    if (!m_impl) return;
+    const job_allocator alloc = m_impl->alloc;
+    alloc.free(alloc.user, m_impl->cells);
+    m_impl->~impl();
+    alloc.free(alloc.user, m_impl);
+    m_impl = {};
+}
+
+
+bool mpsc_queue::try_push(const void* entry) noexcept
+{
+    auto& s = *m_impl;
+    u64 pos = s.tail.load(std::memory_order_relaxed);
+    for (;;) {
+        const i64 diff = i64(s.sequence(pos).load(std::memory_order_acquire)) - i64(pos);
+        if (diff == 0) {
+            if (s.tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            return false;
+        }
+        else {
+            pos = s.tail.load(std::memory_order_relaxed);
+        }
+    }
+    memcpy(s.entry(pos), entry, s.entry_size);
+    s.sequence(pos).store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+
+bool mpsc_queue::try_pop(void* entry) noexcept
+{
+    auto& s = *m_impl;
+    const u64 pos = s.head;
+    if (s.sequence(pos).load(std::memory_order_acquire) != pos + 1)
+        return false;
+    memcpy(entry, s.entry(pos), s.entry_size);
+    s.sequence(pos).store(pos + s.mask + 1, std::memory_order_release);
+    s.head = pos + 1;
+    return true;
+}
+
+//endregion
+
+//region job_thread
+
+struct job_thread::impl {
+    job_allocator                   alloc{};
+    thread_fn                       fn{};
+    void*                           data{};
+    std::thread                     thread{};
+    std::atomic<bool>               quit{};
+    std::atomic<bool>               woken{};
+    std::mutex                      sleep_mutex{};
+    std::condition_variable         sleep_cv{};
+
+    void main()
+    {
+        while (!quit.load(std::memory_order_acquire)) {
+            woken.store(false, std::memory_order_seq_cst);
+            if (fn(data))
+                continue;
+            std::unique_lock<std::mutex> lock{sleep_mutex};
+            sleep_cv.wait_for(lock, std::chrono::milliseconds(1), [this]{
+                return woken.load(std::memory_order_seq_cst) || quit.load(std::memory_order_acquire);
+            });
+        }
+    }
+};
+
+
+job_thread job_thread::create(thread_fn fn, void* data, const job_allocator& desc_alloc) noexcept
+{
+    job_allocator alloc = desc_alloc;
+    if (!alloc.allocate || !alloc.free) {
+        alloc.allocate = default_allocate;
+        alloc.free = default_free;
+    }
+    job_thread t{};
+    t.m_impl = new (alloc.allocate(alloc.user, sizeof(impl), alignof(impl))) impl{};
+    auto& s = *t.m_impl;
+    s.alloc = alloc;
+    s.fn = fn;
+    s.data = data;
+    s.thread = std::thread{[&s]{ s.main(); }};
+    return t;
+}
+
+
+void job_thread::destroy() noexcept
+{
+    if (!m_impl) return;
+    auto& s = *m_impl;
+    const job_allocator alloc = s.alloc;
+    s.quit.store(true, std::memory_order_release);
+    wake();
+    s.thread.join();
+    s.~impl();
+    alloc.free(alloc.user, m_impl);
+    m_impl = {};
+}
+
+
+void job_thread::wake() noexcept
+{
+    auto& s = *m_impl;
+    if (s.woken.exchange(true, std::memory_order_seq_cst))
+        return;
+    std::lock_guard<std::mutex> lock{s.sleep_mutex};
+    s.sleep_cv.notify_one();
+}
+
+//endregion
+
+
+void yield_thread() noexcept
+{
+    std::this_thread::yield();
+}
+
+}
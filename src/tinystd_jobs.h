@@ -0,0 +1,147 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYSTD_JOBS_H
+#define TINYSTD_JOBS_H
+
+#include "tinystd_config.h"
+#include "tinystd_span.h"
+
+namespace tinystd {
+
+/// Job entry point, [begin, end) is the range given to the job (a parallel_for batch or whatever the caller chose).
+/// worker is the index of the executing thread in [0, job_system::worker_count()), stable for the lifetime
+/// of the system, so it can be used to index per-thread resources without locking.
+using job_fn = void(*)(void* data, u32 begin, u32 end, u32 worker);
+
+
+struct job {
+    job_fn          fn{};
+    void*           data{};
+    u32             begin{};
+    u32             end{};
+};
+
+
+/// Number of jobs still in flight, decremented by one each time a job that signals it completes.
+/// Jobs that must not start before the counter is done are parked on it and queued again when it gets there,
+/// so the counter must outlive them.
+struct job_counter {
+    alignas(8) i64  m_value{};
+    void*           m_parked{};
+
+    NODISCARD bool  done() const noexcept;
+
+    /// Add n (may be negative) to the counter, for work tracked outside of job_system::run.
+    /// Queues the jobs parked on the counter when it gets done.
+    void            add(i64 n) noexcept;
+};
+
+
+struct job_allocator {
+    void*           user{};
+    void*           (*allocate)(void* user, size_t size, size_t align){};
+    void            (*free)(void* user, void* ptr){};
+};
+
+
+struct job_system_desc {
+    /// Total number of workers including the thread that calls create, 0 uses the hardware concurrency
+    u32             worker_count{};
+    /// Capacity of each worker's deque, rounded up to a power of two. Jobs that do not fit are run inline
+    u32             queue_capacity{1024};
+    /// Used for all internal allocations, tinystd::malloc/free when empty
+    job_allocator   alloc{};
+};
+
+
+/// Work stealing job scheduler. Each worker owns a Chase-Lev deque: it pushes and pops at the bottom
+/// while idle workers steal from the top (the slots are atomic, so a thief that loses the race never reads a
+/// half-written job). The thread that calls create becomes worker 0 and executes
+/// jobs while it waits. Threads that are not workers can submit jobs, they go through a shared queue.
+struct job_system {
+    struct impl;
+    impl*           m_impl{};
+
+    static job_system create(
+            const job_system_desc&  desc = {}) noexcept;
+
+    void            destroy() noexcept;
+
+    NODISCARD u32   worker_count() const noexcept;
+
+    /// Worker index of the calling thread, or ~0u if the thread does not belong to this system
+    NODISCARD u32   current_worker() const noexcept;
+
+    /// Queue jobs, signal (if any) is incremented by the number of jobs and decremented as they complete.
+    /// Jobs are not started before after (if any) is done, a worker that takes one too early parks it on after.
+    void            run(
+            span<const job>         jobs,
+            job_counter*            signal = {},
+            const job_counter*      after = {}) noexcept;
+
+    /// Wait for counter to reach zero, workers execute other jobs in the meantime
+    void            wait(
+            const job_counter&      counter) noexcept;
+
+    /// Split [0, count) into ranges of at most batch elements, run them in parallel and wait for all of them
+    void            parallel_for(
+            u32                     count,
+            u32                     batch,
+            job_fn                  fn,
+            void*                   data) noexcept;
+};
+
+
+/// Bounded lock-free queue of fixed size entries with any number of producers and a single consumer
+/// (Vyukov's bounded MPMC queue, every cell has a sequence number that tells whose turn it is).
+/// Entries are copied with memcpy, so they must be trivially copyable.
+struct mpsc_queue {
+    struct impl;
+    impl*           m_impl{};
+
+    /// capacity is rounded up to a power of two
+    static mpsc_queue create(
+            u32                     capacity,
+            u32                     entry_size,
+            const job_allocator&    alloc = {}) noexcept;
+
+    void            destroy() noexcept;
+
+    /// Returns false if the queue is full
+    NODISCARD bool  try_push(
+            const void*             entry) noexcept;
+
+    /// Consumer only, returns false if the queue is empty
+    NODISCARD bool  try_pop(
+            void*                   entry) noexcept;
+};
+
+
+/// Dedicated thread that calls fn(data) until destroyed. fn returns whether it found any work, when it did not
+/// the thread sleeps until wake is called (or at most a millisecond).
+struct job_thread {
+    using thread_fn = bool(*)(void* data);
+
+    struct impl;
+    impl*           m_impl{};
+
+    static job_thread create(
+            thread_fn               fn,
+            void*                   data,
+            const job_allocator&    alloc = {}) noexcept;
+
+    /// Finish the current call of fn and join the thread
+    void            destroy() noexcept;
+
+    void            wake() noexcept;
+};
+
+
+/// Give up the rest of the time slice of the calling thread
+void yield_thread() noexcept;
+
+}
+
+#endif //TINYSTD_JOBS_H
@@ -132,7 +132,7 @@ private:
         while (size >= m_capacity)
             m_capacity *= 2;
         auto* new_memory = (T*)tinystd::malloc(m_capacity * sizeof(T));
-        tinystd::memcpy(m_begin, new_memory, m_size * sizeof(T));
+        tinystd::memcpy(new_memory, m_begin, m_size * sizeof(T));
         if (m_begin != m_data)
             tinystd::free(m_begin);
         m_begin = new_memory;
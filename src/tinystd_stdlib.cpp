@@ -8,6 +8,18 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdarg>
+#include <chrono>
+
+#ifdef TINYVK_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace tinystd {
 
@@ -37,4 +49,103 @@ int error(const char* fmt, ...)
     return r;
 }
 
+int format(char* dst, size_t size, const char* fmt, ...)
+{
+    va_list a;
+    va_start(a, fmt);
+    int r = vsnprintf(dst, size, fmt, a);
+    va_end(a);
+    return r;
+}
+
+u64 clock_nanos()
+{
+    const auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return u64(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count());
+}
+
+bool write_file(const char* path, const void* data, size_t size)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    const bool ok = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+bool read_file(const char* path, size_t offset, void* dst, size_t size)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+#ifdef TINYVK_PLATFORM_WINDOWS
+    bool ok = _fseeki64(file, i64(offset), SEEK_SET) == 0;
+#else
+    bool ok = fseeko(file, off_t(offset), SEEK_SET) == 0;
+#endif
+    ok = ok && fread(dst, 1, size, file) == size;
+    fclose(file);
+    return ok;
+}
+
+#ifdef TINYVK_PLATFORM_WINDOWS
+
+mapped_file map_file(const char* path)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return {};
+    LARGE_INTEGER size{};
+    HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart
+        ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    // the mapping keeps the file open
+    CloseHandle(file);
+    if (!mapping) return {};
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        return {};
+    }
+    return {(const u8*)data, size_t(size.QuadPart), mapping};
+}
+
+void unmap_file(mapped_file& file)
+{
+    if (file.data) UnmapViewOfFile(file.data);
+    if (file.handle) CloseHandle(file.handle);
+    file = {};
+}
+
+size_t page_size()
+{
+    SYSTEM_INFO info{};
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+}
+
+#else
+
+mapped_file map_file(const char* path)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return {};
+    struct stat st{};
+    void* data = fstat(fd, &st) == 0 && st.st_size > 0
+        ? mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    // the mapping keeps the file open
+    close(fd);
+    if (data == MAP_FAILED) return {};
+    return {(const u8*)data, size_t(st.st_size), nullptr};
+}
+
+void unmap_file(mapped_file& file)
+{
+    if (file.data) munmap((void*)file.data, file.size);
+    file = {};
+}
+
+size_t page_size()
+{
+    return size_t(sysconf(_SC_PAGESIZE));
+}
+
+#endif
+
 }
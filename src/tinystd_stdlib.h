@@ -27,6 +27,33 @@ int print(const char* fmt, ...);
 
 int error(const char* fmt, ...);
 
+/// snprintf
+int format(char* dst, size_t size, const char* fmt, ...);
+
+/// Monotonic clock in nanoseconds
+u64 clock_nanos();
+
+/// Create or overwrite the file at path, returns false if it could not be written
+bool write_file(const char* path, const void* data, size_t size);
+
+/// Read size bytes at offset of the file at path into dst, returns false if they could not be read
+bool read_file(const char* path, size_t offset, void* dst, size_t size);
+
+/// A read only mapping of a whole file, data is page aligned
+struct mapped_file {
+    const u8*   data{};
+    size_t      size{};
+    void*       handle{};
+};
+
+/// Map the file at path, data is null if it could not be mapped
+mapped_file map_file(const char* path);
+
+void unmap_file(mapped_file& file);
+
+/// Size of a virtual memory page
+size_t page_size();
+
 }
 
 
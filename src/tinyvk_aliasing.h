@@ -0,0 +1,102 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_ALIASING_H
+#define TINYVK_ALIASING_H
+
+#include "tinyvk_core.h"
+
+namespace tinyvk {
+
+/// A resource placed in a shared allocation, it is alive from first to last (passes, render graph stages, ...)
+struct aliased_range {
+    VkMemoryRequirements    requirements{};
+    u32                     first{};
+    u32                     last{};
+};
+
+
+/// Place ranges in one allocation, largest first, every range goes to the lowest aligned offset that does not
+/// overlap a range alive at the same time. offsets receives the offset of every range, returns the size and
+/// alignment of the allocation and the memory types every range supports (0 if they have none in common)
+NDC VkMemoryRequirements    place_aliased(
+        span<const aliased_range>   ranges,
+        span<VkDeviceSize>          offsets) NEX;
+
+/// True if a and b at their offsets share memory
+NDC inline bool             overlaps_memory(
+        const aliased_range&        a,
+        VkDeviceSize                a_offset,
+        const aliased_range&        b,
+        VkDeviceSize                b_offset) NEX
+{
+    return a_offset < b_offset + b.requirements.size && b_offset < a_offset + a.requirements.size;
+}
+
+}
+
+#endif //TINYVK_ALIASING_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_ALIASING_CPP
+#define TINYVK_ALIASING_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+//region aliasing
+
+VkMemoryRequirements
+place_aliased(
+        span<const aliased_range> ranges,
+        span<VkDeviceSize> offsets) NEX
+{
+    tassert(offsets.size() >= ranges.size() && "tinyvk::place_aliased - Not enough offsets");
+
+    // largest first, ties keep their order
+    small_vector<u32, 64> order{};
+    for (u32 i = 0; i < ranges.size(); ++i) {
+        u32 j = order.size();
+        order.push_back(i);
+        for (; j > 0 && ranges[order[j - 1]].requirements.size < ranges[i].requirements.size; --j)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    VkMemoryRequirements total{0, 1, -1u};
+    for (u32 i = 0; i < order.size(); ++i) {
+        const auto& r = ranges[order[i]];
+        const VkDeviceSize alignment = r.requirements.alignment ? r.requirements.alignment : 1;
+
+        // first fit, restart whenever the candidate range hits a placed range that is alive at the same time
+        VkDeviceSize offset = 0;
+        for (bool moved = true; moved;) {
+            moved = false;
+            for (u32 j = 0; j < i; ++j) {
+                const auto& other = ranges[order[j]];
+                const VkDeviceSize other_offset = offsets[order[j]];
+                if (other.first <= r.last && r.first <= other.last && overlaps_memory(r, offset, other, other_offset)) {
+                    offset = tinystd::round_up(other_offset + other.requirements.size, alignment);
+                    moved = true;
+                }
+            }
+        }
+
+        offsets[order[i]] = offset;
+        total.size = tinystd::max(total.size, offset + r.requirements.size);
+        total.alignment = tinystd::max(total.alignment, alignment);
+        total.memoryTypeBits &= r.requirements.memoryTypeBits;
+    }
+    return total;
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_ALIASING_CPP
+
+#endif //TINYVK_IMPLEMENTATION
@@ -6,6 +6,9 @@
 #include <vulkan/vulkan.h>
 #include "vk_mem_alloc.h"
 #include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
 
 //#define TINYVK_BACKEND_TEST
 #ifdef TINYVK_BACKEND_TEST
@@ -42,12 +45,52 @@ struct description_allocator {
 
 struct StaticInfo {
     debug_flags debug{};
+    bool lazily_allocated_memory{true};
+    bool host_coherent_memory{true};
     struct {
         description_allocator<VkInstance, VkInstanceCreateInfo>         instance{};
         description_allocator<VkDevice, VkDeviceCreateInfo>             device{};
         description_allocator<VkRenderPass, VkRenderPassCreateInfo>     renderpass{};
         description_allocator<VkFramebuffer, VkFramebufferCreateInfo>   framebuffer{};
     } alloc{};
+    struct {
+        std::atomic<uint64_t> command_pool{};
+        std::atomic<uint64_t> command{};
+        std::atomic<uint64_t> semaphore{};
+        std::atomic<uint64_t> query_pool{};
+        std::atomic<uint64_t> sampler{};
+        std::atomic<uint64_t> image_view{};
+        std::atomic<uint64_t> buffer{};
+        std::atomic<uint64_t> image{};
+        std::atomic<uint64_t> memory{};
+    } handle_count{};
+    command_stats commands{};
+    struct semaphore_values {
+        static constexpr uint64_t MAX = 256;
+        std::atomic<uint64_t> value[MAX]{};
+        std::atomic<uint64_t> pending[MAX]{};
+    } semaphores{};
+    /// Number of values each query of a pool writes
+    uint32_t query_values[256]{};
+    /// Device memory, host visible memory is backed by host allocations so it can be mapped
+    struct memory_objects {
+        static constexpr uint64_t MAX = 4096;
+        uint32_t type[MAX]{};
+        VkDeviceSize size[MAX]{};
+        void* data[MAX]{};
+        VkDeviceSize heap_usage[VK_MAX_MEMORY_HEAPS]{};
+    } memory{};
+    /// Image views of the last descriptor update
+    struct written_views {
+        static constexpr uint32_t MAX = 64;
+        VkImageView value[MAX]{};
+        uint32_t count{};
+    } written_images{};
+    /// Memory requirements of buffers and images
+    struct requirements {
+        static constexpr uint64_t MAX = 4096;
+        VkMemoryRequirements value[MAX]{};
+    } buffers{}, images{};
 };
 
 static StaticInfo info{};
@@ -56,11 +99,60 @@ void set_debug(debug_flags debug) {
     info.debug = debug;
 }
 
+void set_lazily_allocated_memory(bool supported) {
+    info.lazily_allocated_memory = supported;
+}
+
+void set_host_coherent_memory(bool coherent) {
+    info.host_coherent_memory = coherent;
+}
+
 const VkInstanceCreateInfo&     get_desc(VkInstance v)      { return info.alloc.instance.desc[uint64_t(v)]; }
 const VkDeviceCreateInfo&       get_desc(VkDevice v)        { return info.alloc.device.desc[uint64_t(v)]; }
 const VkRenderPassCreateInfo&   get_desc(VkRenderPass v)    { return info.alloc.renderpass.desc[uint64_t(v)]; }
 const VkFramebufferCreateInfo&  get_desc(VkFramebuffer v)   { return info.alloc.framebuffer.desc[uint64_t(v)]; }
 
+const command_stats&            get_command_stats()         { return info.commands; }
+void                            reset_command_stats()       { info.commands = {}; }
+span<const VkImageView>         get_written_image_views()   { return {info.written_images.value, info.written_images.count}; }
+
+void complete_semaphores()
+{
+    for (uint64_t i = 0; i < info.semaphores.MAX; ++i)
+        info.semaphores.value[i] = info.semaphores.pending[i].load();
+}
+
+static std::atomic<uint64_t>& semaphore_value(VkSemaphore s)   { return info.semaphores.value[uint64_t(s) % info.semaphores.MAX]; }
+static std::atomic<uint64_t>& semaphore_pending(VkSemaphore s) { return info.semaphores.pending[uint64_t(s) % info.semaphores.MAX]; }
+
+/// One device local heap and one host heap, with device local, host (coherent unless disabled), host cached and
+/// (if supported) lazily allocated types
+static VkPhysicalDeviceMemoryProperties memory_properties()
+{
+    VkPhysicalDeviceMemoryProperties props{};
+    props.memoryHeapCount = 2;
+    props.memoryHeaps[0] = {256ull << 20, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+    props.memoryHeaps[1] = {256ull << 20, 0};
+    props.memoryTypeCount = info.lazily_allocated_memory ? 4 : 3;
+    props.memoryTypes[0] = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0};
+    props.memoryTypes[1] = {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | (info.host_coherent_memory ? VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : 0u), 1};
+    props.memoryTypes[2] = {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1};
+    props.memoryTypes[3] = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, 0};
+    return props;
+}
+
+static VkDeviceSize align_up(VkDeviceSize v, VkDeviceSize alignment)
+{
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+static void signal_pending(VkSemaphore s, uint64_t value)
+{
+    auto& pending = semaphore_pending(s);
+    uint64_t current = pending.load();
+    while (current < value && !pending.compare_exchange_weak(current, value)) {}
+}
+
 }
 
 bool test_debug(tinyvk::backend::debug_flags d) {
@@ -110,6 +202,13 @@ VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures(
 
 }
 
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures2(
+    VkPhysicalDevice                            physicalDevice,
+    VkPhysicalDeviceFeatures2*                  pFeatures)
+{
+
+}
+
 VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFormatProperties(
     VkPhysicalDevice                            physicalDevice,
     VkFormat                                    format,
@@ -122,7 +221,24 @@ VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(
     VkPhysicalDevice                            physicalDevice,
     VkPhysicalDeviceProperties*                 pProperties)
 {
+    pProperties->limits.maxMemoryAllocationCount = 4096;
+    pProperties->limits.bufferImageGranularity = 1;
+    pProperties->limits.nonCoherentAtomSize = 64;
+    pProperties->limits.minUniformBufferOffsetAlignment = 256;
+    pProperties->limits.minStorageBufferOffsetAlignment = 64;
+#ifdef VK_API_VERSION_1_3
+    pProperties->apiVersion = VK_API_VERSION_1_3;
+#endif
+}
 
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties2(
+    VkPhysicalDevice                            physicalDevice,
+    VkPhysicalDeviceProperties2*                pProperties)
+{
+    for (auto* p = (VkBaseOutStructure*)pProperties->pNext; p; p = p->pNext) {
+        if (p->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT)
+            ((VkPhysicalDeviceExternalMemoryHostPropertiesEXT*)p)->minImportedHostPointerAlignment = 4096;
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(
@@ -137,7 +253,7 @@ VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(
     VkPhysicalDevice                            physicalDevice,
     VkPhysicalDeviceMemoryProperties*           pMemoryProperties)
 {
-
+    *pMemoryProperties = tinyvk::backend::memory_properties();
 }
 
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(
@@ -147,10 +263,69 @@ VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(
     return nullptr;
 }
 
+VKAPI_ATTR VkResult VKAPI_CALL vkGetMemoryHostPointerPropertiesEXT(
+    VkDevice                                    device,
+    VkExternalMemoryHandleTypeFlagBits          handleType,
+    const void*                                 pHostPointer,
+    VkMemoryHostPointerPropertiesEXT*           pMemoryHostPointerProperties)
+{
+    pMemoryHostPointerProperties->memoryTypeBits = 0x2;
+    if (test_debug(tinyvk::backend::memory)) {
+        printf("vkGetMemoryHostPointerPropertiesEXT - pointer %p\n", pHostPointer);
+    }
+    return VK_SUCCESS;
+}
+
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(
     VkDevice                                    device,
     const char*                                 pName)
 {
+#define TINYVK_BACKEND_PROC(name) if (tinystd::streq(pName, #name)) return (PFN_vkVoidFunction)name;
+#define TINYVK_BACKEND_PROC_ALIAS(alias, name) if (tinystd::streq(pName, #alias)) return (PFN_vkVoidFunction)name;
+#ifdef VK_VERSION_1_2
+    TINYVK_BACKEND_PROC(vkGetSemaphoreCounterValue)
+    TINYVK_BACKEND_PROC(vkWaitSemaphores)
+    TINYVK_BACKEND_PROC_ALIAS(vkGetSemaphoreCounterValueKHR, vkGetSemaphoreCounterValue)
+    TINYVK_BACKEND_PROC_ALIAS(vkWaitSemaphoresKHR, vkWaitSemaphores)
+#endif
+#ifdef VK_VERSION_1_3
+    TINYVK_BACKEND_PROC(vkQueueSubmit2)
+    TINYVK_BACKEND_PROC(vkCmdPipelineBarrier2)
+    TINYVK_BACKEND_PROC_ALIAS(vkQueueSubmit2KHR, vkQueueSubmit2)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdPipelineBarrier2KHR, vkCmdPipelineBarrier2)
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetCullModeEXT, vkCmdSetCullMode)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetFrontFaceEXT, vkCmdSetFrontFace)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetPrimitiveTopologyEXT, vkCmdSetPrimitiveTopology)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetViewportWithCountEXT, vkCmdSetViewportWithCount)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetScissorWithCountEXT, vkCmdSetScissorWithCount)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdBindVertexBuffers2EXT, vkCmdBindVertexBuffers2)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetDepthTestEnableEXT, vkCmdSetDepthTestEnable)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetDepthWriteEnableEXT, vkCmdSetDepthWriteEnable)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetDepthCompareOpEXT, vkCmdSetDepthCompareOp)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetDepthBoundsTestEnableEXT, vkCmdSetDepthBoundsTestEnable)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetStencilTestEnableEXT, vkCmdSetStencilTestEnable)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetStencilOpEXT, vkCmdSetStencilOp)
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetRasterizerDiscardEnableEXT, vkCmdSetRasterizerDiscardEnable)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetDepthBiasEnableEXT, vkCmdSetDepthBiasEnable)
+    TINYVK_BACKEND_PROC_ALIAS(vkCmdSetPrimitiveRestartEnableEXT, vkCmdSetPrimitiveRestartEnable)
+    TINYVK_BACKEND_PROC(vkCmdSetLogicOpEXT)
+    TINYVK_BACKEND_PROC(vkCmdSetPatchControlPointsEXT)
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+    TINYVK_BACKEND_PROC(vkCmdSetPolygonModeEXT)
+    TINYVK_BACKEND_PROC(vkCmdSetRasterizationSamplesEXT)
+    TINYVK_BACKEND_PROC(vkCmdSetColorBlendEnableEXT)
+    TINYVK_BACKEND_PROC(vkCmdSetColorBlendEquationEXT)
+    TINYVK_BACKEND_PROC(vkCmdSetColorWriteMaskEXT)
+#endif
+#undef TINYVK_BACKEND_PROC_ALIAS
+#undef TINYVK_BACKEND_PROC
+    if (tinystd::streq(pName, "vkGetMemoryHostPointerPropertiesEXT"))
+        return (PFN_vkVoidFunction)vkGetMemoryHostPointerPropertiesEXT;
     return nullptr;
 }
 
@@ -203,7 +378,7 @@ VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(
     uint32_t                                    queueIndex,
     VkQueue*                                    pQueue)
 {
-
+    *pQueue = VkQueue(uint64_t(queueFamilyIndex + 1) << 16 | queueIndex);
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(
@@ -212,9 +387,43 @@ VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(
     const VkSubmitInfo*                         pSubmits,
     VkFence                                     fence)
 {
+    auto& stats = tinyvk::backend::info.commands;
+    ++stats.queue_submits;
+    stats.submit_infos += submitCount;
+    for (uint32_t i = 0; i < submitCount; ++i) {
+        stats.submitted_command_buffers += pSubmits[i].commandBufferCount;
+        auto* timeline = (const VkTimelineSemaphoreSubmitInfo*)pSubmits[i].pNext;
+        if (!timeline || timeline->sType != VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO)
+            continue;
+        for (uint32_t s = 0; s < timeline->signalSemaphoreValueCount; ++s)
+            tinyvk::backend::signal_pending(pSubmits[i].pSignalSemaphores[s], timeline->pSignalSemaphoreValues[s]);
+    }
+    if (test_debug(tinyvk::backend::queue))
+        printf("vkQueueSubmit (0x%lx) - %u submits\n", uint64_t(queue), submitCount);
     return VK_SUCCESS;
 }
 
+#ifdef VK_VERSION_1_3
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit2(
+    VkQueue                                     queue,
+    uint32_t                                    submitCount,
+    const VkSubmitInfo2*                        pSubmits,
+    VkFence                                     fence)
+{
+    auto& stats = tinyvk::backend::info.commands;
+    ++stats.queue_submits;
+    stats.submit_infos += submitCount;
+    for (uint32_t i = 0; i < submitCount; ++i) {
+        stats.submitted_command_buffers += pSubmits[i].commandBufferInfoCount;
+        for (uint32_t s = 0; s < pSubmits[i].signalSemaphoreInfoCount; ++s)
+            tinyvk::backend::signal_pending(pSubmits[i].pSignalSemaphoreInfos[s].semaphore, pSubmits[i].pSignalSemaphoreInfos[s].value);
+    }
+    if (test_debug(tinyvk::backend::queue))
+        printf("vkQueueSubmit2 (0x%lx) - %u submits\n", uint64_t(queue), submitCount);
+    return VK_SUCCESS;
+}
+#endif
+
 VKAPI_ATTR VkResult VKAPI_CALL vkQueueWaitIdle(
     VkQueue                                     queue)
 {
@@ -275,6 +484,17 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(
     const VkAllocationCallbacks*                pAllocator,
     VkSemaphore*                                pSemaphore)
 {
+    *pSemaphore = VkSemaphore(++tinyvk::backend::info.handle_count.semaphore);
+    uint64_t initial = 0;
+#ifdef VK_VERSION_1_2
+    auto* type = (const VkSemaphoreTypeCreateInfo*)pCreateInfo->pNext;
+    if (type && type->sType == VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO)
+        initial = type->initialValue;
+#endif
+    tinyvk::backend::semaphore_value(*pSemaphore) = initial;
+    tinyvk::backend::semaphore_pending(*pSemaphore) = initial;
+    if (test_debug(tinyvk::backend::queue))
+        printf("vkCreateSemaphore (0x%lx)\n", uint64_t(*pSemaphore));
     return VK_SUCCESS;
 }
 
@@ -286,6 +506,111 @@ VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(
 
 }
 
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(
+    VkDevice                                    device,
+    const VkQueryPoolCreateInfo*                pCreateInfo,
+    const VkAllocationCallbacks*                pAllocator,
+    VkQueryPool*                                pQueryPool)
+{
+    *pQueryPool = VkQueryPool(++tinyvk::backend::info.handle_count.query_pool);
+    uint32_t values = 1;
+    if (pCreateInfo->queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS) {
+        values = 0;
+        for (auto bits = pCreateInfo->pipelineStatistics; bits; bits &= bits - 1) ++values;
+    }
+    tinyvk::backend::info.query_values[uint64_t(*pQueryPool) % 256] = values;
+    if (test_debug(tinyvk::backend::device))
+        printf("vkCreateQueryPool (0x%lx) - %u queries\n", uint64_t(*pQueryPool), pCreateInfo->queryCount);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(
+    VkDevice                                    device,
+    VkQueryPool                                 queryPool,
+    const VkAllocationCallbacks*                pAllocator)
+{
+
+}
+
+/// Every query is available, timestamps advance by 1000 ticks per query and statistic i of a query is (query + 1) * (i + 1)
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(
+    VkDevice                                    device,
+    VkQueryPool                                 queryPool,
+    uint32_t                                    firstQuery,
+    uint32_t                                    queryCount,
+    size_t                                      dataSize,
+    void*                                       pData,
+    VkDeviceSize                                stride,
+    VkQueryResultFlags                          flags)
+{
+    const bool wide = flags & VK_QUERY_RESULT_64_BIT;
+    const bool availability = flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+    const uint32_t values = tinyvk::backend::info.query_values[uint64_t(queryPool) % 256];
+    for (uint32_t i = 0; i < queryCount; ++i) {
+        auto* p = (char*)pData + i * stride;
+        for (uint32_t v = 0; v <= values; ++v) {
+            const uint64_t query = firstQuery + i + 1;
+            const uint64_t value = v == values ? 1 : values == 1 ? query * 1000 : query * (v + 1);
+            if (v == values && !availability) break;
+            if (wide) ((uint64_t*)p)[v] = value;
+            else      ((uint32_t*)p)[v] = uint32_t(value);
+        }
+    }
+    return VK_SUCCESS;
+}
+
+#ifdef VK_VERSION_1_2
+VKAPI_ATTR void VKAPI_CALL vkResetQueryPool(
+    VkDevice                                    device,
+    VkQueryPool                                 queryPool,
+    uint32_t                                    firstQuery,
+    uint32_t                                    queryCount)
+{
+
+}
+#endif
+
+#ifdef VK_VERSION_1_2
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(
+    VkDevice                                    device,
+    VkSemaphore                                 semaphore,
+    uint64_t*                                   pValue)
+{
+    *pValue = tinyvk::backend::semaphore_value(semaphore);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores(
+    VkDevice                                    device,
+    const VkSemaphoreWaitInfo*                  pWaitInfo,
+    uint64_t                                    timeout)
+{
+    // the device finishes whatever was submitted up to the waited value, values never signalled time out
+    uint32_t reached = 0;
+    for (uint32_t i = 0; i < pWaitInfo->semaphoreCount; ++i) {
+        const auto s = pWaitInfo->pSemaphores[i];
+        const uint64_t wanted = pWaitInfo->pValues[i];
+        if (tinyvk::backend::semaphore_pending(s) < wanted && tinyvk::backend::semaphore_value(s) < wanted)
+            continue;
+        auto& value = tinyvk::backend::semaphore_value(s);
+        uint64_t current = value.load();
+        while (current < wanted && !value.compare_exchange_weak(current, wanted)) {}
+        ++reached;
+    }
+    const bool any = (pWaitInfo->flags & VK_SEMAPHORE_WAIT_ANY_BIT) != 0;
+    return (any ? reached > 0 : reached == pWaitInfo->semaphoreCount) ? VK_SUCCESS : VK_TIMEOUT;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkSignalSemaphore(
+    VkDevice                                    device,
+    const VkSemaphoreSignalInfo*                pSignalInfo)
+{
+    tinyvk::backend::semaphore_value(pSignalInfo->semaphore) = pSignalInfo->value;
+    tinyvk::backend::signal_pending(pSignalInfo->semaphore, pSignalInfo->value);
+    return VK_SUCCESS;
+}
+#endif
+
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateEvent(
     VkDevice                                    device,
     const VkEventCreateInfo*                    pCreateInfo,
@@ -398,7 +723,7 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(
     VkPipeline                                  pipeline,
     const VkAllocationCallbacks*                pAllocator)
 {
-
+    if (pipeline) ++tinyvk::backend::info.commands.destroyed_objects;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(
@@ -428,6 +753,20 @@ VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(
     const VkAllocationCallbacks*                pAllocator,
     VkDeviceMemory*                             pMemory)
 {
+    auto& mem = tinyvk::backend::info.memory;
+    const auto props = tinyvk::backend::memory_properties();
+    const uint64_t handle = ++tinyvk::backend::info.handle_count.memory;
+    const uint64_t i = handle % mem.MAX;
+    const uint32_t type = pAllocateInfo->memoryTypeIndex;
+    mem.type[i] = type;
+    mem.size[i] = pAllocateInfo->allocationSize;
+    mem.data[i] = (props.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        ? malloc(size_t(pAllocateInfo->allocationSize)) : nullptr;
+    mem.heap_usage[props.memoryTypes[type].heapIndex] += pAllocateInfo->allocationSize;
+    *pMemory = VkDeviceMemory(handle);
+    if (test_debug(tinyvk::backend::memory)) {
+        printf("vkAllocateMemory (0x%lx) - type %u, size %lu\n", handle, type, uint64_t(pAllocateInfo->allocationSize));
+    }
     return VK_SUCCESS;
 }
 
@@ -436,7 +775,13 @@ VKAPI_ATTR void VKAPI_CALL vkFreeMemory(
     VkDeviceMemory                              memory,
     const VkAllocationCallbacks*                pAllocator)
 {
-
+    if (!memory) return;
+    auto& mem = tinyvk::backend::info.memory;
+    const uint64_t i = uint64_t(memory) % mem.MAX;
+    mem.heap_usage[tinyvk::backend::memory_properties().memoryTypes[mem.type[i]].heapIndex] -= mem.size[i];
+    free(mem.data[i]);
+    mem.data[i] = nullptr;
+    mem.size[i] = 0;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(
@@ -447,6 +792,9 @@ VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(
     VkMemoryMapFlags                            flags,
     void**                                      ppData)
 {
+    auto* data = (char*)tinyvk::backend::info.memory.data[uint64_t(memory) % tinyvk::backend::info.memory.MAX];
+    if (!data) return VK_ERROR_MEMORY_MAP_FAILED;
+    *ppData = data + offset;
     return VK_SUCCESS;
 }
 
@@ -462,6 +810,11 @@ VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(
     uint32_t                                    memoryRangeCount,
     const VkMappedMemoryRange*                  pMemoryRanges)
 {
+    tinyvk::backend::info.commands.flushed_ranges += memoryRangeCount;
+    if (test_debug(tinyvk::backend::memory)) {
+        for (uint32_t i = 0; i < memoryRangeCount; ++i)
+            printf("vkFlushMappedMemoryRanges (0x%lx) - offset %lu, size %lu\n", uint64_t(pMemoryRanges[i].memory), uint64_t(pMemoryRanges[i].offset), uint64_t(pMemoryRanges[i].size));
+    }
     return VK_SUCCESS;
 }
 
@@ -496,14 +849,22 @@ VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(
     VkBuffer                                    buffer,
     VkMemoryRequirements*                       pMemoryRequirements)
 {
-
+    *pMemoryRequirements = tinyvk::backend::info.buffers.value[uint64_t(buffer) % tinyvk::backend::info.buffers.MAX];
 }
 
 VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties2(
     VkPhysicalDevice                            physicalDevice,
     VkPhysicalDeviceMemoryProperties2*          pMemoryProperties)
 {
-
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &pMemoryProperties->memoryProperties);
+    for (auto* p = (VkBaseOutStructure*)pMemoryProperties->pNext; p; p = p->pNext) {
+        if (p->sType != VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT) continue;
+        auto* budget = (VkPhysicalDeviceMemoryBudgetPropertiesEXT*)p;
+        for (uint32_t h = 0; h < pMemoryProperties->memoryProperties.memoryHeapCount; ++h) {
+            budget->heapUsage[h] = tinyvk::backend::info.memory.heap_usage[h];
+            budget->heapBudget[h] = pMemoryProperties->memoryProperties.memoryHeaps[h].size / 4 * 3;
+        }
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(
@@ -511,7 +872,7 @@ VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(
     VkImage                                     image,
     VkMemoryRequirements*                       pMemoryRequirements)
 {
-
+    *pMemoryRequirements = tinyvk::backend::info.images.value[uint64_t(image) % tinyvk::backend::info.images.MAX];
 }
 
 VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(
@@ -519,7 +880,7 @@ VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(
     const VkImageMemoryRequirementsInfo2*       pInfo,
     VkMemoryRequirements2*                      pMemoryRequirements)
 {
-
+    vkGetImageMemoryRequirements(device, pInfo->image, &pMemoryRequirements->memoryRequirements);
 }
 
 VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(
@@ -527,7 +888,7 @@ VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(
     const VkBufferMemoryRequirementsInfo2*      pInfo,
     VkMemoryRequirements2*                      pMemoryRequirements)
 {
-
+    vkGetBufferMemoryRequirements(device, pInfo->buffer, &pMemoryRequirements->memoryRequirements);
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory2(
@@ -556,6 +917,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateSampler(
     const VkAllocationCallbacks*                pAllocator,
     VkSampler*                                  pSampler)
 {
+    *pSampler = VkSampler(++tinyvk::backend::info.handle_count.sampler);
     return VK_SUCCESS;
 }
 
@@ -564,7 +926,7 @@ VKAPI_ATTR void VKAPI_CALL vkDestroySampler(
     VkSampler                                   sampler,
     const VkAllocationCallbacks*                pAllocator)
 {
-
+    if (sampler) ++tinyvk::backend::info.commands.destroyed_objects;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(
@@ -573,6 +935,20 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(
     const VkAllocationCallbacks*                pAllocator,
     VkImage*                                    pImage)
 {
+    // 4 bytes per texel for every mip level and layer, transient attachments may be lazily allocated
+    const uint64_t handle = ++tinyvk::backend::info.handle_count.image;
+    const auto& e = pCreateInfo->extent;
+    VkDeviceSize size = 0;
+    for (uint32_t mip = 0; mip < pCreateInfo->mipLevels; ++mip) {
+        const auto w = std::max(e.width >> mip, 1u), h = std::max(e.height >> mip, 1u), d = std::max(e.depth >> mip, 1u);
+        size += VkDeviceSize(w) * h * d * 4 * pCreateInfo->arrayLayers;
+    }
+    auto& req = tinyvk::backend::info.images.value[handle % tinyvk::backend::info.images.MAX];
+    req.alignment = 4096;
+    req.size = tinyvk::backend::align_up(size, req.alignment);
+    const bool lazy = tinyvk::backend::info.lazily_allocated_memory && (pCreateInfo->usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT);
+    req.memoryTypeBits = 0x1u | (lazy ? 0x8u : 0u);
+    *pImage = VkImage(handle);
     return VK_SUCCESS;
 }
 
@@ -581,7 +957,7 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyImage(
     VkImage                                     image,
     const VkAllocationCallbacks*                pAllocator)
 {
-
+    if (image) ++tinyvk::backend::info.commands.destroyed_objects;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(
@@ -590,6 +966,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(
     const VkAllocationCallbacks*                pAllocator,
     VkImageView*                                pView)
 {
+    *pView = VkImageView(++tinyvk::backend::info.handle_count.image_view);
     return VK_SUCCESS;
 }
 
@@ -598,7 +975,7 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(
     VkImageView                                 imageView,
     const VkAllocationCallbacks*                pAllocator)
 {
-
+    if (imageView) ++tinyvk::backend::info.commands.destroyed_objects;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(
@@ -607,6 +984,12 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(
     const VkAllocationCallbacks*                pAllocator,
     VkBuffer*                                   pBuffer)
 {
+    const uint64_t handle = ++tinyvk::backend::info.handle_count.buffer;
+    auto& req = tinyvk::backend::info.buffers.value[handle % tinyvk::backend::info.buffers.MAX];
+    req.alignment = 256;
+    req.size = tinyvk::backend::align_up(pCreateInfo->size, req.alignment);
+    req.memoryTypeBits = 0x7u;
+    *pBuffer = VkBuffer(handle);
     return VK_SUCCESS;
 }
 
@@ -615,7 +998,7 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(
     VkBuffer                                    buffer,
     const VkAllocationCallbacks*                pAllocator)
 {
-
+    if (buffer) ++tinyvk::backend::info.commands.destroyed_objects;
 }
 
 //endregion
@@ -702,6 +1085,16 @@ VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(
     uint32_t                                    descriptorCopyCount,
     const VkCopyDescriptorSet*                  pDescriptorCopies)
 {
+    auto& views = tinyvk::backend::info.written_images;
+    views.count = 0;
+    tinyvk::backend::info.commands.descriptor_writes += descriptorWriteCount;
+    for (uint32_t i = 0; i < descriptorWriteCount; ++i) {
+        auto& w = pDescriptorWrites[i];
+        tinyvk::backend::info.commands.written_descriptors += w.descriptorCount;
+        const bool image = w.descriptorType <= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || w.descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        for (uint32_t j = 0; image && j < w.descriptorCount && views.count < views.MAX; ++j)
+            views.value[views.count++] = w.pImageInfo[j].imageView;
+    }
     if (test_debug(tinyvk::backend::descriptor_set)) {
         printf("vkUpdateDescriptorSets: writes (%u), copies (%u) - \n", descriptorWriteCount, descriptorCopyCount);
         for (uint32_t i = 0; i < descriptorWriteCount; ++i) {
@@ -778,6 +1171,10 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(
     const VkAllocationCallbacks*                pAllocator,
     VkCommandPool*                              pCommandPool)
 {
+    *pCommandPool = (VkCommandPool)(++tinyvk::backend::info.handle_count.command_pool);
+    if (test_debug(tinyvk::backend::command_pool)) {
+        printf("vkCreateCommandPool (0x%lx) - queue family %u\n", uint64_t(*pCommandPool), pCreateInfo->queueFamilyIndex);
+    }
     return VK_SUCCESS;
 }
 
@@ -786,7 +1183,9 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(
     VkCommandPool                               commandPool,
     const VkAllocationCallbacks*                pAllocator)
 {
-
+    if (test_debug(tinyvk::backend::command_pool)) {
+        printf("vkDestroyCommandPool (0x%lx)\n", uint64_t(commandPool));
+    }
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(
@@ -794,6 +1193,9 @@ VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(
     VkCommandPool                               commandPool,
     VkCommandPoolResetFlags                     flags)
 {
+    if (test_debug(tinyvk::backend::command_pool)) {
+        printf("vkResetCommandPool (0x%lx)\n", uint64_t(commandPool));
+    }
     return VK_SUCCESS;
 }
 
@@ -802,6 +1204,11 @@ VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(
     const VkCommandBufferAllocateInfo*          pAllocateInfo,
     VkCommandBuffer*                            pCommandBuffers)
 {
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; ++i)
+        pCommandBuffers[i] = (VkCommandBuffer)(++tinyvk::backend::info.handle_count.command);
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkAllocateCommandBuffers (0x%lx) - %u buffers\n", uint64_t(pAllocateInfo->commandPool), pAllocateInfo->commandBufferCount);
+    }
     return VK_SUCCESS;
 }
 
@@ -915,6 +1322,185 @@ VKAPI_ATTR void VKAPI_CALL vkCmdSetStencilReference(
 
 }
 
+#ifdef VK_VERSION_1_3
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetCullMode(
+    VkCommandBuffer                             commandBuffer,
+    VkCullModeFlags                             cullMode)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetFrontFace(
+    VkCommandBuffer                             commandBuffer,
+    VkFrontFace                                 frontFace)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetPrimitiveTopology(
+    VkCommandBuffer                             commandBuffer,
+    VkPrimitiveTopology                         primitiveTopology)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetViewportWithCount(
+    VkCommandBuffer                             commandBuffer,
+    uint32_t                                    viewportCount,
+    const VkViewport*                           pViewports)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetScissorWithCount(
+    VkCommandBuffer                             commandBuffer,
+    uint32_t                                    scissorCount,
+    const VkRect2D*                             pScissors)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers2(
+    VkCommandBuffer                             commandBuffer,
+    uint32_t                                    firstBinding,
+    uint32_t                                    bindingCount,
+    const VkBuffer*                             pBuffers,
+    const VkDeviceSize*                         pOffsets,
+    const VkDeviceSize*                         pSizes,
+    const VkDeviceSize*                         pStrides)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetDepthTestEnable(
+    VkCommandBuffer                             commandBuffer,
+    VkBool32                                    depthTestEnable)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetDepthWriteEnable(
+    VkCommandBuffer                             commandBuffer,
+    VkBool32                                    depthWriteEnable)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetDepthCompareOp(
+    VkCommandBuffer                             commandBuffer,
+    VkCompareOp                                 depthCompareOp)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetDepthBoundsTestEnable(
+    VkCommandBuffer                             commandBuffer,
+    VkBool32                                    depthBoundsTestEnable)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetStencilTestEnable(
+    VkCommandBuffer                             commandBuffer,
+    VkBool32                                    stencilTestEnable)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetStencilOp(
+    VkCommandBuffer                             commandBuffer,
+    VkStencilFaceFlags                          faceMask,
+    VkStencilOp                                 failOp,
+    VkStencilOp                                 passOp,
+    VkStencilOp                                 depthFailOp,
+    VkCompareOp                                 compareOp)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetRasterizerDiscardEnable(
+    VkCommandBuffer                             commandBuffer,
+    VkBool32                                    rasterizerDiscardEnable)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetDepthBiasEnable(
+    VkCommandBuffer                             commandBuffer,
+    VkBool32                                    depthBiasEnable)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetPrimitiveRestartEnable(
+    VkCommandBuffer                             commandBuffer,
+    VkBool32                                    primitiveRestartEnable)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetLogicOpEXT(
+    VkCommandBuffer                             commandBuffer,
+    VkLogicOp                                   logicOp)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetPatchControlPointsEXT(
+    VkCommandBuffer                             commandBuffer,
+    uint32_t                                    patchControlPoints)
+{
+
+}
+
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state3
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetPolygonModeEXT(
+    VkCommandBuffer                             commandBuffer,
+    VkPolygonMode                               polygonMode)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetRasterizationSamplesEXT(
+    VkCommandBuffer                             commandBuffer,
+    VkSampleCountFlagBits                       rasterizationSamples)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetColorBlendEnableEXT(
+    VkCommandBuffer                             commandBuffer,
+    uint32_t                                    firstAttachment,
+    uint32_t                                    attachmentCount,
+    const VkBool32*                             pColorBlendEnables)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetColorBlendEquationEXT(
+    VkCommandBuffer                             commandBuffer,
+    uint32_t                                    firstAttachment,
+    uint32_t                                    attachmentCount,
+    const VkColorBlendEquationEXT*              pColorBlendEquations)
+{
+
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetColorWriteMaskEXT(
+    VkCommandBuffer                             commandBuffer,
+    uint32_t                                    firstAttachment,
+    uint32_t                                    attachmentCount,
+    const VkColorComponentFlags*                pColorWriteMasks)
+{
+
+}
+
+#endif
+
 VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(
     VkCommandBuffer                             commandBuffer,
     VkPipelineBindPoint                         pipelineBindPoint,
@@ -954,7 +1540,10 @@ VKAPI_ATTR void VKAPI_CALL vkCmdDraw(
     uint32_t                                    firstVertex,
     uint32_t                                    firstInstance)
 {
-
+    ++tinyvk::backend::info.commands.draws;
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkCmdDraw (0x%lx) - %u vertices x %u instances\n", uint64_t(commandBuffer), vertexCount, instanceCount);
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(
@@ -965,7 +1554,10 @@ VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(
     int32_t                                     vertexOffset,
     uint32_t                                    firstInstance)
 {
-
+    ++tinyvk::backend::info.commands.draws;
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkCmdDrawIndexed (0x%lx) - %u indices x %u instances\n", uint64_t(commandBuffer), indexCount, instanceCount);
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndirect(
@@ -994,7 +1586,11 @@ VKAPI_ATTR void VKAPI_CALL vkCmdDispatch(
     uint32_t                                    groupCountY,
     uint32_t                                    groupCountZ)
 {
-
+    ++tinyvk::backend::info.commands.dispatches;
+    tinyvk::backend::info.commands.dispatched_groups += groupCountX * groupCountY * groupCountZ;
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkCmdDispatch (0x%lx) - %u x %u x %u\n", uint64_t(commandBuffer), groupCountX, groupCountY, groupCountZ);
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL vkCmdDispatchIndirect(
@@ -1012,7 +1608,11 @@ VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(
     uint32_t                                    regionCount,
     const VkBufferCopy*                         pRegions)
 {
-
+    ++tinyvk::backend::info.commands.copies;
+    tinyvk::backend::info.commands.copy_regions += regionCount;
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkCmdCopyBuffer (0x%lx) - 0x%lx -> 0x%lx, %u regions\n", uint64_t(commandBuffer), uint64_t(srcBuffer), uint64_t(dstBuffer), regionCount);
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL vkCmdCopyImage(
@@ -1024,7 +1624,11 @@ VKAPI_ATTR void VKAPI_CALL vkCmdCopyImage(
     uint32_t                                    regionCount,
     const VkImageCopy*                          pRegions)
 {
-
+    ++tinyvk::backend::info.commands.copies;
+    tinyvk::backend::info.commands.copy_regions += regionCount;
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkCmdCopyImage (0x%lx) - 0x%lx -> 0x%lx, %u regions\n", uint64_t(commandBuffer), uint64_t(srcImage), uint64_t(dstImage), regionCount);
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL vkCmdBlitImage(
@@ -1048,7 +1652,11 @@ VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(
     uint32_t                                    regionCount,
     const VkBufferImageCopy*                    pRegions)
 {
-
+    ++tinyvk::backend::info.commands.copies;
+    tinyvk::backend::info.commands.copy_regions += regionCount;
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkCmdCopyBufferToImage (0x%lx) - 0x%lx -> 0x%lx, %u regions\n", uint64_t(commandBuffer), uint64_t(srcBuffer), uint64_t(dstImage), regionCount);
+    }
 }
 
 VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(
@@ -1170,8 +1778,33 @@ VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(
     uint32_t                                    imageMemoryBarrierCount,
     const VkImageMemoryBarrier*                 pImageMemoryBarriers)
 {
+    auto& stats = tinyvk::backend::info.commands;
+    ++stats.pipeline_barriers;
+    stats.memory_barriers += memoryBarrierCount;
+    stats.buffer_barriers += bufferMemoryBarrierCount;
+    stats.image_barriers += imageMemoryBarrierCount;
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkCmdPipelineBarrier (0x%lx) - %u memory, %u buffer, %u image\n", uint64_t(commandBuffer),
+            memoryBarrierCount, bufferMemoryBarrierCount, imageMemoryBarrierCount);
+    }
+}
 
+#ifdef VK_VERSION_1_3
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier2(
+    VkCommandBuffer                             commandBuffer,
+    const VkDependencyInfo*                     pDependencyInfo)
+{
+    auto& stats = tinyvk::backend::info.commands;
+    ++stats.pipeline_barriers;
+    stats.memory_barriers += pDependencyInfo->memoryBarrierCount;
+    stats.buffer_barriers += pDependencyInfo->bufferMemoryBarrierCount;
+    stats.image_barriers += pDependencyInfo->imageMemoryBarrierCount;
+    if (test_debug(tinyvk::backend::command)) {
+        printf("vkCmdPipelineBarrier2 (0x%lx) - %u memory, %u buffer, %u image\n", uint64_t(commandBuffer),
+            pDependencyInfo->memoryBarrierCount, pDependencyInfo->bufferMemoryBarrierCount, pDependencyInfo->imageMemoryBarrierCount);
+    }
 }
+#endif
 
 VKAPI_ATTR void VKAPI_CALL vkCmdBeginQuery(
     VkCommandBuffer                             commandBuffer,
@@ -1205,7 +1838,7 @@ VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(
     VkQueryPool                                 queryPool,
     uint32_t                                    query)
 {
-
+    ++tinyvk::backend::info.commands.timestamps;
 }
 
 VKAPI_ATTR void VKAPI_CALL vkCmdCopyQueryPoolResults(
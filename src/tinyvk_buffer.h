@@ -8,6 +8,7 @@
 #include "tinyvk_core.h"
 #ifdef TINYVK_USE_VMA
 #include "vk_mem_alloc.h"
+#include "tinyvk_memory_stats.h"
 #endif
 
 namespace tinyvk {
@@ -43,15 +44,24 @@ struct buffer_desc {
 
 struct buffer : type_wrapper<buffer, VkBuffer> {
 
+    /// stats (optional) tracks the allocation in category until destroy releases it
     static buffer                   create(
             VmaAllocator                vma,
             VmaAllocation&              vma_alloc,
             buffer_desc                 desc,
-            void**                      p_mapped_data = {}) NEX;
+            void**                      p_mapped_data = {},
+            memory_stats*               stats = {},
+            memory_category_t           category = MEMORY_CATEGORY_BUFFER) NEX;
 
     void                            destroy(
             VmaAllocator                vma,
-            VmaAllocation               vma_alloc) NEX;
+            VmaAllocation               vma_alloc,
+            memory_stats*               stats = {},
+            memory_category_t           category = MEMORY_CATEGORY_BUFFER) NEX;
+
+    /// The create info create uses for desc, desc.queue_families must outlive it
+    static VkBufferCreateInfo       create_info(
+            const buffer_desc&          desc) NEX;
 
     static void                     map(
             VmaAllocator                vma,
@@ -93,18 +103,13 @@ buffer::create(
         VmaAllocator vma,
         VmaAllocation& vma_alloc,
         buffer_desc desc,
-        void** p_mapped_data) NEX
+        void** p_mapped_data,
+        memory_stats* stats,
+        memory_category_t category) NEX
 {
     buffer b{};
 
-    const u64 alignment = tinystd::max(desc.alignment, 4ull);
-    const u64 size = tinystd::round_up(desc.size, alignment);
-
-    VkBufferCreateInfo buffer_info { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-    buffer_info.size = size;
-    buffer_info.usage = VkBufferUsageFlags(desc.usage);
-    buffer_info.sharingMode = VkSharingMode(!desc.queue_families.empty());
-    buffer_info.pQueueFamilyIndices = desc.queue_families.data();
+    const VkBufferCreateInfo buffer_info = create_info(desc);
 
     VmaAllocationCreateInfo alloc_info{};
     alloc_info.usage = VmaMemoryUsage(desc.mem_usage);
@@ -116,6 +121,8 @@ buffer::create(
 
     if (p_mapped_data)
         *p_mapped_data = info.pMappedData;
+    if (stats)
+        stats->track(category, info.size);
 
     return b;
 }
@@ -123,12 +130,31 @@ buffer::create(
 void
 buffer::destroy(
         VmaAllocator vma,
-        VmaAllocation vma_alloc) NEX
+        VmaAllocation vma_alloc,
+        memory_stats* stats,
+        memory_category_t category) NEX
 {
+    if (stats)
+        stats->release(vma, category, vma_alloc);
     vmaDestroyBuffer(vma, vk, vma_alloc);
     vk = {};
 }
 
+VkBufferCreateInfo
+buffer::create_info(
+        const buffer_desc& desc) NEX
+{
+    const u64 alignment = tinystd::max(desc.alignment, 4ull);
+
+    VkBufferCreateInfo buffer_info { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    buffer_info.size = tinystd::round_up(desc.size, alignment);
+    buffer_info.usage = VkBufferUsageFlags(desc.usage);
+    buffer_info.sharingMode = VkSharingMode(!desc.queue_families.empty());
+    buffer_info.queueFamilyIndexCount = u32(desc.queue_families.size());
+    buffer_info.pQueueFamilyIndices = desc.queue_families.data();
+    return buffer_info;
+}
+
 void
 buffer::map(
         VmaAllocator vma,
@@ -6,6 +6,9 @@
 #define TINYVK_COMMAND_H
 
 #include "tinyvk_core.h"
+#ifndef TINYVK_NO_JOBS
+#include "tinystd_jobs.h"
+#endif
 
 namespace tinyvk {
 
@@ -25,6 +28,412 @@ struct command : type_wrapper<command, VkCommandBuffer> {
             u32                         height,
             u32                         mip_levels = -1u) const NEX;
 
+    /// Query functions
+    void                begin_query(
+            VkQueryPool                 pool,
+            u32                         query,
+            VkQueryControlFlags         flags = 0) const NEX;
+
+    void                end_query(
+            VkQueryPool                 pool,
+            u32                         query) const NEX;
+
+    void                reset_queries(
+            VkQueryPool                 pool,
+            u32                         first,
+            u32                         count) const NEX;
+
+    void                write_timestamp(
+            VkQueryPool                 pool,
+            u32                         query,
+            VkPipelineStageFlagBits     stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT) const NEX;
+
+    /// Secondary command buffer functions
+    void                execute_commands(
+            span<const VkCommandBuffer> cmds) const NEX;
+
+    /// Dynamic state functions
+    void                set_viewport(
+            const VkViewport&           viewport) const NEX;
+
+    void                set_scissor(
+            const VkRect2D&             scissor) const NEX;
+
+    void                set_line_width(
+            float                       width) const NEX;
+
+    void                set_depth_bias(
+            float                       constant,
+            float                       clamp,
+            float                       slope) const NEX;
+
+    void                set_blend_constants(
+            const float                 (&constants)[4]) const NEX;
+
+    void                set_depth_bounds(
+            float                       min,
+            float                       max) const NEX;
+
+    void                set_stencil_compare_mask(
+            VkStencilFaceFlags          faces,
+            u32                         mask) const NEX;
+
+    void                set_stencil_write_mask(
+            VkStencilFaceFlags          faces,
+            u32                         mask) const NEX;
+
+    void                set_stencil_reference(
+            VkStencilFaceFlags          faces,
+            u32                         reference) const NEX;
+
+#ifdef VK_EXT_extended_dynamic_state
+    /// Extended dynamic state functions (VK_EXT_extended_dynamic_state/2/3, the first two are core in 1.3)
+    /// These are not exported by the loader, load_dynamic_state_ext loads them for device (the extension names,
+    /// or the core ones on a 1.3 device without the extensions). device::create calls it
+    static void         load_dynamic_state_ext(
+            VkDevice                    device) NEX;
+
+    void                set_cull_mode(
+            VkCullModeFlags             cull_mode) const NEX;
+
+    void                set_front_face(
+            VkFrontFace                 front_face) const NEX;
+
+    void                set_topology(
+            VkPrimitiveTopology         topology) const NEX;
+
+    void                set_viewports(
+            span<const VkViewport>      viewports) const NEX;
+
+    void                set_scissors(
+            span<const VkRect2D>        scissors) const NEX;
+
+    void                bind_vertex_buffers(
+            u32                         first_binding,
+            span<const VkBuffer>        buffers,
+            span<const VkDeviceSize>    offsets,
+            span<const VkDeviceSize>    strides) const NEX;
+
+    void                set_depth_test(
+            bool                        enable) const NEX;
+
+    void                set_depth_write(
+            bool                        enable) const NEX;
+
+    void                set_depth_compare(
+            VkCompareOp                 compare_op) const NEX;
+
+    void                set_depth_bounds_test(
+            bool                        enable) const NEX;
+
+    void                set_stencil_test(
+            bool                        enable) const NEX;
+
+    void                set_stencil_op(
+            VkStencilFaceFlags          faces,
+            VkStencilOp                 fail,
+            VkStencilOp                 pass,
+            VkStencilOp                 depth_fail,
+            VkCompareOp                 compare_op) const NEX;
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state2
+    void                set_rasterizer_discard(
+            bool                        enable) const NEX;
+
+    void                set_depth_bias_enable(
+            bool                        enable) const NEX;
+
+    void                set_primitive_restart(
+            bool                        enable) const NEX;
+
+    void                set_logic_op(
+            VkLogicOp                   logic_op) const NEX;
+
+    void                set_patch_control_points(
+            u32                         control_points) const NEX;
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state3
+    void                set_polygon_mode(
+            VkPolygonMode               polygon_mode) const NEX;
+
+    void                set_rasterization_samples(
+            sample_count_t              samples) const NEX;
+
+    void                set_blend_enable(
+            u32                         first_attachment,
+            span<const VkBool32>        enable) const NEX;
+
+    void                set_blend_equation(
+            u32                         first_attachment,
+            span<const VkColorBlendEquationEXT> equations) const NEX;
+
+    void                set_color_write_mask(
+            u32                         first_attachment,
+            span<const VkColorComponentFlags> masks) const NEX;
+#endif
+};
+
+
+/// Records through a command while remembering the bound pipelines, descriptor sets, vertex/index buffers,
+/// push constants and dynamic state, binds and sets that would not change anything are dropped.
+/// A pipeline with static state overwrites the corresponding dynamic state, so binding a different pipeline
+/// forgets all dynamic state unless the caller knows every pipeline declares the same dynamic states.
+/// Call invalidate after recording anything that disturbs state behind the recorder's back (e.g. vkCmdExecuteCommands).
+struct command_recorder {
+    enum state_t : u32 {
+        STATE_VIEWPORT,
+        STATE_SCISSOR,
+        STATE_LINE_WIDTH,
+        STATE_DEPTH_BIAS,
+        STATE_BLEND_CONSTANTS,
+        STATE_DEPTH_BOUNDS,
+        STATE_STENCIL_COMPARE_MASK_FRONT,
+        STATE_STENCIL_COMPARE_MASK_BACK,
+        STATE_STENCIL_WRITE_MASK_FRONT,
+        STATE_STENCIL_WRITE_MASK_BACK,
+        STATE_STENCIL_REFERENCE_FRONT,
+        STATE_STENCIL_REFERENCE_BACK,
+        STATE_CULL_MODE,
+        STATE_FRONT_FACE,
+        STATE_TOPOLOGY,
+        STATE_DEPTH_TEST,
+        STATE_DEPTH_WRITE,
+        STATE_DEPTH_COMPARE,
+        STATE_DEPTH_BOUNDS_TEST,
+        STATE_STENCIL_TEST,
+        STATE_STENCIL_OP_FRONT,
+        STATE_STENCIL_OP_BACK,
+        STATE_RASTERIZER_DISCARD,
+        STATE_DEPTH_BIAS_ENABLE,
+        STATE_PRIMITIVE_RESTART,
+        STATE_COUNT
+    };
+
+    struct bind_point_state {
+        VkPipeline              pipeline{};
+        VkPipelineLayout        layout{};
+        u32                     set_mask{};
+        VkDescriptorSet         sets[MAX_BOUND_DESCRIPTOR_SETS]{};
+    };
+
+    command                     cmd{};
+    bind_point_state            bind_points[3]{};
+    u32                         vertex_mask{};
+    VkBuffer                    vertex_buffers[MAX_VERTEX_BINDINGS]{};
+    VkDeviceSize                vertex_offsets[MAX_VERTEX_BINDINGS]{};
+    VkBuffer                    index_buffer{};
+    VkDeviceSize                index_offset{};
+    VkIndexType                 index_type{};
+    VkPipelineLayout            push_layout{};
+    VkShaderStageFlags          push_stages{};
+    u32                         push_begin{};
+    u32                         push_end{};
+    u8                          push_data[MAX_PUSH_CONSTANT_SIZE]{};
+    u64                         state_mask{};
+    u32                         state_values[STATE_COUNT][6]{};
+    u32                         issued{};
+    u32                         dropped{};
+
+    /// Start recording into cmd, all state is unknown at the start of a command buffer
+    void                begin(
+            command                     cmd) NEX;
+
+    void                invalidate() NEX;
+
+    NDC u32             dropped_count() const NEX { return dropped; }
+
+    NDC u32             issued_count() const NEX { return issued; }
+
+    void                bind_pipeline(
+            VkPipelineBindPoint         bind_point,
+            VkPipeline                  pipeline,
+            bool                        same_dynamic_states = false) NEX;
+
+    void                bind_descriptor_sets(
+            VkPipelineBindPoint         bind_point,
+            VkPipelineLayout            layout,
+            u32                         first_set,
+            span<const VkDescriptorSet> sets,
+            span<const u32>             dynamic_offsets = {}) NEX;
+
+    void                bind_vertex_buffers(
+            u32                         first_binding,
+            span<const VkBuffer>        buffers,
+            span<const VkDeviceSize>    offsets) NEX;
+
+    void                bind_index_buffer(
+            VkBuffer                    buffer,
+            VkDeviceSize                offset,
+            VkIndexType                 index_type) NEX;
+
+    void                push_constants(
+            VkPipelineLayout            layout,
+            VkShaderStageFlags          stages,
+            u32                         offset,
+            u32                         size,
+            const void*                 data) NEX;
+
+    void                set_viewport(
+            const VkViewport&           viewport) NEX;
+
+    void                set_scissor(
+            const VkRect2D&             scissor) NEX;
+
+    void                set_line_width(
+            float                       width) NEX;
+
+    void                set_depth_bias(
+            float                       constant,
+            float                       clamp,
+            float                       slope) NEX;
+
+    void                set_blend_constants(
+            const float                 (&constants)[4]) NEX;
+
+    void                set_depth_bounds(
+            float                       min,
+            float                       max) NEX;
+
+    void                set_stencil_compare_mask(
+            VkStencilFaceFlags          faces,
+            u32                         mask) NEX;
+
+    void                set_stencil_write_mask(
+            VkStencilFaceFlags          faces,
+            u32                         mask) NEX;
+
+    void                set_stencil_reference(
+            VkStencilFaceFlags          faces,
+            u32                         reference) NEX;
+
+#ifdef VK_EXT_extended_dynamic_state
+    void                set_cull_mode(
+            VkCullModeFlags             cull_mode) NEX;
+
+    void                set_front_face(
+            VkFrontFace                 front_face) NEX;
+
+    void                set_topology(
+            VkPrimitiveTopology         topology) NEX;
+
+    void                set_depth_test(
+            bool                        enable) NEX;
+
+    void                set_depth_write(
+            bool                        enable) NEX;
+
+    void                set_depth_compare(
+            VkCompareOp                 compare_op) NEX;
+
+    void                set_depth_bounds_test(
+            bool                        enable) NEX;
+
+    void                set_stencil_test(
+            bool                        enable) NEX;
+
+    void                set_stencil_op(
+            VkStencilFaceFlags          faces,
+            VkStencilOp                 fail,
+            VkStencilOp                 pass,
+            VkStencilOp                 depth_fail,
+            VkCompareOp                 compare_op) NEX;
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state2
+    void                set_rasterizer_discard(
+            bool                        enable) NEX;
+
+    void                set_depth_bias_enable(
+            bool                        enable) NEX;
+
+    void                set_primitive_restart(
+            bool                        enable) NEX;
+#endif
+
+private:
+    NDC bool            filter(
+            state_t                     state,
+            const void*                 value,
+            size_t                      size) NEX;
+
+    NDC VkStencilFaceFlags filter_faces(
+            VkStencilFaceFlags          faces,
+            state_t                     front,
+            const void*                 value,
+            size_t                      size) NEX;
+};
+
+
+/// Stage and access masks are 64 bit when the headers have synchronization2, so the finer grained stages
+/// (e.g. VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT) can be used everywhere
+struct barrier_access {
+    pipeline_stage_flags        stage{};
+    access_flags                access{};
+};
+
+
+/// Collects memory, buffer and image barriers and records them with a single pipeline barrier.
+/// Identical barriers are dropped, image barriers that only differ in adjacent mip levels or array layers
+/// and buffer barriers over adjacent ranges are merged. Flush before the first command that depends on them.
+struct barrier_batch {
+    struct masks_t {
+        barrier_access          src{};
+        barrier_access          dst{};
+    };
+
+    small_vector<VkImageMemoryBarrier, 16>  images{};
+    small_vector<masks_t, 16>               image_masks{};
+    small_vector<VkBufferMemoryBarrier, 8>  buffers{};
+    small_vector<masks_t, 8>                buffer_masks{};
+    masks_t                                 memory{};
+    VkDependencyFlags                       dependency_flags{};
+
+    void                global(
+            barrier_access              src,
+            barrier_access              dst) NEX;
+
+    void                buffer(
+            VkBuffer                    buffer,
+            barrier_access              src,
+            barrier_access              dst,
+            VkDeviceSize                offset = 0,
+            VkDeviceSize                size = VK_WHOLE_SIZE,
+            u32                         src_queue_family = VK_QUEUE_FAMILY_IGNORED,
+            u32                         dst_queue_family = VK_QUEUE_FAMILY_IGNORED) NEX;
+
+    void                image(
+            VkImage                     image,
+            const VkImageSubresourceRange& range,
+            VkImageLayout               old_layout,
+            VkImageLayout               new_layout,
+            barrier_access              src,
+            barrier_access              dst,
+            u32                         src_queue_family = VK_QUEUE_FAMILY_IGNORED,
+            u32                         dst_queue_family = VK_QUEUE_FAMILY_IGNORED) NEX;
+
+    NDC bool            empty() const NEX;
+
+    void                clear() NEX;
+
+    /// Record everything as one pipeline barrier and clear the batch. This is flush2 with TINYVK_USE_SYNCHRONIZATION2
+    /// on a device that supports synchronization2, otherwise vkCmdPipelineBarrier with the union of all (legacy)
+    /// stage masks
+    void                flush(
+            VkCommandBuffer             cmd) NEX;
+
+#ifdef VK_VERSION_1_3
+    /// Load vkCmdPipelineBarrier2 (core in Vulkan 1.3, VK_KHR_synchronization2 before), device::create calls it when
+    /// TINYVK_USE_SYNCHRONIZATION2 is defined, with the device if it supports synchronization2, with null (unloads it,
+    /// flush falls back to the legacy barrier) otherwise
+    static void         load_synchronization2(
+            VkDevice                    device) NEX;
+
+    /// Record everything as one vkCmdPipelineBarrier2, every barrier keeps its own 64 bit stage and access masks
+    void                flush2(
+            VkCommandBuffer             cmd) NEX;
+#endif
 };
 
 
@@ -50,6 +459,149 @@ struct command_pool : type_wrapper<command_pool, VkCommandPool> {
             span<VkCommandBuffer>       cmds) const NEX;
 };
 
+
+/// Transient command pools for every (frame in flight, recording thread, queue family),
+/// each pool is reset wholesale once the fence of its frame has signalled.
+/// A thread only ever touches the pools of its own thread index, so handing out
+/// command buffers needs no locks - reset_frame must not race with recording into the same frame.
+struct command_ring {
+    struct slot_t {
+        command_pool            pool{};
+        u32                     used[2]{};
+        u32                     allocated[2]{};
+        VkCommandBuffer         cmds[2][MAX_RING_COMMAND_BUFFERS]{};
+    };
+
+    small_vector<slot_t, 1>     slots{};
+    u32                         families[MAX_QUEUE_FAMILIES]{};
+    u32                         family_count{};
+    u32                         frame_count{};
+    u32                         thread_count{};
+
+    static command_ring create(
+            VkDevice                    device,
+            span<const u32>             queue_families,
+            u32                         frames_in_flight,
+            u32                         threads,
+            vk_alloc                    alloc = {}) NEX;
+
+    void                destroy(
+            VkDevice                    device,
+            vk_alloc                    alloc = {}) NEX;
+
+    NDC command         allocate(
+            VkDevice                    device,
+            u32                         frame,
+            u32                         thread,
+            u32                         queue_family,
+            bool secondary = false) NEX;
+
+    NDC ibool           reset_frame(
+            VkDevice                    device,
+            u32                         frame,
+            VkFence                     fence,
+            bool wait = true) NEX;
+
+    void                reset_frame(
+            VkDevice                    device,
+            u32                         frame) NEX;
+
+    NDC slot_t&         slot(
+            u32                         frame,
+            u32                         thread,
+            u32                         queue_family) NEX;
+
+#ifndef TINYVK_NO_JOBS
+    using record_fn = void(*)(command cmd, u32 index, void* data);
+
+    /// Record cmds.size() secondary command buffers in parallel, fn is called once per index between begin and end.
+    /// Each job allocates from the ring slot of the worker running it, so the ring needs a thread per worker.
+    void                record_secondary(
+            tinystd::job_system&        jobs,
+            VkDevice                    device,
+            u32                         frame,
+            u32                         queue_family,
+            const VkCommandBufferInheritanceInfo& inheritance,
+            span<VkCommandBuffer>       cmds,
+            record_fn                   fn,
+            void*                       data) NEX;
+#endif
+};
+
+/// Secondary command buffers that are recorded once and executed every frame (UI, static geometry) until
+/// something they reference changes. A bundle is identified by id and keyed on the handles of the pipelines,
+/// descriptor sets, buffers, ... it references and on its inheritance info (render pass, subpass, framebuffer):
+///     - get re-records a bundle when its references or inheritance info differ from the last recording
+///     - invalidate(handle) marks every bundle referencing handle stale, for resources changed in place
+///       (e.g. a descriptor set was written to or a buffer was recreated with the same handle)
+/// Bundles are recorded with SIMULTANEOUS_USE so the primaries of every frame in flight can execute them.
+/// Replaced command buffers may still be executing, they are freed frames_in_flight calls to next_frame later.
+/// Not thread safe.
+struct command_bundle_cache {
+    struct bundle_t {
+        u64                     id{};
+        VkCommandBuffer         cmd{};
+        VkRenderPass            render_pass{};
+        u32                     subpass{};
+        VkFramebuffer           framebuffer{};
+        u32                     reference_count{};
+        u64                     references[MAX_BUNDLE_REFERENCES]{};
+        bool                    stale{};
+    };
+
+    struct retired_t {
+        VkCommandBuffer         cmd{};
+        u64                     frame{};
+    };
+
+    using record_fn = void(*)(command cmd, void* data);
+
+    command_pool                pool{};
+    small_vector<bundle_t, 8>   bundles{};
+    small_vector<retired_t, 8>  retired{};
+    u64                         frame{};
+    u32                         frame_count{};
+    u32                         recorded{};
+
+    static command_bundle_cache create(
+            VkDevice                    device,
+            u32                         queue_family,
+            u32                         frames_in_flight,
+            vk_alloc                    alloc = {}) NEX;
+
+    void                destroy(
+            VkDevice                    device,
+            vk_alloc                    alloc = {}) NEX;
+
+    /// Command buffer of bundle id, fn records it (between begin and end) if it was not recorded yet,
+    /// it was invalidated or references/inheritance changed. References are the handles cast to u64
+    NDC VkCommandBuffer get(
+            VkDevice                    device,
+            u64                         id,
+            span<const u64>             references,
+            const VkCommandBufferInheritanceInfo& inheritance,
+            record_fn                   fn,
+            void*                       data) NEX;
+
+    /// Mark every bundle referencing handle stale, they are re-recorded the next time they are requested
+    void                invalidate(
+            u64                         handle) NEX;
+
+    void                remove(
+            u64                         id) NEX;
+
+    /// Start a new frame, frees the command buffers replaced frames_in_flight frames ago
+    void                next_frame(
+            VkDevice                    device) NEX;
+
+    /// Number of times a bundle was (re-)recorded
+    NDC u32             recorded_count() const NEX { return recorded; }
+
+private:
+    void                retire(
+            VkCommandBuffer             cmd) NEX;
+};
+
 }
 
 #endif //TINYVK_COMMAND_H
@@ -59,6 +611,8 @@ struct command_pool : type_wrapper<command_pool, VkCommandPool> {
 #ifndef TINYVK_COMMAND_CPP
 #define TINYVK_COMMAND_CPP
 
+#include "tinystd_algorithm.h"
+
 namespace tinyvk {
 
 //region command_pool
@@ -102,7 +656,7 @@ command_pool::allocate(
 	alloc_info.commandBufferCount = cmds.size();
     alloc_info.level = VkCommandBufferLevel(secondary);
 	vk_validate(vkAllocateCommandBuffers(device, &alloc_info, cmds.data()),
-	    "tinyvk::command_pool::allocate - Pool (0x%llx) failed to allocate command buffers", vk);
+	    "tinyvk::command_pool::allocate - Pool (0x%llx) failed to allocate command buffers", (unsigned long long)vk);
 }
 
 void
@@ -116,6 +670,308 @@ command_pool::free(
 
 //endregion
 
+//region command_ring
+
+command_ring
+command_ring::create(
+        VkDevice device,
+        span<const u32> queue_families,
+        u32 frames_in_flight,
+        u32 threads,
+        vk_alloc alloc) NEX
+{
+    tassert(queue_families.size() <= MAX_QUEUE_FAMILIES && "tinyvk::command_ring::create - Too many queue families");
+    tassert(frames_in_flight <= MAX_FRAMES_IN_FLIGHT && "tinyvk::command_ring::create - Too many frames in flight");
+    tassert(threads <= MAX_RECORDING_THREADS && "tinyvk::command_ring::create - Too many recording threads");
+
+    command_ring ring{};
+    ring.family_count = u32(queue_families.size());
+    ring.frame_count = frames_in_flight;
+    ring.thread_count = threads;
+    for (u32 i = 0; i < ring.family_count; ++i)
+        ring.families[i] = queue_families[i];
+
+    ring.slots.resize(frames_in_flight * threads * ring.family_count);
+    u32 i = 0;
+    for (auto& s: ring.slots) {
+        s = {};
+        s.pool = command_pool::create(device, ring.families[i++ % ring.family_count], CMD_POOL_TRANSIENT, alloc);
+    }
+    return ring;
+}
+
+
+void
+command_ring::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    for (auto& s: slots) {
+        // destroying the pool frees all of its command buffers
+        s.pool.destroy(device, alloc);
+        s = {};
+    }
+    slots.clear();
+    family_count = frame_count = thread_count = 0;
+}
+
+
+command
+command_ring::allocate(
+        VkDevice device,
+        u32 frame,
+        u32 thread,
+        u32 queue_family,
+        bool secondary) NEX
+{
+    auto& s = slot(frame, thread, queue_family);
+    const u32 level = u32(secondary);
+    if (s.used[level] == s.allocated[level]) {
+        tassert(s.allocated[level] < MAX_RING_COMMAND_BUFFERS && "tinyvk::command_ring::allocate - Too many command buffers for one frame, increase TINYVK_MAX_RING_COMMAND_BUFFERS");
+        s.pool.allocate(device, {&s.cmds[level][s.allocated[level]], 1}, secondary);
+        ++s.allocated[level];
+    }
+    return command::from(s.cmds[level][s.used[level]++]);
+}
+
+
+ibool
+command_ring::reset_frame(
+        VkDevice device,
+        u32 frame,
+        VkFence fence,
+        bool wait) NEX
+{
+    if (fence) {
+        const VkResult r = wait
+            ? vkWaitForFences(device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT_NANOS)
+            : vkGetFenceStatus(device, fence);
+        if (r == VK_TIMEOUT || r == VK_NOT_READY)
+            return false;
+        vk_validate(r, "tinyvk::command_ring::reset_frame - Failed to wait for fence of frame %u", frame);
+    }
+    reset_frame(device, frame);
+    return true;
+}
+
+
+void
+command_ring::reset_frame(
+        VkDevice device,
+        u32 frame) NEX
+{
+    tassert(frame < frame_count && "tinyvk::command_ring::reset_frame - Frame out of range");
+    const u32 per_frame = thread_count * family_count;
+    for (u32 i = frame * per_frame; i < (frame + 1) * per_frame; ++i) {
+        auto& s = slots[i];
+        if (!s.used[0] && !s.used[1])
+            continue;
+        vk_validate(vkResetCommandPool(device, s.pool, 0),
+            "tinyvk::command_ring::reset_frame - Failed to reset command pool (0x%llx)", (unsigned long long)s.pool.vk);
+        s.used[0] = s.used[1] = 0;
+    }
+}
+
+
+command_ring::slot_t&
+command_ring::slot(
+        u32 frame,
+        u32 thread,
+        u32 queue_family) NEX
+{
+    tassert(frame < frame_count && "tinyvk::command_ring::slot - Frame out of range");
+    tassert(thread < thread_count && "tinyvk::command_ring::slot - Thread out of range");
+    u32 family = 0;
+    while (family < family_count && families[family] != queue_family) ++family;
+    tassert(family < family_count && "tinyvk::command_ring::slot - Queue family was not registered with this ring");
+    return slots[(frame * thread_count + thread) * family_count + family];
+}
+
+#ifndef TINYVK_NO_JOBS
+void
+command_ring::record_secondary(
+        tinystd::job_system& jobs,
+        VkDevice device,
+        u32 frame,
+        u32 queue_family,
+        const VkCommandBufferInheritanceInfo& inheritance,
+        span<VkCommandBuffer> cmds,
+        record_fn fn,
+        void* data) NEX
+{
+    tassert(jobs.worker_count() <= thread_count && "tinyvk::command_ring::record_secondary - Ring needs one thread per job system worker");
+
+    struct record_data {
+        command_ring*                           ring;
+        VkDevice                                device;
+        u32                                     frame;
+        u32                                     queue_family;
+        const VkCommandBufferInheritanceInfo*   inheritance;
+        VkCommandBuffer*                        cmds;
+        record_fn                               fn;
+        void*                                   data;
+    } rec{this, device, frame, queue_family, &inheritance, cmds.data(), fn, data};
+
+    jobs.parallel_for(u32(cmds.size()), 1, [](void* p, u32 begin, u32 end, u32 worker) {
+        auto& r = *(record_data*)p;
+        VkCommandBufferBeginInfo begin_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (r.inheritance->renderPass)
+            begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo = r.inheritance;
+        for (u32 i = begin; i < end; ++i) {
+            const command cmd = r.ring->allocate(r.device, r.frame, worker, r.queue_family, true);
+            vk_validate(vkBeginCommandBuffer(cmd, &begin_info),
+                "tinyvk::command_ring::record_secondary - Failed to begin command buffer %u", i);
+            r.fn(cmd, i, r.data);
+            vk_validate(vkEndCommandBuffer(cmd),
+                "tinyvk::command_ring::record_secondary - Failed to end command buffer %u", i);
+            r.cmds[i] = cmd;
+        }
+    }, &rec);
+}
+#endif
+
+//endregion
+
+//region command_bundle_cache
+
+command_bundle_cache
+command_bundle_cache::create(
+        VkDevice device,
+        u32 queue_family,
+        u32 frames_in_flight,
+        vk_alloc alloc) NEX
+{
+    tassert(frames_in_flight <= MAX_FRAMES_IN_FLIGHT && "tinyvk::command_bundle_cache::create - Too many frames in flight");
+    command_bundle_cache cache{};
+    cache.pool = command_pool::create(device, queue_family, {}, alloc);
+    cache.frame_count = frames_in_flight;
+    return cache;
+}
+
+
+void
+command_bundle_cache::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    // destroying the pool frees all of its command buffers
+    pool.destroy(device, alloc);
+    bundles.clear();
+    retired.clear();
+    frame = recorded = 0;
+}
+
+
+VkCommandBuffer
+command_bundle_cache::get(
+        VkDevice device,
+        u64 id,
+        span<const u64> references,
+        const VkCommandBufferInheritanceInfo& inheritance,
+        record_fn fn,
+        void* data) NEX
+{
+    tassert(references.size() <= MAX_BUNDLE_REFERENCES && "tinyvk::command_bundle_cache::get - Too many references");
+
+    auto* it = tinystd::find_if(bundles.begin(), bundles.end(), [=](const bundle_t& b){ return b.id == id; });
+    if (it == bundles.end()) {
+        bundles.push_back({});
+        it = &bundles.back();
+        it->id = id;
+    }
+
+    auto& b = *it;
+    bool changed = b.stale || !b.cmd || b.reference_count != references.size()
+        || b.render_pass != inheritance.renderPass || b.subpass != inheritance.subpass || b.framebuffer != inheritance.framebuffer;
+    for (u32 i = 0; !changed && i < b.reference_count; ++i)
+        changed = b.references[i] != references[i];
+    if (!changed)
+        return b.cmd;
+
+    if (b.cmd)
+        retire(b.cmd);
+    pool.allocate(device, {&b.cmd, 1}, true);
+
+    VkCommandBufferBeginInfo begin_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    if (inheritance.renderPass)
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance;
+    vk_validate(vkBeginCommandBuffer(b.cmd, &begin_info),
+        "tinyvk::command_bundle_cache::get - Failed to begin bundle %llu", (unsigned long long)id);
+    fn(command::from(b.cmd), data);
+    vk_validate(vkEndCommandBuffer(b.cmd),
+        "tinyvk::command_bundle_cache::get - Failed to end bundle %llu", (unsigned long long)id);
+
+    b.render_pass = inheritance.renderPass;
+    b.subpass = inheritance.subpass;
+    b.framebuffer = inheritance.framebuffer;
+    b.reference_count = u32(references.size());
+    for (u32 i = 0; i < b.reference_count; ++i)
+        b.references[i] = references[i];
+    b.stale = false;
+    ++recorded;
+    return b.cmd;
+}
+
+
+void
+command_bundle_cache::invalidate(
+        u64 handle) NEX
+{
+    for (auto& b: bundles) {
+        for (u32 i = 0; i < b.reference_count; ++i) {
+            if (b.references[i] == handle) {
+                b.stale = true;
+                break;
+            }
+        }
+    }
+}
+
+
+void
+command_bundle_cache::remove(
+        u64 id) NEX
+{
+    auto* it = tinystd::find_if(bundles.begin(), bundles.end(), [=](const bundle_t& b){ return b.id == id; });
+    if (it == bundles.end())
+        return;
+    if (it->cmd)
+        retire(it->cmd);
+    *it = bundles.back();
+    bundles.pop_back();
+}
+
+
+void
+command_bundle_cache::next_frame(
+        VkDevice device) NEX
+{
+    ++frame;
+    for (u32 i = 0; i < retired.size();) {
+        if (retired[i].frame + frame_count > frame) {
+            ++i;
+            continue;
+        }
+        pool.free(device, {&retired[i].cmd, 1});
+        retired[i] = retired.back();
+        retired.pop_back();
+    }
+}
+
+
+void
+command_bundle_cache::retire(
+        VkCommandBuffer cmd) NEX
+{
+    retired.push_back({cmd, frame});
+}
+
+//endregion
+
 //region command
 
 void command::generate_mipmaps(
@@ -138,30 +994,28 @@ void command::generate_mipmaps(
         mip_levels = 0;
         while (w > 1 && h > 1) { w /= 2; h /= 2; ++mip_levels; }
     }
-    VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
-    barrier.image = image;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
+#ifdef VK_VERSION_1_3
+    constexpr barrier_access blit_write{VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT};
+    constexpr barrier_access blit_read{VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_READ_BIT};
+    constexpr barrier_access shader_read{VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT};
+#else
+    constexpr barrier_access blit_write{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+    constexpr barrier_access blit_read{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+    constexpr barrier_access shader_read{VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT};
+#endif
+    VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
 
+    barrier_batch step{};
+    barrier_batch done{};
     i32 mip_width = i32(width);
     i32 mip_height = i32(height);
 
     for (u32 i = 1; i < mip_levels; i++) {
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-        vkCmdPipelineBarrier(vk,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
+        range.baseMipLevel = i - 1;
+        step.image(image, range,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            blit_write, blit_read);
+        step.flush(vk);
 
         VkImageBlit blit{};
         blit.srcOffsets[0] = {0, 0, 0};
@@ -183,33 +1037,1104 @@ void command::generate_mipmaps(
             1, &blit,
             VK_FILTER_LINEAR);
 
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(vk,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
+        // nothing reads the source level again, transition all of them to shader read together at the end
+        done.image(image, range,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            blit_read, shader_read);
 
         if (mip_width > 1) mip_width /= 2;
         if (mip_height > 1) mip_height /= 2;
     }
 
-    barrier.subresourceRange.baseMipLevel = mip_levels - 1;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    range.baseMipLevel = mip_levels - 1;
+    done.image(image, range,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        blit_write, shader_read);
+    done.flush(vk);
+}
+
+
+void
+command::begin_query(
+        VkQueryPool pool,
+        u32 query,
+        VkQueryControlFlags flags) const NEX
+{
+    vkCmdBeginQuery(vk, pool, query, flags);
+}
+
+
+void
+command::end_query(
+        VkQueryPool pool,
+        u32 query) const NEX
+{
+    vkCmdEndQuery(vk, pool, query);
+}
+
 
-    vkCmdPipelineBarrier(vk,
-        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier);
+void
+command::reset_queries(
+        VkQueryPool pool,
+        u32 first,
+        u32 count) const NEX
+{
+    vkCmdResetQueryPool(vk, pool, first, count);
+}
+
+
+void
+command::write_timestamp(
+        VkQueryPool pool,
+        u32 query,
+        VkPipelineStageFlagBits stage) const NEX
+{
+    vkCmdWriteTimestamp(vk, stage, pool, query);
+}
+
+
+void
+command::execute_commands(
+        span<const VkCommandBuffer> cmds) const NEX
+{
+    vkCmdExecuteCommands(vk, u32(cmds.size()), cmds.data());
+}
+
+//endregion
+
+//region command dynamic state
+
+void
+command::set_viewport(
+        const VkViewport& viewport) const NEX
+{
+    vkCmdSetViewport(vk, 0, 1, &viewport);
+}
+
+
+void
+command::set_scissor(
+        const VkRect2D& scissor) const NEX
+{
+    vkCmdSetScissor(vk, 0, 1, &scissor);
+}
+
+
+void
+command::set_line_width(
+        float width) const NEX
+{
+    vkCmdSetLineWidth(vk, width);
+}
+
+
+void
+command::set_depth_bias(
+        float constant,
+        float clamp,
+        float slope) const NEX
+{
+    vkCmdSetDepthBias(vk, constant, clamp, slope);
+}
+
+
+void
+command::set_blend_constants(
+        const float (& constants)[4]) const NEX
+{
+    vkCmdSetBlendConstants(vk, constants);
+}
+
+
+void
+command::set_depth_bounds(
+        float min,
+        float max) const NEX
+{
+    vkCmdSetDepthBounds(vk, min, max);
+}
+
+
+void
+command::set_stencil_compare_mask(
+        VkStencilFaceFlags faces,
+        u32 mask) const NEX
+{
+    vkCmdSetStencilCompareMask(vk, faces, mask);
+}
+
+
+void
+command::set_stencil_write_mask(
+        VkStencilFaceFlags faces,
+        u32 mask) const NEX
+{
+    vkCmdSetStencilWriteMask(vk, faces, mask);
+}
+
+
+void
+command::set_stencil_reference(
+        VkStencilFaceFlags faces,
+        u32 reference) const NEX
+{
+    vkCmdSetStencilReference(vk, faces, reference);
+}
+
+#ifdef VK_EXT_extended_dynamic_state
+
+static struct {
+    PFN_vkCmdSetCullModeEXT                 set_cull_mode;
+    PFN_vkCmdSetFrontFaceEXT                set_front_face;
+    PFN_vkCmdSetPrimitiveTopologyEXT        set_topology;
+    PFN_vkCmdSetViewportWithCountEXT        set_viewports;
+    PFN_vkCmdSetScissorWithCountEXT         set_scissors;
+    PFN_vkCmdBindVertexBuffers2EXT          bind_vertex_buffers;
+    PFN_vkCmdSetDepthTestEnableEXT          set_depth_test;
+    PFN_vkCmdSetDepthWriteEnableEXT         set_depth_write;
+    PFN_vkCmdSetDepthCompareOpEXT           set_depth_compare;
+    PFN_vkCmdSetDepthBoundsTestEnableEXT    set_depth_bounds_test;
+    PFN_vkCmdSetStencilTestEnableEXT        set_stencil_test;
+    PFN_vkCmdSetStencilOpEXT                set_stencil_op;
+#ifdef VK_EXT_extended_dynamic_state2
+    PFN_vkCmdSetRasterizerDiscardEnableEXT  set_rasterizer_discard;
+    PFN_vkCmdSetDepthBiasEnableEXT          set_depth_bias_enable;
+    PFN_vkCmdSetPrimitiveRestartEnableEXT   set_primitive_restart;
+    PFN_vkCmdSetLogicOpEXT                  set_logic_op;
+    PFN_vkCmdSetPatchControlPointsEXT       set_patch_control_points;
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+    PFN_vkCmdSetPolygonModeEXT              set_polygon_mode;
+    PFN_vkCmdSetRasterizationSamplesEXT     set_rasterization_samples;
+    PFN_vkCmdSetColorBlendEnableEXT         set_blend_enable;
+    PFN_vkCmdSetColorBlendEquationEXT       set_blend_equation;
+    PFN_vkCmdSetColorWriteMaskEXT           set_color_write_mask;
+#endif
+} dynamic_state_ext{};
+
+
+static PFN_vkVoidFunction
+load_dynamic_state_fn(
+        VkDevice device,
+        const char* ext_name,
+        const char* core_name)
+{
+    const auto fn = vkGetDeviceProcAddr(device, ext_name);
+    return fn || !core_name ? fn : vkGetDeviceProcAddr(device, core_name);
+}
+
+
+void
+command::load_dynamic_state_ext(
+        VkDevice device) NEX
+{
+    dynamic_state_ext.set_cull_mode = (PFN_vkCmdSetCullModeEXT) load_dynamic_state_fn(device, "vkCmdSetCullModeEXT", "vkCmdSetCullMode");
+    dynamic_state_ext.set_front_face = (PFN_vkCmdSetFrontFaceEXT) load_dynamic_state_fn(device, "vkCmdSetFrontFaceEXT", "vkCmdSetFrontFace");
+    dynamic_state_ext.set_topology = (PFN_vkCmdSetPrimitiveTopologyEXT) load_dynamic_state_fn(device, "vkCmdSetPrimitiveTopologyEXT", "vkCmdSetPrimitiveTopology");
+    dynamic_state_ext.set_viewports = (PFN_vkCmdSetViewportWithCountEXT) load_dynamic_state_fn(device, "vkCmdSetViewportWithCountEXT", "vkCmdSetViewportWithCount");
+    dynamic_state_ext.set_scissors = (PFN_vkCmdSetScissorWithCountEXT) load_dynamic_state_fn(device, "vkCmdSetScissorWithCountEXT", "vkCmdSetScissorWithCount");
+    dynamic_state_ext.bind_vertex_buffers = (PFN_vkCmdBindVertexBuffers2EXT) load_dynamic_state_fn(device, "vkCmdBindVertexBuffers2EXT", "vkCmdBindVertexBuffers2");
+    dynamic_state_ext.set_depth_test = (PFN_vkCmdSetDepthTestEnableEXT) load_dynamic_state_fn(device, "vkCmdSetDepthTestEnableEXT", "vkCmdSetDepthTestEnable");
+    dynamic_state_ext.set_depth_write = (PFN_vkCmdSetDepthWriteEnableEXT) load_dynamic_state_fn(device, "vkCmdSetDepthWriteEnableEXT", "vkCmdSetDepthWriteEnable");
+    dynamic_state_ext.set_depth_compare = (PFN_vkCmdSetDepthCompareOpEXT) load_dynamic_state_fn(device, "vkCmdSetDepthCompareOpEXT", "vkCmdSetDepthCompareOp");
+    dynamic_state_ext.set_depth_bounds_test = (PFN_vkCmdSetDepthBoundsTestEnableEXT) load_dynamic_state_fn(device, "vkCmdSetDepthBoundsTestEnableEXT", "vkCmdSetDepthBoundsTestEnable");
+    dynamic_state_ext.set_stencil_test = (PFN_vkCmdSetStencilTestEnableEXT) load_dynamic_state_fn(device, "vkCmdSetStencilTestEnableEXT", "vkCmdSetStencilTestEnable");
+    dynamic_state_ext.set_stencil_op = (PFN_vkCmdSetStencilOpEXT) load_dynamic_state_fn(device, "vkCmdSetStencilOpEXT", "vkCmdSetStencilOp");
+#ifdef VK_EXT_extended_dynamic_state2
+    dynamic_state_ext.set_rasterizer_discard = (PFN_vkCmdSetRasterizerDiscardEnableEXT) load_dynamic_state_fn(device, "vkCmdSetRasterizerDiscardEnableEXT", "vkCmdSetRasterizerDiscardEnable");
+    dynamic_state_ext.set_depth_bias_enable = (PFN_vkCmdSetDepthBiasEnableEXT) load_dynamic_state_fn(device, "vkCmdSetDepthBiasEnableEXT", "vkCmdSetDepthBiasEnable");
+    dynamic_state_ext.set_primitive_restart = (PFN_vkCmdSetPrimitiveRestartEnableEXT) load_dynamic_state_fn(device, "vkCmdSetPrimitiveRestartEnableEXT", "vkCmdSetPrimitiveRestartEnable");
+    // logic op and patch control points were not promoted to 1.3
+    dynamic_state_ext.set_logic_op = (PFN_vkCmdSetLogicOpEXT) load_dynamic_state_fn(device, "vkCmdSetLogicOpEXT", nullptr);
+    dynamic_state_ext.set_patch_control_points = (PFN_vkCmdSetPatchControlPointsEXT) load_dynamic_state_fn(device, "vkCmdSetPatchControlPointsEXT", nullptr);
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+    dynamic_state_ext.set_polygon_mode = (PFN_vkCmdSetPolygonModeEXT) vkGetDeviceProcAddr(device, "vkCmdSetPolygonModeEXT");
+    dynamic_state_ext.set_rasterization_samples = (PFN_vkCmdSetRasterizationSamplesEXT) vkGetDeviceProcAddr(device, "vkCmdSetRasterizationSamplesEXT");
+    dynamic_state_ext.set_blend_enable = (PFN_vkCmdSetColorBlendEnableEXT) vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT");
+    dynamic_state_ext.set_blend_equation = (PFN_vkCmdSetColorBlendEquationEXT) vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEquationEXT");
+    dynamic_state_ext.set_color_write_mask = (PFN_vkCmdSetColorWriteMaskEXT) vkGetDeviceProcAddr(device, "vkCmdSetColorWriteMaskEXT");
+#endif
+}
+
+
+void
+command::set_cull_mode(
+        VkCullModeFlags cull_mode) const NEX
+{
+    tassert(dynamic_state_ext.set_cull_mode && "tinyvk::command::set_cull_mode - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_cull_mode(vk, cull_mode);
+}
+
+
+void
+command::set_front_face(
+        VkFrontFace front_face) const NEX
+{
+    tassert(dynamic_state_ext.set_front_face && "tinyvk::command::set_front_face - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_front_face(vk, front_face);
+}
+
+
+void
+command::set_topology(
+        VkPrimitiveTopology topology) const NEX
+{
+    tassert(dynamic_state_ext.set_topology && "tinyvk::command::set_topology - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_topology(vk, topology);
+}
+
+
+void
+command::set_viewports(
+        span<const VkViewport> viewports) const NEX
+{
+    tassert(dynamic_state_ext.set_viewports && "tinyvk::command::set_viewports - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_viewports(vk, u32(viewports.size()), viewports.data());
+}
+
+
+void
+command::set_scissors(
+        span<const VkRect2D> scissors) const NEX
+{
+    tassert(dynamic_state_ext.set_scissors && "tinyvk::command::set_scissors - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_scissors(vk, u32(scissors.size()), scissors.data());
+}
+
+
+void
+command::bind_vertex_buffers(
+        u32 first_binding,
+        span<const VkBuffer> buffers,
+        span<const VkDeviceSize> offsets,
+        span<const VkDeviceSize> strides) const NEX
+{
+    tassert(buffers.size() == offsets.size() && "Must provide an offset for each vertex buffer");
+    tassert((strides.empty() || strides.size() == buffers.size()) && "Must provide a stride for each vertex buffer");
+    tassert(dynamic_state_ext.bind_vertex_buffers && "tinyvk::command::bind_vertex_buffers - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.bind_vertex_buffers(vk, first_binding, u32(buffers.size()), buffers.data(), offsets.data(), nullptr,
+        strides.empty() ? nullptr : strides.data());
+}
+
+
+void
+command::set_depth_test(
+        bool enable) const NEX
+{
+    tassert(dynamic_state_ext.set_depth_test && "tinyvk::command::set_depth_test - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_depth_test(vk, enable);
+}
+
+
+void
+command::set_depth_write(
+        bool enable) const NEX
+{
+    tassert(dynamic_state_ext.set_depth_write && "tinyvk::command::set_depth_write - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_depth_write(vk, enable);
+}
+
+
+void
+command::set_depth_compare(
+        VkCompareOp compare_op) const NEX
+{
+    tassert(dynamic_state_ext.set_depth_compare && "tinyvk::command::set_depth_compare - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_depth_compare(vk, compare_op);
+}
+
+
+void
+command::set_depth_bounds_test(
+        bool enable) const NEX
+{
+    tassert(dynamic_state_ext.set_depth_bounds_test && "tinyvk::command::set_depth_bounds_test - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_depth_bounds_test(vk, enable);
+}
+
+
+void
+command::set_stencil_test(
+        bool enable) const NEX
+{
+    tassert(dynamic_state_ext.set_stencil_test && "tinyvk::command::set_stencil_test - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_stencil_test(vk, enable);
+}
+
+
+void
+command::set_stencil_op(
+        VkStencilFaceFlags faces,
+        VkStencilOp fail,
+        VkStencilOp pass,
+        VkStencilOp depth_fail,
+        VkCompareOp compare_op) const NEX
+{
+    tassert(dynamic_state_ext.set_stencil_op && "tinyvk::command::set_stencil_op - VK_EXT_extended_dynamic_state not loaded");
+    dynamic_state_ext.set_stencil_op(vk, faces, fail, pass, depth_fail, compare_op);
+}
+
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state2
+
+void
+command::set_rasterizer_discard(
+        bool enable) const NEX
+{
+    tassert(dynamic_state_ext.set_rasterizer_discard && "tinyvk::command::set_rasterizer_discard - VK_EXT_extended_dynamic_state2 not loaded");
+    dynamic_state_ext.set_rasterizer_discard(vk, enable);
+}
+
+
+void
+command::set_depth_bias_enable(
+        bool enable) const NEX
+{
+    tassert(dynamic_state_ext.set_depth_bias_enable && "tinyvk::command::set_depth_bias_enable - VK_EXT_extended_dynamic_state2 not loaded");
+    dynamic_state_ext.set_depth_bias_enable(vk, enable);
+}
+
+
+void
+command::set_primitive_restart(
+        bool enable) const NEX
+{
+    tassert(dynamic_state_ext.set_primitive_restart && "tinyvk::command::set_primitive_restart - VK_EXT_extended_dynamic_state2 not loaded");
+    dynamic_state_ext.set_primitive_restart(vk, enable);
+}
+
+
+void
+command::set_logic_op(
+        VkLogicOp logic_op) const NEX
+{
+    tassert(dynamic_state_ext.set_logic_op && "tinyvk::command::set_logic_op - VK_EXT_extended_dynamic_state2 not loaded");
+    dynamic_state_ext.set_logic_op(vk, logic_op);
+}
+
+
+void
+command::set_patch_control_points(
+        u32 control_points) const NEX
+{
+    tassert(dynamic_state_ext.set_patch_control_points && "tinyvk::command::set_patch_control_points - VK_EXT_extended_dynamic_state2 not loaded");
+    dynamic_state_ext.set_patch_control_points(vk, control_points);
+}
+
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state3
+
+void
+command::set_polygon_mode(
+        VkPolygonMode polygon_mode) const NEX
+{
+    tassert(dynamic_state_ext.set_polygon_mode && "tinyvk::command::set_polygon_mode - VK_EXT_extended_dynamic_state3 not loaded");
+    dynamic_state_ext.set_polygon_mode(vk, polygon_mode);
+}
+
+
+void
+command::set_rasterization_samples(
+        sample_count_t samples) const NEX
+{
+    tassert(dynamic_state_ext.set_rasterization_samples && "tinyvk::command::set_rasterization_samples - VK_EXT_extended_dynamic_state3 not loaded");
+    dynamic_state_ext.set_rasterization_samples(vk, VkSampleCountFlagBits(samples));
+}
+
+
+void
+command::set_blend_enable(
+        u32 first_attachment,
+        span<const VkBool32> enable) const NEX
+{
+    tassert(dynamic_state_ext.set_blend_enable && "tinyvk::command::set_blend_enable - VK_EXT_extended_dynamic_state3 not loaded");
+    dynamic_state_ext.set_blend_enable(vk, first_attachment, u32(enable.size()), enable.data());
+}
+
+
+void
+command::set_blend_equation(
+        u32 first_attachment,
+        span<const VkColorBlendEquationEXT> equations) const NEX
+{
+    tassert(dynamic_state_ext.set_blend_equation && "tinyvk::command::set_blend_equation - VK_EXT_extended_dynamic_state3 not loaded");
+    dynamic_state_ext.set_blend_equation(vk, first_attachment, u32(equations.size()), equations.data());
+}
+
+
+void
+command::set_color_write_mask(
+        u32 first_attachment,
+        span<const VkColorComponentFlags> masks) const NEX
+{
+    tassert(dynamic_state_ext.set_color_write_mask && "tinyvk::command::set_color_write_mask - VK_EXT_extended_dynamic_state3 not loaded");
+    dynamic_state_ext.set_color_write_mask(vk, first_attachment, u32(masks.size()), masks.data());
+}
+
+#endif
+
+//endregion
+
+//region barrier_batch
+
+void
+barrier_batch::global(
+        barrier_access src,
+        barrier_access dst) NEX
+{
+    memory.src.stage |= src.stage;
+    memory.src.access |= src.access;
+    memory.dst.stage |= dst.stage;
+    memory.dst.access |= dst.access;
+}
+
+
+static bool same_masks(const barrier_batch::masks_t& m, barrier_access src, barrier_access dst)
+{
+    return m.src.stage == src.stage && m.src.access == src.access && m.dst.stage == dst.stage && m.dst.access == dst.access;
+}
+
+
+/// Merge [offset, offset + size) into [base, base + count) if the ranges touch, count == ~0 means 'the remainder'
+template<typename T>
+static bool merge_range(T& base, T& count, T offset, T size, T remaining)
+{
+    if (base == offset && count == size) return true;
+    if (count == remaining || size == remaining) {
+        if (count == remaining && size == remaining) { base = tinystd::min(base, offset); return true; }
+        if (count == remaining && offset >= base) return true;
+        if (size == remaining && base >= offset) { base = offset; count = remaining; return true; }
+        return false;
+    }
+    if (offset > base + count || base > offset + size) return false;
+    const T end = tinystd::max(base + count, offset + size);
+    base = tinystd::min(base, offset);
+    count = end - base;
+    return true;
+}
+
+
+void
+barrier_batch::buffer(
+        VkBuffer buf,
+        barrier_access src,
+        barrier_access dst,
+        VkDeviceSize offset,
+        VkDeviceSize size,
+        u32 src_queue_family,
+        u32 dst_queue_family) NEX
+{
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        auto& b = buffers[i];
+        if (b.buffer != buf || !same_masks(buffer_masks[i], src, dst)
+            || b.srcQueueFamilyIndex != src_queue_family || b.dstQueueFamilyIndex != dst_queue_family)
+            continue;
+        if (merge_range<VkDeviceSize>(b.offset, b.size, offset, size, VK_WHOLE_SIZE))
+            return;
+    }
+
+    VkBufferMemoryBarrier b{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    b.srcAccessMask = legacy_access(src.access);
+    b.dstAccessMask = legacy_access(dst.access);
+    b.srcQueueFamilyIndex = src_queue_family;
+    b.dstQueueFamilyIndex = dst_queue_family;
+    b.buffer = buf;
+    b.offset = offset;
+    b.size = size;
+    buffers.push_back(b);
+    buffer_masks.push_back({src, dst});
+}
+
+
+void
+barrier_batch::image(
+        VkImage img,
+        const VkImageSubresourceRange& range,
+        VkImageLayout old_layout,
+        VkImageLayout new_layout,
+        barrier_access src,
+        barrier_access dst,
+        u32 src_queue_family,
+        u32 dst_queue_family) NEX
+{
+    for (size_t i = 0; i < images.size(); ++i) {
+        auto& b = images[i];
+        auto& r = b.subresourceRange;
+        if (b.image != img || b.oldLayout != old_layout || b.newLayout != new_layout
+            || !same_masks(image_masks[i], src, dst)
+            || b.srcQueueFamilyIndex != src_queue_family || b.dstQueueFamilyIndex != dst_queue_family
+            || r.aspectMask != range.aspectMask)
+            continue;
+        // ranges can only grow along one dimension at a time
+        if (r.baseArrayLayer == range.baseArrayLayer && r.layerCount == range.layerCount
+            && merge_range<u32>(r.baseMipLevel, r.levelCount, range.baseMipLevel, range.levelCount, VK_REMAINING_MIP_LEVELS))
+            return;
+        if (r.baseMipLevel == range.baseMipLevel && r.levelCount == range.levelCount
+            && merge_range<u32>(r.baseArrayLayer, r.layerCount, range.baseArrayLayer, range.layerCount, VK_REMAINING_ARRAY_LAYERS))
+            return;
+    }
+
+    VkImageMemoryBarrier b{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    b.srcAccessMask = legacy_access(src.access);
+    b.dstAccessMask = legacy_access(dst.access);
+    b.oldLayout = old_layout;
+    b.newLayout = new_layout;
+    b.srcQueueFamilyIndex = src_queue_family;
+    b.dstQueueFamilyIndex = dst_queue_family;
+    b.image = img;
+    b.subresourceRange = range;
+    images.push_back(b);
+    image_masks.push_back({src, dst});
+}
+
+
+bool
+barrier_batch::empty() const NEX
+{
+    return images.empty() && buffers.empty() && !memory.src.stage && !memory.dst.stage;
+}
+
+
+void
+barrier_batch::clear() NEX
+{
+    images.clear();
+    image_masks.clear();
+    buffers.clear();
+    buffer_masks.clear();
+    memory = {};
+    dependency_flags = 0;
+}
+
+
+#ifdef VK_VERSION_1_3
+static struct {
+    PFN_vkCmdPipelineBarrier2               pipeline_barrier2;
+} synchronization2_barrier{};
+#endif
+
+
+void
+barrier_batch::flush(
+        VkCommandBuffer cmd) NEX
+{
+#ifdef TINYVK_USE_SYNCHRONIZATION2
+    // devices without synchronization2 never load it and keep the legacy barrier
+    if (synchronization2_barrier.pipeline_barrier2) {
+        flush2(cmd);
+        return;
+    }
+#endif
+    if (empty())
+        return;
+
+    pipeline_stage_flags src_stages = memory.src.stage, dst_stages = memory.dst.stage;
+    for (auto& m: image_masks) { src_stages |= m.src.stage; dst_stages |= m.dst.stage; }
+    for (auto& m: buffer_masks) { src_stages |= m.src.stage; dst_stages |= m.dst.stage; }
+    const VkPipelineStageFlags src = src_stages ? legacy_stages(src_stages) : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    const VkPipelineStageFlags dst = dst_stages ? legacy_stages(dst_stages) : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+    VkMemoryBarrier mem{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    mem.srcAccessMask = legacy_access(memory.src.access);
+    mem.dstAccessMask = legacy_access(memory.dst.access);
+    const bool has_memory = memory.src.stage || memory.dst.stage;
+    vkCmdPipelineBarrier(cmd, src, dst, dependency_flags,
+        has_memory ? 1 : 0, has_memory ? &mem : nullptr,
+        u32(buffers.size()), buffers.data(),
+        u32(images.size()), images.data());
+    clear();
+}
+
+#ifdef VK_VERSION_1_3
+void
+barrier_batch::load_synchronization2(
+        VkDevice device) NEX
+{
+    synchronization2_barrier.pipeline_barrier2 = {};
+    if (!device)
+        return;
+    synchronization2_barrier.pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2) vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2");
+    if (!synchronization2_barrier.pipeline_barrier2)
+        synchronization2_barrier.pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2) vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR");
+}
+
+
+void
+barrier_batch::flush2(
+        VkCommandBuffer cmd) NEX
+{
+    if (empty())
+        return;
+    tassert(synchronization2_barrier.pipeline_barrier2 && "tinyvk::barrier_batch::flush2 - synchronization2 not loaded");
+
+    VkMemoryBarrier2 mem{VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    mem.srcStageMask = memory.src.stage;
+    mem.srcAccessMask = memory.src.access;
+    mem.dstStageMask = memory.dst.stage;
+    mem.dstAccessMask = memory.dst.access;
+
+    small_vector<VkBufferMemoryBarrier2, 8> buf{};
+    buf.resize(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        const auto& src = buffers[i];
+        auto& dst = buf[i];
+        dst = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2};
+        dst.srcStageMask = buffer_masks[i].src.stage;
+        dst.srcAccessMask = buffer_masks[i].src.access;
+        dst.dstStageMask = buffer_masks[i].dst.stage;
+        dst.dstAccessMask = buffer_masks[i].dst.access;
+        dst.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+        dst.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+        dst.buffer = src.buffer;
+        dst.offset = src.offset;
+        dst.size = src.size;
+    }
+
+    small_vector<VkImageMemoryBarrier2, 16> img{};
+    img.resize(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        const auto& src = images[i];
+        auto& dst = img[i];
+        dst = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+        dst.srcStageMask = image_masks[i].src.stage;
+        dst.srcAccessMask = image_masks[i].src.access;
+        dst.dstStageMask = image_masks[i].dst.stage;
+        dst.dstAccessMask = image_masks[i].dst.access;
+        dst.oldLayout = src.oldLayout;
+        dst.newLayout = src.newLayout;
+        dst.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+        dst.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+        dst.image = src.image;
+        dst.subresourceRange = src.subresourceRange;
+    }
+
+    VkDependencyInfo info{VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    info.dependencyFlags = dependency_flags;
+    info.memoryBarrierCount = (memory.src.stage || memory.dst.stage) ? 1 : 0;
+    info.pMemoryBarriers = &mem;
+    info.bufferMemoryBarrierCount = u32(buf.size());
+    info.pBufferMemoryBarriers = buf.data();
+    info.imageMemoryBarrierCount = u32(img.size());
+    info.pImageMemoryBarriers = img.data();
+    synchronization2_barrier.pipeline_barrier2(cmd, &info);
+    clear();
+}
+#endif
+
+//endregion
+
+//region command_recorder
+
+void
+command_recorder::begin(
+        command c) NEX
+{
+    cmd = c;
+    invalidate();
+}
+
+
+void
+command_recorder::invalidate() NEX
+{
+    for (auto& bp: bind_points) bp = {};
+    vertex_mask = 0;
+    index_buffer = {};
+    push_layout = {};
+    push_begin = push_end = 0;
+    state_mask = 0;
+}
+
+
+void
+command_recorder::bind_pipeline(
+        VkPipelineBindPoint bind_point,
+        VkPipeline pipeline,
+        bool same_dynamic_states) NEX
+{
+    auto& bp = bind_points[tinystd::min(u32(bind_point), 2u)];
+    if (bp.pipeline == pipeline) {
+        ++dropped;
+        return;
+    }
+    vkCmdBindPipeline(cmd, bind_point, pipeline);
+    bp.pipeline = pipeline;
+    if (!same_dynamic_states && bind_point == VK_PIPELINE_BIND_POINT_GRAPHICS)
+        state_mask = 0;
+    ++issued;
+}
+
+
+void
+command_recorder::bind_descriptor_sets(
+        VkPipelineBindPoint bind_point,
+        VkPipelineLayout layout,
+        u32 first_set,
+        span<const VkDescriptorSet> sets,
+        span<const u32> dynamic_offsets) NEX
+{
+    tassert(first_set + sets.size() <= MAX_BOUND_DESCRIPTOR_SETS && "tinyvk::command_recorder::bind_descriptor_sets - Too many descriptor sets, increase TINYVK_MAX_BOUND_DESCRIPTOR_SETS");
+    auto& bp = bind_points[tinystd::min(u32(bind_point), 2u)];
+    // sets bound with another layout may have been disturbed, only trust bindings made with the same layout
+    if (bp.layout != layout) {
+        bp.layout = layout;
+        bp.set_mask = 0;
+    }
+
+    const u32 count = u32(sets.size());
+    if (!dynamic_offsets.empty()) {
+        // dynamic offsets are not tracked, always bind and forget these sets
+        vkCmdBindDescriptorSets(cmd, bind_point, layout, first_set, count, sets.data(), u32(dynamic_offsets.size()), dynamic_offsets.data());
+        for (u32 i = 0; i < count; ++i) bp.set_mask &= ~(1u << (first_set + i));
+        ++issued;
+        return;
+    }
+
+    u32 begin = 0, end = count;
+    auto bound = [&](u32 i) { return (bp.set_mask & (1u << (first_set + i))) && bp.sets[first_set + i] == sets[i]; };
+    while (begin < end && bound(begin)) ++begin;
+    while (end > begin && bound(end - 1)) --end;
+    if (begin == end) {
+        ++dropped;
+        return;
+    }
+
+    vkCmdBindDescriptorSets(cmd, bind_point, layout, first_set + begin, end - begin, sets.data() + begin, 0, nullptr);
+    for (u32 i = begin; i < end; ++i) {
+        bp.sets[first_set + i] = sets[i];
+        bp.set_mask |= 1u << (first_set + i);
+    }
+    ++issued;
+}
+
+
+void
+command_recorder::bind_vertex_buffers(
+        u32 first_binding,
+        span<const VkBuffer> buffers,
+        span<const VkDeviceSize> offsets) NEX
+{
+    tassert(buffers.size() == offsets.size() && "tinyvk::command_recorder::bind_vertex_buffers - Buffer and offset count must match");
+    tassert(first_binding + buffers.size() <= MAX_VERTEX_BINDINGS && "tinyvk::command_recorder::bind_vertex_buffers - Too many vertex bindings, increase TINYVK_MAX_VERTEX_BINDINGS");
+
+    u32 begin = 0, end = u32(buffers.size());
+    auto bound = [&](u32 i) {
+        const u32 b = first_binding + i;
+        return (vertex_mask & (1u << b)) && vertex_buffers[b] == buffers[i] && vertex_offsets[b] == offsets[i];
+    };
+    while (begin < end && bound(begin)) ++begin;
+    while (end > begin && bound(end - 1)) --end;
+    if (begin == end) {
+        ++dropped;
+        return;
+    }
+
+    vkCmdBindVertexBuffers(cmd, first_binding + begin, end - begin, buffers.data() + begin, offsets.data() + begin);
+    for (u32 i = begin; i < end; ++i) {
+        vertex_buffers[first_binding + i] = buffers[i];
+        vertex_offsets[first_binding + i] = offsets[i];
+        vertex_mask |= 1u << (first_binding + i);
+    }
+    ++issued;
+}
+
+
+void
+command_recorder::bind_index_buffer(
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkIndexType type) NEX
+{
+    if (index_buffer && index_buffer == buffer && index_offset == offset && index_type == type) {
+        ++dropped;
+        return;
+    }
+    vkCmdBindIndexBuffer(cmd, buffer, offset, type);
+    index_buffer = buffer;
+    index_offset = offset;
+    index_type = type;
+    ++issued;
+}
+
+
+void
+command_recorder::push_constants(
+        VkPipelineLayout layout,
+        VkShaderStageFlags stages,
+        u32 offset,
+        u32 size,
+        const void* data) NEX
+{
+    tassert(offset + size <= MAX_PUSH_CONSTANT_SIZE && "tinyvk::command_recorder::push_constants - Push constant range out of bounds");
+    const bool same_range = push_layout == layout && push_stages == stages;
+    if (same_range && offset >= push_begin && offset + size <= push_end && tinystd::memeq(push_data + offset, data, size)) {
+        ++dropped;
+        return;
+    }
+
+    vkCmdPushConstants(cmd, layout, stages, offset, size, data);
+    tinystd::memcpy(push_data + offset, data, size);
+    // keep a single contiguous known range, a disjoint push replaces it
+    if (same_range && offset <= push_end && offset + size >= push_begin) {
+        push_begin = tinystd::min(push_begin, offset);
+        push_end = tinystd::max(push_end, offset + size);
+    }
+    else {
+        push_layout = layout;
+        push_stages = stages;
+        push_begin = offset;
+        push_end = offset + size;
+    }
+    ++issued;
+}
+
+
+bool
+command_recorder::filter(
+        state_t state,
+        const void* value,
+        size_t size) NEX
+{
+    const u64 bit = 1ull << state;
+    if ((state_mask & bit) && tinystd::memeq(state_values[state], value, size)) {
+        ++dropped;
+        return false;
+    }
+    tinystd::memcpy(state_values[state], value, size);
+    state_mask |= bit;
+    ++issued;
+    return true;
+}
+
+
+VkStencilFaceFlags
+command_recorder::filter_faces(
+        VkStencilFaceFlags faces,
+        state_t front,
+        const void* value,
+        size_t size) NEX
+{
+    VkStencilFaceFlags changed = 0;
+    for (u32 i = 0; i < 2; ++i) {
+        const u64 bit = 1ull << (front + i);
+        if (!(faces & (VK_STENCIL_FACE_FRONT_BIT << i)))
+            continue;
+        if ((state_mask & bit) && tinystd::memeq(state_values[front + i], value, size))
+            continue;
+        tinystd::memcpy(state_values[front + i], value, size);
+        state_mask |= bit;
+        changed |= VK_STENCIL_FACE_FRONT_BIT << i;
+    }
+    ++(changed ? issued : dropped);
+    return changed;
+}
+
+
+void
+command_recorder::set_viewport(
+        const VkViewport& viewport) NEX
+{
+    if (filter(STATE_VIEWPORT, &viewport, sizeof(viewport)))
+        cmd.set_viewport(viewport);
+}
+
+
+void
+command_recorder::set_scissor(
+        const VkRect2D& scissor) NEX
+{
+    if (filter(STATE_SCISSOR, &scissor, sizeof(scissor)))
+        cmd.set_scissor(scissor);
+}
+
+
+void
+command_recorder::set_line_width(
+        float width) NEX
+{
+    if (filter(STATE_LINE_WIDTH, &width, sizeof(width)))
+        cmd.set_line_width(width);
+}
+
+
+void
+command_recorder::set_depth_bias(
+        float constant,
+        float clamp,
+        float slope) NEX
+{
+    const float v[3]{constant, clamp, slope};
+    if (filter(STATE_DEPTH_BIAS, v, sizeof(v)))
+        cmd.set_depth_bias(constant, clamp, slope);
+}
+
+
+void
+command_recorder::set_blend_constants(
+        const float (&constants)[4]) NEX
+{
+    if (filter(STATE_BLEND_CONSTANTS, constants, sizeof(constants)))
+        cmd.set_blend_constants(constants);
+}
+
+
+void
+command_recorder::set_depth_bounds(
+        float min,
+        float max) NEX
+{
+    const float v[2]{min, max};
+    if (filter(STATE_DEPTH_BOUNDS, v, sizeof(v)))
+        cmd.set_depth_bounds(min, max);
+}
+
+
+void
+command_recorder::set_stencil_compare_mask(
+        VkStencilFaceFlags faces,
+        u32 mask) NEX
+{
+    if (const auto changed = filter_faces(faces, STATE_STENCIL_COMPARE_MASK_FRONT, &mask, sizeof(mask)))
+        cmd.set_stencil_compare_mask(changed, mask);
+}
+
+
+void
+command_recorder::set_stencil_write_mask(
+        VkStencilFaceFlags faces,
+        u32 mask) NEX
+{
+    if (const auto changed = filter_faces(faces, STATE_STENCIL_WRITE_MASK_FRONT, &mask, sizeof(mask)))
+        cmd.set_stencil_write_mask(changed, mask);
+}
+
+
+void
+command_recorder::set_stencil_reference(
+        VkStencilFaceFlags faces,
+        u32 reference) NEX
+{
+    if (const auto changed = filter_faces(faces, STATE_STENCIL_REFERENCE_FRONT, &reference, sizeof(reference)))
+        cmd.set_stencil_reference(changed, reference);
+}
+
+#ifdef VK_EXT_extended_dynamic_state
+void
+command_recorder::set_cull_mode(
+        VkCullModeFlags cull_mode) NEX
+{
+    if (filter(STATE_CULL_MODE, &cull_mode, sizeof(cull_mode)))
+        cmd.set_cull_mode(cull_mode);
+}
+
+
+void
+command_recorder::set_front_face(
+        VkFrontFace front_face) NEX
+{
+    if (filter(STATE_FRONT_FACE, &front_face, sizeof(front_face)))
+        cmd.set_front_face(front_face);
+}
+
+
+void
+command_recorder::set_topology(
+        VkPrimitiveTopology topology) NEX
+{
+    if (filter(STATE_TOPOLOGY, &topology, sizeof(topology)))
+        cmd.set_topology(topology);
+}
+
+
+void
+command_recorder::set_depth_test(
+        bool enable) NEX
+{
+    if (filter(STATE_DEPTH_TEST, &enable, sizeof(enable)))
+        cmd.set_depth_test(enable);
+}
+
+
+void
+command_recorder::set_depth_write(
+        bool enable) NEX
+{
+    if (filter(STATE_DEPTH_WRITE, &enable, sizeof(enable)))
+        cmd.set_depth_write(enable);
+}
+
+
+void
+command_recorder::set_depth_compare(
+        VkCompareOp compare_op) NEX
+{
+    if (filter(STATE_DEPTH_COMPARE, &compare_op, sizeof(compare_op)))
+        cmd.set_depth_compare(compare_op);
+}
+
+
+void
+command_recorder::set_depth_bounds_test(
+        bool enable) NEX
+{
+    if (filter(STATE_DEPTH_BOUNDS_TEST, &enable, sizeof(enable)))
+        cmd.set_depth_bounds_test(enable);
+}
+
+
+void
+command_recorder::set_stencil_test(
+        bool enable) NEX
+{
+    if (filter(STATE_STENCIL_TEST, &enable, sizeof(enable)))
+        cmd.set_stencil_test(enable);
+}
+
+
+void
+command_recorder::set_stencil_op(
+        VkStencilFaceFlags faces,
+        VkStencilOp fail,
+        VkStencilOp pass,
+        VkStencilOp depth_fail,
+        VkCompareOp compare_op) NEX
+{
+    const u32 v[4]{u32(fail), u32(pass), u32(depth_fail), u32(compare_op)};
+    if (const auto changed = filter_faces(faces, STATE_STENCIL_OP_FRONT, v, sizeof(v)))
+        cmd.set_stencil_op(changed, fail, pass, depth_fail, compare_op);
+}
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state2
+void
+command_recorder::set_rasterizer_discard(
+        bool enable) NEX
+{
+    if (filter(STATE_RASTERIZER_DISCARD, &enable, sizeof(enable)))
+        cmd.set_rasterizer_discard(enable);
+}
+
+
+void
+command_recorder::set_depth_bias_enable(
+        bool enable) NEX
+{
+    if (filter(STATE_DEPTH_BIAS_ENABLE, &enable, sizeof(enable)))
+        cmd.set_depth_bias_enable(enable);
+}
+
+
+void
+command_recorder::set_primitive_restart(
+        bool enable) NEX
+{
+    if (filter(STATE_PRIMITIVE_RESTART, &enable, sizeof(enable)))
+        cmd.set_primitive_restart(enable);
 }
+#endif
 
 //endregion
 
@@ -0,0 +1,564 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_COMMAND_STREAM_H
+#define TINYVK_COMMAND_STREAM_H
+
+#include "tinyvk_core.h"
+#include "tinyvk_command.h"
+
+namespace tinyvk {
+
+/// Deferred command list, commands are encoded as a header word (opcode in the low 8 bits, payload size in words
+/// above it) followed by their payload, tightly packed in a single word arena.
+/// Recording does not touch Vulkan, so every thread can record its own stream without synchronization.
+/// Commands are grouped into items by key (the commands after key() until the next key), streams of different
+/// threads are merged and the items sorted by key (items with equal keys keep their recording order) before
+/// they are replayed into a command buffer in one loop:
+///     - binds and dynamic state go through a command_recorder, so the binds made redundant by sorting are dropped
+///     - consecutive barriers (also across items) are collected in a barrier_batch and recorded as one pipeline
+///       barrier right before the next command. The caller orders barriers through the keys of their items
+/// Without TINYVK_SORT_ALLOCATE_MEMORY sort supports at most TINYVK_SORT_STACK_SIZE items.
+struct command_stream {
+    enum op_t : u32 {
+        OP_BIND_PIPELINE,
+        OP_BIND_DESCRIPTOR_SETS,
+        OP_BIND_VERTEX_BUFFERS,
+        OP_BIND_INDEX_BUFFER,
+        OP_PUSH_CONSTANTS,
+        OP_SET_VIEWPORT,
+        OP_SET_SCISSOR,
+        OP_DRAW,
+        OP_DRAW_INDEXED,
+        OP_DISPATCH,
+        OP_MEMORY_BARRIER,
+        OP_BUFFER_BARRIER,
+        OP_IMAGE_BARRIER,
+        OP_COUNT
+    };
+
+    struct item_t {
+        u64                     key{};
+        u32                     begin{};
+        u32                     end{};
+    };
+
+    small_vector<u32, 256>      words{};
+    small_vector<item_t, 32>    items{};
+
+    /// Start a new item, the commands recorded after this are sorted by key
+    void                key(
+            u64                         key) NEX;
+
+    void                bind_pipeline(
+            VkPipelineBindPoint         bind_point,
+            VkPipeline                  pipeline,
+            bool                        same_dynamic_states = false) NEX;
+
+    void                bind_descriptor_sets(
+            VkPipelineBindPoint         bind_point,
+            VkPipelineLayout            layout,
+            u32                         first_set,
+            span<const VkDescriptorSet> sets,
+            span<const u32>             dynamic_offsets = {}) NEX;
+
+    void                bind_vertex_buffers(
+            u32                         first_binding,
+            span<const VkBuffer>        buffers,
+            span<const VkDeviceSize>    offsets) NEX;
+
+    void                bind_index_buffer(
+            VkBuffer                    buffer,
+            VkDeviceSize                offset,
+            VkIndexType                 index_type) NEX;
+
+    void                push_constants(
+            VkPipelineLayout            layout,
+            VkShaderStageFlags          stages,
+            u32                         offset,
+            u32                         size,
+            const void*                 data) NEX;
+
+    void                set_viewport(
+            const VkViewport&           viewport) NEX;
+
+    void                set_scissor(
+            const VkRect2D&             scissor) NEX;
+
+    void                draw(
+            u32                         vertex_count,
+            u32                         instance_count = 1,
+            u32                         first_vertex = 0,
+            u32                         first_instance = 0) NEX;
+
+    void                draw_indexed(
+            u32                         index_count,
+            u32                         instance_count = 1,
+            u32                         first_index = 0,
+            i32                         vertex_offset = 0,
+            u32                         first_instance = 0) NEX;
+
+    void                dispatch(
+            u32                         x,
+            u32                         y = 1,
+            u32                         z = 1) NEX;
+
+    void                memory_barrier(
+            barrier_access              src,
+            barrier_access              dst) NEX;
+
+    void                buffer_barrier(
+            VkBuffer                    buffer,
+            barrier_access              src,
+            barrier_access              dst,
+            VkDeviceSize                offset = 0,
+            VkDeviceSize                size = VK_WHOLE_SIZE) NEX;
+
+    void                image_barrier(
+            VkImage                     image,
+            const VkImageSubresourceRange& range,
+            VkImageLayout               old_layout,
+            VkImageLayout               new_layout,
+            barrier_access              src,
+            barrier_access              dst) NEX;
+
+    /// Append the commands of other, its items keep their keys
+    void                merge(
+            const command_stream&       other) NEX;
+
+    /// Order the items by key, items with equal keys keep the order they were recorded (or merged) in
+    void                sort() NEX;
+
+    void                clear() NEX;
+
+    NDC bool            empty() const NEX { return words.size() == 0; }
+
+    NDC size_t          size_bytes() const NEX { return words.size() * sizeof(u32); }
+
+    /// Record every command into the command buffer of recorder, in item order
+    void                replay(
+            command_recorder&           recorder) const NEX;
+
+private:
+    NDC u32*            push(
+            op_t                        op,
+            u32                         size) NEX;
+};
+
+}
+
+#endif //TINYVK_COMMAND_STREAM_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_COMMAND_STREAM_CPP
+#define TINYVK_COMMAND_STREAM_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+namespace command_stream_impl {
+
+template<typename T>
+constexpr u32 words_of(u32 count = 1)
+{
+    return u32((sizeof(T) * count + sizeof(u32) - 1) / sizeof(u32));
+}
+
+template<typename T>
+void write_array(u32*& p, const T* v, u32 count)
+{
+    if (count)
+        tinystd::memcpy(p, v, sizeof(T) * count);
+    p += words_of<T>(count);
+}
+
+template<typename T>
+void write(u32*& p, const T& v)
+{
+    write_array(p, &v, 1);
+}
+
+template<typename T>
+T read(const u32*& p)
+{
+    T v;
+    tinystd::memcpy(&v, p, sizeof(T));
+    p += words_of<T>();
+    return v;
+}
+
+}
+
+//region command_stream
+
+void
+command_stream::key(
+        u64 key) NEX
+{
+    const u32 at = u32(words.size());
+    items.push_back({key, at, at});
+}
+
+
+u32*
+command_stream::push(
+        op_t op,
+        u32 size) NEX
+{
+    tassert(size < (1u << 24) && "tinyvk::command_stream::push - Command payload too large");
+    if (items.size() == 0)
+        key(0);
+    const size_t at = words.size();
+    words.resize(at + 1 + size);
+    words[at] = u32(op) | (size << 8);
+    items.back().end = u32(words.size());
+    return words.data() + at + 1;
+}
+
+
+void
+command_stream::bind_pipeline(
+        VkPipelineBindPoint bind_point,
+        VkPipeline pipeline,
+        bool same_dynamic_states) NEX
+{
+    using namespace command_stream_impl;
+    u32* p = push(OP_BIND_PIPELINE, 2 + words_of<VkPipeline>());
+    write(p, u32(bind_point));
+    write(p, pipeline);
+    write(p, u32(same_dynamic_states));
+}
+
+
+void
+command_stream::bind_descriptor_sets(
+        VkPipelineBindPoint bind_point,
+        VkPipelineLayout layout,
+        u32 first_set,
+        span<const VkDescriptorSet> sets,
+        span<const u32> dynamic_offsets) NEX
+{
+    using namespace command_stream_impl;
+    const u32 set_count = u32(sets.size()), offset_count = u32(dynamic_offsets.size());
+    u32* p = push(OP_BIND_DESCRIPTOR_SETS,
+        4 + words_of<VkPipelineLayout>() + words_of<VkDescriptorSet>(set_count) + offset_count);
+    write(p, u32(bind_point));
+    write(p, layout);
+    write(p, first_set);
+    write(p, set_count);
+    write(p, offset_count);
+    write_array(p, sets.data(), set_count);
+    write_array(p, dynamic_offsets.data(), offset_count);
+}
+
+
+void
+command_stream::bind_vertex_buffers(
+        u32 first_binding,
+        span<const VkBuffer> buffers,
+        span<const VkDeviceSize> offsets) NEX
+{
+    using namespace command_stream_impl;
+    tassert(buffers.size() == offsets.size() && "tinyvk::command_stream::bind_vertex_buffers - Every buffer needs an offset");
+    const u32 count = u32(buffers.size());
+    u32* p = push(OP_BIND_VERTEX_BUFFERS, 2 + words_of<VkBuffer>(count) + words_of<VkDeviceSize>(count));
+    write(p, first_binding);
+    write(p, count);
+    write_array(p, buffers.data(), count);
+    write_array(p, offsets.data(), count);
+}
+
+
+void
+command_stream::bind_index_buffer(
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkIndexType index_type) NEX
+{
+    using namespace command_stream_impl;
+    u32* p = push(OP_BIND_INDEX_BUFFER, words_of<VkBuffer>() + words_of<VkDeviceSize>() + 1);
+    write(p, buffer);
+    write(p, offset);
+    write(p, u32(index_type));
+}
+
+
+void
+command_stream::push_constants(
+        VkPipelineLayout layout,
+        VkShaderStageFlags stages,
+        u32 offset,
+        u32 size,
+        const void* data) NEX
+{
+    using namespace command_stream_impl;
+    u32* p = push(OP_PUSH_CONSTANTS, words_of<VkPipelineLayout>() + 3 + words_of<u8>(size));
+    write(p, layout);
+    write(p, u32(stages));
+    write(p, offset);
+    write(p, size);
+    write_array(p, (const u8*)data, size);
+}
+
+
+void
+command_stream::set_viewport(
+        const VkViewport& viewport) NEX
+{
+    using namespace command_stream_impl;
+    u32* p = push(OP_SET_VIEWPORT, words_of<VkViewport>());
+    write(p, viewport);
+}
+
+
+void
+command_stream::set_scissor(
+        const VkRect2D& scissor) NEX
+{
+    using namespace command_stream_impl;
+    u32* p = push(OP_SET_SCISSOR, words_of<VkRect2D>());
+    write(p, scissor);
+}
+
+
+void
+command_stream::draw(
+        u32 vertex_count,
+        u32 instance_count,
+        u32 first_vertex,
+        u32 first_instance) NEX
+{
+    u32* p = push(OP_DRAW, 4);
+    p[0] = vertex_count;
+    p[1] = instance_count;
+    p[2] = first_vertex;
+    p[3] = first_instance;
+}
+
+
+void
+command_stream::draw_indexed(
+        u32 index_count,
+        u32 instance_count,
+        u32 first_index,
+        i32 vertex_offset,
+        u32 first_instance) NEX
+{
+    u32* p = push(OP_DRAW_INDEXED, 5);
+    p[0] = index_count;
+    p[1] = instance_count;
+    p[2] = first_index;
+    p[3] = u32(vertex_offset);
+    p[4] = first_instance;
+}
+
+
+void
+command_stream::dispatch(
+        u32 x,
+        u32 y,
+        u32 z) NEX
+{
+    u32* p = push(OP_DISPATCH, 3);
+    p[0] = x;
+    p[1] = y;
+    p[2] = z;
+}
+
+
+void
+command_stream::memory_barrier(
+        barrier_access src,
+        barrier_access dst) NEX
+{
+    using namespace command_stream_impl;
+    u32* p = push(OP_MEMORY_BARRIER, 2 * words_of<barrier_access>());
+    write(p, src);
+    write(p, dst);
+}
+
+
+void
+command_stream::buffer_barrier(
+        VkBuffer buffer,
+        barrier_access src,
+        barrier_access dst,
+        VkDeviceSize offset,
+        VkDeviceSize size) NEX
+{
+    using namespace command_stream_impl;
+    u32* p = push(OP_BUFFER_BARRIER, words_of<VkBuffer>() + 2 * words_of<barrier_access>() + 2 * words_of<VkDeviceSize>());
+    write(p, buffer);
+    write(p, src);
+    write(p, dst);
+    write(p, offset);
+    write(p, size);
+}
+
+
+void
+command_stream::image_barrier(
+        VkImage image,
+        const VkImageSubresourceRange& range,
+        VkImageLayout old_layout,
+        VkImageLayout new_layout,
+        barrier_access src,
+        barrier_access dst) NEX
+{
+    using namespace command_stream_impl;
+    u32* p = push(OP_IMAGE_BARRIER, words_of<VkImage>() + words_of<VkImageSubresourceRange>() + 2 + 2 * words_of<barrier_access>());
+    write(p, image);
+    write(p, range);
+    write(p, u32(old_layout));
+    write(p, u32(new_layout));
+    write(p, src);
+    write(p, dst);
+}
+
+
+void
+command_stream::merge(
+        const command_stream& other) NEX
+{
+    const u32 at = u32(words.size());
+    words.resize(at + other.words.size());
+    tinystd::memcpy(words.data() + at, other.words.data(), other.words.size() * sizeof(u32));
+    for (auto& item: other.items)
+        items.push_back({item.key, item.begin + at, item.end + at});
+}
+
+
+void
+command_stream::sort() NEX
+{
+    // begin is unique, comparing it as well keeps the recording order of equal keys
+    tinystd::sort(items.begin(), items.end(), [](const item_t& l, const item_t& r) {
+        return l.key < r.key || (l.key == r.key && l.begin < r.begin);
+    });
+}
+
+
+void
+command_stream::clear() NEX
+{
+    words.clear();
+    items.clear();
+}
+
+
+void
+command_stream::replay(
+        command_recorder& recorder) const NEX
+{
+    using namespace command_stream_impl;
+    const VkCommandBuffer cmd = recorder.cmd;
+    barrier_batch barriers{};
+
+    for (auto& item: items) {
+        const u32* p = words.data() + item.begin;
+        const u32* end = words.data() + item.end;
+        while (p < end) {
+            const op_t op = op_t(*p & 0xffu);
+            const u32* next = p + 1 + (*p >> 8);
+            ++p;
+            if (op < OP_MEMORY_BARRIER && !barriers.empty())
+                barriers.flush(cmd);
+
+            switch (op) {
+                case OP_BIND_PIPELINE: {
+                    const auto bind_point = VkPipelineBindPoint(read<u32>(p));
+                    const auto pipeline = read<VkPipeline>(p);
+                    recorder.bind_pipeline(bind_point, pipeline, read<u32>(p) != 0);
+                    break;
+                }
+                case OP_BIND_DESCRIPTOR_SETS: {
+                    const auto bind_point = VkPipelineBindPoint(read<u32>(p));
+                    const auto layout = read<VkPipelineLayout>(p);
+                    const u32 first_set = read<u32>(p), set_count = read<u32>(p), offset_count = read<u32>(p);
+                    VkDescriptorSet sets[MAX_BOUND_DESCRIPTOR_SETS]{};
+                    tassert(set_count <= MAX_BOUND_DESCRIPTOR_SETS && "tinyvk::command_stream::replay - Too many descriptor sets");
+                    tinystd::memcpy(sets, p, set_count * sizeof(VkDescriptorSet));
+                    p += words_of<VkDescriptorSet>(set_count);
+                    recorder.bind_descriptor_sets(bind_point, layout, first_set, {sets, set_count}, {p, offset_count});
+                    break;
+                }
+                case OP_BIND_VERTEX_BUFFERS: {
+                    const u32 first = read<u32>(p), count = read<u32>(p);
+                    VkBuffer buffers[MAX_VERTEX_BINDINGS]{};
+                    VkDeviceSize offsets[MAX_VERTEX_BINDINGS]{};
+                    tassert(count <= MAX_VERTEX_BINDINGS && "tinyvk::command_stream::replay - Too many vertex buffers");
+                    tinystd::memcpy(buffers, p, count * sizeof(VkBuffer));
+                    p += words_of<VkBuffer>(count);
+                    tinystd::memcpy(offsets, p, count * sizeof(VkDeviceSize));
+                    recorder.bind_vertex_buffers(first, {buffers, count}, {offsets, count});
+                    break;
+                }
+                case OP_BIND_INDEX_BUFFER: {
+                    const auto buffer = read<VkBuffer>(p);
+                    const auto offset = read<VkDeviceSize>(p);
+                    recorder.bind_index_buffer(buffer, offset, VkIndexType(read<u32>(p)));
+                    break;
+                }
+                case OP_PUSH_CONSTANTS: {
+                    const auto layout = read<VkPipelineLayout>(p);
+                    const auto stages = VkShaderStageFlags(read<u32>(p));
+                    const u32 offset = read<u32>(p), size = read<u32>(p);
+                    recorder.push_constants(layout, stages, offset, size, p);
+                    break;
+                }
+                case OP_SET_VIEWPORT:
+                    recorder.set_viewport(read<VkViewport>(p));
+                    break;
+                case OP_SET_SCISSOR:
+                    recorder.set_scissor(read<VkRect2D>(p));
+                    break;
+                case OP_DRAW:
+                    vkCmdDraw(cmd, p[0], p[1], p[2], p[3]);
+                    break;
+                case OP_DRAW_INDEXED:
+                    vkCmdDrawIndexed(cmd, p[0], p[1], p[2], i32(p[3]), p[4]);
+                    break;
+                case OP_DISPATCH:
+                    vkCmdDispatch(cmd, p[0], p[1], p[2]);
+                    break;
+                case OP_MEMORY_BARRIER: {
+                    const auto src = read<barrier_access>(p);
+                    barriers.global(src, read<barrier_access>(p));
+                    break;
+                }
+                case OP_BUFFER_BARRIER: {
+                    const auto buffer = read<VkBuffer>(p);
+                    const auto src = read<barrier_access>(p);
+                    const auto dst = read<barrier_access>(p);
+                    const auto offset = read<VkDeviceSize>(p);
+                    barriers.buffer(buffer, src, dst, offset, read<VkDeviceSize>(p));
+                    break;
+                }
+                case OP_IMAGE_BARRIER: {
+                    const auto image = read<VkImage>(p);
+                    const auto range = read<VkImageSubresourceRange>(p);
+                    const auto old_layout = VkImageLayout(read<u32>(p));
+                    const auto new_layout = VkImageLayout(read<u32>(p));
+                    const auto src = read<barrier_access>(p);
+                    barriers.image(image, range, old_layout, new_layout, src, read<barrier_access>(p));
+                    break;
+                }
+                default:
+                    tassert(false && "tinyvk::command_stream::replay - Invalid opcode");
+            }
+            p = next;
+        }
+    }
+    barriers.flush(cmd);
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_COMMAND_STREAM_CPP
+
+#endif //TINYVK_IMPLEMENTATION
@@ -57,6 +57,46 @@
 #define TINYVK_DEFAULT_MAX_PUSH_CONSTANT_SIZE   128
 #endif
 
+#ifndef TINYVK_MAX_DYNAMIC_STATES
+#define TINYVK_MAX_DYNAMIC_STATES               32
+#endif
+
+#ifndef TINYVK_MAX_FRAMES_IN_FLIGHT
+#define TINYVK_MAX_FRAMES_IN_FLIGHT             3
+#endif
+
+#ifndef TINYVK_MAX_RECORDING_THREADS
+#define TINYVK_MAX_RECORDING_THREADS            16
+#endif
+
+#ifndef TINYVK_MAX_RING_COMMAND_BUFFERS
+#define TINYVK_MAX_RING_COMMAND_BUFFERS         32
+#endif
+
+#ifndef TINYVK_MAX_BUNDLE_REFERENCES
+#define TINYVK_MAX_BUNDLE_REFERENCES            16
+#endif
+
+#ifndef TINYVK_MAX_BOUND_DESCRIPTOR_SETS
+#define TINYVK_MAX_BOUND_DESCRIPTOR_SETS        8
+#endif
+
+#ifndef TINYVK_MAX_VERTEX_BINDINGS
+#define TINYVK_MAX_VERTEX_BINDINGS              16
+#endif
+
+#ifndef TINYVK_MAX_PACKET_COMMAND_BUFFERS
+#define TINYVK_MAX_PACKET_COMMAND_BUFFERS       8
+#endif
+
+#ifndef TINYVK_MAX_PACKET_SEMAPHORES
+#define TINYVK_MAX_PACKET_SEMAPHORES            4
+#endif
+
+#ifndef TINYVK_MAX_UPLOAD_BATCHES
+#define TINYVK_MAX_UPLOAD_BATCHES               4
+#endif
+
 #ifndef TINYVK_DEFAULT_TIMEOUT_NANOSECONDS
 #define TINYVK_DEFAULT_TIMEOUT_NANOSECONDS      1000000000
 #endif
@@ -69,6 +109,22 @@
 #define TINYVK_RENDERPASS_API_LIMITS        tinyvk::default_renderpass_api_limits
 #endif
 
+#ifndef TINYVK_RENDER_GRAPH_API_LIMITS
+#define TINYVK_RENDER_GRAPH_API_LIMITS      tinyvk::default_render_graph_api_limits
+#endif
+
+#ifndef TINYVK_PROFILER_API_LIMITS
+#define TINYVK_PROFILER_API_LIMITS          tinyvk::default_profiler_api_limits
+#endif
+
+#ifndef TINYVK_RESOURCE_CACHE_API_LIMITS
+#define TINYVK_RESOURCE_CACHE_API_LIMITS    tinyvk::default_resource_cache_api_limits
+#endif
+
+#if defined(TINYVK_USE_SYNCHRONIZATION2) && !defined(VK_VERSION_1_3)
+#error TINYVK_USE_SYNCHRONIZATION2 requires the Vulkan 1.3 headers
+#endif
+
 
 #define DEFINE_ENUM_FLAG(ENUM_TYPE)                                                                        \
 	static inline ENUM_TYPE operator|(ENUM_TYPE a, ENUM_TYPE b) { return (ENUM_TYPE)((uint32_t)(a) | (uint32_t)(b)); } \
@@ -84,6 +140,16 @@ enum {
     MAX_DEVICE_QUEUES = TINYVK_MAX_DEVICE_QUEUES,
     MAX_SWAPCHAIN_IMAGES = TINYVK_MAX_SWAPCHAIN_IMAGES,
     MAX_PUSH_CONSTANT_SIZE = TINYVK_DEFAULT_MAX_PUSH_CONSTANT_SIZE,
+    MAX_DYNAMIC_STATES = TINYVK_MAX_DYNAMIC_STATES,
+    MAX_FRAMES_IN_FLIGHT = TINYVK_MAX_FRAMES_IN_FLIGHT,
+    MAX_RECORDING_THREADS = TINYVK_MAX_RECORDING_THREADS,
+    MAX_RING_COMMAND_BUFFERS = TINYVK_MAX_RING_COMMAND_BUFFERS,
+    MAX_BUNDLE_REFERENCES = TINYVK_MAX_BUNDLE_REFERENCES,
+    MAX_BOUND_DESCRIPTOR_SETS = TINYVK_MAX_BOUND_DESCRIPTOR_SETS,
+    MAX_VERTEX_BINDINGS = TINYVK_MAX_VERTEX_BINDINGS,
+    MAX_PACKET_COMMAND_BUFFERS = TINYVK_MAX_PACKET_COMMAND_BUFFERS,
+    MAX_PACKET_SEMAPHORES = TINYVK_MAX_PACKET_SEMAPHORES,
+    MAX_UPLOAD_BATCHES = TINYVK_MAX_UPLOAD_BATCHES,
     DEFAULT_TIMEOUT_NANOS = TINYVK_DEFAULT_TIMEOUT_NANOSECONDS,
 };
 
@@ -118,6 +184,52 @@ using tinystd::ibool;
 using vk_alloc = const VkAllocationCallbacks*;
 
 
+#ifdef VK_VERSION_1_3
+/// Synchronization2 (VK_KHR_synchronization2, core in 1.3) stage and access masks.
+/// The low 32 bits have the same meaning as the legacy flags, the high bits are the finer grained stages/accesses.
+using pipeline_stage_flags = VkPipelineStageFlags2;
+using access_flags = VkAccessFlags2;
+
+/// Map the finer grained stages to the legacy stages that contain them
+NDC constexpr VkPipelineStageFlags legacy_stages(pipeline_stage_flags stages) NEX
+{
+    constexpr pipeline_stage_flags transfer = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT
+            | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT;
+    constexpr pipeline_stage_flags vertex_input = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+    constexpr pipeline_stage_flags pre_raster = VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT;
+
+    VkPipelineStageFlags legacy = VkPipelineStageFlags(stages & 0xffffffffull);
+    if (stages & transfer)
+        legacy |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (stages & vertex_input)
+        legacy |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    if (stages & pre_raster)
+        legacy |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT
+                | VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+    if ((stages >> 32) & ~((transfer | vertex_input | pre_raster) >> 32))
+        legacy |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT; // no legacy equivalent
+    return legacy;
+}
+
+/// Map the finer grained accesses to the legacy accesses that contain them
+NDC constexpr VkAccessFlags legacy_access(access_flags access) NEX
+{
+    VkAccessFlags legacy = VkAccessFlags(access & 0xffffffffull);
+    if (access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT))
+        legacy |= VK_ACCESS_SHADER_READ_BIT;
+    if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+        legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+    return legacy;
+}
+#else
+using pipeline_stage_flags = VkPipelineStageFlags;
+using access_flags = VkAccessFlags;
+
+NDC constexpr VkPipelineStageFlags legacy_stages(pipeline_stage_flags stages) NEX { return stages; }
+NDC constexpr VkAccessFlags legacy_access(access_flags access) NEX { return access; }
+#endif
+
+
 enum image_layout_t: u32 {
     LAYOUT_UNDEFINED = 0,
     LAYOUT_GENERAL = 1,
@@ -185,6 +297,7 @@ enum vma_usage_t {
     VMA_USAGE_CPU_TO_GPU = 3,
     VMA_USAGE_GPU_TO_CPU = 4,
     VMA_USAGE_CPU_COPY = 5,
+    VMA_USAGE_GPU_LAZILY_ALLOCATED = 6,
 };
 
 
@@ -300,12 +413,50 @@ using debug_flags = u32;
 
 void set_debug(debug_flags debug);
 
+/// Without lazily allocated memory the memory properties have no LAZILY_ALLOCATED type,
+/// set it before creating the device (VMA reads the memory properties once)
+void set_lazily_allocated_memory(bool supported);
+
+/// Without host coherent memory the uncached host visible type is not HOST_COHERENT (the cached one still is),
+/// set it before creating the device
+void set_host_coherent_memory(bool coherent);
+
 
 const VkInstanceCreateInfo&     get_desc(VkInstance v);
 const VkDeviceCreateInfo&       get_desc(VkDevice v);
 const VkRenderPassCreateInfo&   get_desc(VkRenderPass v);
 const VkFramebufferCreateInfo&  get_desc(VkFramebuffer v);
 
+struct command_stats {
+    u32 pipeline_barriers;
+    u32 memory_barriers;
+    u32 buffer_barriers;
+    u32 image_barriers;
+    u32 draws;
+    u32 dispatches;
+    u32 dispatched_groups;
+    u32 copies;
+    u32 copy_regions;
+    u32 flushed_ranges;
+    u32 queue_submits;
+    u32 submit_infos;
+    u32 submitted_command_buffers;
+    u32 timestamps;
+    u32 destroyed_objects;
+    u32 descriptor_writes;
+    u32 written_descriptors;
+};
+
+const command_stats&            get_command_stats();
+void                            reset_command_stats();
+
+/// Image views written by the last vkUpdateDescriptorSets, in write and array element order
+span<const VkImageView>         get_written_image_views();
+
+/// Timeline semaphores only advance when they are waited on or signalled from the host,
+/// this completes all work signalled by submits so far (as if the device went idle)
+void                            complete_semaphores();
+
 }
 
 }
@@ -0,0 +1,487 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_DEFRAGMENTER_H
+#define TINYVK_DEFRAGMENTER_H
+
+#include "tinyvk_core.h"
+#include "tinyvk_queue.h"
+#include "tinyvk_command.h"
+#include "tinyvk_buffer.h"
+#include "tinyvk_image.h"
+
+namespace tinyvk {
+
+#ifdef TINYVK_USE_VMA
+
+/// Incremental defragmentation of VMA allocations made with buffer::create and image::create.
+/// Resources are tracked with the desc they were created with, begin plans the moves of every tracked allocation
+/// and step (once per frame) runs the plan one pass at a time:
+///     - a pass takes moves until max_bytes are moved, creates the new buffers and images at their destination and
+///       copies the old ones into them with one command buffer on the transfer queue (the graphics queue without one)
+///     - once the copy completed, step returns the moves and calls the rebind callback with the old and the new
+///       handles, switch descriptors, views and framebuffers to the new handles before the next frame
+///     - the old handles are destroyed and the old memory released frames_in_flight frames later, then the
+///       next pass starts
+/// Tracked resources must be created with both transfer usages (BUFFER/IMAGE_TRANSFER_SRC and _DST), the copies
+/// read the old resource and write the new one created with the same desc.
+/// Tracked resources must not be written by the device while defragmentation is running, images are transitioned
+/// to TRANSFER_SRC_OPTIMAL and back for the copy unless they are kept in GENERAL or TRANSFER_SRC_OPTIMAL, so
+/// other images must not be accessed by the device while their pass copies them.
+/// When the transfer family differs from the graphics family resources must be created with queue_families
+/// (concurrent sharing) so both families can access them. Tracked allocations must not be destroyed while
+/// defragmentation is running. Not thread safe.
+struct defragmenter {
+    /// The resource of allocation moved, exactly one of the buffer and image pairs is set
+    struct move_t {
+        VmaAllocation           allocation{};
+        VkBuffer                old_buffer{};
+        VkBuffer                new_buffer{};
+        VkImage                 old_image{};
+        VkImage                 new_image{};
+        u64                     size{};
+    };
+
+    using rebind_fn = void(*)(void* data, const move_t& move);
+
+    struct resource_t {
+        VmaAllocation           allocation{};
+        VkBuffer                buffer{};
+        VkImage                 image{};
+        u64                     size{};
+        buffer_desc             buffer_info{};
+        image_desc              image_info{};
+        VkImageLayout           layout{};
+    };
+
+    enum state_t : u32 { IDLE, COPYING, RETIRING };
+
+    VkQueue                     queue{};
+    u32                         transfer_family{};
+    u32                         graphics_family{};
+    command_pool                pool{};
+    VkCommandBuffer             cmd{};
+    VkFence                     fence{};
+    u32                         frame_count{};
+    u64                         frame{};
+    rebind_fn                   rebind{};
+    void*                       rebind_data{};
+    VmaDefragmentationContext   context{};
+    state_t                     state{};
+    u64                         retire_frame{};
+    small_vector<move_t, 32>    moves{};
+    small_vector<resource_t, 64> resources{};
+    u64                         bytes_moved{};
+    u64                         allocations_moved{};
+
+    static defragmenter create(
+            VkDevice                        device,
+            const queue_collection&         queues,
+            const queue_create_info&        info,
+            u32                             frames_in_flight,
+            rebind_fn                       rebind = {},
+            void*                           rebind_data = {},
+            vk_alloc                        alloc = {}) NEX;
+
+    /// Finishes a running defragmentation, call when the device is idle
+    void                destroy(
+            VmaAllocator                    vma,
+            VkDevice                        device,
+            vk_alloc                        alloc = {}) NEX;
+
+    /// Allow allocation (of buffer b created with desc) to be moved, desc.queue_families must outlive the tracking
+    void                track(
+            VmaAllocator                    vma,
+            VmaAllocation                   allocation,
+            VkBuffer                        b,
+            const buffer_desc&              desc) NEX;
+
+    /// Allow allocation (of image im created with desc) to be moved, layout is the layout the image is kept in
+    void                track(
+            VmaAllocator                    vma,
+            VmaAllocation                   allocation,
+            VkImage                         im,
+            const image_desc&               desc,
+            VkImageLayout                   layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) NEX;
+
+    /// Stop tracking allocation, before destroying it
+    void                untrack(
+            VmaAllocation                   allocation) NEX;
+
+    /// Plan the moves of all tracked allocations, step runs the plan. Does nothing if it is already running
+    void                begin(
+            VmaAllocator                    vma) NEX;
+
+    /// Advance the defragmentation by one frame, moving at most max_bytes (at least one allocation) in a new pass.
+    /// Returns the moves whose copies completed during this step, valid until the next step
+    span<const move_t>  step(
+            VmaAllocator                    vma,
+            VkDevice                        device,
+            u64                             max_bytes,
+            vk_alloc                        alloc = {}) NEX;
+
+    NDC bool            running() const NEX { return context != nullptr; }
+
+private:
+    void                record_pass(
+            VkDevice                        device) NEX;
+
+    void                end_pass(
+            VmaAllocator                    vma,
+            VkDevice                        device,
+            vk_alloc                        alloc) NEX;
+};
+
+#else
+
+#error tinyvk::defragmenter not supported without TINYVK_USE_VMA defined
+
+#endif
+
+}
+
+#endif //TINYVK_DEFRAGMENTER_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_DEFRAGMENTER_CPP
+#define TINYVK_DEFRAGMENTER_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+#ifdef TINYVK_USE_VMA
+
+//region defragmenter
+
+defragmenter
+defragmenter::create(
+        VkDevice device,
+        const queue_collection& queues,
+        const queue_create_info& info,
+        u32 frames_in_flight,
+        rebind_fn rebind,
+        void* rebind_data,
+        vk_alloc alloc) NEX
+{
+    tassert(queues.count[QUEUE_GRAPHICS] && "tinyvk::defragmenter::create - A graphics queue is required");
+    tassert(frames_in_flight && frames_in_flight <= MAX_FRAMES_IN_FLIGHT && "tinyvk::defragmenter::create - Invalid number of frames in flight");
+
+    defragmenter d{};
+    const queue_type_t type = queues.count[QUEUE_TRANSFER] ? QUEUE_TRANSFER : QUEUE_GRAPHICS;
+    d.queue = queues.get(type);
+    d.transfer_family = info.queues[type][0].family;
+    d.graphics_family = info.queues[QUEUE_GRAPHICS][0].family;
+    d.frame_count = frames_in_flight;
+    d.rebind = rebind;
+    d.rebind_data = rebind_data;
+    d.pool = command_pool::create(device, d.transfer_family, CMD_POOL_TRANSIENT, alloc);
+    d.pool.allocate(device, {&d.cmd, 1});
+
+    VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    vk_validate(vkCreateFence(device, &fence_info, alloc, &d.fence),
+        "tinyvk::defragmenter::create - Failed to create fence");
+    return d;
+}
+
+
+void
+defragmenter::destroy(
+        VmaAllocator vma,
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    if (state == COPYING) {
+        vk_validate(vkWaitForFences(device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT_NANOS),
+            "tinyvk::defragmenter::destroy - Failed to wait for copies");
+        step(vma, device, 0, alloc);
+    }
+    if (state == RETIRING)
+        end_pass(vma, device, alloc);
+    if (running())
+        vmaDefragmentationEnd(vma, context);
+
+    vkDestroyFence(device, fence, alloc);
+    pool.destroy(device, alloc);
+    *this = {};
+}
+
+
+void
+defragmenter::track(
+        VmaAllocator vma,
+        VmaAllocation allocation,
+        VkBuffer b,
+        const buffer_desc& desc) NEX
+{
+    tassert(!running() && "tinyvk::defragmenter::track - Can not track allocations while running");
+    tassert((transfer_family == graphics_family || !desc.queue_families.empty())
+        && "tinyvk::defragmenter::track - Buffer must be shared with the transfer family");
+    tassert((desc.usage & (BUFFER_TRANSFER_SRC | BUFFER_TRANSFER_DST)) == (BUFFER_TRANSFER_SRC | BUFFER_TRANSFER_DST)
+        && "tinyvk::defragmenter::track - Buffer must be created with BUFFER_TRANSFER_SRC and BUFFER_TRANSFER_DST usage");
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(vma, allocation, &info);
+    resource_t r{};
+    r.allocation = allocation;
+    r.buffer = b;
+    r.size = info.size;
+    r.buffer_info = desc;
+    resources.push_back(r);
+}
+
+
+void
+defragmenter::track(
+        VmaAllocator vma,
+        VmaAllocation allocation,
+        VkImage im,
+        const image_desc& desc,
+        VkImageLayout layout) NEX
+{
+    tassert(!running() && "tinyvk::defragmenter::track - Can not track allocations while running");
+    tassert((transfer_family == graphics_family || !desc.queue_families.empty())
+        && "tinyvk::defragmenter::track - Image must be shared with the transfer family");
+    tassert((desc.usage & (IMAGE_TRANSFER_SRC | IMAGE_TRANSFER_DST)) == (IMAGE_TRANSFER_SRC | IMAGE_TRANSFER_DST)
+        && "tinyvk::defragmenter::track - Image must be created with IMAGE_TRANSFER_SRC and IMAGE_TRANSFER_DST usage");
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(vma, allocation, &info);
+    resource_t r{};
+    r.allocation = allocation;
+    r.image = im;
+    r.size = info.size;
+    r.image_info = desc;
+    r.layout = layout;
+    resources.push_back(r);
+}
+
+
+void
+defragmenter::untrack(
+        VmaAllocation allocation) NEX
+{
+    tassert(!running() && "tinyvk::defragmenter::untrack - Can not untrack allocations while running");
+    auto* r = tinystd::find_if(resources.begin(), resources.end(), [&](const resource_t& res){ return res.allocation == allocation; });
+    if (r == resources.end())
+        return;
+    *r = resources.back();
+    resources.pop_back();
+}
+
+
+void
+defragmenter::begin(
+        VmaAllocator vma) NEX
+{
+    if (running() || resources.empty())
+        return;
+
+    small_vector<VmaAllocation, 64> allocations{};
+    for (const auto& r: resources)
+        allocations.push_back(r.allocation);
+
+    VmaDefragmentationInfo2 info{};
+    info.flags = VMA_DEFRAGMENTATION_FLAG_INCREMENTAL;
+    info.allocationCount = u32(allocations.size());
+    info.pAllocations = allocations.data();
+    // every move is a GPU copy, host visible allocations included
+    info.maxGpuBytesToMove = VK_WHOLE_SIZE;
+    info.maxGpuAllocationsToMove = -1u;
+    const VkResult r = vmaDefragmentationBegin(vma, &info, nullptr, &context);
+    if (r != VK_NOT_READY)
+        vk_validate(r, "tinyvk::defragmenter::begin - Failed to begin defragmentation");
+}
+
+
+span<const defragmenter::move_t>
+defragmenter::step(
+        VmaAllocator vma,
+        VkDevice device,
+        u64 max_bytes,
+        vk_alloc alloc) NEX
+{
+    ++frame;
+    if (!running())
+        return {};
+
+    if (state == COPYING) {
+        const VkResult r = vkGetFenceStatus(device, fence);
+        if (r == VK_NOT_READY)
+            return {};
+        vk_validate(r, "tinyvk::defragmenter::step - Failed to wait for copies");
+        vk_validate(vkResetFences(device, 1, &fence),
+            "tinyvk::defragmenter::step - Failed to reset fence");
+
+        // the new handles are ready, the old ones stay alive until the frames that use them completed
+        for (const auto& m: moves) {
+            auto* res = tinystd::find_if(resources.begin(), resources.end(), [&](const resource_t& r){ return r.allocation == m.allocation; });
+            res->buffer = m.new_buffer;
+            res->image = m.new_image;
+            bytes_moved += m.size;
+            ++allocations_moved;
+            if (rebind)
+                rebind(rebind_data, m);
+        }
+        state = RETIRING;
+        retire_frame = frame;
+        return {moves.data(), moves.size()};
+    }
+
+    if (state == RETIRING) {
+        if (retire_frame + frame_count > frame)
+            return {};
+        end_pass(vma, device, alloc);
+    }
+
+    // take moves until the budget is spent, moves of a plan never overlap so they can be copied together
+    u64 bytes = 0;
+    while (moves.empty() || bytes < max_bytes) {
+        VmaDefragmentationPassMoveInfo vma_move{};
+        VmaDefragmentationPassInfo pass{1, &vma_move};
+        vk_validate(vmaBeginDefragmentationPass(vma, context, &pass),
+            "tinyvk::defragmenter::step - Failed to begin defragmentation pass");
+        if (!pass.moveCount)
+            break;
+
+        const auto* res = tinystd::find_if(resources.begin(), resources.end(), [&](const resource_t& r){ return r.allocation == vma_move.allocation; });
+        tassert(res != resources.end() && "tinyvk::defragmenter::step - Moved allocation is not tracked");
+        move_t m{};
+        m.allocation = vma_move.allocation;
+        m.size = res->size;
+        if (res->buffer) {
+            const VkBufferCreateInfo info = buffer::create_info(res->buffer_info);
+            m.old_buffer = res->buffer;
+            vk_validate(vkCreateBuffer(device, &info, alloc, &m.new_buffer),
+                "tinyvk::defragmenter::step - Failed to create moved buffer");
+            vk_validate(vkBindBufferMemory(device, m.new_buffer, vma_move.memory, vma_move.offset),
+                "tinyvk::defragmenter::step - Failed to bind moved buffer");
+        } else {
+            const VkImageCreateInfo info = image::create_info(res->image_info);
+            m.old_image = res->image;
+            vk_validate(vkCreateImage(device, &info, alloc, &m.new_image),
+                "tinyvk::defragmenter::step - Failed to create moved image");
+            vk_validate(vkBindImageMemory(device, m.new_image, vma_move.memory, vma_move.offset),
+                "tinyvk::defragmenter::step - Failed to bind moved image");
+        }
+        bytes += m.size;
+        moves.push_back(m);
+    }
+
+    if (moves.empty()) {
+        vmaDefragmentationEnd(vma, context);
+        context = {};
+        return {};
+    }
+
+    record_pass(device);
+    return {};
+}
+
+
+void
+defragmenter::record_pass(
+        VkDevice device) NEX
+{
+    VkCommandBufferBeginInfo begin_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vk_validate(vkResetCommandPool(device, pool, 0),
+        "tinyvk::defragmenter::record_pass - Failed to reset command pool");
+    vk_validate(vkBeginCommandBuffer(cmd, &begin_info),
+        "tinyvk::defragmenter::record_pass - Failed to begin command buffer");
+
+    // the copies wait for all earlier work on the queue: writes of the old resources must be visible to them,
+    // and earlier reads of the old images and accesses of the destination memory must be done before the layout
+    // transitions and the copies overwrite them
+    const barrier_access earlier{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_WRITE_BIT};
+    const barrier_access transfer_read{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+    const barrier_access transfer_write{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+    const barrier_access transfer_copy{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT};
+    const barrier_access all_reads{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT};
+    const auto copy_layout = [](VkImageLayout layout) {
+        return layout == VK_IMAGE_LAYOUT_GENERAL ? layout : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    };
+    barrier_batch barriers{};
+    barriers.global(earlier, transfer_copy);
+
+    for (const auto& m: moves) {
+        if (!m.new_image) continue;
+        const auto* res = tinystd::find_if(resources.begin(), resources.end(), [&](const resource_t& r){ return r.allocation == m.allocation; });
+        const VkImageSubresourceRange range{VkImageAspectFlags(image::determine_aspect_mask(res->image_info.format, true)),
+            0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        if (copy_layout(res->layout) != res->layout)
+            barriers.image(m.old_image, range, res->layout, copy_layout(res->layout), earlier, transfer_read);
+        barriers.image(m.new_image, range, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, earlier, transfer_write);
+    }
+    barriers.flush(cmd);
+
+    small_vector<VkImageCopy, 16> regions{};
+    for (const auto& m: moves) {
+        const auto* res = tinystd::find_if(resources.begin(), resources.end(), [&](const resource_t& r){ return r.allocation == m.allocation; });
+        if (m.new_buffer) {
+            const VkBufferCopy region{0, 0, buffer::create_info(res->buffer_info).size};
+            vkCmdCopyBuffer(cmd, m.old_buffer, m.new_buffer, 1, &region);
+            continue;
+        }
+
+        // one region per mip level, covering every array layer
+        const auto& desc = res->image_info;
+        const auto aspect = VkImageAspectFlags(image::determine_aspect_mask(desc.format, true));
+        regions.clear();
+        for (u32 mip = 0; mip < desc.size.mip_levels; ++mip) {
+            VkImageCopy region{};
+            region.srcSubresource = {aspect, mip, 0, desc.size.array_layers};
+            region.dstSubresource = region.srcSubresource;
+            region.extent = {tinystd::max(desc.size.width >> mip, 1u), tinystd::max(desc.size.height >> mip, 1u),
+                tinystd::max(desc.size.depth >> mip, 1u)};
+            regions.push_back(region);
+        }
+        vkCmdCopyImage(cmd, m.old_image, copy_layout(res->layout), m.new_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            u32(regions.size()), regions.data());
+
+        const VkImageSubresourceRange range{aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        if (copy_layout(res->layout) != res->layout)
+            barriers.image(m.old_image, range, copy_layout(res->layout), res->layout, transfer_read, {});
+        barriers.image(m.new_image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, res->layout, transfer_write, all_reads);
+    }
+    barriers.global(transfer_write, all_reads);
+    barriers.flush(cmd);
+
+    vk_validate(vkEndCommandBuffer(cmd),
+        "tinyvk::defragmenter::record_pass - Failed to end command buffer");
+
+    submit_batch submit{};
+    submit.add({&cmd, 1});
+    submit.submit(queue, fence);
+    state = COPYING;
+}
+
+
+void
+defragmenter::end_pass(
+        VmaAllocator vma,
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    for (const auto& m: moves) {
+        if (m.old_buffer) vkDestroyBuffer(device, m.old_buffer, alloc);
+        if (m.old_image) vkDestroyImage(device, m.old_image, alloc);
+    }
+    moves.clear();
+    state = IDLE;
+
+    // commits the moves, the old memory is released to the allocator
+    const VkResult r = vmaEndDefragmentationPass(vma, context);
+    if (r != VK_NOT_READY)
+        vk_validate(r, "tinyvk::defragmenter::end_pass - Failed to end defragmentation pass");
+}
+
+//endregion
+
+#endif
+
+}
+
+#endif //TINYVK_DEFRAGMENTER_CPP
+
+#endif //TINYVK_IMPLEMENTATION
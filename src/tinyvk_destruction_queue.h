@@ -0,0 +1,438 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_DESTRUCTION_QUEUE_H
+#define TINYVK_DESTRUCTION_QUEUE_H
+
+#include "tinyvk_core.h"
+#include "tinyvk_queue.h"
+#ifdef TINYVK_USE_VMA
+#include "vk_mem_alloc.h"
+#include "tinyvk_memory_stats.h"
+#endif
+
+namespace tinyvk {
+
+enum destroy_type_t: u32 {
+    DESTROY_BUFFER,
+    DESTROY_IMAGE,
+    DESTROY_IMAGE_VIEW,
+    DESTROY_SAMPLER,
+    DESTROY_PIPELINE,
+    DESTROY_PIPELINE_LAYOUT,
+    DESTROY_DESCRIPTOR_POOL,
+    DESTROY_DESCRIPTOR_SET_LAYOUT,
+    DESTROY_SHADER_MODULE,
+    DESTROY_RENDERPASS,
+    DESTROY_FRAMEBUFFER,
+    DESTROY_COMMAND_POOL,
+    DESTROY_QUERY_POOL,
+    DESTROY_SEMAPHORE,
+    DESTROY_FENCE,
+    DESTROY_EVENT,
+    DESTROY_MEMORY,
+    DESTROY_ALLOCATION,
+};
+
+
+/// Destroys objects once the device is done with them instead of waiting for the device to go idle.
+/// Objects pushed while recording a frame are destroyed by the next begin_frame of the same frame in flight,
+/// after its fence signaled. Objects pushed with a retire_point (work submitted through a submission_tracker,
+/// e.g. async compute or transfer) are destroyed by collect once their timeline value is reached.
+/// Buffers and images pushed with their VmaAllocation are destroyed with it, DESTROY_ALLOCATION only frees one.
+/// The wrappers (buffer, image, image_view, sampler, pipeline, renderpass, ...) are pushed with retire(queue, object).
+/// Not thread safe, push from the thread that records the frame.
+struct destruction_queue {
+    static constexpr size_t N   = 32;
+
+    struct entry_t {
+        u64                     object{};
+        destroy_type_t          type{};
+#ifdef TINYVK_USE_VMA
+        VmaAllocation           allocation{};
+#endif
+#ifdef VK_VERSION_1_2
+        retire_point            point{};
+#endif
+    };
+
+    VkDevice                    device{};
+    vk_alloc                    callbacks{};
+#ifdef TINYVK_USE_VMA
+    VmaAllocator                vma{};
+#endif
+    u32                         frame_count{};
+    u32                         frame{};
+    u64                         destroyed{};
+    small_vector<entry_t, N>    frames[MAX_FRAMES_IN_FLIGHT]{};
+    small_vector<entry_t, N>    timeline{};
+
+    static destruction_queue create(
+            VkDevice                        device,
+            u32                             frames_in_flight,
+            vk_alloc                        alloc = {}) NEX;
+
+#ifdef TINYVK_USE_VMA
+    static destruction_queue create(
+            VkDevice                        device,
+            VmaAllocator                    vma,
+            u32                             frames_in_flight,
+            vk_alloc                        alloc = {}) NEX;
+#endif
+
+    /// Destroy everything still queued, call once the device is idle
+    void                destroy() NEX;
+
+    /// Start recording frame, waits for fence (if any, usually already waited on by the caller) and destroys
+    /// everything pushed the last time frame was recorded
+    void                begin_frame(
+            u32                             frame,
+            VkFence                         fence = {}) NEX;
+
+    /// Destroy object after the device is done with the current frame
+    void                push(
+            destroy_type_t                  type,
+            u64                             object) NEX;
+
+#ifdef TINYVK_USE_VMA
+    void                push(
+            destroy_type_t                  type,
+            u64                             object,
+            VmaAllocation                   allocation) NEX;
+#endif
+
+#ifdef VK_VERSION_1_2
+    /// Destroy object once point completed
+    void                push(
+            retire_point                    point,
+            destroy_type_t                  type,
+            u64                             object) NEX;
+
+#ifdef TINYVK_USE_VMA
+    void                push(
+            retire_point                    point,
+            destroy_type_t                  type,
+            u64                             object,
+            VmaAllocation                   allocation) NEX;
+#endif
+
+    /// Destroy the objects whose retire point completed, queries every timeline at most once and never blocks
+    void                collect(
+            submission_tracker&             tracker) NEX;
+#endif
+
+    /// Number of objects waiting to be destroyed
+    NDC u64             pending() const NEX;
+
+private:
+    void                destroy_entry(
+            const entry_t&                  e) NEX;
+
+    void                destroy_all(
+            small_vector<entry_t, N>&       entries) NEX;
+};
+
+
+constexpr destroy_type_t destroy_type_of(const buffer*) NEX                 { return DESTROY_BUFFER; }
+constexpr destroy_type_t destroy_type_of(const image*) NEX                  { return DESTROY_IMAGE; }
+constexpr destroy_type_t destroy_type_of(const image_view*) NEX             { return DESTROY_IMAGE_VIEW; }
+constexpr destroy_type_t destroy_type_of(const sampler*) NEX                { return DESTROY_SAMPLER; }
+constexpr destroy_type_t destroy_type_of(const pipeline*) NEX               { return DESTROY_PIPELINE; }
+constexpr destroy_type_t destroy_type_of(const pipeline_layout*) NEX        { return DESTROY_PIPELINE_LAYOUT; }
+constexpr destroy_type_t destroy_type_of(const descriptor_pool*) NEX        { return DESTROY_DESCRIPTOR_POOL; }
+constexpr destroy_type_t destroy_type_of(const descriptor_set_layout*) NEX  { return DESTROY_DESCRIPTOR_SET_LAYOUT; }
+constexpr destroy_type_t destroy_type_of(const shader_module*) NEX          { return DESTROY_SHADER_MODULE; }
+constexpr destroy_type_t destroy_type_of(const renderpass*) NEX             { return DESTROY_RENDERPASS; }
+constexpr destroy_type_t destroy_type_of(const framebuffer*) NEX            { return DESTROY_FRAMEBUFFER; }
+constexpr destroy_type_t destroy_type_of(const command_pool*) NEX           { return DESTROY_COMMAND_POOL; }
+
+/// Destroy object (image_view, sampler, pipeline, renderpass, ...) once the device is done with the frame queue is
+/// recording and reset its handle. Defined here so the wrappers do not depend on the destruction queue
+template<typename T>
+void                    retire(
+        destruction_queue&              queue,
+        T&                              object) NEX
+{
+    queue.push(destroy_type_of((const T*)nullptr), u64(object.vk));
+    object.vk = {};
+}
+
+#ifdef TINYVK_USE_VMA
+constexpr memory_category_t memory_category_of(const buffer*) NEX           { return MEMORY_CATEGORY_BUFFER; }
+constexpr memory_category_t memory_category_of(const image*) NEX            { return MEMORY_CATEGORY_IMAGE; }
+
+/// Destroy a buffer or image with its allocation once the device is done with the frame queue (created with the
+/// allocator) is recording, stats (optional) releases it from category right away
+template<typename T>
+void                    retire(
+        destruction_queue&              queue,
+        T&                              object,
+        VmaAllocation                   allocation,
+        memory_stats*                   stats = {},
+        memory_category_t               category = memory_category_of((const T*)nullptr)) NEX
+{
+    tassert(queue.vma && "tinyvk::retire - Destruction queue was created without a VmaAllocator");
+    if (stats)
+        stats->release(queue.vma, category, allocation);
+    queue.push(destroy_type_of((const T*)nullptr), u64(object.vk), allocation);
+    object.vk = {};
+}
+#endif
+
+}
+
+#endif //TINYVK_DESTRUCTION_QUEUE_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_DESTRUCTION_QUEUE_CPP
+#define TINYVK_DESTRUCTION_QUEUE_CPP
+
+namespace tinyvk {
+
+//region destruction_queue
+
+destruction_queue
+destruction_queue::create(
+        VkDevice device,
+        u32 frames_in_flight,
+        vk_alloc alloc) NEX
+{
+    tassert(frames_in_flight && frames_in_flight <= MAX_FRAMES_IN_FLIGHT && "tinyvk::destruction_queue::create - Invalid number of frames in flight");
+    destruction_queue q{};
+    q.device = device;
+    q.callbacks = alloc;
+    q.frame_count = frames_in_flight;
+    return q;
+}
+
+
+#ifdef TINYVK_USE_VMA
+destruction_queue
+destruction_queue::create(
+        VkDevice device,
+        VmaAllocator vma,
+        u32 frames_in_flight,
+        vk_alloc alloc) NEX
+{
+    destruction_queue q = create(device, frames_in_flight, alloc);
+    q.vma = vma;
+    return q;
+}
+#endif
+
+
+void
+destruction_queue::destroy() NEX
+{
+    for (u32 f = 0; f < frame_count; ++f)
+        destroy_all(frames[f]);
+    destroy_all(timeline);
+}
+
+
+void
+destruction_queue::begin_frame(
+        u32 f,
+        VkFence fence) NEX
+{
+    tassert(f < frame_count && "tinyvk::destruction_queue::begin_frame - Frame out of range");
+    frame = f;
+    if (frames[f].empty())
+        return;
+    if (fence)
+        vk_validate(vkWaitForFences(device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT_NANOS),
+            "tinyvk::destruction_queue::begin_frame - Failed to wait for fence of frame %u", f);
+    destroy_all(frames[f]);
+}
+
+
+void
+destruction_queue::push(
+        destroy_type_t type,
+        u64 object) NEX
+{
+    entry_t e{};
+    e.object = object;
+    e.type = type;
+    frames[frame].push_back(e);
+}
+
+
+#ifdef TINYVK_USE_VMA
+void
+destruction_queue::push(
+        destroy_type_t type,
+        u64 object,
+        VmaAllocation allocation) NEX
+{
+    entry_t e{};
+    e.object = object;
+    e.type = type;
+    e.allocation = allocation;
+    frames[frame].push_back(e);
+}
+#endif
+
+
+#ifdef VK_VERSION_1_2
+void
+destruction_queue::push(
+        retire_point point,
+        destroy_type_t type,
+        u64 object) NEX
+{
+    entry_t e{};
+    e.object = object;
+    e.type = type;
+    e.point = point;
+    timeline.push_back(e);
+}
+
+
+#ifdef TINYVK_USE_VMA
+void
+destruction_queue::push(
+        retire_point point,
+        destroy_type_t type,
+        u64 object,
+        VmaAllocation allocation) NEX
+{
+    entry_t e{};
+    e.object = object;
+    e.type = type;
+    e.allocation = allocation;
+    e.point = point;
+    timeline.push_back(e);
+}
+#endif
+
+
+void
+destruction_queue::collect(
+        submission_tracker& tracker) NEX
+{
+    if (timeline.empty())
+        return;
+    tracker.poll(device);
+    for (u32 i = 0; i < timeline.size();) {
+        const auto& e = timeline[i];
+        tassert(e.point.queue < tracker.timelines.size() && "tinyvk::destruction_queue::collect - Invalid retire point");
+        if (e.point.value <= tracker.timelines[e.point.queue].completed) {
+            destroy_entry(e);
+            timeline[i] = timeline.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+#endif
+
+
+u64
+destruction_queue::pending() const NEX
+{
+    u64 count = timeline.size();
+    for (u32 f = 0; f < frame_count; ++f)
+        count += frames[f].size();
+    return count;
+}
+
+
+void
+destruction_queue::destroy_all(
+        small_vector<entry_t, N>& entries) NEX
+{
+    for (const auto& e: entries)
+        destroy_entry(e);
+    entries.clear();
+}
+
+
+void
+destruction_queue::destroy_entry(
+        const entry_t& e) NEX
+{
+    ++destroyed;
+    switch (e.type) {
+        case DESTROY_BUFFER:
+#ifdef TINYVK_USE_VMA
+            if (e.allocation) {
+                vmaDestroyBuffer(vma, VkBuffer(e.object), e.allocation);
+                break;
+            }
+#endif
+            vkDestroyBuffer(device, VkBuffer(e.object), callbacks);
+            break;
+        case DESTROY_IMAGE:
+#ifdef TINYVK_USE_VMA
+            if (e.allocation) {
+                vmaDestroyImage(vma, VkImage(e.object), e.allocation);
+                break;
+            }
+#endif
+            vkDestroyImage(device, VkImage(e.object), callbacks);
+            break;
+        case DESTROY_IMAGE_VIEW:
+            vkDestroyImageView(device, VkImageView(e.object), callbacks);
+            break;
+        case DESTROY_SAMPLER:
+            vkDestroySampler(device, VkSampler(e.object), callbacks);
+            break;
+        case DESTROY_PIPELINE:
+            vkDestroyPipeline(device, VkPipeline(e.object), callbacks);
+            break;
+        case DESTROY_PIPELINE_LAYOUT:
+            vkDestroyPipelineLayout(device, VkPipelineLayout(e.object), callbacks);
+            break;
+        case DESTROY_DESCRIPTOR_POOL:
+            vkDestroyDescriptorPool(device, VkDescriptorPool(e.object), callbacks);
+            break;
+        case DESTROY_DESCRIPTOR_SET_LAYOUT:
+            vkDestroyDescriptorSetLayout(device, VkDescriptorSetLayout(e.object), callbacks);
+            break;
+        case DESTROY_SHADER_MODULE:
+            vkDestroyShaderModule(device, VkShaderModule(e.object), callbacks);
+            break;
+        case DESTROY_RENDERPASS:
+            vkDestroyRenderPass(device, VkRenderPass(e.object), callbacks);
+            break;
+        case DESTROY_FRAMEBUFFER:
+            vkDestroyFramebuffer(device, VkFramebuffer(e.object), callbacks);
+            break;
+        case DESTROY_COMMAND_POOL:
+            vkDestroyCommandPool(device, VkCommandPool(e.object), callbacks);
+            break;
+        case DESTROY_QUERY_POOL:
+            vkDestroyQueryPool(device, VkQueryPool(e.object), callbacks);
+            break;
+        case DESTROY_SEMAPHORE:
+            vkDestroySemaphore(device, VkSemaphore(e.object), callbacks);
+            break;
+        case DESTROY_FENCE:
+            vkDestroyFence(device, VkFence(e.object), callbacks);
+            break;
+        case DESTROY_EVENT:
+            vkDestroyEvent(device, VkEvent(e.object), callbacks);
+            break;
+        case DESTROY_MEMORY:
+            vkFreeMemory(device, VkDeviceMemory(e.object), callbacks);
+            break;
+        case DESTROY_ALLOCATION:
+#ifdef TINYVK_USE_VMA
+            vmaFreeMemory(vma, e.allocation);
+#else
+            tassert(false && "tinyvk::destruction_queue::destroy_entry - DESTROY_ALLOCATION requires TINYVK_USE_VMA");
+#endif
+            break;
+    }
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_DESTRUCTION_QUEUE_CPP
+
+#endif //TINYVK_IMPLEMENTATION
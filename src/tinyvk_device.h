@@ -12,7 +12,8 @@ namespace tinyvk {
 enum version {
     VULKAN_1_0,
     VULKAN_1_1,
-    VULKAN_1_2
+    VULKAN_1_2,
+    VULKAN_1_3
 };
 
 
@@ -119,6 +120,8 @@ struct application_info: VkApplicationInfo {
 
 
 struct instance : type_wrapper<instance, VkInstance> {
+    /// apiVersion of the application_info the instance was created with (0, i.e. 1.0, for instance::from)
+    u32             api_version{};
 
     static instance create(
             application_info            app_info = application_info{},
@@ -155,8 +158,9 @@ struct physical_devices : fixed_vector<VkPhysicalDevice> {
 
 struct device : type_wrapper<device, VkDevice> {
 
+    /// Features are enabled up to the lower of the instance's api_version and the device's apiVersion
     static device   create(
-            VkInstance                  instance,
+            const instance&             inst,
             VkPhysicalDevice            physical_device,
             const queue_create_info&    queue_info,
             extensions                  ext = {},
@@ -205,6 +209,7 @@ struct debug_messenger : type_wrapper<debug_messenger, VkDebugUtilsMessengerEXT>
 
 #include "tinystd_algorithm.h"
 #include "tinystd_string.h"
+#include "tinyvk_command.h"
 #include "tinyvk_queue.h"
 #include "tinyvk_swapchain.h"
 
@@ -222,6 +227,23 @@ namespace tinyvk {
 #define VK_API_VERSION_1_2 VK_API_VERSION_1_1
 #endif
 
+#ifndef VK_API_VERSION_1_3
+#define VK_API_VERSION_1_3 VK_API_VERSION_1_2
+#endif
+
+static u32
+vk_api_version(
+        version ver)
+{
+    return ver == VULKAN_1_3
+            ? VK_API_VERSION_1_3
+            : (ver == VULKAN_1_2
+                ? VK_API_VERSION_1_2
+                : (ver == VULKAN_1_1
+                    ? VK_API_VERSION_1_1
+                    : VK_API_VERSION_1_0));
+}
+
 template<typename Int, typename OnChar>
 static void str_from_int(Int i, OnChar&& on_char)
 {
@@ -251,11 +273,7 @@ application_info(
     pEngineName = engine_name;
     applicationVersion = app_version;
     engineVersion = engine_version;
-    apiVersion = ver == VULKAN_1_2
-            ? VK_API_VERSION_1_2
-            : (ver == VULKAN_1_1
-                ? VK_API_VERSION_1_1
-                : VK_API_VERSION_1_0);
+    apiVersion = vk_api_version(ver);
 }
 
 
@@ -357,6 +375,7 @@ instance::create(
 
     vk_validate(vkCreateInstance(&instance_info, alloc, &inst.vk),
         "tinyvk::instance::create - Failed to create vulkan instance");
+    inst.api_version = app_info.apiVersion;
 
     return inst;
 }
@@ -529,7 +548,7 @@ supported_device_features(
 
 device
 device::create(
-        VkInstance instance,
+        const instance& inst,
         VkPhysicalDevice physical_device,
         const queue_create_info& queue_info,
         extensions ext,
@@ -557,8 +576,6 @@ device::create(
     create_info.queueCreateInfoCount = queue_infos.size();
     create_info.pQueueCreateInfos = queue_infos.data();
     create_info.pEnabledFeatures = &features;
-    create_info.enabledExtensionCount = ext.device.size();
-    create_info.ppEnabledExtensionNames = ext.device.data();
     create_info.enabledLayerCount = ext.validation_layers.size();
     create_info.ppEnabledLayerNames = ext.validation_layers.data();
 
@@ -574,16 +591,125 @@ device::create(
         create_info.pNext = &descriptor_features;
     }
 
+    // Feature structs of newer versions and extensions are queried together and chained onto create_info for the
+    // ones the device supports. Before the version that made them core, their extension is enabled when available
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    const u32 api = tinystd::min(inst.api_version, properties.apiVersion);
+
+    small_vector<const char*, 32> extension_names{};
+    for (auto e: ext.device)
+        extension_names.push_back(e);
+
+    u32 extension_count{};
+    vk_validate(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr),
+        "tinyvk::device::create - Failed to list device extensions");
+    small_vector<VkExtensionProperties, 128> available_extensions{};
+    available_extensions.resize(extension_count);
+    vk_validate(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, available_extensions.data()),
+        "tinyvk::device::create - Failed to acquire device extension info");
+
+    auto extension_enabled = [&](const char* extension) -> ibool {
+        for (auto e: extension_names)
+            if (tinystd::streq(e, extension)) return true;
+        return false;
+    };
+    auto extension_available = [&](const char* extension) -> ibool {
+        for (const auto& e: available_extensions)
+            if (tinystd::streq(e.extensionName, extension)) return true;
+        return false;
+    };
+
+    struct optional_features_t {
+        VkBaseOutStructure*     features;
+        const VkBool32*         supported;
+        const char*             extension;
+    };
+    static constexpr u32 NEVER_CORE = ~0u;
+    small_vector<optional_features_t, 8> optional_features{};
+    // supported is the feature that must be set to enable features (all of them are enabled if null)
+    auto add_features = [&](void* features, const VkBool32* supported, u32 core_version, const char* extension) {
+        if (api < VK_API_VERSION_1_1)
+            return;
+        const ibool core = api >= core_version;
+        if (!core && !(extension && extension_available(extension)))
+            return;
+        optional_features.push_back({(VkBaseOutStructure*)features, supported, core ? nullptr : extension});
+    };
+
+#ifdef VK_VERSION_1_2
+    // submission_tracker needs timeline semaphores
+    VkPhysicalDeviceTimelineSemaphoreFeatures timeline_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+    add_features(&timeline_features, &timeline_features.timelineSemaphore, VK_API_VERSION_1_2, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+#endif
+
+#ifdef TINYVK_USE_SYNCHRONIZATION2
+    VkPhysicalDeviceSynchronization2Features sync2_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES};
+    add_features(&sync2_features, &sync2_features.synchronization2, VK_API_VERSION_1_3, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state
+    // extended dynamic state (2) is enabled when available, the setters are core in 1.3 but the features belong to
+    // the extensions. extended dynamic state 3 only when requested
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamic_state{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT};
+    add_features(&dynamic_state, &dynamic_state.extendedDynamicState, NEVER_CORE, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT dynamic_state2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT};
+    add_features(&dynamic_state2, &dynamic_state2.extendedDynamicState2, NEVER_CORE, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+#endif
+#ifdef VK_EXT_extended_dynamic_state3
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamic_state3{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT};
+    if (extension_enabled(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME))
+        add_features(&dynamic_state3, nullptr, NEVER_CORE, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+#endif
+
+    if (!optional_features.empty()) {
+        VkPhysicalDeviceFeatures2 query{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+        for (auto& f: optional_features) {
+            f.features->pNext = (VkBaseOutStructure*)query.pNext;
+            query.pNext = f.features;
+        }
+        vkGetPhysicalDeviceFeatures2(physical_device, &query);
+        for (auto& f: optional_features) {
+            if (f.supported && !*f.supported)
+                continue;
+            if (f.extension && !extension_enabled(f.extension))
+                extension_names.push_back(f.extension);
+            f.features->pNext = (VkBaseOutStructure*)create_info.pNext;
+            create_info.pNext = f.features;
+        }
+    }
+    create_info.enabledExtensionCount = extension_names.size();
+    create_info.ppEnabledExtensionNames = extension_names.data();
+
     vk_validate(vkCreateDevice(physical_device, &create_info, alloc, &d.vk),
         "tinyvk::device::create - Failed to create logical device");
 
+#ifdef VK_EXT_extended_dynamic_state
+    command::load_dynamic_state_ext(d.vk);
+#endif
+
+#ifdef TINYVK_USE_SYNCHRONIZATION2
+    // without synchronization2 barriers and submits fall back to the legacy calls
+    submit_batch::load_synchronization2(sync2_features.synchronization2 ? d.vk : VkDevice{});
+    barrier_batch::load_synchronization2(sync2_features.synchronization2 ? d.vk : VkDevice{});
+#endif
+
 #ifdef TINYVK_USE_VMA
     if (p_vma_alloc) {
         VmaAllocatorCreateInfo allocatorInfo{};
         allocatorInfo.device = d.vk;
-        allocatorInfo.instance = instance;
+        allocatorInfo.instance = inst;
         allocatorInfo.physicalDevice = physical_device;
-        allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+        allocatorInfo.vulkanApiVersion = tinystd::min(api, u32(VK_API_VERSION_1_2));
+#ifdef VK_EXT_memory_budget
+        // real heap budgets for memory_stats instead of VMA's estimate
+        for (auto e: ext.device) {
+            if (tinystd::streq(e, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+                allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+        }
+#endif
         vk_validate(vmaCreateAllocator(&allocatorInfo, p_vma_alloc),
             "tinyvk::device::create - Failed to create VmaAllocator");
     }
@@ -0,0 +1,756 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_DOWNSAMPLER_H
+#define TINYVK_DOWNSAMPLER_H
+
+#include "tinyvk_core.h"
+#include "tinyvk_pipeline.h"
+#include "tinyvk_descriptor.h"
+#include "tinyvk_shader.h"
+
+namespace tinyvk {
+
+/// Single pass compute mip generator modelled after AMD's Single Pass Downsampler (SPD).
+/// Every workgroup reduces a 64x64 tile of mip 0 down to mip 6 in shared memory, the last workgroup
+/// of each array layer (found with an atomic counter) then reduces the mip 6 results down to mip 12.
+/// All levels of all layers are written by a single dispatch, so it also runs on async compute queues.
+/// Cubemaps are handled as 2D arrays with 6 layers per cube.
+///
+/// Descriptor set layout:
+///     0 - combined image sampler, 2D array view of mip 0
+///     1 - storage image[MAX_MIPS], 2D array view of each level starting at mip 1
+///     2 - storage buffer, per layer atomic counters      (scratch)
+///     3 - storage buffer, per workgroup mip 6 texels     (scratch)
+/// The image must be in VK_IMAGE_LAYOUT_GENERAL and the device needs shaderStorageImageWriteWithoutFormat.
+struct downsampler {
+    enum {
+        MAX_MIPS = 12,
+        TILE_SIZE = 64,
+        SCRATCH_ALIGNMENT = 256,
+    };
+
+    descriptor_set_layout       set_layout{};
+    pipeline_layout             layout{};
+    pipeline                    pipe{};
+    VkSampler                   sampler{};
+
+    /// Compute shader source, spirv passed to create must be compiled from it
+    NDC static span<const char> source() NEX;
+
+    /// SPIR-V 1.0 of source(), embedded so create does not need the shader compiler
+    NDC static span<const u32> spirv() NEX;
+
+    /// When spirv is empty the embedded SPIR-V is used
+    static downsampler  create(
+            VkDevice                    device,
+            span<const u32>             spirv = {},
+            VkPipelineCache             cache = {},
+            vk_alloc                    alloc = {}) NEX;
+
+    void                destroy(
+            VkDevice                    device,
+            vk_alloc                    alloc = {}) NEX;
+
+    NDC static u32      mip_count(
+            u32                         width,
+            u32                         height) NEX;
+
+    NDC static VkExtent3D dispatch_size(
+            u32                         width,
+            u32                         height,
+            u32                         layers) NEX;
+
+    NDC static VkDeviceSize scratch_size(
+            u32                         width,
+            u32                         height,
+            u32                         layers) NEX;
+
+    void                write_descriptors(
+            VkDevice                    device,
+            VkDescriptorSet             set,
+            VkImageView                 mip0,
+            span<const VkImageView>     mips,
+            VkBuffer                    scratch,
+            VkDeviceSize                scratch_offset,
+            u32                         width,
+            u32                         height,
+            u32                         layers) const NEX;
+
+    /// Zero the atomic counters once after creating the scratch buffer, the shader resets them after use
+    static void         init_scratch(
+            VkCommandBuffer             cmd,
+            VkBuffer                    scratch,
+            VkDeviceSize                scratch_offset,
+            u32                         layers) NEX;
+
+    /// Generate mips 1 to mips (all levels when -1u) for every layer with a single dispatch
+    void                record(
+            VkCommandBuffer             cmd,
+            VkDescriptorSet             set,
+            u32                         width,
+            u32                         height,
+            u32                         layers,
+            u32                         mips = -1u) const NEX;
+};
+
+}
+
+#endif //TINYVK_DOWNSAMPLER_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_DOWNSAMPLER_CPP
+#define TINYVK_DOWNSAMPLER_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+//region downsampler
+
+static constexpr const char DOWNSAMPLER_SOURCE[] = R"(#version 450
+layout(local_size_x = 256) in;
+
+layout(push_constant) uniform push_t {
+    vec2    inv_size;
+    uint    mips;
+    uint    groups;
+    ivec2   group_count;
+} pc;
+
+layout(binding = 0) uniform sampler2DArray src;
+layout(binding = 1) uniform writeonly image2DArray dst[12];
+layout(binding = 2, std430) coherent buffer counter_t { uint counters[]; };
+layout(binding = 3, std430) coherent buffer mid_t { vec4 mid[]; };
+
+shared vec4 lds[16][16];
+shared uint is_last;
+
+// constant indices only, dynamic indexing of storage image arrays is an optional feature
+#define STORE(i) case i: if (all(lessThan(p, imageSize(dst[i - 1]).xy))) imageStore(dst[i - 1], ivec3(p, layer), v); break;
+
+void store(int mip, ivec2 p, int layer, vec4 v)
+{
+    if (mip > int(pc.mips))
+        return;
+    switch (mip) {
+        STORE(1) STORE(2) STORE(3) STORE(4) STORE(5) STORE(6)
+        STORE(7) STORE(8) STORE(9) STORE(10) STORE(11) STORE(12)
+    }
+}
+
+vec4 load_mid(ivec2 p, int layer)
+{
+    p = min(p, pc.group_count - 1);
+    return mid[layer * int(pc.groups) + p.y * pc.group_count.x + p.x];
+}
+
+// texel p of level base + 1, a bilinear sample in the middle of a 2x2 quad averages it
+vec4 load(int base, ivec2 p, int layer)
+{
+    if (base == 0)
+        return textureLod(src, vec3((vec2(p) * 2.0 + 1.0) * pc.inv_size, float(layer)), 0.0);
+    ivec2 q = p * 2;
+    return (load_mid(q, layer) + load_mid(q + ivec2(1, 0), layer)
+        + load_mid(q + ivec2(0, 1), layer) + load_mid(q + ivec2(1, 1), layer)) * 0.25;
+}
+
+// reduce a tile of level base down to base + 6, lds[0][0] holds the result
+void downsample(int base, ivec2 tile, int layer)
+{
+    int tx = int(gl_LocalInvocationIndex % 16u);
+    int ty = int(gl_LocalInvocationIndex / 16u);
+
+    vec4 sum = vec4(0.0);
+    for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 2; ++i) {
+            ivec2 p = tile * 32 + ivec2(tx * 2 + i, ty * 2 + j);
+            vec4 v = load(base, p, layer);
+            store(base + 1, p, layer, v);
+            sum += v;
+        }
+    }
+
+    vec4 v = sum * 0.25;
+    store(base + 2, tile * 16 + ivec2(tx, ty), layer, v);
+    lds[ty][tx] = v;
+    barrier();
+
+    int mip = base + 3;
+    for (int s = 8; s > 0; s /= 2) {
+        bool active = tx < s && ty < s;
+        if (active)
+            v = (lds[ty * 2][tx * 2] + lds[ty * 2][tx * 2 + 1] + lds[ty * 2 + 1][tx * 2] + lds[ty * 2 + 1][tx * 2 + 1]) * 0.25;
+        barrier();
+        if (active) {
+            lds[ty][tx] = v;
+            store(mip, tile * s + ivec2(tx, ty), layer, v);
+        }
+        barrier();
+        ++mip;
+    }
+}
+
+void main()
+{
+    int layer = int(gl_WorkGroupID.z);
+    ivec2 tile = ivec2(gl_WorkGroupID.xy);
+    downsample(0, tile, layer);
+    if (pc.mips <= 6u)
+        return;
+
+    if (gl_LocalInvocationIndex == 0u) {
+        mid[layer * int(pc.groups) + tile.y * pc.group_count.x + tile.x] = lds[0][0];
+        memoryBarrierBuffer();
+        is_last = atomicAdd(counters[layer], 1u) == pc.groups - 1u ? 1u : 0u;
+    }
+    barrier();
+    if (is_last == 0u)
+        return;
+
+    if (gl_LocalInvocationIndex == 0u)
+        counters[layer] = 0u;
+    memoryBarrierBuffer();
+    downsample(6, ivec2(0), layer);
+}
+)";
+
+
+// SPIR-V 1.0 of DOWNSAMPLER_SOURCE: Shader, ImageQuery and StorageImageWriteWithoutFormat capabilities
+static constexpr const u32 DOWNSAMPLER_SPIRV[] = {
+    0x07230203, 0x00010000, 0x00000000, 0x000001d6, 0x00000000, 0x00020011, 0x00000001, 0x00020011,
+    0x00000032, 0x00020011, 0x00000038, 0x0006000b, 0x00000001, 0x4c534c47, 0x6474732e, 0x3035342e,
+    0x00000000, 0x0003000e, 0x00000000, 0x00000001, 0x0007000f, 0x00000005, 0x0000003b, 0x6e69616d,
+    0x00000000, 0x00000029, 0x0000002b, 0x00060010, 0x0000003b, 0x00000011, 0x00000100, 0x00000001,
+    0x00000001, 0x00030047, 0x0000000f, 0x00000002, 0x00050048, 0x0000000f, 0x00000000, 0x00000023,
+    0x00000000, 0x00050048, 0x0000000f, 0x00000001, 0x00000023, 0x00000008, 0x00050048, 0x0000000f,
+    0x00000002, 0x00000023, 0x0000000c, 0x00050048, 0x0000000f, 0x00000003, 0x00000023, 0x00000010,
+    0x00040047, 0x00000014, 0x00000022, 0x00000000, 0x00040047, 0x00000014, 0x00000021, 0x00000000,
+    0x00040047, 0x00000019, 0x00000022, 0x00000000, 0x00040047, 0x00000019, 0x00000021, 0x00000001,
+    0x00040047, 0x0000001d, 0x00000022, 0x00000000, 0x00040047, 0x0000001d, 0x00000021, 0x00000002,
+    0x00040047, 0x00000021, 0x00000022, 0x00000000, 0x00040047, 0x00000021, 0x00000021, 0x00000003,
+    0x00030047, 0x00000019, 0x00000019, 0x00040047, 0x0000001b, 0x00000006, 0x00000004, 0x00040047,
+    0x0000001f, 0x00000006, 0x00000010, 0x00030047, 0x0000001c, 0x00000003, 0x00050048, 0x0000001c,
+    0x00000000, 0x00000023, 0x00000000, 0x00040048, 0x0000001c, 0x00000000, 0x00000017, 0x00030047,
+    0x00000020, 0x00000003, 0x00050048, 0x00000020, 0x00000000, 0x00000023, 0x00000000, 0x00040048,
+    0x00000020, 0x00000000, 0x00000017, 0x00040047, 0x00000029, 0x0000000b, 0x0000001a, 0x00040047,
+    0x0000002b, 0x0000000b, 0x0000001d, 0x00020013, 0x00000002, 0x00020014, 0x00000003, 0x00040015,
+    0x00000004, 0x00000020, 0x00000001, 0x00040015, 0x00000005, 0x00000020, 0x00000000, 0x00030016,
+    0x00000006, 0x00000020, 0x00040017, 0x00000007, 0x00000004, 0x00000002, 0x00040017, 0x00000008,
+    0x00000004, 0x00000003, 0x00040017, 0x00000009, 0x00000005, 0x00000002, 0x00040017, 0x0000000a,
+    0x00000005, 0x00000003, 0x00040017, 0x0000000b, 0x00000006, 0x00000002, 0x00040017, 0x0000000c,
+    0x00000006, 0x00000003, 0x00040017, 0x0000000d, 0x00000006, 0x00000004, 0x00040017, 0x0000000e,
+    0x00000003, 0x00000002, 0x0006001e, 0x0000000f, 0x0000000b, 0x00000005, 0x00000005, 0x00000007,
+    0x00040020, 0x00000011, 0x00000009, 0x0000000f, 0x0004003b, 0x00000011, 0x00000010, 0x00000009,
+    0x00090019, 0x00000012, 0x00000006, 0x00000001, 0x00000000, 0x00000001, 0x00000000, 0x00000001,
+    0x00000000, 0x0003001b, 0x00000013, 0x00000012, 0x00040020, 0x00000015, 0x00000000, 0x00000013,
+    0x0004003b, 0x00000015, 0x00000014, 0x00000000, 0x00090019, 0x00000016, 0x00000006, 0x00000001,
+    0x00000000, 0x00000001, 0x00000000, 0x00000002, 0x00000000, 0x0004002b, 0x00000005, 0x00000017,
+    0x0000000c, 0x0004001c, 0x00000018, 0x00000016, 0x00000017, 0x00040020, 0x0000001a, 0x00000000,
+    0x00000018, 0x0004003b, 0x0000001a, 0x00000019, 0x00000000, 0x0003001d, 0x0000001b, 0x00000005,
+    0x0003001e, 0x0000001c, 0x0000001b, 0x00040020, 0x0000001e, 0x00000002, 0x0000001c, 0x0004003b,
+    0x0000001e, 0x0000001d, 0x00000002, 0x0003001d, 0x0000001f, 0x0000000d, 0x0003001e, 0x00000020,
+    0x0000001f, 0x00040020, 0x00000022, 0x00000002, 0x00000020, 0x0004003b, 0x00000022, 0x00000021,
+    0x00000002, 0x0004002b, 0x00000005, 0x00000023, 0x00000100, 0x0004001c, 0x00000024, 0x0000000d,
+    0x00000023, 0x00040020, 0x00000026, 0x00000004, 0x00000024, 0x0004003b, 0x00000026, 0x00000025,
+    0x00000004, 0x00040020, 0x00000028, 0x00000004, 0x00000005, 0x0004003b, 0x00000028, 0x00000027,
+    0x00000004, 0x00040020, 0x0000002a, 0x00000001, 0x0000000a, 0x0004003b, 0x0000002a, 0x00000029,
+    0x00000001, 0x00040020, 0x0000002c, 0x00000001, 0x00000005, 0x0004003b, 0x0000002c, 0x0000002b,
+    0x00000001, 0x0004002b, 0x00000005, 0x0000002d, 0x00000001, 0x0004002b, 0x00000005, 0x0000002e,
+    0x00000002, 0x0004002b, 0x00000005, 0x0000002f, 0x00000108, 0x0004002b, 0x00000005, 0x00000030,
+    0x00000048, 0x0004002b, 0x00000005, 0x00000031, 0x00000000, 0x00070021, 0x00000032, 0x00000002,
+    0x00000004, 0x00000007, 0x00000004, 0x0000000d, 0x00050021, 0x00000033, 0x0000000d, 0x00000007,
+    0x00000004, 0x00060021, 0x00000034, 0x0000000d, 0x00000004, 0x00000007, 0x00000004, 0x00060021,
+    0x00000035, 0x00000002, 0x00000004, 0x00000007, 0x00000004, 0x00030021, 0x00000036, 0x00000002,
+    0x00040020, 0x00000041, 0x00000009, 0x00000005, 0x0004002b, 0x00000004, 0x00000042, 0x00000001,
+    0x00040020, 0x00000059, 0x00000000, 0x00000016, 0x0004002b, 0x00000004, 0x0000005a, 0x00000000,
+    0x0004002b, 0x00000004, 0x0000006b, 0x00000002, 0x0004002b, 0x00000004, 0x00000074, 0x00000003,
+    0x0004002b, 0x00000004, 0x0000007d, 0x00000004, 0x0004002b, 0x00000004, 0x00000086, 0x00000005,
+    0x0004002b, 0x00000004, 0x0000008f, 0x00000006, 0x0004002b, 0x00000004, 0x00000098, 0x00000007,
+    0x0004002b, 0x00000004, 0x000000a1, 0x00000008, 0x0004002b, 0x00000004, 0x000000aa, 0x00000009,
+    0x0004002b, 0x00000004, 0x000000b3, 0x0000000a, 0x0004002b, 0x00000004, 0x000000bc, 0x0000000b,
+    0x00040020, 0x000000c8, 0x00000009, 0x00000007, 0x0005002c, 0x00000007, 0x000000ce, 0x00000042,
+    0x00000042, 0x00040020, 0x000000d8, 0x00000002, 0x0000000d, 0x0004002b, 0x00000006, 0x000000e4,
+    0x40000000, 0x0004002b, 0x00000006, 0x000000e6, 0x3f800000, 0x0005002c, 0x0000000b, 0x000000e7,
+    0x000000e6, 0x000000e6, 0x00040020, 0x000000e9, 0x00000009, 0x0000000b, 0x0004002b, 0x00000006,
+    0x000000f2, 0x00000000, 0x0005002c, 0x00000007, 0x000000f4, 0x0000006b, 0x0000006b, 0x0005002c,
+    0x00000007, 0x000000f7, 0x00000042, 0x0000005a, 0x0005002c, 0x00000007, 0x000000fb, 0x0000005a,
+    0x00000042, 0x0004002b, 0x00000006, 0x00000102, 0x3e800000, 0x0004002b, 0x00000005, 0x0000010a,
+    0x00000010, 0x0004002b, 0x00000004, 0x00000110, 0x00000020, 0x0005002c, 0x00000007, 0x00000111,
+    0x00000110, 0x00000110, 0x0004002b, 0x00000004, 0x00000126, 0x00000010, 0x0005002c, 0x00000007,
+    0x00000127, 0x00000126, 0x00000126, 0x00040020, 0x0000012d, 0x00000004, 0x0000000d, 0x0004002b,
+    0x00000004, 0x0000013f, 0x00000011, 0x0005002c, 0x00000007, 0x0000014c, 0x000000a1, 0x000000a1,
+    0x0005002c, 0x00000007, 0x00000169, 0x0000007d, 0x0000007d, 0x0004002b, 0x00000005, 0x000001ae,
+    0x00000006, 0x00040020, 0x000001c5, 0x00000002, 0x00000005, 0x0005002c, 0x00000007, 0x000001d4,
+    0x0000005a, 0x0000005a, 0x00050036, 0x00000002, 0x00000037, 0x00000000, 0x00000032, 0x00030037,
+    0x00000004, 0x0000003c, 0x00030037, 0x00000007, 0x0000003d, 0x00030037, 0x00000004, 0x0000003e,
+    0x00030037, 0x0000000d, 0x0000003f, 0x000200f8, 0x00000040, 0x00050041, 0x00000041, 0x00000043,
+    0x00000010, 0x00000042, 0x0004003d, 0x00000005, 0x00000044, 0x00000043, 0x0004007c, 0x00000004,
+    0x00000045, 0x00000044, 0x00050051, 0x00000004, 0x00000046, 0x0000003d, 0x00000000, 0x00050051,
+    0x00000004, 0x00000047, 0x0000003d, 0x00000001, 0x00060050, 0x00000008, 0x00000048, 0x00000046,
+    0x00000047, 0x0000003e, 0x000500ad, 0x00000003, 0x00000049, 0x0000003c, 0x00000045, 0x000300f7,
+    0x0000004a, 0x00000000, 0x000400fa, 0x00000049, 0x0000004a, 0x0000004b, 0x000200f8, 0x0000004b,
+    0x000300f7, 0x0000004c, 0x00000000, 0x001b00fb, 0x0000003c, 0x0000004c, 0x00000001, 0x0000004d,
+    0x00000002, 0x0000004e, 0x00000003, 0x0000004f, 0x00000004, 0x00000050, 0x00000005, 0x00000051,
+    0x00000006, 0x00000052, 0x00000007, 0x00000053, 0x00000008, 0x00000054, 0x00000009, 0x00000055,
+    0x0000000a, 0x00000056, 0x0000000b, 0x00000057, 0x0000000c, 0x00000058, 0x000200f8, 0x0000004d,
+    0x00050041, 0x00000059, 0x0000005b, 0x00000019, 0x0000005a, 0x0004003d, 0x00000016, 0x0000005c,
+    0x0000005b, 0x00040068, 0x00000008, 0x0000005d, 0x0000005c, 0x0007004f, 0x00000007, 0x0000005e,
+    0x0000005d, 0x0000005d, 0x00000000, 0x00000001, 0x000500b1, 0x0000000e, 0x0000005f, 0x0000003d,
+    0x0000005e, 0x0004009b, 0x00000003, 0x00000060, 0x0000005f, 0x000300f7, 0x00000062, 0x00000000,
+    0x000400fa, 0x00000060, 0x00000061, 0x00000062, 0x000200f8, 0x00000061, 0x00040063, 0x0000005c,
+    0x00000048, 0x0000003f, 0x000200f9, 0x00000062, 0x000200f8, 0x00000062, 0x000200f9, 0x0000004c,
+    0x000200f8, 0x0000004e, 0x00050041, 0x00000059, 0x00000063, 0x00000019, 0x00000042, 0x0004003d,
+    0x00000016, 0x00000064, 0x00000063, 0x00040068, 0x00000008, 0x00000065, 0x00000064, 0x0007004f,
+    0x00000007, 0x00000066, 0x00000065, 0x00000065, 0x00000000, 0x00000001, 0x000500b1, 0x0000000e,
+    0x00000067, 0x0000003d, 0x00000066, 0x0004009b, 0x00000003, 0x00000068, 0x00000067, 0x000300f7,
+    0x0000006a, 0x00000000, 0x000400fa, 0x00000068, 0x00000069, 0x0000006a, 0x000200f8, 0x00000069,
+    0x00040063, 0x00000064, 0x00000048, 0x0000003f, 0x000200f9, 0x0000006a, 0x000200f8, 0x0000006a,
+    0x000200f9, 0x0000004c, 0x000200f8, 0x0000004f, 0x00050041, 0x00000059, 0x0000006c, 0x00000019,
+    0x0000006b, 0x0004003d, 0x00000016, 0x0000006d, 0x0000006c, 0x00040068, 0x00000008, 0x0000006e,
+    0x0000006d, 0x0007004f, 0x00000007, 0x0000006f, 0x0000006e, 0x0000006e, 0x00000000, 0x00000001,
+    0x000500b1, 0x0000000e, 0x00000070, 0x0000003d, 0x0000006f, 0x0004009b, 0x00000003, 0x00000071,
+    0x00000070, 0x000300f7, 0x00000073, 0x00000000, 0x000400fa, 0x00000071, 0x00000072, 0x00000073,
+    0x000200f8, 0x00000072, 0x00040063, 0x0000006d, 0x00000048, 0x0000003f, 0x000200f9, 0x00000073,
+    0x000200f8, 0x00000073, 0x000200f9, 0x0000004c, 0x000200f8, 0x00000050, 0x00050041, 0x00000059,
+    0x00000075, 0x00000019, 0x00000074, 0x0004003d, 0x00000016, 0x00000076, 0x00000075, 0x00040068,
+    0x00000008, 0x00000077, 0x00000076, 0x0007004f, 0x00000007, 0x00000078, 0x00000077, 0x00000077,
+    0x00000000, 0x00000001, 0x000500b1, 0x0000000e, 0x00000079, 0x0000003d, 0x00000078, 0x0004009b,
+    0x00000003, 0x0000007a, 0x00000079, 0x000300f7, 0x0000007c, 0x00000000, 0x000400fa, 0x0000007a,
+    0x0000007b, 0x0000007c, 0x000200f8, 0x0000007b, 0x00040063, 0x00000076, 0x00000048, 0x0000003f,
+    0x000200f9, 0x0000007c, 0x000200f8, 0x0000007c, 0x000200f9, 0x0000004c, 0x000200f8, 0x00000051,
+    0x00050041, 0x00000059, 0x0000007e, 0x00000019, 0x0000007d, 0x0004003d, 0x00000016, 0x0000007f,
+    0x0000007e, 0x00040068, 0x00000008, 0x00000080, 0x0000007f, 0x0007004f, 0x00000007, 0x00000081,
+    0x00000080, 0x00000080, 0x00000000, 0x00000001, 0x000500b1, 0x0000000e, 0x00000082, 0x0000003d,
+    0x00000081, 0x0004009b, 0x00000003, 0x00000083, 0x00000082, 0x000300f7, 0x00000085, 0x00000000,
+    0x000400fa, 0x00000083, 0x00000084, 0x00000085, 0x000200f8, 0x00000084, 0x00040063, 0x0000007f,
+    0x00000048, 0x0000003f, 0x000200f9, 0x00000085, 0x000200f8, 0x00000085, 0x000200f9, 0x0000004c,
+    0x000200f8, 0x00000052, 0x00050041, 0x00000059, 0x00000087, 0x00000019, 0x00000086, 0x0004003d,
+    0x00000016, 0x00000088, 0x00000087, 0x00040068, 0x00000008, 0x00000089, 0x00000088, 0x0007004f,
+    0x00000007, 0x0000008a, 0x00000089, 0x00000089, 0x00000000, 0x00000001, 0x000500b1, 0x0000000e,
+    0x0000008b, 0x0000003d, 0x0000008a, 0x0004009b, 0x00000003, 0x0000008c, 0x0000008b, 0x000300f7,
+    0x0000008e, 0x00000000, 0x000400fa, 0x0000008c, 0x0000008d, 0x0000008e, 0x000200f8, 0x0000008d,
+    0x00040063, 0x00000088, 0x00000048, 0x0000003f, 0x000200f9, 0x0000008e, 0x000200f8, 0x0000008e,
+    0x000200f9, 0x0000004c, 0x000200f8, 0x00000053, 0x00050041, 0x00000059, 0x00000090, 0x00000019,
+    0x0000008f, 0x0004003d, 0x00000016, 0x00000091, 0x00000090, 0x00040068, 0x00000008, 0x00000092,
+    0x00000091, 0x0007004f, 0x00000007, 0x00000093, 0x00000092, 0x00000092, 0x00000000, 0x00000001,
+    0x000500b1, 0x0000000e, 0x00000094, 0x0000003d, 0x00000093, 0x0004009b, 0x00000003, 0x00000095,
+    0x00000094, 0x000300f7, 0x00000097, 0x00000000, 0x000400fa, 0x00000095, 0x00000096, 0x00000097,
+    0x000200f8, 0x00000096, 0x00040063, 0x00000091, 0x00000048, 0x0000003f, 0x000200f9, 0x00000097,
+    0x000200f8, 0x00000097, 0x000200f9, 0x0000004c, 0x000200f8, 0x00000054, 0x00050041, 0x00000059,
+    0x00000099, 0x00000019, 0x00000098, 0x0004003d, 0x00000016, 0x0000009a, 0x00000099, 0x00040068,
+    0x00000008, 0x0000009b, 0x0000009a, 0x0007004f, 0x00000007, 0x0000009c, 0x0000009b, 0x0000009b,
+    0x00000000, 0x00000001, 0x000500b1, 0x0000000e, 0x0000009d, 0x0000003d, 0x0000009c, 0x0004009b,
+    0x00000003, 0x0000009e, 0x0000009d, 0x000300f7, 0x000000a0, 0x00000000, 0x000400fa, 0x0000009e,
+    0x0000009f, 0x000000a0, 0x000200f8, 0x0000009f, 0x00040063, 0x0000009a, 0x00000048, 0x0000003f,
+    0x000200f9, 0x000000a0, 0x000200f8, 0x000000a0, 0x000200f9, 0x0000004c, 0x000200f8, 0x00000055,
+    0x00050041, 0x00000059, 0x000000a2, 0x00000019, 0x000000a1, 0x0004003d, 0x00000016, 0x000000a3,
+    0x000000a2, 0x00040068, 0x00000008, 0x000000a4, 0x000000a3, 0x0007004f, 0x00000007, 0x000000a5,
+    0x000000a4, 0x000000a4, 0x00000000, 0x00000001, 0x000500b1, 0x0000000e, 0x000000a6, 0x0000003d,
+    0x000000a5, 0x0004009b, 0x00000003, 0x000000a7, 0x000000a6, 0x000300f7, 0x000000a9, 0x00000000,
+    0x000400fa, 0x000000a7, 0x000000a8, 0x000000a9, 0x000200f8, 0x000000a8, 0x00040063, 0x000000a3,
+    0x00000048, 0x0000003f, 0x000200f9, 0x000000a9, 0x000200f8, 0x000000a9, 0x000200f9, 0x0000004c,
+    0x000200f8, 0x00000056, 0x00050041, 0x00000059, 0x000000ab, 0x00000019, 0x000000aa, 0x0004003d,
+    0x00000016, 0x000000ac, 0x000000ab, 0x00040068, 0x00000008, 0x000000ad, 0x000000ac, 0x0007004f,
+    0x00000007, 0x000000ae, 0x000000ad, 0x000000ad, 0x00000000, 0x00000001, 0x000500b1, 0x0000000e,
+    0x000000af, 0x0000003d, 0x000000ae, 0x0004009b, 0x00000003, 0x000000b0, 0x000000af, 0x000300f7,
+    0x000000b2, 0x00000000, 0x000400fa, 0x000000b0, 0x000000b1, 0x000000b2, 0x000200f8, 0x000000b1,
+    0x00040063, 0x000000ac, 0x00000048, 0x0000003f, 0x000200f9, 0x000000b2, 0x000200f8, 0x000000b2,
+    0x000200f9, 0x0000004c, 0x000200f8, 0x00000057, 0x00050041, 0x00000059, 0x000000b4, 0x00000019,
+    0x000000b3, 0x0004003d, 0x00000016, 0x000000b5, 0x000000b4, 0x00040068, 0x00000008, 0x000000b6,
+    0x000000b5, 0x0007004f, 0x00000007, 0x000000b7, 0x000000b6, 0x000000b6, 0x00000000, 0x00000001,
+    0x000500b1, 0x0000000e, 0x000000b8, 0x0000003d, 0x000000b7, 0x0004009b, 0x00000003, 0x000000b9,
+    0x000000b8, 0x000300f7, 0x000000bb, 0x00000000, 0x000400fa, 0x000000b9, 0x000000ba, 0x000000bb,
+    0x000200f8, 0x000000ba, 0x00040063, 0x000000b5, 0x00000048, 0x0000003f, 0x000200f9, 0x000000bb,
+    0x000200f8, 0x000000bb, 0x000200f9, 0x0000004c, 0x000200f8, 0x00000058, 0x00050041, 0x00000059,
+    0x000000bd, 0x00000019, 0x000000bc, 0x0004003d, 0x00000016, 0x000000be, 0x000000bd, 0x00040068,
+    0x00000008, 0x000000bf, 0x000000be, 0x0007004f, 0x00000007, 0x000000c0, 0x000000bf, 0x000000bf,
+    0x00000000, 0x00000001, 0x000500b1, 0x0000000e, 0x000000c1, 0x0000003d, 0x000000c0, 0x0004009b,
+    0x00000003, 0x000000c2, 0x000000c1, 0x000300f7, 0x000000c4, 0x00000000, 0x000400fa, 0x000000c2,
+    0x000000c3, 0x000000c4, 0x000200f8, 0x000000c3, 0x00040063, 0x000000be, 0x00000048, 0x0000003f,
+    0x000200f9, 0x000000c4, 0x000200f8, 0x000000c4, 0x000200f9, 0x0000004c, 0x000200f8, 0x0000004c,
+    0x000200f9, 0x0000004a, 0x000200f8, 0x0000004a, 0x000100fd, 0x00010038, 0x00050036, 0x0000000d,
+    0x00000038, 0x00000000, 0x00000033, 0x00030037, 0x00000007, 0x000000c5, 0x00030037, 0x00000004,
+    0x000000c6, 0x000200f8, 0x000000c7, 0x00050041, 0x000000c8, 0x000000c9, 0x00000010, 0x00000074,
+    0x0004003d, 0x00000007, 0x000000ca, 0x000000c9, 0x00050041, 0x00000041, 0x000000cb, 0x00000010,
+    0x0000006b, 0x0004003d, 0x00000005, 0x000000cc, 0x000000cb, 0x0004007c, 0x00000004, 0x000000cd,
+    0x000000cc, 0x00050082, 0x00000007, 0x000000cf, 0x000000ca, 0x000000ce, 0x0007000c, 0x00000007,
+    0x000000d0, 0x00000001, 0x00000027, 0x000000c5, 0x000000cf, 0x00050051, 0x00000004, 0x000000d1,
+    0x000000d0, 0x00000000, 0x00050051, 0x00000004, 0x000000d2, 0x000000d0, 0x00000001, 0x00050051,
+    0x00000004, 0x000000d3, 0x000000ca, 0x00000000, 0x00050084, 0x00000004, 0x000000d4, 0x000000c6,
+    0x000000cd, 0x00050084, 0x00000004, 0x000000d5, 0x000000d2, 0x000000d3, 0x00050080, 0x00000004,
+    0x000000d6, 0x000000d4, 0x000000d5, 0x00050080, 0x00000004, 0x000000d7, 0x000000d6, 0x000000d1,
+    0x00060041, 0x000000d8, 0x000000d9, 0x00000021, 0x0000005a, 0x000000d7, 0x0004003d, 0x0000000d,
+    0x000000da, 0x000000d9, 0x000200fe, 0x000000da, 0x00010038, 0x00050036, 0x0000000d, 0x00000039,
+    0x00000000, 0x00000034, 0x00030037, 0x00000004, 0x000000db, 0x00030037, 0x00000007, 0x000000dc,
+    0x00030037, 0x00000004, 0x000000dd, 0x000200f8, 0x000000de, 0x000500aa, 0x00000003, 0x000000df,
+    0x000000db, 0x0000005a, 0x000300f7, 0x000000e2, 0x00000000, 0x000400fa, 0x000000df, 0x000000e0,
+    0x000000e1, 0x000200f8, 0x000000e0, 0x0004006f, 0x0000000b, 0x000000e3, 0x000000dc, 0x0005008e,
+    0x0000000b, 0x000000e5, 0x000000e3, 0x000000e4, 0x00050081, 0x0000000b, 0x000000e8, 0x000000e5,
+    0x000000e7, 0x00050041, 0x000000e9, 0x000000ea, 0x00000010, 0x0000005a, 0x0004003d, 0x0000000b,
+    0x000000eb, 0x000000ea, 0x00050085, 0x0000000b, 0x000000ec, 0x000000e8, 0x000000eb, 0x00050051,
+    0x00000006, 0x000000ed, 0x000000ec, 0x00000000, 0x00050051, 0x00000006, 0x000000ee, 0x000000ec,
+    0x00000001, 0x0004006f, 0x00000006, 0x000000ef, 0x000000dd, 0x00060050, 0x0000000c, 0x000000f0,
+    0x000000ed, 0x000000ee, 0x000000ef, 0x0004003d, 0x00000013, 0x000000f1, 0x00000014, 0x00070058,
+    0x0000000d, 0x000000f3, 0x000000f1, 0x000000f0, 0x00000002, 0x000000f2, 0x000200f9, 0x000000e2,
+    0x000200f8, 0x000000e1, 0x00050084, 0x00000007, 0x000000f5, 0x000000dc, 0x000000f4, 0x00060039,
+    0x0000000d, 0x000000f6, 0x00000038, 0x000000f5, 0x000000dd, 0x00050080, 0x00000007, 0x000000f8,
+    0x000000f5, 0x000000f7, 0x00060039, 0x0000000d, 0x000000f9, 0x00000038, 0x000000f8, 0x000000dd,
+    0x00050081, 0x0000000d, 0x000000fa, 0x000000f6, 0x000000f9, 0x00050080, 0x00000007, 0x000000fc,
+    0x000000f5, 0x000000fb, 0x00060039, 0x0000000d, 0x000000fd, 0x00000038, 0x000000fc, 0x000000dd,
+    0x00050081, 0x0000000d, 0x000000fe, 0x000000fa, 0x000000fd, 0x00050080, 0x00000007, 0x000000ff,
+    0x000000f5, 0x000000ce, 0x00060039, 0x0000000d, 0x00000100, 0x00000038, 0x000000ff, 0x000000dd,
+    0x00050081, 0x0000000d, 0x00000101, 0x000000fe, 0x00000100, 0x0005008e, 0x0000000d, 0x00000103,
+    0x00000101, 0x00000102, 0x000200f9, 0x000000e2, 0x000200f8, 0x000000e2, 0x000700f5, 0x0000000d,
+    0x00000104, 0x000000f3, 0x000000e0, 0x00000103, 0x000000e1, 0x000200fe, 0x00000104, 0x00010038,
+    0x00050036, 0x00000002, 0x0000003a, 0x00000000, 0x00000035, 0x00030037, 0x00000004, 0x00000105,
+    0x00030037, 0x00000007, 0x00000106, 0x00030037, 0x00000004, 0x00000107, 0x000200f8, 0x00000108,
+    0x0004003d, 0x00000005, 0x00000109, 0x0000002b, 0x00050089, 0x00000005, 0x0000010b, 0x00000109,
+    0x0000010a, 0x0004007c, 0x00000004, 0x0000010c, 0x0000010b, 0x00050086, 0x00000005, 0x0000010d,
+    0x00000109, 0x0000010a, 0x0004007c, 0x00000004, 0x0000010e, 0x0000010d, 0x00050050, 0x00000007,
+    0x0000010f, 0x0000010c, 0x0000010e, 0x00050084, 0x00000007, 0x00000112, 0x00000106, 0x00000111,
+    0x00050084, 0x00000007, 0x00000113, 0x0000010f, 0x000000f4, 0x00050080, 0x00000007, 0x00000114,
+    0x00000112, 0x00000113, 0x00050080, 0x00000004, 0x00000115, 0x00000105, 0x00000042, 0x00070039,
+    0x0000000d, 0x00000116, 0x00000039, 0x00000105, 0x00000114, 0x00000107, 0x00080039, 0x00000002,
+    0x00000117, 0x00000037, 0x00000115, 0x00000114, 0x00000107, 0x00000116, 0x00050080, 0x00000007,
+    0x00000118, 0x00000114, 0x000000f7, 0x00070039, 0x0000000d, 0x00000119, 0x00000039, 0x00000105,
+    0x00000118, 0x00000107, 0x00080039, 0x00000002, 0x0000011a, 0x00000037, 0x00000115, 0x00000118,
+    0x00000107, 0x00000119, 0x00050081, 0x0000000d, 0x0000011b, 0x00000116, 0x00000119, 0x00050080,
+    0x00000007, 0x0000011c, 0x00000114, 0x000000fb, 0x00070039, 0x0000000d, 0x0000011d, 0x00000039,
+    0x00000105, 0x0000011c, 0x00000107, 0x00080039, 0x00000002, 0x0000011e, 0x00000037, 0x00000115,
+    0x0000011c, 0x00000107, 0x0000011d, 0x00050081, 0x0000000d, 0x0000011f, 0x0000011b, 0x0000011d,
+    0x00050080, 0x00000007, 0x00000120, 0x00000114, 0x000000ce, 0x00070039, 0x0000000d, 0x00000121,
+    0x00000039, 0x00000105, 0x00000120, 0x00000107, 0x00080039, 0x00000002, 0x00000122, 0x00000037,
+    0x00000115, 0x00000120, 0x00000107, 0x00000121, 0x00050081, 0x0000000d, 0x00000123, 0x0000011f,
+    0x00000121, 0x0005008e, 0x0000000d, 0x00000124, 0x00000123, 0x00000102, 0x00050080, 0x00000004,
+    0x00000125, 0x00000105, 0x0000006b, 0x00050084, 0x00000007, 0x00000128, 0x00000106, 0x00000127,
+    0x00050080, 0x00000007, 0x00000129, 0x00000128, 0x0000010f, 0x00080039, 0x00000002, 0x0000012a,
+    0x00000037, 0x00000125, 0x00000129, 0x00000107, 0x00000124, 0x00050084, 0x00000004, 0x0000012b,
+    0x0000010e, 0x00000126, 0x00050080, 0x00000004, 0x0000012c, 0x0000012b, 0x0000010c, 0x00050041,
+    0x0000012d, 0x0000012e, 0x00000025, 0x0000012c, 0x0003003e, 0x0000012e, 0x00000124, 0x000400e0,
+    0x0000002e, 0x0000002e, 0x0000002f, 0x00050084, 0x00000004, 0x0000012f, 0x0000010e, 0x00000110,
+    0x00050084, 0x00000004, 0x00000130, 0x0000010c, 0x0000006b, 0x00050080, 0x00000004, 0x00000131,
+    0x0000012f, 0x00000130, 0x000500b1, 0x00000003, 0x00000132, 0x0000010c, 0x000000a1, 0x000500b1,
+    0x00000003, 0x00000133, 0x0000010e, 0x000000a1, 0x000500a7, 0x00000003, 0x00000134, 0x00000132,
+    0x00000133, 0x000300f7, 0x00000136, 0x00000000, 0x000400fa, 0x00000134, 0x00000135, 0x00000136,
+    0x000200f8, 0x00000135, 0x00050041, 0x0000012d, 0x00000137, 0x00000025, 0x00000131, 0x0004003d,
+    0x0000000d, 0x00000138, 0x00000137, 0x00050080, 0x00000004, 0x00000139, 0x00000131, 0x00000042,
+    0x00050041, 0x0000012d, 0x0000013a, 0x00000025, 0x00000139, 0x0004003d, 0x0000000d, 0x0000013b,
+    0x0000013a, 0x00050080, 0x00000004, 0x0000013c, 0x00000131, 0x00000126, 0x00050041, 0x0000012d,
+    0x0000013d, 0x00000025, 0x0000013c, 0x0004003d, 0x0000000d, 0x0000013e, 0x0000013d, 0x00050080,
+    0x00000004, 0x00000140, 0x00000131, 0x0000013f, 0x00050041, 0x0000012d, 0x00000141, 0x00000025,
+    0x00000140, 0x0004003d, 0x0000000d, 0x00000142, 0x00000141, 0x00050081, 0x0000000d, 0x00000143,
+    0x00000138, 0x0000013b, 0x00050081, 0x0000000d, 0x00000144, 0x00000143, 0x0000013e, 0x00050081,
+    0x0000000d, 0x00000145, 0x00000144, 0x00000142, 0x0005008e, 0x0000000d, 0x00000146, 0x00000145,
+    0x00000102, 0x000200f9, 0x00000136, 0x000200f8, 0x00000136, 0x000700f5, 0x0000000d, 0x00000147,
+    0x00000146, 0x00000135, 0x00000124, 0x00000108, 0x000400e0, 0x0000002e, 0x0000002e, 0x0000002f,
+    0x000300f7, 0x00000149, 0x00000000, 0x000400fa, 0x00000134, 0x00000148, 0x00000149, 0x000200f8,
+    0x00000148, 0x00050041, 0x0000012d, 0x0000014a, 0x00000025, 0x0000012c, 0x0003003e, 0x0000014a,
+    0x00000147, 0x00050080, 0x00000004, 0x0000014b, 0x00000105, 0x00000074, 0x00050084, 0x00000007,
+    0x0000014d, 0x00000106, 0x0000014c, 0x00050080, 0x00000007, 0x0000014e, 0x0000014d, 0x0000010f,
+    0x00080039, 0x00000002, 0x0000014f, 0x00000037, 0x0000014b, 0x0000014e, 0x00000107, 0x00000147,
+    0x000200f9, 0x00000149, 0x000200f8, 0x00000149, 0x000400e0, 0x0000002e, 0x0000002e, 0x0000002f,
+    0x000500b1, 0x00000003, 0x00000150, 0x0000010c, 0x0000007d, 0x000500b1, 0x00000003, 0x00000151,
+    0x0000010e, 0x0000007d, 0x000500a7, 0x00000003, 0x00000152, 0x00000150, 0x00000151, 0x000300f7,
+    0x00000154, 0x00000000, 0x000400fa, 0x00000152, 0x00000153, 0x00000154, 0x000200f8, 0x00000153,
+    0x00050041, 0x0000012d, 0x00000155, 0x00000025, 0x00000131, 0x0004003d, 0x0000000d, 0x00000156,
+    0x00000155, 0x00050080, 0x00000004, 0x00000157, 0x00000131, 0x00000042, 0x00050041, 0x0000012d,
+    0x00000158, 0x00000025, 0x00000157, 0x0004003d, 0x0000000d, 0x00000159, 0x00000158, 0x00050080,
+    0x00000004, 0x0000015a, 0x00000131, 0x00000126, 0x00050041, 0x0000012d, 0x0000015b, 0x00000025,
+    0x0000015a, 0x0004003d, 0x0000000d, 0x0000015c, 0x0000015b, 0x00050080, 0x00000004, 0x0000015d,
+    0x00000131, 0x0000013f, 0x00050041, 0x0000012d, 0x0000015e, 0x00000025, 0x0000015d, 0x0004003d,
+    0x0000000d, 0x0000015f, 0x0000015e, 0x00050081, 0x0000000d, 0x00000160, 0x00000156, 0x00000159,
+    0x00050081, 0x0000000d, 0x00000161, 0x00000160, 0x0000015c, 0x00050081, 0x0000000d, 0x00000162,
+    0x00000161, 0x0000015f, 0x0005008e, 0x0000000d, 0x00000163, 0x00000162, 0x00000102, 0x000200f9,
+    0x00000154, 0x000200f8, 0x00000154, 0x000700f5, 0x0000000d, 0x00000164, 0x00000163, 0x00000153,
+    0x00000147, 0x00000149, 0x000400e0, 0x0000002e, 0x0000002e, 0x0000002f, 0x000300f7, 0x00000166,
+    0x00000000, 0x000400fa, 0x00000152, 0x00000165, 0x00000166, 0x000200f8, 0x00000165, 0x00050041,
+    0x0000012d, 0x00000167, 0x00000025, 0x0000012c, 0x0003003e, 0x00000167, 0x00000164, 0x00050080,
+    0x00000004, 0x00000168, 0x00000105, 0x0000007d, 0x00050084, 0x00000007, 0x0000016a, 0x00000106,
+    0x00000169, 0x00050080, 0x00000007, 0x0000016b, 0x0000016a, 0x0000010f, 0x00080039, 0x00000002,
+    0x0000016c, 0x00000037, 0x00000168, 0x0000016b, 0x00000107, 0x00000164, 0x000200f9, 0x00000166,
+    0x000200f8, 0x00000166, 0x000400e0, 0x0000002e, 0x0000002e, 0x0000002f, 0x000500b1, 0x00000003,
+    0x0000016d, 0x0000010c, 0x0000006b, 0x000500b1, 0x00000003, 0x0000016e, 0x0000010e, 0x0000006b,
+    0x000500a7, 0x00000003, 0x0000016f, 0x0000016d, 0x0000016e, 0x000300f7, 0x00000171, 0x00000000,
+    0x000400fa, 0x0000016f, 0x00000170, 0x00000171, 0x000200f8, 0x00000170, 0x00050041, 0x0000012d,
+    0x00000172, 0x00000025, 0x00000131, 0x0004003d, 0x0000000d, 0x00000173, 0x00000172, 0x00050080,
+    0x00000004, 0x00000174, 0x00000131, 0x00000042, 0x00050041, 0x0000012d, 0x00000175, 0x00000025,
+    0x00000174, 0x0004003d, 0x0000000d, 0x00000176, 0x00000175, 0x00050080, 0x00000004, 0x00000177,
+    0x00000131, 0x00000126, 0x00050041, 0x0000012d, 0x00000178, 0x00000025, 0x00000177, 0x0004003d,
+    0x0000000d, 0x00000179, 0x00000178, 0x00050080, 0x00000004, 0x0000017a, 0x00000131, 0x0000013f,
+    0x00050041, 0x0000012d, 0x0000017b, 0x00000025, 0x0000017a, 0x0004003d, 0x0000000d, 0x0000017c,
+    0x0000017b, 0x00050081, 0x0000000d, 0x0000017d, 0x00000173, 0x00000176, 0x00050081, 0x0000000d,
+    0x0000017e, 0x0000017d, 0x00000179, 0x00050081, 0x0000000d, 0x0000017f, 0x0000017e, 0x0000017c,
+    0x0005008e, 0x0000000d, 0x00000180, 0x0000017f, 0x00000102, 0x000200f9, 0x00000171, 0x000200f8,
+    0x00000171, 0x000700f5, 0x0000000d, 0x00000181, 0x00000180, 0x00000170, 0x00000164, 0x00000166,
+    0x000400e0, 0x0000002e, 0x0000002e, 0x0000002f, 0x000300f7, 0x00000183, 0x00000000, 0x000400fa,
+    0x0000016f, 0x00000182, 0x00000183, 0x000200f8, 0x00000182, 0x00050041, 0x0000012d, 0x00000184,
+    0x00000025, 0x0000012c, 0x0003003e, 0x00000184, 0x00000181, 0x00050080, 0x00000004, 0x00000185,
+    0x00000105, 0x00000086, 0x00050084, 0x00000007, 0x00000186, 0x00000106, 0x000000f4, 0x00050080,
+    0x00000007, 0x00000187, 0x00000186, 0x0000010f, 0x00080039, 0x00000002, 0x00000188, 0x00000037,
+    0x00000185, 0x00000187, 0x00000107, 0x00000181, 0x000200f9, 0x00000183, 0x000200f8, 0x00000183,
+    0x000400e0, 0x0000002e, 0x0000002e, 0x0000002f, 0x000500b1, 0x00000003, 0x00000189, 0x0000010c,
+    0x00000042, 0x000500b1, 0x00000003, 0x0000018a, 0x0000010e, 0x00000042, 0x000500a7, 0x00000003,
+    0x0000018b, 0x00000189, 0x0000018a, 0x000300f7, 0x0000018d, 0x00000000, 0x000400fa, 0x0000018b,
+    0x0000018c, 0x0000018d, 0x000200f8, 0x0000018c, 0x00050041, 0x0000012d, 0x0000018e, 0x00000025,
+    0x00000131, 0x0004003d, 0x0000000d, 0x0000018f, 0x0000018e, 0x00050080, 0x00000004, 0x00000190,
+    0x00000131, 0x00000042, 0x00050041, 0x0000012d, 0x00000191, 0x00000025, 0x00000190, 0x0004003d,
+    0x0000000d, 0x00000192, 0x00000191, 0x00050080, 0x00000004, 0x00000193, 0x00000131, 0x00000126,
+    0x00050041, 0x0000012d, 0x00000194, 0x00000025, 0x00000193, 0x0004003d, 0x0000000d, 0x00000195,
+    0x00000194, 0x00050080, 0x00000004, 0x00000196, 0x00000131, 0x0000013f, 0x00050041, 0x0000012d,
+    0x00000197, 0x00000025, 0x00000196, 0x0004003d, 0x0000000d, 0x00000198, 0x00000197, 0x00050081,
+    0x0000000d, 0x00000199, 0x0000018f, 0x00000192, 0x00050081, 0x0000000d, 0x0000019a, 0x00000199,
+    0x00000195, 0x00050081, 0x0000000d, 0x0000019b, 0x0000019a, 0x00000198, 0x0005008e, 0x0000000d,
+    0x0000019c, 0x0000019b, 0x00000102, 0x000200f9, 0x0000018d, 0x000200f8, 0x0000018d, 0x000700f5,
+    0x0000000d, 0x0000019d, 0x0000019c, 0x0000018c, 0x00000181, 0x00000183, 0x000400e0, 0x0000002e,
+    0x0000002e, 0x0000002f, 0x000300f7, 0x0000019f, 0x00000000, 0x000400fa, 0x0000018b, 0x0000019e,
+    0x0000019f, 0x000200f8, 0x0000019e, 0x00050041, 0x0000012d, 0x000001a0, 0x00000025, 0x0000012c,
+    0x0003003e, 0x000001a0, 0x0000019d, 0x00050080, 0x00000004, 0x000001a1, 0x00000105, 0x0000008f,
+    0x00050084, 0x00000007, 0x000001a2, 0x00000106, 0x000000ce, 0x00050080, 0x00000007, 0x000001a3,
+    0x000001a2, 0x0000010f, 0x00080039, 0x00000002, 0x000001a4, 0x00000037, 0x000001a1, 0x000001a3,
+    0x00000107, 0x0000019d, 0x000200f9, 0x0000019f, 0x000200f8, 0x0000019f, 0x000400e0, 0x0000002e,
+    0x0000002e, 0x0000002f, 0x000100fd, 0x00010038, 0x00050036, 0x00000002, 0x0000003b, 0x00000000,
+    0x00000036, 0x000200f8, 0x000001a5, 0x0004003d, 0x0000000a, 0x000001a6, 0x00000029, 0x00050051,
+    0x00000005, 0x000001a7, 0x000001a6, 0x00000002, 0x0004007c, 0x00000004, 0x000001a8, 0x000001a7,
+    0x0007004f, 0x00000009, 0x000001a9, 0x000001a6, 0x000001a6, 0x00000000, 0x00000001, 0x0004007c,
+    0x00000007, 0x000001aa, 0x000001a9, 0x00070039, 0x00000002, 0x000001ab, 0x0000003a, 0x0000005a,
+    0x000001aa, 0x000001a8, 0x00050041, 0x00000041, 0x000001ac, 0x00000010, 0x00000042, 0x0004003d,
+    0x00000005, 0x000001ad, 0x000001ac, 0x000500b2, 0x00000003, 0x000001af, 0x000001ad, 0x000001ae,
+    0x000300f7, 0x000001b1, 0x00000000, 0x000400fa, 0x000001af, 0x000001b0, 0x000001b1, 0x000200f8,
+    0x000001b0, 0x000100fd, 0x000200f8, 0x000001b1, 0x00050041, 0x00000041, 0x000001b2, 0x00000010,
+    0x0000006b, 0x0004003d, 0x00000005, 0x000001b3, 0x000001b2, 0x0004003d, 0x00000005, 0x000001b4,
+    0x0000002b, 0x000500aa, 0x00000003, 0x000001b5, 0x000001b4, 0x00000031, 0x000300f7, 0x000001b7,
+    0x00000000, 0x000400fa, 0x000001b5, 0x000001b6, 0x000001b7, 0x000200f8, 0x000001b6, 0x00050041,
+    0x000000c8, 0x000001b8, 0x00000010, 0x00000074, 0x0004003d, 0x00000007, 0x000001b9, 0x000001b8,
+    0x00050051, 0x00000004, 0x000001ba, 0x000001aa, 0x00000000, 0x00050051, 0x00000004, 0x000001bb,
+    0x000001aa, 0x00000001, 0x0004007c, 0x00000004, 0x000001bc, 0x000001b3, 0x00050084, 0x00000004,
+    0x000001bd, 0x000001a8, 0x000001bc, 0x00050051, 0x00000004, 0x000001be, 0x000001b9, 0x00000000,
+    0x00050084, 0x00000004, 0x000001bf, 0x000001bb, 0x000001be, 0x00050080, 0x00000004, 0x000001c0,
+    0x000001bd, 0x000001bf, 0x00050080, 0x00000004, 0x000001c1, 0x000001c0, 0x000001ba, 0x00060041,
+    0x000000d8, 0x000001c2, 0x00000021, 0x0000005a, 0x000001c1, 0x00050041, 0x0000012d, 0x000001c3,
+    0x00000025, 0x0000005a, 0x0004003d, 0x0000000d, 0x000001c4, 0x000001c3, 0x0003003e, 0x000001c2,
+    0x000001c4, 0x000300e1, 0x0000002d, 0x00000030, 0x00060041, 0x000001c5, 0x000001c6, 0x0000001d,
+    0x0000005a, 0x000001a8, 0x000700ea, 0x00000005, 0x000001c7, 0x000001c6, 0x0000002d, 0x00000031,
+    0x0000002d, 0x00050082, 0x00000005, 0x000001c8, 0x000001b3, 0x0000002d, 0x000500aa, 0x00000003,
+    0x000001c9, 0x000001c7, 0x000001c8, 0x000600a9, 0x00000005, 0x000001ca, 0x000001c9, 0x0000002d,
+    0x00000031, 0x0003003e, 0x00000027, 0x000001ca, 0x000200f9, 0x000001b7, 0x000200f8, 0x000001b7,
+    0x000400e0, 0x0000002e, 0x0000002e, 0x0000002f, 0x0004003d, 0x00000005, 0x000001cb, 0x00000027,
+    0x000500aa, 0x00000003, 0x000001cc, 0x000001cb, 0x00000031, 0x000300f7, 0x000001ce, 0x00000000,
+    0x000400fa, 0x000001cc, 0x000001cd, 0x000001ce, 0x000200f8, 0x000001cd, 0x000100fd, 0x000200f8,
+    0x000001ce, 0x0004003d, 0x00000005, 0x000001cf, 0x0000002b, 0x000500aa, 0x00000003, 0x000001d0,
+    0x000001cf, 0x00000031, 0x000300f7, 0x000001d2, 0x00000000, 0x000400fa, 0x000001d0, 0x000001d1,
+    0x000001d2, 0x000200f8, 0x000001d1, 0x00060041, 0x000001c5, 0x000001d3, 0x0000001d, 0x0000005a,
+    0x000001a8, 0x0003003e, 0x000001d3, 0x00000031, 0x000200f9, 0x000001d2, 0x000200f8, 0x000001d2,
+    0x000300e1, 0x0000002d, 0x00000030, 0x00070039, 0x00000002, 0x000001d5, 0x0000003a, 0x0000008f,
+    0x000001d4, 0x000001a8, 0x000100fd, 0x00010038
+};
+
+
+struct downsampler_push_constants {
+    float   inv_size[2];
+    u32     mips;
+    u32     groups;
+    i32     group_count[2];
+};
+
+
+span<const char>
+downsampler::source() NEX
+{
+    return {DOWNSAMPLER_SOURCE, sizeof(DOWNSAMPLER_SOURCE) - 1};
+}
+
+
+span<const u32>
+downsampler::spirv() NEX
+{
+    return {DOWNSAMPLER_SPIRV, sizeof(DOWNSAMPLER_SPIRV) / sizeof(u32)};
+}
+
+
+downsampler
+downsampler::create(
+        VkDevice device,
+        span<const u32> spirv,
+        VkPipelineCache cache,
+        vk_alloc alloc) NEX
+{
+    downsampler d{};
+
+    const descriptor bindings[]{
+        {0, DESCRIPTOR_COMBINED_IMAGE_SAMPLER, 1, SHADER_COMPUTE},
+        {1, DESCRIPTOR_STORAGE_IMAGE, MAX_MIPS, SHADER_COMPUTE},
+        {2, DESCRIPTOR_STORAGE_BUFFER, 1, SHADER_COMPUTE},
+        {3, DESCRIPTOR_STORAGE_BUFFER, 1, SHADER_COMPUTE},
+    };
+    d.set_layout = descriptor_set_layout::create(device, bindings, alloc);
+
+    const VkDescriptorSetLayout set_layouts[]{d.set_layout};
+    const push_constant_range push_constants[]{{0, sizeof(downsampler_push_constants), SHADER_COMPUTE}};
+    d.layout = pipeline_layout::create(device, set_layouts, push_constants, alloc);
+
+    auto shader = shader_module::create(device, spirv.empty() ? downsampler::spirv() : spirv, alloc);
+    d.pipe = pipeline::create(device, pipeline::compute_desc{d.layout, shader}, cache, alloc);
+    shader.destroy(device, alloc);
+
+    VkSamplerCreateInfo sampler_info{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    vk_validate(vkCreateSampler(device, &sampler_info, alloc, &d.sampler),
+        "tinyvk::downsampler::create - Failed to create sampler");
+
+    return d;
+}
+
+
+void
+downsampler::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    vkDestroySampler(device, sampler, alloc);
+    pipe.destroy(device, alloc);
+    layout.destroy(device, alloc);
+    set_layout.destroy(device, alloc);
+    sampler = {};
+}
+
+
+u32
+downsampler::mip_count(
+        u32 width,
+        u32 height) NEX
+{
+    u32 mips = 1;
+    for (u32 size = tinystd::max(width, height); size > 1; size /= 2) ++mips;
+    return mips;
+}
+
+
+VkExtent3D
+downsampler::dispatch_size(
+        u32 width,
+        u32 height,
+        u32 layers) NEX
+{
+    return {(width + TILE_SIZE - 1) / TILE_SIZE, (height + TILE_SIZE - 1) / TILE_SIZE, layers};
+}
+
+
+static VkDeviceSize
+downsampler_mid_offset(
+        u32 layers)
+{
+    return (VkDeviceSize(layers) * sizeof(u32) + downsampler::SCRATCH_ALIGNMENT - 1) & ~VkDeviceSize(downsampler::SCRATCH_ALIGNMENT - 1);
+}
+
+
+VkDeviceSize
+downsampler::scratch_size(
+        u32 width,
+        u32 height,
+        u32 layers) NEX
+{
+    const auto groups = dispatch_size(width, height, layers);
+    return downsampler_mid_offset(layers) + VkDeviceSize(groups.width) * groups.height * layers * 4 * sizeof(float);
+}
+
+
+void
+downsampler::write_descriptors(
+        VkDevice device,
+        VkDescriptorSet set,
+        VkImageView mip0,
+        span<const VkImageView> mips,
+        VkBuffer scratch,
+        VkDeviceSize scratch_offset,
+        u32 width,
+        u32 height,
+        u32 layers) const NEX
+{
+    tassert(!mips.empty() && mips.size() <= MAX_MIPS && "tinyvk::downsampler::write_descriptors - Between 1 and 12 mip views required");
+
+    const VkDescriptorImageInfo src{sampler, mip0, VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo dst[MAX_MIPS]{};
+    for (u32 i = 0; i < MAX_MIPS; ++i) {
+        // levels that are not written still need a valid descriptor
+        dst[i].imageView = mips[tinystd::min(i, u32(mips.size() - 1))];
+        dst[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+    const VkDescriptorBufferInfo counters{scratch, scratch_offset, VkDeviceSize(layers) * sizeof(u32)};
+    const VkDescriptorBufferInfo mid{scratch, scratch_offset + downsampler_mid_offset(layers),
+        scratch_size(width, height, layers) - downsampler_mid_offset(layers)};
+
+    small_vector<VkWriteDescriptorSet, 4> writes{};
+    descriptor_set::write_images(writes, 0, DESCRIPTOR_COMBINED_IMAGE_SAMPLER, {&src, 1});
+    descriptor_set::write_images(writes, 1, DESCRIPTOR_STORAGE_IMAGE, dst);
+    descriptor_set::write_buffers(writes, 2, DESCRIPTOR_STORAGE_BUFFER, {&counters, 1});
+    descriptor_set::write_buffers(writes, 3, DESCRIPTOR_STORAGE_BUFFER, {&mid, 1});
+    descriptor_set::write(device, writes, set);
+}
+
+
+void
+downsampler::init_scratch(
+        VkCommandBuffer cmd,
+        VkBuffer scratch,
+        VkDeviceSize scratch_offset,
+        u32 layers) NEX
+{
+    vkCmdFillBuffer(cmd, scratch, scratch_offset, VkDeviceSize(layers) * sizeof(u32), 0);
+
+    VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = scratch;
+    barrier.offset = scratch_offset;
+    barrier.size = VkDeviceSize(layers) * sizeof(u32);
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, nullptr,
+        1, &barrier,
+        0, nullptr);
+}
+
+
+void
+downsampler::record(
+        VkCommandBuffer cmd,
+        VkDescriptorSet set,
+        u32 width,
+        u32 height,
+        u32 layers,
+        u32 mips) const NEX
+{
+    tassert(tinystd::max(width, height) <= (1u << MAX_MIPS) && "tinyvk::downsampler::record - Image is too large, at most 4096x4096 is supported");
+    const u32 levels = tinystd::min(mips == -1u ? mip_count(width, height) - 1 : mips, u32(MAX_MIPS));
+    if (!levels)
+        return;
+
+    const auto groups = dispatch_size(width, height, layers);
+    const downsampler_push_constants pc{
+        {1.0f / float(width), 1.0f / float(height)},
+        levels,
+        groups.width * groups.height,
+        {i32(groups.width), i32(groups.height)}};
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipe);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pc), &pc);
+    vkCmdDispatch(cmd, groups.width, groups.height, groups.depth);
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_DOWNSAMPLER_CPP
+
+#endif //TINYVK_IMPLEMENTATION
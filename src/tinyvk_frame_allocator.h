@@ -0,0 +1,256 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_FRAME_ALLOCATOR_H
+#define TINYVK_FRAME_ALLOCATOR_H
+
+#include "tinyvk_core.h"
+#ifdef TINYVK_USE_VMA
+#include "tinyvk_buffer.h"
+#endif
+
+namespace tinyvk {
+
+/// Linear allocator for per draw uniform and storage data bound with DESCRIPTOR_UNIFORM_BUFFER_DYNAMIC or
+/// DESCRIPTOR_STORAGE_BUFFER_DYNAMIC. The persistently mapped buffer is split into one region per frame in flight,
+/// allocations return the mapped pointer and the dynamic offset to bind the descriptor set with, so the descriptor
+/// (written once with the buffer and the largest range) never changes.
+///     - begin_frame waits for the fence of the frame that last used the region and resets it
+///     - offsets are aligned to minUniformBufferOffsetAlignment and minStorageBufferOffsetAlignment
+///     - memory that is not HOST_COHERENT is flushed by flush with a single range for everything allocated since
+///       the previous flush (call it before submitting), it is a no-op for coherent memory
+struct frame_allocator {
+    struct allocation_t {
+        void*                   data{};
+        u32                     offset{};
+    };
+
+    struct frame_t {
+        u64                     begin{};
+        u64                     end{};
+        u64                     head{};
+        u64                     flushed{};
+    };
+
+    VkBuffer                    buffer{};
+    u8*                         mapped{};
+    VkDeviceMemory              memory{};
+    u64                         memory_offset{};
+    u64                         alignment{};
+    u64                         atom_size{};
+    u32                         frame_count{};
+    u32                         frame{};
+    frame_t                     frames[MAX_FRAMES_IN_FLIGHT]{};
+#ifdef TINYVK_USE_VMA
+    VmaAllocation               allocation{};
+    memory_stats*               stats{};
+#endif
+
+    /// Allocate from buffer (mapped is its persistent mapping of size bytes). memory is the non coherent memory
+    /// buffer is bound to at memory_offset (a multiple of nonCoherentAtomSize), or null for coherent memory
+    static frame_allocator create(
+            VkBuffer                        buffer,
+            void*                           mapped,
+            u64                             size,
+            u32                             frames_in_flight,
+            const VkPhysicalDeviceLimits&   limits,
+            VkDeviceMemory                  memory = {},
+            u64                             memory_offset = 0) NEX;
+
+#ifdef TINYVK_USE_VMA
+    /// Allocate from a VMA_USAGE_CPU_TO_GPU uniform and storage buffer of size bytes owned by the allocator,
+    /// stats (optional) tracks it as MEMORY_CATEGORY_BUFFER until destroy
+    static frame_allocator create(
+            VmaAllocator                    vma,
+            u64                             size,
+            u32                             frames_in_flight,
+            const VkPhysicalDeviceLimits&   limits,
+            memory_stats*                   stats = {}) NEX;
+
+    /// Destroy an allocator created with its own buffer
+    void                destroy(
+            VmaAllocator                    vma) NEX;
+#endif
+
+    /// Start allocating from the region of frame, waits for fence (if any) to make sure the device is done with it
+    void                begin_frame(
+            VkDevice                        device,
+            u32                             frame,
+            VkFence                         fence = {}) NEX;
+
+    /// Pointer to size bytes and their dynamic offset, data is null when the region of the frame is full
+    NDC allocation_t    allocate(
+            u64                             size) NEX;
+
+    /// Copy v and return its dynamic offset
+    template<typename T>
+    NDC allocation_t    push(
+            const T&                        v) NEX;
+
+    /// Make everything allocated since the last flush visible to the device
+    void                flush(
+            VkDevice                        device) NEX;
+
+    /// Largest range a single allocation can have (the range of the descriptor)
+    NDC u64             frame_size() const NEX { return frames[0].end - frames[0].begin; }
+
+    NDC u64             used() const NEX { return frames[frame].head - frames[frame].begin; }
+};
+
+
+template<typename T>
+frame_allocator::allocation_t
+frame_allocator::push(
+        const T& v) NEX
+{
+    const allocation_t a = allocate(sizeof(T));
+    if (a.data)
+        tinystd::memcpy(a.data, &v, sizeof(T));
+    return a;
+}
+
+}
+
+#endif //TINYVK_FRAME_ALLOCATOR_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_FRAME_ALLOCATOR_CPP
+#define TINYVK_FRAME_ALLOCATOR_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+//region frame_allocator
+
+frame_allocator
+frame_allocator::create(
+        VkBuffer buffer,
+        void* mapped,
+        u64 size,
+        u32 frames_in_flight,
+        const VkPhysicalDeviceLimits& limits,
+        VkDeviceMemory memory,
+        u64 memory_offset) NEX
+{
+    tassert(mapped && "tinyvk::frame_allocator::create - Buffer must be persistently mapped");
+    tassert(frames_in_flight && frames_in_flight <= MAX_FRAMES_IN_FLIGHT && "tinyvk::frame_allocator::create - Invalid number of frames in flight");
+
+    frame_allocator a{};
+    a.buffer = buffer;
+    a.mapped = (u8*)mapped;
+    a.memory = memory;
+    a.memory_offset = memory_offset;
+    a.alignment = tinystd::max(u64(limits.minUniformBufferOffsetAlignment), u64(limits.minStorageBufferOffsetAlignment));
+    a.alignment = tinystd::max(a.alignment, u64(4));
+    a.atom_size = tinystd::max(u64(limits.nonCoherentAtomSize), u64(1));
+    a.frame_count = frames_in_flight;
+
+    // regions start at multiples of both alignments, so flushed ranges rounded to atoms never leave their region
+    const u64 granularity = tinystd::max(a.alignment, memory ? a.atom_size : u64(1));
+    const u64 region_size = (size / frames_in_flight) / granularity * granularity;
+    tassert(region_size && "tinyvk::frame_allocator::create - Buffer too small for the frames in flight");
+    for (u32 f = 0; f < frames_in_flight; ++f) {
+        auto& fr = a.frames[f];
+        fr.begin = fr.head = fr.flushed = f * region_size;
+        fr.end = fr.begin + region_size;
+    }
+    return a;
+}
+
+
+#ifdef TINYVK_USE_VMA
+frame_allocator
+frame_allocator::create(
+        VmaAllocator vma,
+        u64 size,
+        u32 frames_in_flight,
+        const VkPhysicalDeviceLimits& limits,
+        memory_stats* stats) NEX
+{
+    VmaAllocation allocation{};
+    void* mapped{};
+    const tinyvk::buffer b = tinyvk::buffer::create(vma, allocation,
+        {size, buffer_usage_t(BUFFER_UNIFORM | BUFFER_STORAGE), VMA_USAGE_CPU_TO_GPU, VMA_CREATE_MAPPED}, &mapped, stats);
+
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(vma, allocation, &info);
+    VkMemoryPropertyFlags flags{};
+    vmaGetMemoryTypeProperties(vma, info.memoryType, &flags);
+    const bool coherent = flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    frame_allocator a = create(b, mapped, size, frames_in_flight, limits,
+        coherent ? VkDeviceMemory{} : info.deviceMemory, info.offset);
+    a.allocation = allocation;
+    a.stats = stats;
+    return a;
+}
+
+
+void
+frame_allocator::destroy(
+        VmaAllocator vma) NEX
+{
+    tinyvk::buffer::from(buffer).destroy(vma, allocation, stats);
+    *this = {};
+}
+#endif
+
+
+void
+frame_allocator::begin_frame(
+        VkDevice device,
+        u32 f,
+        VkFence fence) NEX
+{
+    tassert(f < frame_count && "tinyvk::frame_allocator::begin_frame - Frame out of range");
+    if (fence)
+        vk_validate(vkWaitForFences(device, 1, &fence, VK_TRUE, DEFAULT_TIMEOUT_NANOS),
+            "tinyvk::frame_allocator::begin_frame - Failed to wait for fence of frame %u", f);
+    frame = f;
+    auto& fr = frames[f];
+    fr.head = fr.flushed = fr.begin;
+}
+
+
+frame_allocator::allocation_t
+frame_allocator::allocate(
+        u64 size) NEX
+{
+    auto& fr = frames[frame];
+    const u64 offset = tinystd::round_up(fr.head, alignment);
+    if (offset + size > fr.end)
+        return {};
+    fr.head = offset + size;
+    return {mapped + offset, u32(offset)};
+}
+
+
+void
+frame_allocator::flush(
+        VkDevice device) NEX
+{
+    auto& fr = frames[frame];
+    if (!memory || fr.flushed == fr.head) {
+        fr.flushed = fr.head;
+        return;
+    }
+
+    VkMappedMemoryRange range{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE};
+    range.memory = memory;
+    range.offset = memory_offset + fr.flushed / atom_size * atom_size;
+    range.size = tinystd::round_up(memory_offset + fr.head, atom_size) - range.offset;
+    vk_validate(vkFlushMappedMemoryRanges(device, 1, &range),
+        "tinyvk::frame_allocator::flush - Failed to flush frame %u", frame);
+    fr.flushed = fr.head;
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_FRAME_ALLOCATOR_CPP
+
+#endif //TINYVK_IMPLEMENTATION
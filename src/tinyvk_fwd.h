@@ -21,6 +21,12 @@ struct queue_family_properties;
 struct queue_availability;
 struct queue_create_info;
 struct queue_collection;
+struct semaphore_submit;
+struct submit_batch;
+struct submit_packet;
+struct submit_thread;
+struct retire_point;
+struct submission_tracker;
 
 /// tinyvk_swapchain.h
 struct swapchain_desc;
@@ -30,6 +36,30 @@ struct swapchain;
 /// tinyvk_command.h
 struct command;
 struct command_pool;
+struct command_ring;
+struct command_bundle_cache;
+struct command_recorder;
+struct barrier_access;
+struct barrier_batch;
+
+/// tinyvk_command_stream.h
+struct command_stream;
+
+/// tinyvk_upload.h
+struct upload_manager;
+
+/// tinyvk_frame_allocator.h
+struct frame_allocator;
+
+/// tinyvk_geometry_buffer.h
+struct tlsf_allocator;
+struct geometry_buffer;
+
+/// tinyvk_memory_stats.h
+struct memory_stats;
+
+/// tinyvk_defragmenter.h
+struct defragmenter;
 
 /// tinyvk_descriptor.h
 struct descriptor;
@@ -59,17 +89,51 @@ struct framebuffer;
 struct buffer_desc;
 struct buffer;
 
+/// tinyvk_aliasing.h
+struct aliased_range;
+
 /// tinyvk_image.h
 struct image_desc;
 struct image_dimensions;
+struct image_alias_desc;
 struct image;
 struct image_view_desc;
 struct image_view;
 
+/// tinyvk_resource_cache.h
+struct sampler_desc;
+struct sampler;
+struct sampler_cache;
+struct image_view_key;
+struct image_view_cache;
+
+/// tinyvk_resource_pool.h
+struct handle_table;
+struct resource_state;
+struct buffer_pool;
+struct image_pool;
+
+/// tinyvk_destruction_queue.h
+struct destruction_queue;
+
 /// tinyvk_pipeline.h
 struct pipeline_layout;
 struct pipeline;
 
+/// tinyvk_downsampler.h
+struct downsampler;
+
+/// tinyvk_render_graph.h
+struct render_graph;
+
+/// tinyvk_queue_scheduler.h
+struct queue_scheduler;
+
+/// tinyvk_profiler.h
+struct profiler;
+struct gpu_scope;
+struct cpu_scope;
+
 }
 
 /// vulkan fwd
@@ -0,0 +1,567 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_GEOMETRY_BUFFER_H
+#define TINYVK_GEOMETRY_BUFFER_H
+
+#include "tinyvk_core.h"
+#ifdef TINYVK_USE_VMA
+#include "tinyvk_buffer.h"
+#endif
+
+namespace tinyvk {
+
+/// Two level segregated fit allocator of offset ranges, allocate and free run in constant time.
+/// Free blocks are kept in lists per size class: the first level is the power of two of the size, the second level
+/// splits it into SL_COUNT linear steps. Sizes are rounded up to granularity, so every offset is a multiple of it.
+struct tlsf_allocator {
+    enum : u32 {
+        SL_BITS = 4,
+        SL_COUNT = 1u << SL_BITS,
+        FL_COUNT = 64,
+        NONE = -1u,
+    };
+
+    struct block_t {
+        u64                     offset{};
+        u64                     size{};
+        u32                     prev{NONE};
+        u32                     next{NONE};
+        u32                     prev_free{NONE};
+        u32                     next_free{NONE};
+        bool                    free{};
+    };
+
+    struct allocation_t {
+        u64                     offset{};
+        u64                     size{};
+        u32                     block{NONE};
+    };
+
+    small_vector<block_t, 64>   blocks{};
+    small_vector<u32, 16>       unused_blocks{};
+    u64                         fl_bitmap{};
+    u32                         sl_bitmap[FL_COUNT]{};
+    u32                         free_heads[FL_COUNT][SL_COUNT]{};
+    u64                         capacity{};
+    u64                         granularity{};
+    u64                         used_bytes{};
+
+    static tlsf_allocator create(
+            u64                         capacity,
+            u64                         granularity = 16) NEX;
+
+    /// Range of at least size bytes, block is NONE when no free range is large enough
+    NDC allocation_t    allocate(
+            u64                         size) NEX;
+
+    void                free(
+            u32                         block) NEX;
+
+    /// Move the allocation of block to the lowest free range that ends before it starts (so the two never overlap).
+    /// Returns the new allocation (block is NONE when there is none), the old one stays allocated until it is freed
+    NDC allocation_t    relocate(
+            u32                         block) NEX;
+
+    NDC u64             used() const NEX { return used_bytes; }
+
+    NDC u64             largest_free() const NEX;
+
+private:
+    NDC u32             find_free(
+            u64                         size) const NEX;
+
+    NDC allocation_t    take(
+            u32                         block,
+            u64                         size) NEX;
+
+    void                insert_free(
+            u32                         block) NEX;
+
+    void                remove_free(
+            u32                         block) NEX;
+
+    NDC u32             new_block() NEX;
+
+    void                release_block(
+            u32                         block) NEX;
+};
+
+
+/// Large vertex/index buffer shared by many meshes, so they can be drawn with a single bind (and multi draw indirect).
+/// Meshes get offset ranges from a tlsf_allocator, data is written with transfers (e.g. upload_manager).
+///     - free is deferred, ranges are reused frames_in_flight calls to next_frame later when the device is done with them
+///     - compact moves allocations from the end of the buffer into free ranges below them with one vkCmdCopyBuffer,
+///       the caller updates the offsets of the moved meshes (draws recorded after the copy and a barrier use them)
+/// Not thread safe.
+struct geometry_buffer {
+    struct retired_t {
+        u32                     block{};
+        u64                     frame{};
+    };
+
+    struct move_t {
+        u32                     old_block{};
+        tlsf_allocator::allocation_t allocation{};
+    };
+
+    VkBuffer                    buffer{};
+    tlsf_allocator              allocator{};
+    small_vector<retired_t, 32> retired{};
+    u64                         frame{};
+    u32                         frame_count{};
+#ifdef TINYVK_USE_VMA
+    VmaAllocation               allocation{};
+    memory_stats*               stats{};
+#endif
+
+    /// Suballocate buffer of size bytes
+    static geometry_buffer create(
+            VkBuffer                        buffer,
+            u64                             size,
+            u32                             frames_in_flight,
+            u64                             granularity = 16) NEX;
+
+#ifdef TINYVK_USE_VMA
+    /// Suballocate a device local vertex, index and indirect buffer of size bytes owned by the geometry buffer,
+    /// stats (optional) tracks it as MEMORY_CATEGORY_BUFFER until destroy
+    static geometry_buffer create(
+            VmaAllocator                    vma,
+            u64                             size,
+            u32                             frames_in_flight,
+            buffer_usage_t                  extra_usage = {},
+            u64                             granularity = 16,
+            memory_stats*                   stats = {}) NEX;
+
+    /// Destroy a geometry buffer created with its own buffer
+    void                destroy(
+            VmaAllocator                    vma) NEX;
+#endif
+
+    NDC tlsf_allocator::allocation_t allocate(
+            u64                             size) NEX;
+
+    /// The range is reused once the device is done with the current frame
+    void                free(
+            const tlsf_allocator::allocation_t& range) NEX;
+
+    /// Start a new frame, frees the ranges freed frames_in_flight frames ago
+    void                next_frame() NEX;
+
+    /// Move up to max_bytes of allocations to lower free ranges and record the copies into cmd.
+    /// Returns the number of moves written to moves, their old ranges are freed like free
+    NDC u32             compact(
+            VkCommandBuffer                 cmd,
+            u64                             max_bytes,
+            span<move_t>                    moves) NEX;
+
+private:
+    NDC bool            is_retired(
+            u32                             block) const NEX;
+};
+
+}
+
+#endif //TINYVK_GEOMETRY_BUFFER_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_GEOMETRY_BUFFER_CPP
+#define TINYVK_GEOMETRY_BUFFER_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+namespace tlsf_impl {
+
+inline u32 lowest_bit(u64 v)
+{
+    u32 i = 0;
+    while (!(v & 1ull)) { v >>= 1; ++i; }
+    return i;
+}
+
+inline u32 highest_bit(u64 v)
+{
+    u32 i = 0;
+    while (v >>= 1) ++i;
+    return i;
+}
+
+/// First and second level of the size class containing size
+inline void mapping(u64 size, u32& fl, u32& sl)
+{
+    if (size < tlsf_allocator::SL_COUNT) {
+        fl = 0;
+        sl = u32(size);
+        return;
+    }
+    const u32 msb = highest_bit(size);
+    fl = msb - tlsf_allocator::SL_BITS + 1;
+    sl = u32(size >> (msb - tlsf_allocator::SL_BITS)) ^ tlsf_allocator::SL_COUNT;
+}
+
+}
+
+//region tlsf_allocator
+
+tlsf_allocator
+tlsf_allocator::create(
+        u64 capacity,
+        u64 granularity) NEX
+{
+    tlsf_allocator a{};
+    a.granularity = tinystd::max(granularity, u64(1));
+    a.capacity = capacity / a.granularity * a.granularity;
+    for (auto& fl: a.free_heads)
+        for (auto& head: fl)
+            head = NONE;
+    if (!a.capacity)
+        return a;
+
+    const u32 b = a.new_block();
+    a.blocks[b].size = a.capacity;
+    a.blocks[b].free = true;
+    a.insert_free(b);
+    return a;
+}
+
+
+tlsf_allocator::allocation_t
+tlsf_allocator::allocate(
+        u64 size) NEX
+{
+    size = tinystd::round_up(tinystd::max(size, u64(1)), granularity);
+    const u32 b = find_free(size);
+    if (b == NONE)
+        return {};
+    return take(b, size);
+}
+
+
+void
+tlsf_allocator::free(
+        u32 block) NEX
+{
+    tassert(block < blocks.size() && !blocks[block].free && "tinyvk::tlsf_allocator::free - Block is not allocated");
+    used_bytes -= blocks[block].size;
+    blocks[block].free = true;
+
+    // merge with the free neighbours, the lower block absorbs the higher one
+    const u32 next = blocks[block].next;
+    if (next != NONE && blocks[next].free) {
+        remove_free(next);
+        blocks[block].size += blocks[next].size;
+        blocks[block].next = blocks[next].next;
+        if (blocks[block].next != NONE)
+            blocks[blocks[block].next].prev = block;
+        release_block(next);
+    }
+    const u32 prev = blocks[block].prev;
+    if (prev != NONE && blocks[prev].free) {
+        remove_free(prev);
+        blocks[prev].size += blocks[block].size;
+        blocks[prev].next = blocks[block].next;
+        if (blocks[prev].next != NONE)
+            blocks[blocks[prev].next].prev = prev;
+        release_block(block);
+        block = prev;
+    }
+    insert_free(block);
+}
+
+
+tlsf_allocator::allocation_t
+tlsf_allocator::relocate(
+        u32 block) NEX
+{
+    tassert(block < blocks.size() && !blocks[block].free && "tinyvk::tlsf_allocator::relocate - Block is not allocated");
+    const u64 size = blocks[block].size;
+    const u64 limit = blocks[block].offset;
+    // block 0 always starts at offset 0, free ranges are found in address order
+    for (u32 b = 0; b != NONE && blocks[b].offset + size <= limit; b = blocks[b].next) {
+        if (blocks[b].free && blocks[b].size >= size)
+            return take(b, size);
+    }
+    return {};
+}
+
+
+u64
+tlsf_allocator::largest_free() const NEX
+{
+    if (!fl_bitmap)
+        return 0;
+    const u32 fl = tlsf_impl::highest_bit(fl_bitmap);
+    const u32 sl = tlsf_impl::highest_bit(sl_bitmap[fl]);
+    u64 largest = 0;
+    for (u32 b = free_heads[fl][sl]; b != NONE; b = blocks[b].next_free)
+        largest = tinystd::max(largest, blocks[b].size);
+    return largest;
+}
+
+
+u32
+tlsf_allocator::find_free(
+        u64 size) const NEX
+{
+    // round up to the next size class so every block of the class found is large enough
+    if (size >= SL_COUNT)
+        size += (1ull << (tlsf_impl::highest_bit(size) - SL_BITS)) - 1;
+    u32 fl{}, sl{};
+    tlsf_impl::mapping(size, fl, sl);
+    if (fl >= FL_COUNT)
+        return NONE;
+
+    u32 sl_map = sl_bitmap[fl] & (-1u << sl);
+    if (!sl_map) {
+        const u64 fl_map = fl + 1 < FL_COUNT ? fl_bitmap & (-1ull << (fl + 1)) : 0;
+        if (!fl_map)
+            return NONE;
+        fl = tlsf_impl::lowest_bit(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    return free_heads[fl][tlsf_impl::lowest_bit(sl_map)];
+}
+
+
+tlsf_allocator::allocation_t
+tlsf_allocator::take(
+        u32 b,
+        u64 size) NEX
+{
+    remove_free(b);
+    if (blocks[b].size - size >= granularity) {
+        // the rest of the block stays free
+        const u32 r = new_block();
+        auto& rest = blocks[r];
+        auto& taken = blocks[b];
+        rest.offset = taken.offset + size;
+        rest.size = taken.size - size;
+        rest.prev = b;
+        rest.next = taken.next;
+        rest.free = true;
+        if (rest.next != NONE)
+            blocks[rest.next].prev = r;
+        taken.next = r;
+        taken.size = size;
+        insert_free(r);
+    }
+    blocks[b].free = false;
+    used_bytes += blocks[b].size;
+    return {blocks[b].offset, blocks[b].size, b};
+}
+
+
+void
+tlsf_allocator::insert_free(
+        u32 b) NEX
+{
+    u32 fl{}, sl{};
+    tlsf_impl::mapping(blocks[b].size, fl, sl);
+    auto& head = free_heads[fl][sl];
+    blocks[b].prev_free = NONE;
+    blocks[b].next_free = head;
+    if (head != NONE)
+        blocks[head].prev_free = b;
+    head = b;
+    fl_bitmap |= 1ull << fl;
+    sl_bitmap[fl] |= 1u << sl;
+}
+
+
+void
+tlsf_allocator::remove_free(
+        u32 b) NEX
+{
+    u32 fl{}, sl{};
+    tlsf_impl::mapping(blocks[b].size, fl, sl);
+    auto& block = blocks[b];
+    if (block.prev_free != NONE)
+        blocks[block.prev_free].next_free = block.next_free;
+    else
+        free_heads[fl][sl] = block.next_free;
+    if (block.next_free != NONE)
+        blocks[block.next_free].prev_free = block.prev_free;
+    block.prev_free = block.next_free = NONE;
+
+    if (free_heads[fl][sl] == NONE) {
+        sl_bitmap[fl] &= ~(1u << sl);
+        if (!sl_bitmap[fl])
+            fl_bitmap &= ~(1ull << fl);
+    }
+}
+
+
+u32
+tlsf_allocator::new_block() NEX
+{
+    u32 b{};
+    if (!unused_blocks.empty()) {
+        b = unused_blocks.pop_back();
+    }
+    else {
+        b = u32(blocks.size());
+        blocks.push_back({});
+    }
+    blocks[b] = {};
+    return b;
+}
+
+
+void
+tlsf_allocator::release_block(
+        u32 b) NEX
+{
+    blocks[b] = {};
+    unused_blocks.push_back(b);
+}
+
+//endregion
+
+//region geometry_buffer
+
+geometry_buffer
+geometry_buffer::create(
+        VkBuffer buffer,
+        u64 size,
+        u32 frames_in_flight,
+        u64 granularity) NEX
+{
+    geometry_buffer g{};
+    g.buffer = buffer;
+    g.allocator = tlsf_allocator::create(size, granularity);
+    g.frame_count = frames_in_flight;
+    return g;
+}
+
+
+#ifdef TINYVK_USE_VMA
+geometry_buffer
+geometry_buffer::create(
+        VmaAllocator vma,
+        u64 size,
+        u32 frames_in_flight,
+        buffer_usage_t extra_usage,
+        u64 granularity,
+        memory_stats* stats) NEX
+{
+    VmaAllocation allocation{};
+    const auto usage = buffer_usage_t(BUFFER_VERTEX | BUFFER_INDEX | BUFFER_INDIRECT | BUFFER_TRANSFER_SRC | BUFFER_TRANSFER_DST | extra_usage);
+    const tinyvk::buffer b = tinyvk::buffer::create(vma, allocation, {size, usage, VMA_USAGE_GPU_ONLY}, {}, stats);
+    geometry_buffer g = create(b, size, frames_in_flight, granularity);
+    g.allocation = allocation;
+    g.stats = stats;
+    return g;
+}
+
+
+void
+geometry_buffer::destroy(
+        VmaAllocator vma) NEX
+{
+    tinyvk::buffer::from(buffer).destroy(vma, allocation, stats);
+    buffer = {};
+    allocation = {};
+    stats = {};
+    allocator = {};
+    retired.clear();
+}
+#endif
+
+
+tlsf_allocator::allocation_t
+geometry_buffer::allocate(
+        u64 size) NEX
+{
+    return allocator.allocate(size);
+}
+
+
+void
+geometry_buffer::free(
+        const tlsf_allocator::allocation_t& range) NEX
+{
+    if (range.block != tlsf_allocator::NONE)
+        retired.push_back({range.block, frame});
+}
+
+
+void
+geometry_buffer::next_frame() NEX
+{
+    ++frame;
+    for (u32 i = 0; i < retired.size();) {
+        if (retired[i].frame + frame_count > frame) {
+            ++i;
+            continue;
+        }
+        allocator.free(retired[i].block);
+        retired[i] = retired.back();
+        retired.pop_back();
+    }
+}
+
+
+u32
+geometry_buffer::compact(
+        VkCommandBuffer cmd,
+        u64 max_bytes,
+        span<move_t> moves) NEX
+{
+    auto& blocks = allocator.blocks;
+    if (blocks.empty())
+        return 0;
+
+    u32 last = 0;
+    while (blocks[last].next != tlsf_allocator::NONE)
+        last = blocks[last].next;
+
+    small_vector<VkBufferCopy, 32> regions{};
+    u32 count = 0;
+    u64 moved = 0;
+    // highest allocations first, they are the ones keeping the free space fragmented
+    for (u32 b = last; b != tlsf_allocator::NONE && count < moves.size();) {
+        const u32 prev = blocks[b].prev;
+        const u64 size = blocks[b].size;
+        // ranges moved to in this call are written by the same copy, they cannot be its source as well
+        bool moved_here = false;
+        for (u32 i = 0; i < count; ++i)
+            moved_here |= moves[i].allocation.block == b;
+        if (!blocks[b].free && !moved_here && !is_retired(b) && moved + size <= max_bytes) {
+            const auto a = allocator.relocate(b);
+            if (a.block != tlsf_allocator::NONE) {
+                regions.push_back({blocks[b].offset, a.offset, size});
+                moves[count++] = {b, a};
+                retired.push_back({b, frame});
+                moved += size;
+            }
+        }
+        b = prev;
+    }
+
+    if (!regions.empty())
+        vkCmdCopyBuffer(cmd, buffer, buffer, u32(regions.size()), regions.data());
+    return count;
+}
+
+
+bool
+geometry_buffer::is_retired(
+        u32 block) const NEX
+{
+    for (auto& r: retired)
+        if (r.block == block)
+            return true;
+    return false;
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_GEOMETRY_BUFFER_CPP
+
+#endif //TINYVK_IMPLEMENTATION
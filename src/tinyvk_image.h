@@ -8,6 +8,8 @@
 #include "tinyvk_core.h"
 #ifdef TINYVK_USE_VMA
 #include "vk_mem_alloc.h"
+#include "tinyvk_memory_stats.h"
+#include "tinyvk_aliasing.h"
 #endif
 
 namespace tinyvk {
@@ -42,6 +44,16 @@ struct image_desc {
     image_usage_t   usage{IMAGE_COLOR};
     sample_count_t  samples{SAMPLE_COUNT_1};
     bool            cubemap{};
+    span<const u32> queue_families{};
+};
+
+
+/// An image placed in a shared allocation by image::create_aliased, it is alive from pass first to pass last
+/// (any ordering works, e.g. render graph stages)
+struct image_alias_desc {
+    image_desc      desc{};
+    u32             first{};
+    u32             last{};
 };
 
 
@@ -63,6 +75,12 @@ struct image_view : type_wrapper<image_view, VkImageView> {
             const image_dimensions&     dim,
             vk_alloc                    alloc = {}) NEX;
 
+    /// The create info create uses for a view of image
+    static VkImageViewCreateInfo    create_info(
+            image_view_desc             desc,
+            VkImage                     image,
+            const image_dimensions&     dim) NEX;
+
     void                            destroy(
             VkDevice                    device,
             vk_alloc                    alloc = {}) NEX;
@@ -89,18 +107,45 @@ struct image_dimensions {
 
 struct image : type_wrapper<image, VkImage> {
 
+    /// stats (optional) tracks the allocation as MEMORY_CATEGORY_IMAGE until destroy releases it
     static image                    create(
             VmaAllocator                vma,
             VmaAllocation&              vma_alloc,
             image_desc                  desc,
             image_dimensions*           dim = {},
+            memory_stats*               stats = {},
             vk_alloc                    alloc = {}) NEX;
 
     void                            destroy(
             VmaAllocator                vma,
             VmaAllocation               vma_alloc,
+            memory_stats*               stats = {},
             vk_alloc                    alloc = {}) NEX;
 
+    /// Create images in one allocation, images whose lifetimes do not overlap share memory. An image placed over
+    /// another one has undefined contents, transition it from VK_IMAGE_LAYOUT_UNDEFINED at the start of its lifetime
+    /// after the last use of the previous one. offsets (optional) receives the offset of every image
+    static void                     create_aliased(
+            VmaAllocator                vma,
+            VkDevice                    device,
+            VmaAllocation&              vma_alloc,
+            span<const image_alias_desc> descs,
+            span<image>                 images,
+            span<VkDeviceSize>          offsets = {},
+            vk_alloc                    alloc = {}) NEX;
+
+    /// Destroy images created with create_aliased and free their allocation
+    static void                     destroy_aliased(
+            VmaAllocator                vma,
+            VkDevice                    device,
+            VmaAllocation               vma_alloc,
+            span<image>                 images,
+            vk_alloc                    alloc = {}) NEX;
+
+    /// The create info create uses for desc, desc.queue_families must outlive it
+    static VkImageCreateInfo        create_info(
+            const image_desc&           desc) NEX;
+
     image_view                      create_view(
             VkDevice                    device,
             image_view_desc             desc,
@@ -126,6 +171,8 @@ struct image : type_wrapper<image, VkImage> {
 #ifndef TINYVK_IMAGE_CPP
 #define TINYVK_IMAGE_CPP
 
+#include "tinystd_algorithm.h"
+
 namespace tinyvk {
 
 //region image
@@ -138,6 +185,7 @@ image::create(
         VmaAllocation& vma_alloc,
         image_desc desc,
         image_dimensions* dim,
+        memory_stats* stats,
         vk_alloc alloc) NEX
 {
     if (desc.size.width > 1 && desc.size.height > 1 && desc.size.depth > 1 && desc.size.array_layers > 1) {
@@ -147,6 +195,38 @@ image::create(
 
     image im{};
 
+    const VkImageCreateInfo im_info = create_info(desc);
+
+    VmaAllocationCreateInfo info{};
+    // TODO: CPU-visible images?
+    // transient attachments can live in on-tile memory, without lazily allocated memory they fall back to device memory
+    info.usage = (desc.usage & IMAGE_TRANSIENT) ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED : VMA_MEMORY_USAGE_GPU_ONLY;
+    VkResult r = vmaCreateImage(vma, &im_info, &info, &im.vk, &vma_alloc, nullptr);
+    if (r == VK_ERROR_FEATURE_NOT_PRESENT && info.usage == VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED) {
+        info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        r = vmaCreateImage(vma, &im_info, &info, &im.vk, &vma_alloc, nullptr);
+    }
+    vk_validate(r, "tinyvk::image::create - failed to create image");
+    if (stats)
+        stats->track(vma, MEMORY_CATEGORY_IMAGE, vma_alloc);
+
+    if (dim) {
+        dim->format = desc.format;
+        dim->width = desc.size.width;
+        dim->height = desc.size.height;
+        dim->depth = desc.size.depth;
+        dim->array_layers = desc.size.array_layers;
+        dim->mip_levels = desc.size.mip_levels;
+        dim->is_cubemap = desc.cubemap;
+    }
+    return im;
+}
+
+
+VkImageCreateInfo
+image::create_info(
+        const image_desc& desc) NEX
+{
     const VkImageType image_type = desc.size.height == 1
             ? VK_IMAGE_TYPE_1D
             : (desc.size.depth == 1 ? VK_IMAGE_TYPE_2D : VK_IMAGE_TYPE_3D);
@@ -163,7 +243,9 @@ image::create(
     im_info.samples = VkSampleCountFlagBits(desc.samples);
     // TODO: Handle non-optimal images?
     im_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-    im_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    im_info.sharingMode = VkSharingMode(!desc.queue_families.empty());
+    im_info.queueFamilyIndexCount = u32(desc.queue_families.size());
+    im_info.pQueueFamilyIndices = desc.queue_families.data();
     // TODO: Use initial layout for images?
     im_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
@@ -171,34 +253,85 @@ image::create(
         im_info.flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
     if (desc.size.array_layers > 1)
         im_info.flags |= VK_IMAGE_CREATE_2D_ARRAY_COMPATIBLE_BIT_KHR;
+    return im_info;
+}
+
+
+void
+image::destroy(
+        VmaAllocator vma,
+        VmaAllocation vma_alloc,
+        memory_stats* stats,
+        vk_alloc alloc) NEX
+{
+    if (stats)
+        stats->release(vma, MEMORY_CATEGORY_IMAGE, vma_alloc);
+    vmaDestroyImage(vma, vk, vma_alloc);
+    vk = {};
+}
+
+
+void
+image::create_aliased(
+        VmaAllocator vma,
+        VkDevice device,
+        VmaAllocation& vma_alloc,
+        span<const image_alias_desc> descs,
+        span<image> images,
+        span<VkDeviceSize> offsets,
+        vk_alloc alloc) NEX
+{
+    tassert(images.size() >= descs.size() && "tinyvk::image::create_aliased - Not enough images");
+    tassert((offsets.empty() || offsets.size() >= descs.size()) && "tinyvk::image::create_aliased - Not enough offsets");
+
+    small_vector<aliased_range, 16> ranges{};
+    small_vector<VkDeviceSize, 16> placed{};
+    bool transient = true;
+    for (u32 i = 0; i < descs.size(); ++i) {
+        const VkImageCreateInfo im_info = create_info(descs[i].desc);
+        vk_validate(vkCreateImage(device, &im_info, alloc, &images[i].vk),
+            "tinyvk::image::create_aliased - failed to create image %u", i);
+        aliased_range r{{}, descs[i].first, descs[i].last};
+        vkGetImageMemoryRequirements(device, images[i], &r.requirements);
+        ranges.push_back(r);
+        placed.push_back(0);
+        transient &= (descs[i].desc.usage & IMAGE_TRANSIENT) != 0;
+    }
+
+    const VkMemoryRequirements total = place_aliased(ranges, placed);
+    tassert((descs.empty() || total.memoryTypeBits) && "tinyvk::image::create_aliased - Images have no memory type in common");
 
     VmaAllocationCreateInfo info{};
-    // TODO: CPU-visible images?
-    info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-    vk_validate(vmaCreateImage(vma, &im_info, &info, &im.vk, &vma_alloc, nullptr),
-        "tinyvk::image::create - failed to create image");
+    info.usage = transient ? VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED : VMA_MEMORY_USAGE_GPU_ONLY;
+    VkResult r = vmaAllocateMemory(vma, &total, &info, &vma_alloc, nullptr);
+    if (r == VK_ERROR_FEATURE_NOT_PRESENT && transient) {
+        info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        r = vmaAllocateMemory(vma, &total, &info, &vma_alloc, nullptr);
+    }
+    vk_validate(r, "tinyvk::image::create_aliased - failed to allocate memory");
 
-    if (dim) {
-        dim->format = desc.format;
-        dim->width = desc.size.width;
-        dim->height = desc.size.height;
-        dim->depth = desc.size.depth;
-        dim->array_layers = desc.size.array_layers;
-        dim->mip_levels = desc.size.mip_levels;
-        dim->is_cubemap = desc.cubemap;
+    for (u32 i = 0; i < descs.size(); ++i) {
+        vk_validate(vmaBindImageMemory2(vma, vma_alloc, placed[i], images[i], nullptr),
+            "tinyvk::image::create_aliased - failed to bind image %u", i);
+        if (!offsets.empty())
+            offsets[i] = placed[i];
     }
-    return im;
 }
 
 
 void
-image::destroy(
+image::destroy_aliased(
         VmaAllocator vma,
+        VkDevice device,
         VmaAllocation vma_alloc,
+        span<image> images,
         vk_alloc alloc) NEX
 {
-    vmaDestroyImage(vma, vk, vma_alloc);
-    vk = {};
+    for (auto& im: images) {
+        vkDestroyImage(device, im, alloc);
+        im.vk = {};
+    }
+    vmaFreeMemory(vma, vma_alloc);
 }
 
 #else
@@ -261,7 +394,20 @@ image_view::create(
         vk_alloc alloc) NEX
 {
     image_view v;
+    const VkImageViewCreateInfo view_info = create_info(desc, image, dim);
+    vk_validate(vkCreateImageView(device, &view_info, alloc, &v.vk),
+              "tinyvk::image::create_view - failed to create image view");
+
+    return v;
+}
+
 
+VkImageViewCreateInfo
+image_view::create_info(
+        image_view_desc desc,
+        VkImage image,
+        const image_dimensions& dim) NEX
+{
     const VkImageType image_type = dim.height == 1
             ? VK_IMAGE_TYPE_1D
             : (dim.depth == 1 ? VK_IMAGE_TYPE_2D : VK_IMAGE_TYPE_3D);
@@ -276,11 +422,7 @@ image_view::create(
     view_info.subresourceRange.levelCount = desc.level_count;
     view_info.subresourceRange.baseArrayLayer = desc.array_layer;
     view_info.subresourceRange.layerCount = desc.layer_count;
-
-    vk_validate(vkCreateImageView(device, &view_info, alloc, &v.vk),
-              "tinyvk::image::create_view - failed to create image view");
-
-    return v;
+    return view_info;
 }
 
 
@@ -0,0 +1,296 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_MEMORY_STATS_H
+#define TINYVK_MEMORY_STATS_H
+
+#include "tinyvk_core.h"
+#ifdef TINYVK_USE_VMA
+#include "vk_mem_alloc.h"
+#endif
+
+namespace tinyvk {
+
+enum memory_category_t: u32 {
+    MEMORY_CATEGORY_BUFFER,
+    MEMORY_CATEGORY_IMAGE,
+    MEMORY_CATEGORY_STAGING,
+    MEMORY_CATEGORY_COUNT,
+};
+
+
+/// Memory telemetry: per heap budget and usage, allocation counts and sizes per category, and high-water marks.
+/// Heap numbers come from vmaGetBudget, which reads VK_EXT_memory_budget when the allocator was created with it
+/// (device::create enables it when the extension is in the device extensions) and estimates them otherwise.
+/// Categories are counted by buffer::create and image::create (released by destroy) when they are given the stats,
+/// upload_manager, frame_allocator and geometry_buffer created with it track their own buffer (upload_manager rings
+/// are STAGING, the others BUFFER). Other allocations are counted by the caller with track/release.
+/// snapshot is cheap enough to call every frame and returns everything by value, write_json dumps one for tooling.
+/// Not thread safe, track and release from the thread that creates and destroys resources or guard the calls.
+struct memory_stats {
+    struct heap_t {
+        u64                     budget{};
+        u64                     usage{};
+        u64                     block_bytes{};
+        u64                     allocation_bytes{};
+        u64                     peak_usage{};
+        ibool                   device_local{};
+    };
+
+    struct category_t {
+        u64                     count{};
+        u64                     bytes{};
+        u64                     peak_bytes{};
+    };
+
+    struct snapshot_t {
+        u64                     frame{};
+        u32                     heap_count{};
+        heap_t                  heaps[VK_MAX_MEMORY_HEAPS]{};
+        category_t              categories[MEMORY_CATEGORY_COUNT]{};
+
+        /// True if the usage of any heap is above fraction of its budget
+        NDC bool            over_budget(
+                float                       fraction = 1.0f) const NEX;
+
+        /// Budget left on device local heaps, 0 for heaps that are over budget
+        NDC u64             device_local_available() const NEX;
+
+        /// Write the snapshot as JSON into dst (always null terminated), returns the length it needs
+        u64                 format_json(
+                char*                       dst,
+                u64                         size) const NEX;
+
+        /// Write the snapshot as JSON, returns false if the file could not be written
+        bool                write_json(
+                const char*                 path) const NEX;
+    };
+
+    category_t                  categories[MEMORY_CATEGORY_COUNT]{};
+    u64                         heap_peaks[VK_MAX_MEMORY_HEAPS]{};
+    u64                         frame{};
+
+    void                track(
+            memory_category_t               category,
+            u64                             bytes) NEX;
+
+    void                release(
+            memory_category_t               category,
+            u64                             bytes) NEX;
+
+    /// Snapshot of the given heaps (their peak_usage is ignored) and the categories, updates the high-water marks
+    /// and advances the frame
+    NDC snapshot_t      snapshot(
+            span<const heap_t>              heaps) NEX;
+
+#ifdef TINYVK_USE_VMA
+    /// Track the size of a VMA allocation
+    void                track(
+            VmaAllocator                    vma,
+            memory_category_t               category,
+            VmaAllocation                   allocation) NEX;
+
+    /// Release the size of a VMA allocation, call before destroying it
+    void                release(
+            VmaAllocator                    vma,
+            memory_category_t               category,
+            VmaAllocation                   allocation) NEX;
+
+    /// Snapshot the heaps of vma, also sets the VMA frame index so the budget is refreshed once per frame
+    NDC snapshot_t      snapshot(
+            VmaAllocator                    vma) NEX;
+#endif
+};
+
+}
+
+#endif //TINYVK_MEMORY_STATS_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_MEMORY_STATS_CPP
+#define TINYVK_MEMORY_STATS_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+//region memory_stats
+
+void
+memory_stats::track(
+        memory_category_t category,
+        u64 bytes) NEX
+{
+    tassert(category < MEMORY_CATEGORY_COUNT && "tinyvk::memory_stats::track - Invalid category");
+    auto& c = categories[category];
+    ++c.count;
+    c.bytes += bytes;
+    c.peak_bytes = tinystd::max(c.peak_bytes, c.bytes);
+}
+
+
+void
+memory_stats::release(
+        memory_category_t category,
+        u64 bytes) NEX
+{
+    tassert(category < MEMORY_CATEGORY_COUNT && "tinyvk::memory_stats::release - Invalid category");
+    auto& c = categories[category];
+    tassert(c.count && c.bytes >= bytes && "tinyvk::memory_stats::release - Released more than was tracked");
+    --c.count;
+    c.bytes -= bytes;
+}
+
+
+memory_stats::snapshot_t
+memory_stats::snapshot(
+        span<const heap_t> heaps) NEX
+{
+    tassert(heaps.size() <= VK_MAX_MEMORY_HEAPS && "tinyvk::memory_stats::snapshot - Too many heaps");
+    snapshot_t s{};
+    s.frame = frame++;
+    s.heap_count = u32(heaps.size());
+    for (u32 h = 0; h < s.heap_count; ++h) {
+        heap_peaks[h] = tinystd::max(heap_peaks[h], heaps[h].usage);
+        s.heaps[h] = heaps[h];
+        s.heaps[h].peak_usage = heap_peaks[h];
+    }
+    tinystd::memcpy(s.categories, categories, sizeof(categories));
+    return s;
+}
+
+
+#ifdef TINYVK_USE_VMA
+void
+memory_stats::track(
+        VmaAllocator vma,
+        memory_category_t category,
+        VmaAllocation allocation) NEX
+{
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(vma, allocation, &info);
+    track(category, info.size);
+}
+
+
+void
+memory_stats::release(
+        VmaAllocator vma,
+        memory_category_t category,
+        VmaAllocation allocation) NEX
+{
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(vma, allocation, &info);
+    release(category, info.size);
+}
+
+
+memory_stats::snapshot_t
+memory_stats::snapshot(
+        VmaAllocator vma) NEX
+{
+    vmaSetCurrentFrameIndex(vma, u32(frame));
+
+    const VkPhysicalDeviceMemoryProperties* props{};
+    vmaGetMemoryProperties(vma, &props);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+    vmaGetBudget(vma, budgets);
+
+    heap_t heaps[VK_MAX_MEMORY_HEAPS]{};
+    for (u32 h = 0; h < props->memoryHeapCount; ++h) {
+        heaps[h].budget = budgets[h].budget;
+        heaps[h].usage = budgets[h].usage;
+        heaps[h].block_bytes = budgets[h].blockBytes;
+        heaps[h].allocation_bytes = budgets[h].allocationBytes;
+        heaps[h].device_local = (props->memoryHeaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+    return snapshot({heaps, props->memoryHeapCount});
+}
+#endif
+
+
+bool
+memory_stats::snapshot_t::over_budget(
+        float fraction) const NEX
+{
+    for (u32 h = 0; h < heap_count; ++h) {
+        if (double(heaps[h].usage) > double(heaps[h].budget) * double(fraction))
+            return true;
+    }
+    return false;
+}
+
+
+u64
+memory_stats::snapshot_t::device_local_available() const NEX
+{
+    u64 available = 0;
+    for (u32 h = 0; h < heap_count; ++h) {
+        if (heaps[h].device_local && heaps[h].budget > heaps[h].usage)
+            available += heaps[h].budget - heaps[h].usage;
+    }
+    return available;
+}
+
+
+u64
+memory_stats::snapshot_t::format_json(
+        char* dst,
+        u64 size) const NEX
+{
+    static const char* const CATEGORY_NAMES[MEMORY_CATEGORY_COUNT]{"buffer", "image", "staging"};
+    char buf[256]{};
+    u64 length = 0;
+    auto append = [&](const char* s) {
+        for (; *s; ++s, ++length) {
+            if (length + 1 < size) dst[length] = *s;
+        }
+    };
+
+    tinystd::format(buf, sizeof(buf), "{\"frame\":%llu,\"heaps\":[", (unsigned long long)frame);
+    append(buf);
+    for (u32 h = 0; h < heap_count; ++h) {
+        const auto& heap = heaps[h];
+        tinystd::format(buf, sizeof(buf), "%s{\"budget\":%llu,\"usage\":%llu,\"block_bytes\":%llu,"
+            "\"allocation_bytes\":%llu,\"peak_usage\":%llu,\"device_local\":%s}", h ? "," : "",
+            (unsigned long long)heap.budget, (unsigned long long)heap.usage, (unsigned long long)heap.block_bytes,
+            (unsigned long long)heap.allocation_bytes, (unsigned long long)heap.peak_usage,
+            heap.device_local ? "true" : "false");
+        append(buf);
+    }
+    append("],\"categories\":{");
+    for (u32 c = 0; c < MEMORY_CATEGORY_COUNT; ++c) {
+        const auto& cat = categories[c];
+        tinystd::format(buf, sizeof(buf), "%s\"%s\":{\"count\":%llu,\"bytes\":%llu,\"peak_bytes\":%llu}",
+            c ? "," : "", CATEGORY_NAMES[c], (unsigned long long)cat.count, (unsigned long long)cat.bytes,
+            (unsigned long long)cat.peak_bytes);
+        append(buf);
+    }
+    append("}}\n");
+    if (size)
+        dst[tinystd::min(length, size - 1)] = 0;
+    return length;
+}
+
+
+bool
+memory_stats::snapshot_t::write_json(
+        const char* path) const NEX
+{
+    const u64 size = format_json(nullptr, 0) + 1;
+    char* json = (char*)tinystd::malloc(size);
+    format_json(json, size);
+    const bool ok = tinystd::write_file(path, json, size - 1);
+    tinystd::free(json);
+    return ok;
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_MEMORY_STATS_CPP
+
+#endif //TINYVK_IMPLEMENTATION
@@ -22,6 +22,49 @@ enum topology_t {
     TOPOLOGY_LINE_STRIP_WITH_ADJACENCY = 7,
     TOPOLOGY_TRIANGLE_LIST_WITH_ADJACENCY = 8,
     TOPOLOGY_TRIANGLE_STRIP_WITH_ADJACENCY = 9,
+    TOPOLOGY_PATCH_LIST = 10,
+};
+
+
+/// see VkDynamicState for details
+enum dynamic_state_t : u32 {
+    DYNAMIC_VIEWPORT = 0,
+    DYNAMIC_SCISSOR = 1,
+    DYNAMIC_LINE_WIDTH = 2,
+    DYNAMIC_DEPTH_BIAS = 3,
+    DYNAMIC_BLEND_CONSTANTS = 4,
+    DYNAMIC_DEPTH_BOUNDS = 5,
+    DYNAMIC_STENCIL_COMPARE_MASK = 6,
+    DYNAMIC_STENCIL_WRITE_MASK = 7,
+    DYNAMIC_STENCIL_REFERENCE = 8,
+    /// VK_EXT_extended_dynamic_state (core in 1.3)
+    DYNAMIC_CULL_MODE = 1000267000,
+    DYNAMIC_FRONT_FACE = 1000267001,
+    DYNAMIC_PRIMITIVE_TOPOLOGY = 1000267002,
+    DYNAMIC_VIEWPORT_WITH_COUNT = 1000267003,
+    DYNAMIC_SCISSOR_WITH_COUNT = 1000267004,
+    DYNAMIC_VERTEX_INPUT_BINDING_STRIDE = 1000267005,
+    DYNAMIC_DEPTH_TEST_ENABLE = 1000267006,
+    DYNAMIC_DEPTH_WRITE_ENABLE = 1000267007,
+    DYNAMIC_DEPTH_COMPARE_OP = 1000267008,
+    DYNAMIC_DEPTH_BOUNDS_TEST_ENABLE = 1000267009,
+    DYNAMIC_STENCIL_TEST_ENABLE = 1000267010,
+    DYNAMIC_STENCIL_OP = 1000267011,
+    /// VK_EXT_extended_dynamic_state2 (core in 1.3 except logic op and patch control points)
+    DYNAMIC_PATCH_CONTROL_POINTS = 1000377000,
+    DYNAMIC_RASTERIZER_DISCARD_ENABLE = 1000377001,
+    DYNAMIC_DEPTH_BIAS_ENABLE = 1000377002,
+    DYNAMIC_LOGIC_OP = 1000377003,
+    DYNAMIC_PRIMITIVE_RESTART_ENABLE = 1000377004,
+    /// VK_EXT_extended_dynamic_state3
+    DYNAMIC_DEPTH_CLAMP_ENABLE = 1000455003,
+    DYNAMIC_POLYGON_MODE = 1000455004,
+    DYNAMIC_RASTERIZATION_SAMPLES = 1000455005,
+    DYNAMIC_ALPHA_TO_COVERAGE_ENABLE = 1000455007,
+    DYNAMIC_LOGIC_OP_ENABLE = 1000455009,
+    DYNAMIC_COLOR_BLEND_ENABLE = 1000455010,
+    DYNAMIC_COLOR_BLEND_EQUATION = 1000455011,
+    DYNAMIC_COLOR_WRITE_MASK = 1000455012,
 };
 
 
@@ -113,7 +156,7 @@ struct pipeline::spec_constant {
     template<typename T>
     spec_constant(u32 id, const T& v)  : id{id}, is_inline{true}, size{sizeof(T)}, data{} {
         static_assert(sizeof(T) <= 8, "Specialization constant cannot fit in the storage of a pointer");
-        memcpy(&data, &v, sizeof(T));
+        tinystd::memcpy(&data, &v, sizeof(T));
     }
 };
 
@@ -239,6 +282,16 @@ struct pipeline::graphics_desc : VkGraphicsPipelineCreateInfo {
     void add_dynamic_state(
             VkDynamicState              state) NEX;
 
+    void add_dynamic_states(
+            span<const dynamic_state_t> states) NEX;
+
+    NDC ibool is_dynamic(
+            dynamic_state_t             state) const NEX;
+
+    /// Hash of the pipeline state, ignoring any state that is declared dynamic
+    NDC size_t hash_code(
+            ) const NEX;
+
     void enable_primitive_restart(
             ) NEX;
 
@@ -319,6 +372,7 @@ private:
 #define TINYVK_PIPELINE_CPP
 
 #include "tinystd_assert.h"
+#include "tinystd_algorithm.h"
 
 namespace tinyvk {
 
@@ -527,7 +581,7 @@ pipeline::graphics_desc::graphics_desc(
 
     auto* dynamic_states = storage.construct<VkPipelineDynamicStateCreateInfo>(1);
     dynamic_states->sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamic_states->pDynamicStates = storage.construct<VkDynamicState>(16);
+    dynamic_states->pDynamicStates = storage.construct<VkDynamicState>(MAX_DYNAMIC_STATES);
     pDynamicState = dynamic_states;
 
     auto* input_assembly = storage.construct<VkPipelineInputAssemblyStateCreateInfo>(1);
@@ -630,12 +684,223 @@ void
 pipeline::graphics_desc::add_dynamic_state(
         VkDynamicState state) NEX
 {
+    if (is_dynamic(dynamic_state_t(state))) return;
+    tassert(pDynamicState->dynamicStateCount < MAX_DYNAMIC_STATES && "Too many dynamic states (increase TINYVK_MAX_DYNAMIC_STATES)");
     auto* st = const_cast<VkDynamicState*>(pDynamicState->pDynamicStates);
     st[pDynamicState->dynamicStateCount] = state;
     const_cast<VkPipelineDynamicStateCreateInfo*>(pDynamicState)->dynamicStateCount++;
 }
 
 
+void
+pipeline::graphics_desc::add_dynamic_states(
+        span<const dynamic_state_t> states) NEX
+{
+    for (auto s: states) add_dynamic_state(VkDynamicState(s));
+}
+
+
+ibool
+pipeline::graphics_desc::is_dynamic(
+        dynamic_state_t state) const NEX
+{
+    if (pDynamicState == nullptr) return false;
+    for (u32 i = 0; i < pDynamicState->dynamicStateCount; ++i)
+        if (pDynamicState->pDynamicStates[i] == VkDynamicState(state)) return true;
+    return false;
+}
+
+
+static u32 hash_float_bits(float f) NEX
+{
+    u32 v{};
+    tinystd::memcpy(&v, &f, sizeof(float));
+    return v;
+}
+
+
+static u32 topology_class(VkPrimitiveTopology t) NEX
+{
+    switch (topology_t(t)) {
+        case TOPOLOGY_POINT_LIST: return 0;
+        case TOPOLOGY_LINE_LIST:
+        case TOPOLOGY_LINE_STRIP:
+        case TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+        case TOPOLOGY_LINE_STRIP_WITH_ADJACENCY: return 1;
+        case TOPOLOGY_PATCH_LIST: return 3;
+        default: return 2;
+    }
+}
+
+
+size_t
+pipeline::graphics_desc::hash_code(
+        ) const NEX
+{
+    size_t h{1};
+    tinystd::hash_combine(h, size_t(u64(layout)));
+    tinystd::hash_combine(h, size_t(u64(renderPass)));
+    tinystd::hash_combine(h, subpass);
+    tinystd::hash_combine(h, flags);
+    tinystd::hash_combine(h, size_t(u64(basePipelineHandle)));
+
+    // dynamic states are hashed independent of the order they were added in
+    if (pDynamicState) {
+        size_t dynamic{};
+        for (u32 i = 0; i < pDynamicState->dynamicStateCount; ++i) {
+            size_t d{1};
+            tinystd::hash_combine(d, u32(pDynamicState->pDynamicStates[i]));
+            dynamic += d;
+        }
+        tinystd::hash_combine(h, dynamic);
+    }
+
+    for (u32 i = 0; i < stageCount; ++i) {
+        auto& st = pStages[i];
+        tinystd::hash_combine(h, st.stage);
+        tinystd::hash_combine(h, size_t(u64(st.module)));
+        for (const char* c = st.pName; c && *c; ++c) tinystd::hash_combine(h, *c);
+        if (auto* spec = st.pSpecializationInfo) {
+            for (u32 e = 0; e < spec->mapEntryCount; ++e) {
+                tinystd::hash_combine(h, spec->pMapEntries[e].constantID);
+                tinystd::hash_combine(h, spec->pMapEntries[e].offset);
+                tinystd::hash_combine(h, spec->pMapEntries[e].size);
+            }
+            for (size_t b = 0; b < spec->dataSize; ++b)
+                tinystd::hash_combine(h, ((const u8*)spec->pData)[b]);
+        }
+    }
+
+    if (auto* st = pVertexInputState) {
+        const bool dynamic_stride = is_dynamic(DYNAMIC_VERTEX_INPUT_BINDING_STRIDE);
+        for (u32 i = 0; i < st->vertexBindingDescriptionCount; ++i) {
+            auto& b = st->pVertexBindingDescriptions[i];
+            tinystd::hash_combine(h, b.binding);
+            tinystd::hash_combine(h, b.inputRate);
+            if (!dynamic_stride) tinystd::hash_combine(h, b.stride);
+        }
+        for (u32 i = 0; i < st->vertexAttributeDescriptionCount; ++i) {
+            auto& a = st->pVertexAttributeDescriptions[i];
+            tinystd::hash_combine(h, a.binding);
+            tinystd::hash_combine(h, a.location);
+            tinystd::hash_combine(h, a.format);
+            tinystd::hash_combine(h, a.offset);
+        }
+    }
+
+    if (auto* st = pInputAssemblyState) {
+        // with dynamic topology only the topology class must match the pipeline
+        tinystd::hash_combine(h, is_dynamic(DYNAMIC_PRIMITIVE_TOPOLOGY) ? topology_class(st->topology) : u32(st->topology));
+        if (!is_dynamic(DYNAMIC_PRIMITIVE_RESTART_ENABLE)) tinystd::hash_combine(h, st->primitiveRestartEnable);
+    }
+
+    if (auto* st = pTessellationState) {
+        if (!is_dynamic(DYNAMIC_PATCH_CONTROL_POINTS)) tinystd::hash_combine(h, st->patchControlPoints);
+    }
+
+    if (auto* st = pViewportState) {
+        const bool dynamic_viewport_count = is_dynamic(DYNAMIC_VIEWPORT_WITH_COUNT);
+        const bool dynamic_scissor_count = is_dynamic(DYNAMIC_SCISSOR_WITH_COUNT);
+        if (!dynamic_viewport_count) tinystd::hash_combine(h, st->viewportCount);
+        if (!dynamic_scissor_count) tinystd::hash_combine(h, st->scissorCount);
+        if (!dynamic_viewport_count && !is_dynamic(DYNAMIC_VIEWPORT) && st->pViewports) {
+            for (u32 i = 0; i < st->viewportCount; ++i) {
+                auto& v = st->pViewports[i];
+                tinystd::hash_combine(h, hash_float_bits(v.x));
+                tinystd::hash_combine(h, hash_float_bits(v.y));
+                tinystd::hash_combine(h, hash_float_bits(v.width));
+                tinystd::hash_combine(h, hash_float_bits(v.height));
+                tinystd::hash_combine(h, hash_float_bits(v.minDepth));
+                tinystd::hash_combine(h, hash_float_bits(v.maxDepth));
+            }
+        }
+        if (!dynamic_scissor_count && !is_dynamic(DYNAMIC_SCISSOR) && st->pScissors) {
+            for (u32 i = 0; i < st->scissorCount; ++i) {
+                auto& r = st->pScissors[i];
+                tinystd::hash_combine(h, r.offset.x);
+                tinystd::hash_combine(h, r.offset.y);
+                tinystd::hash_combine(h, r.extent.width);
+                tinystd::hash_combine(h, r.extent.height);
+            }
+        }
+    }
+
+    if (auto* st = pRasterizationState) {
+        if (!is_dynamic(DYNAMIC_DEPTH_CLAMP_ENABLE))        tinystd::hash_combine(h, st->depthClampEnable);
+        if (!is_dynamic(DYNAMIC_RASTERIZER_DISCARD_ENABLE)) tinystd::hash_combine(h, st->rasterizerDiscardEnable);
+        if (!is_dynamic(DYNAMIC_POLYGON_MODE))              tinystd::hash_combine(h, st->polygonMode);
+        if (!is_dynamic(DYNAMIC_CULL_MODE))                 tinystd::hash_combine(h, st->cullMode);
+        if (!is_dynamic(DYNAMIC_FRONT_FACE))                tinystd::hash_combine(h, st->frontFace);
+        if (!is_dynamic(DYNAMIC_DEPTH_BIAS_ENABLE))         tinystd::hash_combine(h, st->depthBiasEnable);
+        if (!is_dynamic(DYNAMIC_DEPTH_BIAS)) {
+            tinystd::hash_combine(h, hash_float_bits(st->depthBiasConstantFactor));
+            tinystd::hash_combine(h, hash_float_bits(st->depthBiasClamp));
+            tinystd::hash_combine(h, hash_float_bits(st->depthBiasSlopeFactor));
+        }
+        if (!is_dynamic(DYNAMIC_LINE_WIDTH))                tinystd::hash_combine(h, hash_float_bits(st->lineWidth));
+    }
+
+    if (auto* st = pMultisampleState) {
+        if (!is_dynamic(DYNAMIC_RASTERIZATION_SAMPLES))     tinystd::hash_combine(h, st->rasterizationSamples);
+        if (!is_dynamic(DYNAMIC_ALPHA_TO_COVERAGE_ENABLE))  tinystd::hash_combine(h, st->alphaToCoverageEnable);
+        tinystd::hash_combine(h, st->sampleShadingEnable);
+        tinystd::hash_combine(h, hash_float_bits(st->minSampleShading));
+        tinystd::hash_combine(h, st->alphaToOneEnable);
+    }
+
+    if (auto* st = pDepthStencilState) {
+        if (!is_dynamic(DYNAMIC_DEPTH_TEST_ENABLE))         tinystd::hash_combine(h, st->depthTestEnable);
+        if (!is_dynamic(DYNAMIC_DEPTH_WRITE_ENABLE))        tinystd::hash_combine(h, st->depthWriteEnable);
+        if (!is_dynamic(DYNAMIC_DEPTH_COMPARE_OP))          tinystd::hash_combine(h, st->depthCompareOp);
+        if (!is_dynamic(DYNAMIC_DEPTH_BOUNDS_TEST_ENABLE))  tinystd::hash_combine(h, st->depthBoundsTestEnable);
+        if (!is_dynamic(DYNAMIC_STENCIL_TEST_ENABLE))       tinystd::hash_combine(h, st->stencilTestEnable);
+        if (!is_dynamic(DYNAMIC_DEPTH_BOUNDS)) {
+            tinystd::hash_combine(h, hash_float_bits(st->minDepthBounds));
+            tinystd::hash_combine(h, hash_float_bits(st->maxDepthBounds));
+        }
+        const VkStencilOpState* faces[2]{&st->front, &st->back};
+        for (const auto* face: faces) {
+            if (!is_dynamic(DYNAMIC_STENCIL_OP)) {
+                tinystd::hash_combine(h, face->failOp);
+                tinystd::hash_combine(h, face->passOp);
+                tinystd::hash_combine(h, face->depthFailOp);
+                tinystd::hash_combine(h, face->compareOp);
+            }
+            if (!is_dynamic(DYNAMIC_STENCIL_COMPARE_MASK))  tinystd::hash_combine(h, face->compareMask);
+            if (!is_dynamic(DYNAMIC_STENCIL_WRITE_MASK))    tinystd::hash_combine(h, face->writeMask);
+            if (!is_dynamic(DYNAMIC_STENCIL_REFERENCE))     tinystd::hash_combine(h, face->reference);
+        }
+    }
+
+    if (auto* st = pColorBlendState) {
+        if (!is_dynamic(DYNAMIC_LOGIC_OP_ENABLE))           tinystd::hash_combine(h, st->logicOpEnable);
+        if (!is_dynamic(DYNAMIC_LOGIC_OP))                  tinystd::hash_combine(h, st->logicOp);
+        tinystd::hash_combine(h, st->attachmentCount);
+        const bool dynamic_enable = is_dynamic(DYNAMIC_COLOR_BLEND_ENABLE);
+        const bool dynamic_equation = is_dynamic(DYNAMIC_COLOR_BLEND_EQUATION);
+        const bool dynamic_mask = is_dynamic(DYNAMIC_COLOR_WRITE_MASK);
+        for (u32 i = 0; st->pAttachments && i < st->attachmentCount; ++i) {
+            auto& a = st->pAttachments[i];
+            if (!dynamic_enable) tinystd::hash_combine(h, a.blendEnable);
+            if (!dynamic_equation) {
+                tinystd::hash_combine(h, a.srcColorBlendFactor);
+                tinystd::hash_combine(h, a.dstColorBlendFactor);
+                tinystd::hash_combine(h, a.colorBlendOp);
+                tinystd::hash_combine(h, a.srcAlphaBlendFactor);
+                tinystd::hash_combine(h, a.dstAlphaBlendFactor);
+                tinystd::hash_combine(h, a.alphaBlendOp);
+            }
+            if (!dynamic_mask) tinystd::hash_combine(h, a.colorWriteMask);
+        }
+        if (!is_dynamic(DYNAMIC_BLEND_CONSTANTS)) {
+            for (float c: st->blendConstants) tinystd::hash_combine(h, hash_float_bits(c));
+        }
+    }
+
+    return h;
+}
+
+
 void
 pipeline::graphics_desc::enable_primitive_restart(
         ) NEX
@@ -798,9 +1063,9 @@ pipeline::graphics_desc::viewport(
     tassert((multiple_viewports || viewports.size() == 1) && "Cannot use more than one viewport in a renderpass");
     if (pViewportState->pViewports == nullptr) {
         auto* vp = storage.construct<VkViewport>(viewports.size());
-        memcpy(vp, viewports.data(), viewports.size() * sizeof(VkViewport));
+        tinystd::memcpy(vp, viewports.data(), viewports.size() * sizeof(VkViewport));
         auto* sc = storage.construct<VkRect2D>(scissors.size());
-        memcpy(sc, scissors.data(), scissors.size() * sizeof(VkRect2D));
+        tinystd::memcpy(sc, scissors.data(), scissors.size() * sizeof(VkRect2D));
         auto* st = const_cast<VkPipelineViewportStateCreateInfo*>(pViewportState);
         st->pViewports = vp;
         st->pScissors = sc;
@@ -0,0 +1,599 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_PROFILER_H
+#define TINYVK_PROFILER_H
+
+#include "tinyvk_core.h"
+#include "tinyvk_command.h"
+
+namespace tinyvk {
+
+/// profiler high-level API
+struct default_profiler_api_limits {
+    static constexpr size_t MAX_GPU_ZONES = 256;
+    static constexpr size_t MAX_CPU_ZONES = 256;
+    static constexpr size_t MAX_ZONE_DEPTH = 32;
+    static constexpr size_t MAX_EVENTS = 16384;
+    static constexpr size_t MAX_STATISTICS_ZONES = 64;
+};
+using profiler_api_limits = TINYVK_PROFILER_API_LIMITS;
+
+
+/// GPU and CPU zone profiler. GPU zones write a timestamp at their beginning and end into the query pool of the
+/// current frame, there is one pool per frame in flight. begin_frame reads the pool of the frame that used it
+/// MAX_FRAMES_IN_FLIGHT frames ago without blocking (the caller already waited for that frame), zones whose
+/// timestamps are not available are dropped. GPU times are ticks * timestamp_period, placed on the CPU timeline
+/// relative to the begin_frame of their frame, so they are only as accurate as that alignment.
+/// CPU zones are recorded per thread index (the same indices as command_ring), each thread only touches its own
+/// zones. GPU zones and begin_frame must be called from one thread, begin_frame while no CPU zone is recorded.
+/// Resolved zones are kept in a ring of MAX_EVENTS events that write_chrome_trace writes as Chrome trace JSON
+/// (chrome://tracing, Perfetto).
+/// With TINYVK_PIPELINE_STATISTICS, GPU zones begun with statistics also collect pipeline statistics (the device
+/// needs FEATURE_PIPELINE_STATISTICS_QUERY). Statistics queries of different zones must not overlap, and a zone
+/// that begins inside a subpass must end in it. Without the define the statistics flag is ignored.
+struct profiler {
+    enum { GPU_TRACK = 0 };
+
+    /// A resolved zone, track is GPU_TRACK or 1 + CPU thread index, times are nanoseconds
+    struct event_t {
+        const char*             name{};
+        u64                     begin{};
+        u64                     end{};
+        u32                     track{};
+        u32                     depth{};
+#ifdef TINYVK_PIPELINE_STATISTICS
+        ibool                   has_statistics{};
+#endif
+    };
+
+    struct gpu_zone_t {
+        const char*             name{};
+        u32                     depth{};
+#ifdef TINYVK_PIPELINE_STATISTICS
+        u32                     statistics{-1u};
+#endif
+    };
+
+#ifdef TINYVK_PIPELINE_STATISTICS
+    /// In the order of the statistic bits, which is the order the results are written in
+    struct statistics_t {
+        u64                     input_vertices{};
+        u64                     vertex_invocations{};
+        u64                     clipping_invocations{};
+        u64                     clipping_primitives{};
+        u64                     fragment_invocations{};
+        u64                     compute_invocations{};
+    };
+
+    static constexpr VkQueryPipelineStatisticFlags STATISTICS_FLAGS = 0
+            | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+            | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+    enum { STATISTICS_COUNT = sizeof(statistics_t) / sizeof(u64) };
+#endif
+
+    struct cpu_thread_t {
+        event_t                 zones[profiler_api_limits::MAX_CPU_ZONES]{};
+        u32                     open[profiler_api_limits::MAX_ZONE_DEPTH]{};
+        u32                     count{};
+        u32                     depth{};
+    };
+
+    VkQueryPool                 pools[MAX_FRAMES_IN_FLIGHT]{};
+    u32                         gpu_count[MAX_FRAMES_IN_FLIGHT]{};
+    u64                         frame_begin[MAX_FRAMES_IN_FLIGHT]{};
+    gpu_zone_t*                 gpu_zones{};
+    u32                         gpu_open[profiler_api_limits::MAX_ZONE_DEPTH]{};
+    u32                         gpu_depth{};
+    cpu_thread_t*               threads{};
+    u32                         thread_count{};
+    event_t*                    events{};
+    u64                         event_total{};
+    u64*                        results{};
+    float                       timestamp_period{};
+    u64                         frame{};
+#ifdef TINYVK_PIPELINE_STATISTICS
+    VkQueryPool                 statistics_pools[MAX_FRAMES_IN_FLIGHT]{};
+    u32                         statistics_count[MAX_FRAMES_IN_FLIGHT]{};
+    u32                         statistics_open{-1u};
+    statistics_t*               statistics{};
+    u64*                        statistics_results{};
+#endif
+
+    /// timestamp_period is VkPhysicalDeviceLimits::timestampPeriod
+    static profiler     create(
+            VkDevice                    device,
+            float                       timestamp_period,
+            u32                         threads = 1,
+            vk_alloc                    alloc = {}) NEX;
+
+    void                destroy(
+            VkDevice                    device,
+            vk_alloc                    alloc = {}) NEX;
+
+    /// Resolve the zones of the frame that used this frame's pool and reset the pool in cmd.
+    /// cmd must execute before any command buffer with zones of this frame
+    void                begin_frame(
+            VkDevice                    device,
+            command                     cmd) NEX;
+
+    /// Returns the zone to end, or -1u when the frame has no queries left.
+    /// with_statistics is dropped when another statistics zone is open or the frame has no statistics queries left
+    NDC u32             begin_gpu(
+            command                     cmd,
+            const char*                 name,
+            VkPipelineStageFlagBits     stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            bool                        with_statistics = false) NEX;
+
+    void                end_gpu(
+            command                     cmd,
+            u32                         zone,
+            VkPipelineStageFlagBits     stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT) NEX;
+
+    void                begin_cpu(
+            u32                         thread,
+            const char*                 name) NEX;
+
+    void                end_cpu(
+            u32                         thread) NEX;
+
+    /// Resolved events, oldest first
+    NDC u32             event_count() const NEX;
+
+    NDC const event_t&  event(
+            u32                         i) const NEX;
+
+#ifdef TINYVK_PIPELINE_STATISTICS
+    /// Pipeline statistics of event i, nullptr if it has none
+    NDC const statistics_t* event_statistics(
+            u32                         i) const NEX;
+#endif
+
+    /// Write every resolved event as Chrome trace JSON, returns false if the file could not be written
+    bool                write_chrome_trace(
+            const char*                 path) const NEX;
+
+private:
+    u64                 push_event(
+            const event_t&              e) NEX;
+
+    void                resolve_gpu(
+            VkDevice                    device,
+            u32                         slot) NEX;
+
+    void                resolve_cpu() NEX;
+};
+
+
+/// GPU zone that ends when it goes out of scope
+struct gpu_scope {
+    profiler*                   p{};
+    command                     cmd{};
+    u32                         zone{};
+
+    gpu_scope(
+            profiler&                   owner,
+            command                     cmd,
+            const char*                 name,
+            bool                        with_statistics = false) NEX;
+
+    ~gpu_scope() NEX;
+
+    gpu_scope(const gpu_scope&) = delete;
+    gpu_scope& operator=(const gpu_scope&) = delete;
+};
+
+
+/// CPU zone that ends when it goes out of scope
+struct cpu_scope {
+    profiler*                   p{};
+    u32                         thread{};
+
+    cpu_scope(
+            profiler&                   owner,
+            u32                         thread,
+            const char*                 name) NEX;
+
+    ~cpu_scope() NEX;
+
+    cpu_scope(const cpu_scope&) = delete;
+    cpu_scope& operator=(const cpu_scope&) = delete;
+};
+
+}
+
+#endif //TINYVK_PROFILER_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_PROFILER_CPP
+#define TINYVK_PROFILER_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+//region profiler
+
+profiler
+profiler::create(
+        VkDevice device,
+        float timestamp_period,
+        u32 threads,
+        vk_alloc alloc) NEX
+{
+    tassert(threads <= MAX_RECORDING_THREADS && "tinyvk::profiler::create - Too many threads");
+
+    profiler p{};
+    p.timestamp_period = timestamp_period;
+    p.thread_count = threads;
+
+    VkQueryPoolCreateInfo info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = u32(2 * profiler_api_limits::MAX_GPU_ZONES);
+    for (auto& pool: p.pools) {
+        vk_validate(vkCreateQueryPool(device, &info, alloc, &pool),
+            "tinyvk::profiler::create - Failed to create timestamp query pool");
+    }
+
+    const size_t gpu_zones = MAX_FRAMES_IN_FLIGHT * profiler_api_limits::MAX_GPU_ZONES;
+    p.gpu_zones = (gpu_zone_t*)tinystd::malloc(gpu_zones * sizeof(gpu_zone_t));
+    p.threads = (cpu_thread_t*)tinystd::malloc(tinystd::max(threads, 1u) * sizeof(cpu_thread_t));
+    p.events = (event_t*)tinystd::malloc(profiler_api_limits::MAX_EVENTS * sizeof(event_t));
+    p.results = (u64*)tinystd::malloc(4 * profiler_api_limits::MAX_GPU_ZONES * sizeof(u64));
+    for (u32 t = 0; t < threads; ++t)
+        p.threads[t].count = p.threads[t].depth = 0;
+
+#ifdef TINYVK_PIPELINE_STATISTICS
+    info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    info.queryCount = u32(profiler_api_limits::MAX_STATISTICS_ZONES);
+    info.pipelineStatistics = STATISTICS_FLAGS;
+    for (auto& pool: p.statistics_pools) {
+        vk_validate(vkCreateQueryPool(device, &info, alloc, &pool),
+            "tinyvk::profiler::create - Failed to create pipeline statistics query pool");
+    }
+    p.statistics = (statistics_t*)tinystd::malloc(profiler_api_limits::MAX_EVENTS * sizeof(statistics_t));
+    p.statistics_results = (u64*)tinystd::malloc((STATISTICS_COUNT + 1) * profiler_api_limits::MAX_STATISTICS_ZONES * sizeof(u64));
+#endif
+    return p;
+}
+
+
+void
+profiler::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    for (auto& pool: pools)
+        vkDestroyQueryPool(device, pool, alloc);
+    tinystd::free(gpu_zones);
+    tinystd::free(threads);
+    tinystd::free(events);
+    tinystd::free(results);
+#ifdef TINYVK_PIPELINE_STATISTICS
+    for (auto& pool: statistics_pools)
+        vkDestroyQueryPool(device, pool, alloc);
+    tinystd::free(statistics);
+    tinystd::free(statistics_results);
+#endif
+    *this = {};
+}
+
+
+void
+profiler::begin_frame(
+        VkDevice device,
+        command cmd) NEX
+{
+    const u32 slot = u32(frame % MAX_FRAMES_IN_FLIGHT);
+    if (gpu_count[slot])
+        resolve_gpu(device, slot);
+    resolve_cpu();
+
+    cmd.reset_queries(pools[slot], 0, u32(2 * profiler_api_limits::MAX_GPU_ZONES));
+    gpu_count[slot] = 0;
+    gpu_depth = 0;
+#ifdef TINYVK_PIPELINE_STATISTICS
+    cmd.reset_queries(statistics_pools[slot], 0, u32(profiler_api_limits::MAX_STATISTICS_ZONES));
+    statistics_count[slot] = 0;
+    statistics_open = -1u;
+#endif
+    frame_begin[slot] = tinystd::clock_nanos();
+    ++frame;
+}
+
+
+u32
+profiler::begin_gpu(
+        command cmd,
+        const char* name,
+        VkPipelineStageFlagBits stage,
+        bool with_statistics) NEX
+{
+    tassert(frame && "tinyvk::profiler::begin_gpu - Called before begin_frame");
+    const u32 slot = u32((frame - 1) % MAX_FRAMES_IN_FLIGHT);
+    if (gpu_count[slot] == profiler_api_limits::MAX_GPU_ZONES || gpu_depth == profiler_api_limits::MAX_ZONE_DEPTH)
+        return -1u;
+
+    const u32 zone = gpu_count[slot]++;
+    auto& z = gpu_zones[slot * profiler_api_limits::MAX_GPU_ZONES + zone];
+    z = {name, gpu_depth};
+    gpu_open[gpu_depth++] = zone;
+    cmd.write_timestamp(pools[slot], 2 * zone, stage);
+#ifdef TINYVK_PIPELINE_STATISTICS
+    if (with_statistics && statistics_open == -1u && statistics_count[slot] < profiler_api_limits::MAX_STATISTICS_ZONES) {
+        z.statistics = statistics_count[slot]++;
+        statistics_open = zone;
+        cmd.begin_query(statistics_pools[slot], z.statistics);
+    }
+#else
+    (void)with_statistics;
+#endif
+    return zone;
+}
+
+
+void
+profiler::end_gpu(
+        command cmd,
+        u32 zone,
+        VkPipelineStageFlagBits stage) NEX
+{
+    if (zone == -1u)
+        return;
+    tassert(gpu_depth && gpu_open[gpu_depth - 1] == zone && "tinyvk::profiler::end_gpu - Zones must end in reverse order");
+    --gpu_depth;
+    const u32 slot = u32((frame - 1) % MAX_FRAMES_IN_FLIGHT);
+#ifdef TINYVK_PIPELINE_STATISTICS
+    if (statistics_open == zone) {
+        cmd.end_query(statistics_pools[slot], gpu_zones[slot * profiler_api_limits::MAX_GPU_ZONES + zone].statistics);
+        statistics_open = -1u;
+    }
+#endif
+    cmd.write_timestamp(pools[slot], 2 * zone + 1, stage);
+}
+
+
+void
+profiler::begin_cpu(
+        u32 thread,
+        const char* name) NEX
+{
+    auto& t = threads[thread];
+    if (t.count == profiler_api_limits::MAX_CPU_ZONES || t.depth >= profiler_api_limits::MAX_ZONE_DEPTH) {
+        // still track the depth so the matching end_cpu is ignored
+        if (t.depth < profiler_api_limits::MAX_ZONE_DEPTH) t.open[t.depth] = -1u;
+        ++t.depth;
+        return;
+    }
+    const u32 zone = t.count++;
+    t.zones[zone] = {name, tinystd::clock_nanos(), 0, thread + 1, t.depth};
+    t.open[t.depth++] = zone;
+}
+
+
+void
+profiler::end_cpu(
+        u32 thread) NEX
+{
+    auto& t = threads[thread];
+    tassert(t.depth && "tinyvk::profiler::end_cpu - No zone to end");
+    const u32 depth = --t.depth;
+    const u32 zone = depth < profiler_api_limits::MAX_ZONE_DEPTH ? t.open[depth] : -1u;
+    if (zone != -1u)
+        t.zones[zone].end = tinystd::clock_nanos();
+}
+
+
+u32
+profiler::event_count() const NEX
+{
+    return u32(tinystd::min(event_total, u64(profiler_api_limits::MAX_EVENTS)));
+}
+
+
+const profiler::event_t&
+profiler::event(
+        u32 i) const NEX
+{
+    const u64 first = event_total - event_count();
+    return events[(first + i) % profiler_api_limits::MAX_EVENTS];
+}
+
+
+#ifdef TINYVK_PIPELINE_STATISTICS
+const profiler::statistics_t*
+profiler::event_statistics(
+        u32 i) const NEX
+{
+    const u64 first = event_total - event_count();
+    const u64 index = (first + i) % profiler_api_limits::MAX_EVENTS;
+    return events[index].has_statistics ? &statistics[index] : nullptr;
+}
+#endif
+
+
+u64
+profiler::push_event(
+        const event_t& e) NEX
+{
+    const u64 index = event_total++ % profiler_api_limits::MAX_EVENTS;
+    events[index] = e;
+    return index;
+}
+
+
+void
+profiler::resolve_gpu(
+        VkDevice device,
+        u32 slot) NEX
+{
+    // [begin, begin available, end, end available] per zone
+    const u32 count = gpu_count[slot];
+    const VkResult r = vkGetQueryPoolResults(device, pools[slot], 0, 2 * count, 4 * count * sizeof(u64), results,
+        2 * sizeof(u64), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (r != VK_NOT_READY)
+        vk_validate(r, "tinyvk::profiler::begin_frame - Failed to get timestamps");
+
+#ifdef TINYVK_PIPELINE_STATISTICS
+    // [statistics..., available] per statistics query
+    const u32 statistics_stride = STATISTICS_COUNT + 1;
+    if (statistics_count[slot]) {
+        const VkResult sr = vkGetQueryPoolResults(device, statistics_pools[slot], 0, statistics_count[slot],
+            statistics_stride * statistics_count[slot] * sizeof(u64), statistics_results, statistics_stride * sizeof(u64),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (sr != VK_NOT_READY)
+            vk_validate(sr, "tinyvk::profiler::begin_frame - Failed to get pipeline statistics");
+    }
+#endif
+
+    u64 first = -1ull;
+    for (u32 z = 0; z < count; ++z) {
+        if (results[4 * z + 1])
+            first = tinystd::min(first, results[4 * z]);
+    }
+    for (u32 z = 0; z < count; ++z) {
+        const u64* ts = results + 4 * z;
+        if (!ts[1] || !ts[3] || ts[2] < ts[0])
+            continue;
+        const auto& zone = gpu_zones[slot * profiler_api_limits::MAX_GPU_ZONES + z];
+        const u64 begin = frame_begin[slot] + u64(double(ts[0] - first) * timestamp_period);
+        const u64 end = frame_begin[slot] + u64(double(ts[2] - first) * timestamp_period);
+#ifdef TINYVK_PIPELINE_STATISTICS
+        const u64* stats = zone.statistics != -1u ? statistics_results + zone.statistics * statistics_stride : nullptr;
+        const bool has_statistics = stats && stats[STATISTICS_COUNT];
+        const u64 index = push_event({zone.name, begin, end, GPU_TRACK, zone.depth, has_statistics});
+        if (has_statistics)
+            tinystd::memcpy(&statistics[index], stats, sizeof(statistics_t));
+#else
+        push_event({zone.name, begin, end, GPU_TRACK, zone.depth});
+#endif
+    }
+    gpu_count[slot] = 0;
+}
+
+
+void
+profiler::resolve_cpu() NEX
+{
+    for (u32 i = 0; i < thread_count; ++i) {
+        auto& t = threads[i];
+        // closed zones become events, zones that are still open move to the front
+        u32 kept = 0;
+        for (u32 z = 0; z < t.count; ++z) {
+            if (t.zones[z].end) {
+                push_event(t.zones[z]);
+                continue;
+            }
+            for (u32 d = 0; d < tinystd::min(t.depth, u32(profiler_api_limits::MAX_ZONE_DEPTH)); ++d) {
+                if (t.open[d] == z) t.open[d] = kept;
+            }
+            t.zones[kept++] = t.zones[z];
+        }
+        t.count = kept;
+    }
+}
+
+
+bool
+profiler::write_chrome_trace(
+        const char* path) const NEX
+{
+    enum { EVENT_SIZE = 320 };
+    const u32 n = event_count();
+    size_t capacity = 256 + thread_count * 96;
+    for (u32 i = 0; i < n; ++i) {
+        size_t len = 0;
+        for (const char* c = event(i).name; c && *c; ++c) ++len;
+        capacity += EVENT_SIZE + 2 * len;
+    }
+
+    char* json = (char*)tinystd::malloc(capacity);
+    size_t size = 0;
+    auto append = [&](const char* s) { while (*s) json[size++] = *s++; };
+    char buf[EVENT_SIZE]{};
+
+    append("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"GPU\"}}");
+    for (u32 t = 0; t < thread_count; ++t) {
+        tinystd::format(buf, sizeof(buf), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"CPU %u\"}}", t + 1, t);
+        append(buf);
+    }
+    for (u32 i = 0; i < n; ++i) {
+        const auto& e = event(i);
+        append(",\n{\"name\":\"");
+        for (const char* c = e.name; c && *c; ++c) {
+            if (*c == '"' || *c == '\\') json[size++] = '\\';
+            json[size++] = *c;
+        }
+        tinystd::format(buf, sizeof(buf), "\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+            e.track, double(e.begin) * 1e-3, double(e.end - e.begin) * 1e-3);
+        append(buf);
+#ifdef TINYVK_PIPELINE_STATISTICS
+        if (const auto* s = event_statistics(i)) {
+            tinystd::format(buf, sizeof(buf), ",\"args\":{\"input_vertices\":%llu,\"vertex_invocations\":%llu,"
+                "\"clipping_invocations\":%llu,\"clipping_primitives\":%llu,", (unsigned long long)s->input_vertices,
+                (unsigned long long)s->vertex_invocations, (unsigned long long)s->clipping_invocations,
+                (unsigned long long)s->clipping_primitives);
+            append(buf);
+            tinystd::format(buf, sizeof(buf), "\"fragment_invocations\":%llu,\"compute_invocations\":%llu}",
+                (unsigned long long)s->fragment_invocations, (unsigned long long)s->compute_invocations);
+            append(buf);
+        }
+#endif
+        append("}");
+    }
+    append("\n]}\n");
+
+    const bool ok = tinystd::write_file(path, json, size);
+    tinystd::free(json);
+    return ok;
+}
+
+//endregion
+
+//region profiler scopes
+
+gpu_scope::gpu_scope(
+        profiler& owner,
+        command cmd,
+        const char* name,
+        bool with_statistics) NEX :
+    p{&owner}, cmd{cmd}, zone{owner.begin_gpu(cmd, name, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, with_statistics)}
+{
+}
+
+
+gpu_scope::~gpu_scope() NEX
+{
+    p->end_gpu(cmd, zone);
+}
+
+
+cpu_scope::cpu_scope(
+        profiler& owner,
+        u32 thread,
+        const char* name) NEX :
+    p{&owner}, thread{thread}
+{
+    owner.begin_cpu(thread, name);
+}
+
+
+cpu_scope::~cpu_scope() NEX
+{
+    p->end_cpu(thread);
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_PROFILER_CPP
+
+#endif //TINYVK_IMPLEMENTATION
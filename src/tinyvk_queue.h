@@ -6,6 +6,9 @@
 #define TINYVK_QUEUE_H
 
 #include "tinyvk_core.h"
+#ifndef TINYVK_NO_JOBS
+#include "tinystd_jobs.h"
+#endif
 
 namespace tinyvk {
 
@@ -129,6 +132,194 @@ struct queue_collection {
     NDC ibool    shared(queue_type_t type, u32 index = 0) const NEX;
 };
 
+
+/// Semaphore wait/signal of a submit, value is only used by timeline semaphores.
+/// For waits stage is the first stage that waits, for signals the last stage that must complete first.
+struct semaphore_submit {
+    VkSemaphore                 semaphore{};
+    u64                         value{};
+    pipeline_stage_flags        stage{};
+};
+
+
+/// Collects submits to one queue and records them with a single queue submit call.
+/// With TINYVK_USE_SYNCHRONIZATION2 on a device that supports synchronization2 that is submit2, otherwise
+/// vkQueueSubmit with the stage masks mapped to the legacy flags and timeline values passed with
+/// VkTimelineSemaphoreSubmitInfo.
+struct submit_batch {
+    struct submit_t {
+        u32                     cmd_begin{}, cmd_count{};
+        u32                     wait_begin{}, wait_count{};
+        u32                     signal_begin{}, signal_count{};
+    };
+
+    small_vector<submit_t, 4>               submits{};
+    small_vector<VkCommandBuffer, 16>       cmds{};
+    small_vector<semaphore_submit, 8>       waits{};
+    small_vector<semaphore_submit, 8>       signals{};
+
+    /// Add one submit, consecutive submits execute in order
+    void                add(
+            span<const VkCommandBuffer>     cmds,
+            span<const semaphore_submit>    waits = {},
+            span<const semaphore_submit>    signals = {}) NEX;
+
+    NDC bool            empty() const NEX;
+
+    void                clear() NEX;
+
+    /// Submit everything to queue with one call and clear the batch, fence (if any) signals when all of it completes
+    void                submit(
+            VkQueue                         queue,
+            VkFence                         fence = {}) NEX;
+
+#ifdef VK_VERSION_1_3
+    /// Load vkQueueSubmit2 (core in Vulkan 1.3, VK_KHR_synchronization2 before), device::create calls it when
+    /// TINYVK_USE_SYNCHRONIZATION2 is defined, with the device if it supports synchronization2, with null (unloads it,
+    /// submit falls back to vkQueueSubmit) otherwise
+    static void         load_synchronization2(
+            VkDevice                        device) NEX;
+
+    /// Submit everything with one vkQueueSubmit2, semaphores keep their 64 bit stage masks
+    void                submit2(
+            VkQueue                         queue,
+            VkFence                         fence = {}) NEX;
+#endif
+};
+
+
+#ifndef TINYVK_NO_JOBS
+/// One submit handed to a submit_thread, packets are copied bytewise through the queue
+struct submit_packet {
+    VkCommandBuffer             cmds[MAX_PACKET_COMMAND_BUFFERS]{};
+    semaphore_submit            waits[MAX_PACKET_SEMAPHORES]{};
+    semaphore_submit            signals[MAX_PACKET_SEMAPHORES]{};
+    u32                         cmd_count{};
+    u32                         wait_count{};
+    u32                         signal_count{};
+    VkFence                     fence{};
+};
+
+
+/// Optional submit mode where no thread but one dedicated thread calls vkQueueSubmit, so VkQueue needs no lock.
+/// Any thread pushes packets into the lock-free queue of a physical queue (an index into queue_collection::physical),
+/// the submit thread drains them and batches consecutive packets into a single queue submit.
+/// A packet with a fence ends its batch, the fence is signaled when it and everything before it completes.
+/// Packets pushed by one thread are submitted in push order, there is no order between threads.
+/// The object must not move between start and stop.
+struct submit_thread {
+    enum { MAX_BATCH_PACKETS = 64 };
+
+    fixed_vector<VkQueue, MAX_DEVICE_QUEUES>                queues{};
+    fixed_vector<tinystd::mpsc_queue, MAX_DEVICE_QUEUES>    packets{};
+    tinystd::job_counter                                    pending{};
+    tinystd::job_thread                                     thread{};
+
+    /// capacity is the number of packets each physical queue can hold before push has to wait
+    void                start(
+            const queue_collection&         queues,
+            u32                             capacity = 256,
+            const tinystd::job_allocator&   alloc = {}) NEX;
+
+    /// Submit everything pushed so far and join the thread
+    void                stop() NEX;
+
+    void                push(
+            u32                             queue,
+            const submit_packet&            packet) NEX;
+
+    /// Block until everything pushed so far (by any thread) was submitted
+    void                flush() NEX;
+
+    /// Submit the packets waiting in every queue, called by the thread. Returns false if there were none
+    bool                drain() NEX;
+};
+#endif
+
+
+#ifdef VK_VERSION_1_2
+/// A value on the timeline of a physical queue, reached once everything submitted up to it has completed
+struct retire_point {
+    u32                         queue{};
+    u64                         value{};
+};
+
+
+/// Tracks GPU progress with one timeline semaphore per physical queue of a queue_collection.
+/// Every submit signals the next value of its queue, resources are retired against the returned retire_point
+/// and completed() tells whether the queue got there without blocking (the semaphore is only queried when the
+/// cached value is not far enough). Requires timelineSemaphore, core in Vulkan 1.2 and VK_KHR_timeline_semaphore
+/// on 1.1 (device::create enables either when supported). Not thread safe, submit from one thread at a time.
+struct submission_tracker {
+    struct timeline {
+        VkSemaphore             semaphore{};
+        u64                     submitted{};
+        u64                     completed{};
+    };
+
+    fixed_vector<timeline, MAX_DEVICE_QUEUES>   timelines{};
+    PFN_vkGetSemaphoreCounterValue              get_counter_value{};
+    PFN_vkWaitSemaphores                        wait_semaphores{};
+
+    static submission_tracker create(
+            VkDevice                        device,
+            const queue_collection&         queues,
+            vk_alloc                        alloc = {}) NEX;
+
+    void                destroy(
+            VkDevice                        device,
+            vk_alloc                        alloc = {}) NEX;
+
+    /// Index of the physical queue (and its timeline) behind a logical queue
+    NDC static u32      queue_index(
+            const queue_collection&         queues,
+            queue_type_t                    type,
+            u32                             index = 0) NEX;
+
+    /// Signal the next value of queue from the last submit in batch (an empty submit if there is none)
+    NDC retire_point    signal(
+            u32                             queue,
+            submit_batch&                   batch,
+            pipeline_stage_flags            stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT) NEX;
+
+    /// Signal the next value and submit batch to the physical queue
+    retire_point        submit(
+            const queue_collection&         queues,
+            u32                             queue,
+            submit_batch&                   batch,
+            VkFence                         fence = {}) NEX;
+
+    /// Wait for point in a submit on another queue, stage is the first stage that waits
+    NDC semaphore_submit wait_for(
+            retire_point                    point,
+            pipeline_stage_flags            stage) const NEX;
+
+    /// Completes once everything submitted to queue so far has completed
+    NDC retire_point    last_submitted(
+            u32                             queue) const NEX;
+
+    /// Non-blocking
+    NDC bool            completed(
+            VkDevice                        device,
+            retire_point                    point) NEX;
+
+    /// Refresh the completed value of every queue
+    void                poll(
+            VkDevice                        device) NEX;
+
+    /// Block until point completed or timeout passed, returns true if it completed
+    ibool               wait(
+            VkDevice                        device,
+            retire_point                    point,
+            u64                             timeout = DEFAULT_TIMEOUT_NANOS) NEX;
+
+    /// Block until everything submitted to all queues completed
+    ibool               wait_idle(
+            VkDevice                        device,
+            u64                             timeout = DEFAULT_TIMEOUT_NANOS) NEX;
+};
+#endif
+
 }
 
 #endif //TINYVK_QUEUE_H
@@ -474,9 +665,10 @@ queue_collection(
                 physical_index[type][i.index] = i.physical_index;
             }
             else {
-                physical_index[type][i.index] = *it;
+                const u32 existing = u32(it - indices.begin());
+                physical_index[type][i.index] = existing;
                 is_shared[type].set(i.index, true);
-                auto& f = first_queue[*it];
+                auto& f = first_queue[existing];
                 is_shared[f.type].set(f.index, true);
             }
             ++count[type];
@@ -502,7 +694,7 @@ queue_collection(
     // Count dedicated queues
     for (u32 type = 0; type < MAX_QUEUE_COUNT; ++type) {
         for (u32 i = 0; i < count[type]; ++i) {
-            dedicated_count[type] += is_shared[type].test(i);
+            dedicated_count[type] += !is_shared[type].test(i);
         }
     }
 }
@@ -535,6 +727,460 @@ queue_collection::shared(
 
 //endregion
 
+//region submit_batch
+
+void
+submit_batch::add(
+        span<const VkCommandBuffer> command_buffers,
+        span<const semaphore_submit> wait,
+        span<const semaphore_submit> signal) NEX
+{
+    submit_t s{};
+    s.cmd_begin = u32(cmds.size());
+    s.cmd_count = u32(command_buffers.size());
+    s.wait_begin = u32(waits.size());
+    s.wait_count = u32(wait.size());
+    s.signal_begin = u32(signals.size());
+    s.signal_count = u32(signal.size());
+    for (auto c: command_buffers) cmds.push_back(c);
+    for (auto& w: wait) waits.push_back(w);
+    for (auto& w: signal) signals.push_back(w);
+    submits.push_back(s);
+}
+
+
+bool
+submit_batch::empty() const NEX
+{
+    return submits.empty();
+}
+
+
+void
+submit_batch::clear() NEX
+{
+    submits.clear();
+    cmds.clear();
+    waits.clear();
+    signals.clear();
+}
+
+
+#ifdef VK_VERSION_1_3
+static struct {
+    PFN_vkQueueSubmit2                      queue_submit2;
+} synchronization2_submit{};
+#endif
+
+
+void
+submit_batch::submit(
+        VkQueue queue,
+        VkFence fence) NEX
+{
+#ifdef TINYVK_USE_SYNCHRONIZATION2
+    // devices without synchronization2 never load it and keep vkQueueSubmit
+    if (synchronization2_submit.queue_submit2) {
+        submit2(queue, fence);
+        return;
+    }
+#endif
+    if (submits.empty() && !fence)
+        return;
+
+    small_vector<VkSemaphore, 16> sems{};
+    small_vector<uint64_t, 16> values{};
+    small_vector<VkPipelineStageFlags, 8> wait_stages{};
+    for (auto& w: waits) {
+        sems.push_back(w.semaphore);
+        values.push_back(w.value);
+        wait_stages.push_back(legacy_stages(w.stage));
+    }
+    for (auto& w: signals) {
+        sems.push_back(w.semaphore);
+        values.push_back(w.value);
+    }
+    const u32 signal_offset = u32(waits.size());
+    const bool timeline = tinystd::any_of(values.begin(), values.end(), [](uint64_t v){ return v > 0; });
+
+    // the arrays above do not move anymore, pointers into them are stable
+    small_vector<VkSubmitInfo, 4> infos{};
+    small_vector<VkTimelineSemaphoreSubmitInfo, 4> timeline_infos{};
+    infos.resize(submits.size());
+    timeline_infos.resize(submits.size());
+    for (size_t i = 0; i < submits.size(); ++i) {
+        const auto& s = submits[i];
+        auto& t = timeline_infos[i];
+        t = {VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+        t.waitSemaphoreValueCount = s.wait_count;
+        t.pWaitSemaphoreValues = values.data() + s.wait_begin;
+        t.signalSemaphoreValueCount = s.signal_count;
+        t.pSignalSemaphoreValues = values.data() + signal_offset + s.signal_begin;
+
+        auto& info = infos[i];
+        info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        info.pNext = timeline ? &t : nullptr;
+        info.waitSemaphoreCount = s.wait_count;
+        info.pWaitSemaphores = sems.data() + s.wait_begin;
+        info.pWaitDstStageMask = wait_stages.data() + s.wait_begin;
+        info.commandBufferCount = s.cmd_count;
+        info.pCommandBuffers = cmds.data() + s.cmd_begin;
+        info.signalSemaphoreCount = s.signal_count;
+        info.pSignalSemaphores = sems.data() + signal_offset + s.signal_begin;
+    }
+
+    vk_validate(vkQueueSubmit(queue, u32(infos.size()), infos.data(), fence),
+        "tinyvk::submit_batch::submit - Failed to submit %u batches", u32(infos.size()));
+    clear();
+}
+
+
+#ifdef VK_VERSION_1_3
+void
+submit_batch::load_synchronization2(
+        VkDevice device) NEX
+{
+    synchronization2_submit.queue_submit2 = {};
+    if (!device)
+        return;
+    synchronization2_submit.queue_submit2 = (PFN_vkQueueSubmit2) vkGetDeviceProcAddr(device, "vkQueueSubmit2");
+    if (!synchronization2_submit.queue_submit2)
+        synchronization2_submit.queue_submit2 = (PFN_vkQueueSubmit2) vkGetDeviceProcAddr(device, "vkQueueSubmit2KHR");
+}
+
+
+void
+submit_batch::submit2(
+        VkQueue queue,
+        VkFence fence) NEX
+{
+    if (submits.empty() && !fence)
+        return;
+    tassert(synchronization2_submit.queue_submit2 && "tinyvk::submit_batch::submit2 - synchronization2 not loaded");
+
+    small_vector<VkSemaphoreSubmitInfo, 16> sems{};
+    const auto add_semaphores = [&sems](span<const semaphore_submit> list) {
+        for (auto& w: list) {
+            VkSemaphoreSubmitInfo info{VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO};
+            info.semaphore = w.semaphore;
+            info.value = w.value;
+            info.stageMask = w.stage;
+            sems.push_back(info);
+        }
+    };
+    add_semaphores({waits.data(), waits.size()});
+    add_semaphores({signals.data(), signals.size()});
+    small_vector<VkCommandBufferSubmitInfo, 16> cmd_infos{};
+    for (auto c: cmds) {
+        VkCommandBufferSubmitInfo info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+        info.commandBuffer = c;
+        cmd_infos.push_back(info);
+    }
+    const u32 signal_offset = u32(waits.size());
+
+    small_vector<VkSubmitInfo2, 4> infos{};
+    infos.resize(submits.size());
+    for (size_t i = 0; i < submits.size(); ++i) {
+        const auto& s = submits[i];
+        auto& info = infos[i];
+        info = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+        info.waitSemaphoreInfoCount = s.wait_count;
+        info.pWaitSemaphoreInfos = sems.data() + s.wait_begin;
+        info.commandBufferInfoCount = s.cmd_count;
+        info.pCommandBufferInfos = cmd_infos.data() + s.cmd_begin;
+        info.signalSemaphoreInfoCount = s.signal_count;
+        info.pSignalSemaphoreInfos = sems.data() + signal_offset + s.signal_begin;
+    }
+
+    vk_validate(synchronization2_submit.queue_submit2(queue, u32(infos.size()), infos.data(), fence),
+        "tinyvk::submit_batch::submit2 - Failed to submit %u batches", u32(infos.size()));
+    clear();
+}
+#endif
+
+//endregion
+
+#ifndef TINYVK_NO_JOBS
+
+//region submit_thread
+
+void
+submit_thread::start(
+        const queue_collection& collection,
+        u32 capacity,
+        const tinystd::job_allocator& alloc) NEX
+{
+    tassert(packets.empty() && "tinyvk::submit_thread::start - Already started");
+    for (auto q: collection.physical) {
+        queues.push_back(q);
+        packets.push_back(tinystd::mpsc_queue::create(capacity, sizeof(submit_packet), alloc));
+    }
+    pending = {};
+    thread = tinystd::job_thread::create([](void* data){ return static_cast<submit_thread*>(data)->drain(); }, this, alloc);
+}
+
+
+void
+submit_thread::stop() NEX
+{
+    flush();
+    thread.destroy();
+    for (auto& p: packets)
+        p.destroy();
+    packets.clear();
+    queues.clear();
+}
+
+
+void
+submit_thread::push(
+        u32 queue,
+        const submit_packet& packet) NEX
+{
+    tassert(packet.cmd_count <= MAX_PACKET_COMMAND_BUFFERS && packet.wait_count <= MAX_PACKET_SEMAPHORES
+        && packet.signal_count <= MAX_PACKET_SEMAPHORES && "tinyvk::submit_thread::push - Packet exceeds the packet limits");
+    pending.add(1);
+    while (!packets[queue].try_push(&packet)) {
+        thread.wake();
+        tinystd::yield_thread();
+    }
+    thread.wake();
+}
+
+
+void
+submit_thread::flush() NEX
+{
+    while (!pending.done()) {
+        thread.wake();
+        tinystd::yield_thread();
+    }
+}
+
+
+bool
+submit_thread::drain() NEX
+{
+    u32 drained = 0;
+    submit_batch batch{};
+    submit_packet p{};
+    for (u32 q = 0; q < queues.size(); ++q) {
+        u32 count = 0;
+        for (u32 i = 0; i < MAX_BATCH_PACKETS && packets[q].try_pop(&p); ++i) {
+            batch.add({p.cmds, p.cmd_count}, {p.waits, p.wait_count}, {p.signals, p.signal_count});
+            ++count;
+            if (p.fence) {
+                batch.submit(queues[q], p.fence);
+                pending.add(-i64(count));
+                drained += count;
+                count = 0;
+            }
+        }
+        if (count) {
+            batch.submit(queues[q]);
+            pending.add(-i64(count));
+            drained += count;
+        }
+    }
+    return drained > 0;
+}
+
+//endregion
+
+#endif
+
+#ifdef VK_VERSION_1_2
+
+//region submission_tracker
+
+submission_tracker
+submission_tracker::create(
+        VkDevice device,
+        const queue_collection& queues,
+        vk_alloc alloc) NEX
+{
+    submission_tracker t{};
+    // core entry points on a 1.2 device, the VK_KHR_timeline_semaphore ones on 1.1
+    t.get_counter_value = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue");
+    if (!t.get_counter_value)
+        t.get_counter_value = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+    t.wait_semaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphores");
+    if (!t.wait_semaphores)
+        t.wait_semaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+    tassert(t.get_counter_value && t.wait_semaphores
+        && "tinyvk::submission_tracker::create - Timeline semaphores need a Vulkan 1.2 device or VK_KHR_timeline_semaphore");
+
+    VkSemaphoreTypeCreateInfo type_info{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = 0;
+    VkSemaphoreCreateInfo info{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    info.pNext = &type_info;
+
+    t.timelines.resize(queues.physical.size());
+    for (auto& tl: t.timelines) {
+        tl = {};
+        vk_validate(vkCreateSemaphore(device, &info, alloc, &tl.semaphore),
+            "tinyvk::submission_tracker::create - Failed to create timeline semaphore");
+    }
+    return t;
+}
+
+
+void
+submission_tracker::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    for (auto& tl: timelines)
+        vkDestroySemaphore(device, tl.semaphore, alloc);
+    timelines.clear();
+}
+
+
+u32
+submission_tracker::queue_index(
+        const queue_collection& queues,
+        queue_type_t type,
+        u32 index) NEX
+{
+    return queues.physical_index[type][index];
+}
+
+
+retire_point
+submission_tracker::signal(
+        u32 queue,
+        submit_batch& batch,
+        pipeline_stage_flags stage) NEX
+{
+    auto& tl = timelines[queue];
+    const retire_point point{queue, ++tl.submitted};
+    if (batch.submits.empty())
+        batch.add({});
+    batch.signals.push_back({tl.semaphore, point.value, stage});
+    ++batch.submits.back().signal_count;
+    return point;
+}
+
+
+retire_point
+submission_tracker::submit(
+        const queue_collection& queues,
+        u32 queue,
+        submit_batch& batch,
+        VkFence fence) NEX
+{
+    const retire_point point = signal(queue, batch);
+    batch.submit(queues.physical[queue], fence);
+    return point;
+}
+
+
+semaphore_submit
+submission_tracker::wait_for(
+        retire_point point,
+        pipeline_stage_flags stage) const NEX
+{
+    return {timelines[point.queue].semaphore, point.value, stage};
+}
+
+
+retire_point
+submission_tracker::last_submitted(
+        u32 queue) const NEX
+{
+    return {queue, timelines[queue].submitted};
+}
+
+
+bool
+submission_tracker::completed(
+        VkDevice device,
+        retire_point point) NEX
+{
+    auto& tl = timelines[point.queue];
+    if (tl.completed >= point.value)
+        return true;
+    uint64_t value{};
+    vk_validate(get_counter_value(device, tl.semaphore, &value),
+        "tinyvk::submission_tracker::completed - Failed to get value of timeline %u", point.queue);
+    tl.completed = value;
+    return tl.completed >= point.value;
+}
+
+
+void
+submission_tracker::poll(
+        VkDevice device) NEX
+{
+    for (u32 q = 0; q < timelines.size(); ++q) {
+        auto& tl = timelines[q];
+        if (tl.completed >= tl.submitted)
+            continue;
+        uint64_t value{};
+        vk_validate(get_counter_value(device, tl.semaphore, &value),
+            "tinyvk::submission_tracker::poll - Failed to get value of timeline %u", q);
+        tl.completed = value;
+    }
+}
+
+
+ibool
+submission_tracker::wait(
+        VkDevice device,
+        retire_point point,
+        u64 timeout) NEX
+{
+    if (completed(device, point))
+        return true;
+
+    const uint64_t value = point.value;
+    VkSemaphoreWaitInfo info{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    info.semaphoreCount = 1;
+    info.pSemaphores = &timelines[point.queue].semaphore;
+    info.pValues = &value;
+    const VkResult r = wait_semaphores(device, &info, timeout);
+    if (r == VK_TIMEOUT)
+        return false;
+    vk_validate(r, "tinyvk::submission_tracker::wait - Failed to wait for value %llu of timeline %u", (unsigned long long)point.value, point.queue);
+    timelines[point.queue].completed = tinystd::max(timelines[point.queue].completed, point.value);
+    return true;
+}
+
+
+ibool
+submission_tracker::wait_idle(
+        VkDevice device,
+        u64 timeout) NEX
+{
+    small_vector<VkSemaphore, 8> sems{};
+    small_vector<uint64_t, 8> values{};
+    for (auto& tl: timelines) {
+        if (tl.completed >= tl.submitted)
+            continue;
+        sems.push_back(tl.semaphore);
+        values.push_back(tl.submitted);
+    }
+    if (sems.empty())
+        return true;
+
+    VkSemaphoreWaitInfo info{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    info.semaphoreCount = u32(sems.size());
+    info.pSemaphores = sems.data();
+    info.pValues = values.data();
+    const VkResult r = wait_semaphores(device, &info, timeout);
+    if (r == VK_TIMEOUT)
+        return false;
+    vk_validate(r, "tinyvk::submission_tracker::wait_idle - Failed to wait for timelines");
+    for (auto& tl: timelines)
+        tl.completed = tl.submitted;
+    return true;
+}
+
+//endregion
+
+#endif
+
 }
 
 #endif //TINYVK_QUEUE_CPP
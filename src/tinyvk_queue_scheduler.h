@@ -0,0 +1,265 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_QUEUE_SCHEDULER_H
+#define TINYVK_QUEUE_SCHEDULER_H
+
+#include "tinyvk_core.h"
+#include "tinyvk_queue.h"
+#include "tinyvk_command.h"
+
+#ifdef VK_VERSION_1_2
+
+namespace tinyvk {
+
+/// Routes graphics, async compute and transfer work to the queues of a queue_collection so it can overlap.
+///     - work of a type runs on the first queue of that type (queue_collection::get)
+///     - work that depends on work on another physical queue waits on that queue's timeline semaphore,
+///       dependencies on the same physical queue get no semaphore. Submission order does not make the earlier
+///       work complete or its writes visible, the consumer still needs a pipeline barrier (e.g. barrier_batch)
+///     - types without a dedicated queue (queue_collection::shared) fall back to the graphics queue, their work
+///       needs no semaphores or ownership transfers but barriers against the graphics work like any other
+/// Resources of EXCLUSIVE sharing mode handed between types need a queue family ownership transfer, record the
+/// two halves with transfer_image/transfer_buffer: release in the last command buffer of the producer and acquire
+/// in the first command buffer of the consumer (it becomes a regular barrier when both use the same family).
+/// Work is batched per physical queue until flush, which takes the queue_collection the scheduler was created
+/// with (the scheduler keeps no reference to it). Not thread safe.
+struct queue_scheduler {
+    struct route_t {
+        u32                     physical{};
+        u32                     family{};
+        u32                     batch{};
+        bool                    serialized{};
+    };
+
+    submission_tracker          tracker{};
+    route_t                     routes[MAX_QUEUE_COUNT]{};
+    submit_batch                batches[MAX_QUEUE_COUNT]{};
+
+    static queue_scheduler create(
+            VkDevice                        device,
+            const queue_collection&         queues,
+            const queue_create_info&        info,
+            vk_alloc                        alloc = {}) NEX;
+
+    void                destroy(
+            VkDevice                        device,
+            vk_alloc                        alloc = {}) NEX;
+
+    NDC const route_t&  route(
+            queue_type_t                    type) const NEX;
+
+    /// Queue work of type, it starts (at wait_stage) after everything in after completed.
+    /// Returns the point it completes at, use it in after of later work or to retire resources
+    retire_point        submit(
+            queue_type_t                    type,
+            span<const VkCommandBuffer>     cmds,
+            span<const retire_point>        after = {},
+            pipeline_stage_flags            wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            span<const semaphore_submit>    waits = {},
+            span<const semaphore_submit>    signals = {}) NEX;
+
+    /// Submit queued work to queues, one queue submit per physical queue. fence (if any) is signaled by the graphics queue
+    void                flush(
+            const queue_collection&         queues,
+            VkFence                         fence = {}) NEX;
+
+    /// Queue family ownership transfer of image from work of type from to work of type to
+    void                transfer_image(
+            barrier_batch&                  release,
+            barrier_batch&                  acquire,
+            queue_type_t                    from,
+            queue_type_t                    to,
+            VkImage                         image,
+            const VkImageSubresourceRange&  range,
+            VkImageLayout                   old_layout,
+            VkImageLayout                   new_layout,
+            barrier_access                  src,
+            barrier_access                  dst) const NEX;
+
+    /// Queue family ownership transfer of buffer from work of type from to work of type to
+    void                transfer_buffer(
+            barrier_batch&                  release,
+            barrier_batch&                  acquire,
+            queue_type_t                    from,
+            queue_type_t                    to,
+            VkBuffer                        buffer,
+            barrier_access                  src,
+            barrier_access                  dst,
+            VkDeviceSize                    offset = 0,
+            VkDeviceSize                    size = VK_WHOLE_SIZE) const NEX;
+};
+
+}
+
+#endif
+
+#endif //TINYVK_QUEUE_SCHEDULER_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_QUEUE_SCHEDULER_CPP
+#define TINYVK_QUEUE_SCHEDULER_CPP
+
+#include "tinystd_algorithm.h"
+
+#ifdef VK_VERSION_1_2
+
+namespace tinyvk {
+
+//region queue_scheduler
+
+queue_scheduler
+queue_scheduler::create(
+        VkDevice device,
+        const queue_collection& queues,
+        const queue_create_info& info,
+        vk_alloc alloc) NEX
+{
+    tassert(queues.count[QUEUE_GRAPHICS] && "tinyvk::queue_scheduler::create - A graphics queue is required");
+
+    queue_scheduler s{};
+    s.tracker = submission_tracker::create(device, queues, alloc);
+
+    for (u32 type = 0; type < MAX_QUEUE_COUNT; ++type) {
+        auto& r = s.routes[type];
+        if (type != QUEUE_GRAPHICS && (!queues.count[type] || queues.shared(queue_type_t(type)))) {
+            r = s.routes[QUEUE_GRAPHICS];
+            r.serialized = true;
+            continue;
+        }
+        r.physical = submission_tracker::queue_index(queues, queue_type_t(type));
+        r.family = info.queues[type].empty() ? 0 : info.queues[type][0].family;
+        r.batch = type;
+        // types on the same physical queue share a batch to keep their submission order
+        for (u32 t = 0; t < type; ++t) {
+            if (s.routes[t].physical == r.physical) {
+                r.batch = s.routes[t].batch;
+                break;
+            }
+        }
+    }
+    return s;
+}
+
+
+void
+queue_scheduler::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    tracker.destroy(device, alloc);
+    for (auto& b: batches)
+        b.clear();
+}
+
+
+const queue_scheduler::route_t&
+queue_scheduler::route(
+        queue_type_t type) const NEX
+{
+    return routes[type];
+}
+
+
+retire_point
+queue_scheduler::submit(
+        queue_type_t type,
+        span<const VkCommandBuffer> cmds,
+        span<const retire_point> after,
+        pipeline_stage_flags wait_stage,
+        span<const semaphore_submit> waits,
+        span<const semaphore_submit> signals) NEX
+{
+    const auto& r = routes[type];
+
+    // wait once per other physical queue, for the latest point
+    small_vector<semaphore_submit, 8> wait{};
+    for (auto& w: waits)
+        wait.push_back(w);
+    for (auto& p: after) {
+        if (!p.value || p.queue == r.physical)
+            continue;
+        const auto sem = tracker.wait_for(p, wait_stage);
+        auto it = tinystd::find_if(wait.begin(), wait.end(), [&](const semaphore_submit& w){ return w.semaphore == sem.semaphore; });
+        if (it == wait.end())
+            wait.push_back(sem);
+        else
+            it->value = tinystd::max(it->value, sem.value);
+    }
+
+    auto& batch = batches[r.batch];
+    batch.add(cmds, {wait.data(), wait.size()}, signals);
+    return tracker.signal(r.physical, batch);
+}
+
+
+void
+queue_scheduler::flush(
+        const queue_collection& queues,
+        VkFence fence) NEX
+{
+    for (u32 type = 0; type < MAX_QUEUE_COUNT; ++type) {
+        const auto& r = routes[type];
+        if (r.batch != type)
+            continue;
+        batches[type].submit(queues.physical[r.physical], type == QUEUE_GRAPHICS ? fence : VkFence{});
+    }
+}
+
+
+void
+queue_scheduler::transfer_image(
+        barrier_batch& release,
+        barrier_batch& acquire,
+        queue_type_t from,
+        queue_type_t to,
+        VkImage image,
+        const VkImageSubresourceRange& range,
+        VkImageLayout old_layout,
+        VkImageLayout new_layout,
+        barrier_access src,
+        barrier_access dst) const NEX
+{
+    const u32 src_family = routes[from].family, dst_family = routes[to].family;
+    if (src_family == dst_family) {
+        acquire.image(image, range, old_layout, new_layout, src, dst);
+        return;
+    }
+    // the destination masks of the release and the source masks of the acquire are ignored
+    release.image(image, range, old_layout, new_layout, src, {}, src_family, dst_family);
+    acquire.image(image, range, old_layout, new_layout, {}, dst, src_family, dst_family);
+}
+
+
+void
+queue_scheduler::transfer_buffer(
+        barrier_batch& release,
+        barrier_batch& acquire,
+        queue_type_t from,
+        queue_type_t to,
+        VkBuffer buffer,
+        barrier_access src,
+        barrier_access dst,
+        VkDeviceSize offset,
+        VkDeviceSize size) const NEX
+{
+    const u32 src_family = routes[from].family, dst_family = routes[to].family;
+    if (src_family == dst_family) {
+        acquire.buffer(buffer, src, dst, offset, size);
+        return;
+    }
+    release.buffer(buffer, src, {}, offset, size, src_family, dst_family);
+    acquire.buffer(buffer, {}, dst, offset, size, src_family, dst_family);
+}
+
+//endregion
+
+}
+
+#endif
+
+#endif //TINYVK_QUEUE_SCHEDULER_CPP
+
+#endif //TINYVK_IMPLEMENTATION
@@ -0,0 +1,750 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_RENDER_GRAPH_H
+#define TINYVK_RENDER_GRAPH_H
+
+#include "tinyvk_core.h"
+#include "tinyvk_command.h"
+#include "tinyvk_aliasing.h"
+
+namespace tinyvk {
+
+/// render graph high-level API
+struct default_render_graph_api_limits {
+    static constexpr size_t MAX_PASSES = 32;
+    static constexpr size_t MAX_RESOURCES = 64;
+    static constexpr size_t MAX_PASS_RESOURCES = 16;
+    static constexpr size_t MAX_BARRIERS = 128;
+    static constexpr size_t MAX_HEAPS = 4;
+};
+using render_graph_api_limits = TINYVK_RENDER_GRAPH_API_LIMITS;
+
+
+/// Frame level render graph. Passes declare the images and buffers they read and write, compile then
+///     - culls passes that do not contribute to an output (or have side effects)
+///     - derives hazards between passes (the same way renderpass_desc::builder does for subpasses) and groups
+///       passes without hazards between them into stages, passes execute stage by stage in declaration order
+///     - derives the barriers and layout transitions needed before every stage, one batch per stage
+///     - places transient resources in a few heaps, resources whose lifetimes do not overlap share memory
+/// The graph does not allocate memory. After compile, allocate heaps[i].size bytes of a memory type in
+/// heaps[i].memory_type_bits, bind transient resources at memory_offset(r) in heap_index(r) and set their handles.
+/// Passes that record render passes must use the same initial/final layouts as their declared usage.
+struct render_graph {
+    using resource_h    = u16;
+    using pass_h        = u16;
+    using record_fn     = void(*)(command cmd, void* data);
+
+    enum usage_t: u8 {
+        USAGE_COLOR_ATTACHMENT,
+        USAGE_DEPTH_ATTACHMENT,
+        USAGE_INPUT_ATTACHMENT,
+        USAGE_SAMPLED,
+        USAGE_STORAGE,
+        USAGE_UNIFORM,
+        USAGE_VERTEX,
+        USAGE_INDIRECT,
+        USAGE_TRANSFER,
+        USAGE_PRESENT,
+    };
+
+    struct usage_info {
+        barrier_access          access{};
+        VkImageLayout           layout{};
+    };
+
+    /// Transient images (optimal tiling) and buffers never share a heap, so bufferImageGranularity never applies
+    struct heap_info {
+        VkDeviceSize            size{};
+        VkDeviceSize            alignment{};
+        u32                     memory_type_bits{};
+        bool                    images{};
+    };
+
+    /// Stage, access and layout of a usage in a pass of the given type
+    NDC static usage_info usage(
+            usage_t                     usage,
+            bool                        write,
+            pipeline_type_t             type) NEX;
+
+    /// 1. Declare resources, final_layout UNDEFINED leaves imported images in whatever layout the last pass used
+    resource_h          import_image(
+            VkImage                     image,
+            VkImageLayout               initial_layout,
+            VkImageLayout               final_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+            const VkImageSubresourceRange& range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS}) NEX;
+
+    resource_h          import_buffer(
+            VkBuffer                    buffer,
+            VkDeviceSize                offset = 0,
+            VkDeviceSize                size = VK_WHOLE_SIZE) NEX;
+
+    /// Transient resources only live for the frame, the contents are undefined before their first use
+    resource_h          transient_image(
+            const VkMemoryRequirements& requirements,
+            const VkImageSubresourceRange& range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS}) NEX;
+
+    resource_h          transient_buffer(
+            const VkMemoryRequirements& requirements) NEX;
+
+    /// Passes that produce an output (and the passes they depend on) are never culled
+    void                output(
+            resource_h                  resource) NEX;
+
+    /// 2. Declare passes and their usage, passes with side effects are never culled
+    pass_h              pass(
+            const char*                 name,
+            record_fn                   fn,
+            void*                       data = {},
+            pipeline_type_t             type = PIPELINE_GRAPHICS,
+            bool                        side_effects = false) NEX;
+
+    void                read(
+            pass_h                      pass,
+            resource_h                  resource,
+            usage_t                     usage) NEX;
+
+    void                write(
+            pass_h                      pass,
+            resource_h                  resource,
+            usage_t                     usage) NEX;
+
+    /// 3. Cull, schedule, derive barriers and place transient resources
+    void                compile() NEX;
+
+    /// 4. Set the handles of transient resources once they are bound to memory
+    void                set_image(
+            resource_h                  resource,
+            VkImage                     image) NEX;
+
+    void                set_buffer(
+            resource_h                  resource,
+            VkBuffer                    buffer) NEX;
+
+    /// 5. Record barriers and passes, stage by stage
+    void                execute(
+            VkCommandBuffer             cmd) const NEX;
+
+    /// Forget all resources and passes
+    void                reset() NEX;
+
+    NDC bool            culled(pass_h pass) const NEX               { return passes[pass].culled; }
+    NDC u32             stage(pass_h pass) const NEX                { return passes[pass].stage; }
+    NDC u32             stage_count() const NEX                     { return u32(stages.size()); }
+    NDC u32             heap_index(resource_h resource) const NEX   { return resources[resource].heap; }
+    NDC VkDeviceSize    memory_offset(resource_h resource) const NEX{ return resources[resource].memory_offset; }
+
+    /// This are implementation details
+    static constexpr size_t MAX_PASSES          = render_graph_api_limits::MAX_PASSES;
+    static constexpr size_t MAX_RESOURCES       = render_graph_api_limits::MAX_RESOURCES;
+    static constexpr size_t MAX_PASS_RESOURCES  = render_graph_api_limits::MAX_PASS_RESOURCES;
+    static constexpr size_t MAX_BARRIERS        = render_graph_api_limits::MAX_BARRIERS;
+    static constexpr size_t MAX_HEAPS           = render_graph_api_limits::MAX_HEAPS;
+
+    struct write_hazard {
+        enum Type: u8 { R_AFTER_W, W_AFTER_R, W_AFTER_W };
+        Type                    type{};
+        resource_h              resource{};
+        pass_h                  src{};
+        pass_h                  dst{};
+    };
+
+    struct resource_use {
+        resource_h              resource{};
+        usage_t                 usage{};
+        bool                    write{};
+    };
+
+    struct resource_info {
+        VkImage                 image{};
+        VkBuffer                buffer{};
+        VkImageSubresourceRange range{};
+        VkDeviceSize            offset{};
+        VkDeviceSize            size{};
+        VkImageLayout           initial_layout{};
+        VkImageLayout           final_layout{};
+        VkMemoryRequirements    requirements{};
+        VkDeviceSize            memory_offset{};
+        u16                     heap{};
+        u16                     first{};
+        u16                     last{};
+        u8                      is_image: 1;
+        u8                      transient: 1;
+        u8                      is_output: 1;
+        u8                      used: 1;
+        /// Transient resources that occupied the same memory before this one
+        bitset<MAX_RESOURCES>   aliases{};
+    };
+
+    struct pass_info {
+        const char*             name{};
+        record_fn               fn{};
+        void*                   data{};
+        pipeline_type_t         type{};
+        u8                      side_effects: 1;
+        u8                      culled: 1;
+        u16                     stage{};
+        fixed_vector<resource_use, MAX_PASS_RESOURCES> uses{};
+    };
+
+    struct barrier_info {
+        u16                     stage{};
+        resource_h              resource{};
+        barrier_access          src{};
+        barrier_access          dst{};
+        VkImageLayout           old_layout{};
+        VkImageLayout           new_layout{};
+    };
+
+    void cull_passes() NEX;
+    void calculate_stages() NEX;
+    void place_transients() NEX;
+    void calculate_barriers() NEX;
+
+    fixed_vector<resource_info, MAX_RESOURCES>                  resources{};
+    fixed_vector<pass_info, MAX_PASSES>                         passes{};
+    fixed_vector<write_hazard, 2 * MAX_PASSES>                  hazards{};
+    fixed_vector<fixed_vector<u8, MAX_PASSES>, MAX_PASSES>      stages{};
+    fixed_vector<barrier_info, MAX_BARRIERS>                    barriers{};
+    fixed_vector<heap_info, MAX_HEAPS>                          heaps{};
+    bool                                                        compiled{};
+};
+
+}
+
+#endif //TINYVK_RENDER_GRAPH_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_RENDER_GRAPH_CPP
+#define TINYVK_RENDER_GRAPH_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+//region render_graph
+
+render_graph::usage_info
+render_graph::usage(
+        usage_t usage,
+        bool write,
+        pipeline_type_t type) NEX
+{
+    const pipeline_stage_flags shader_stages = type == PIPELINE_COMPUTE
+            ? pipeline_stage_flags(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+            : pipeline_stage_flags(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+#ifdef VK_VERSION_1_3
+    const access_flags sampled_read = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    const access_flags storage_read = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+    const access_flags storage_write = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+#else
+    const access_flags sampled_read = VK_ACCESS_SHADER_READ_BIT;
+    const access_flags storage_read = VK_ACCESS_SHADER_READ_BIT;
+    const access_flags storage_write = VK_ACCESS_SHADER_WRITE_BIT;
+#endif
+
+    switch (usage) {
+        case USAGE_COLOR_ATTACHMENT:
+            return {{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VkAccessFlags(VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0))},
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        case USAGE_DEPTH_ATTACHMENT:
+            return {{VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                     VkAccessFlags(VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0))},
+                    write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+        case USAGE_INPUT_ATTACHMENT:
+            tassert(!write && "tinyvk::render_graph::usage - Input attachments can not be written");
+            return {{VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT}, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        case USAGE_SAMPLED:
+            tassert(!write && "tinyvk::render_graph::usage - Sampled images can not be written");
+            return {{shader_stages, sampled_read}, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        case USAGE_STORAGE:
+            return {{shader_stages, storage_read | (write ? storage_write : 0)}, VK_IMAGE_LAYOUT_GENERAL};
+        case USAGE_UNIFORM:
+            tassert(!write && "tinyvk::render_graph::usage - Uniform buffers can not be written");
+            return {{shader_stages, VK_ACCESS_UNIFORM_READ_BIT}, VK_IMAGE_LAYOUT_UNDEFINED};
+        case USAGE_VERTEX:
+            tassert(!write && "tinyvk::render_graph::usage - Vertex buffers can not be written");
+            return {{VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT}, VK_IMAGE_LAYOUT_UNDEFINED};
+        case USAGE_INDIRECT:
+            tassert(!write && "tinyvk::render_graph::usage - Indirect buffers can not be written");
+            return {{VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT}, VK_IMAGE_LAYOUT_UNDEFINED};
+        case USAGE_TRANSFER:
+            return {{VK_PIPELINE_STAGE_TRANSFER_BIT, VkAccessFlags(write ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_TRANSFER_READ_BIT)},
+                    write ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        case USAGE_PRESENT:
+            tassert(!write && "tinyvk::render_graph::usage - Presented images can not be written");
+            return {{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0}, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+    }
+    return {};
+}
+
+
+render_graph::resource_h
+render_graph::import_image(
+        VkImage image,
+        VkImageLayout initial_layout,
+        VkImageLayout final_layout,
+        const VkImageSubresourceRange& range) NEX
+{
+    resource_info r{};
+    r.image = image;
+    r.range = range;
+    r.initial_layout = initial_layout;
+    r.final_layout = final_layout;
+    r.is_image = true;
+    r.transient = false;
+    r.is_output = final_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+    r.used = false;
+    resources.push_back(r);
+    return resource_h(resources.size() - 1);
+}
+
+
+render_graph::resource_h
+render_graph::import_buffer(
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkDeviceSize size) NEX
+{
+    resource_info r{};
+    r.buffer = buffer;
+    r.offset = offset;
+    r.size = size;
+    r.is_image = false;
+    r.transient = false;
+    r.is_output = false;
+    r.used = false;
+    resources.push_back(r);
+    return resource_h(resources.size() - 1);
+}
+
+
+render_graph::resource_h
+render_graph::transient_image(
+        const VkMemoryRequirements& requirements,
+        const VkImageSubresourceRange& range) NEX
+{
+    resource_info r{};
+    r.range = range;
+    r.requirements = requirements;
+    r.is_image = true;
+    r.transient = true;
+    r.is_output = false;
+    r.used = false;
+    resources.push_back(r);
+    return resource_h(resources.size() - 1);
+}
+
+
+render_graph::resource_h
+render_graph::transient_buffer(
+        const VkMemoryRequirements& requirements) NEX
+{
+    resource_info r{};
+    r.size = VK_WHOLE_SIZE;
+    r.requirements = requirements;
+    r.is_image = false;
+    r.transient = true;
+    r.is_output = false;
+    r.used = false;
+    resources.push_back(r);
+    return resource_h(resources.size() - 1);
+}
+
+
+void
+render_graph::output(
+        resource_h resource) NEX
+{
+    tassert(!resources[resource].transient && "tinyvk::render_graph::output - Transient resources can not be outputs");
+    resources[resource].is_output = true;
+}
+
+
+render_graph::pass_h
+render_graph::pass(
+        const char* name,
+        record_fn fn,
+        void* data,
+        pipeline_type_t type,
+        bool side_effects) NEX
+{
+    tassert(passes.size() < MAX_PASSES && "tinyvk::render_graph::pass - Too many passes, increase MAX_PASSES");
+    pass_info p{};
+    p.name = name;
+    p.fn = fn;
+    p.data = data;
+    p.type = type;
+    p.side_effects = side_effects;
+    p.culled = false;
+    passes.push_back(p);
+    compiled = false;
+    return pass_h(passes.size() - 1);
+}
+
+
+void
+render_graph::read(
+        pass_h pass,
+        resource_h resource,
+        usage_t usage) NEX
+{
+    passes[pass].uses.push_back({resource, usage, false});
+}
+
+
+void
+render_graph::write(
+        pass_h pass,
+        resource_h resource,
+        usage_t usage) NEX
+{
+    passes[pass].uses.push_back({resource, usage, true});
+}
+
+
+void
+render_graph::compile() NEX
+{
+    hazards.clear();
+    stages.clear();
+    barriers.clear();
+    heaps.clear();
+    cull_passes();
+    calculate_stages();
+    place_transients();
+    calculate_barriers();
+    compiled = true;
+}
+
+
+void
+render_graph::set_image(
+        resource_h resource,
+        VkImage image) NEX
+{
+    tassert(resources[resource].is_image && "tinyvk::render_graph::set_image - Resource is not an image");
+    resources[resource].image = image;
+}
+
+
+void
+render_graph::set_buffer(
+        resource_h resource,
+        VkBuffer buffer) NEX
+{
+    tassert(!resources[resource].is_image && "tinyvk::render_graph::set_buffer - Resource is not a buffer");
+    resources[resource].buffer = buffer;
+}
+
+
+void
+render_graph::execute(
+        VkCommandBuffer cmd) const NEX
+{
+    tassert(compiled && "tinyvk::render_graph::execute - Graph must be compiled before it is executed");
+
+    barrier_batch batch{};
+    u32 b = 0;
+    for (u32 stage = 0; stage <= stages.size(); ++stage) {
+        for (; b < barriers.size() && barriers[b].stage == stage; ++b) {
+            const auto& barrier = barriers[b];
+            const auto& r = resources[barrier.resource];
+            if (r.is_image)
+                batch.image(r.image, r.range, barrier.old_layout, barrier.new_layout, barrier.src, barrier.dst);
+            else
+                batch.buffer(r.buffer, barrier.src, barrier.dst, r.offset, r.size);
+        }
+        batch.flush(cmd);
+
+        if (stage == stages.size())
+            break;
+        for (auto p: stages[stage])
+            passes[p].fn(command::from(cmd), passes[p].data);
+    }
+}
+
+
+void
+render_graph::reset() NEX
+{
+    resources.clear();
+    passes.clear();
+    hazards.clear();
+    stages.clear();
+    barriers.clear();
+    heaps.clear();
+    compiled = false;
+}
+
+
+void
+render_graph::cull_passes() NEX
+{
+    // walk backwards from the outputs, a pass is needed if something needed later reads what it writes
+    bitset<MAX_RESOURCES> needed{};
+    for (u32 r = 0; r < resources.size(); ++r)
+        if (resources[r].is_output)
+            needed.set(r);
+
+    for (u32 i = passes.size(); i > 0; --i) {
+        auto& p = passes[i - 1];
+        bool keep = p.side_effects;
+        for (auto& u: p.uses)
+            keep |= u.write && needed.test(u.resource);
+        p.culled = !keep;
+        if (!keep)
+            continue;
+        for (auto& u: p.uses)
+            if (!u.write)
+                needed.set(u.resource);
+    }
+}
+
+
+void
+render_graph::calculate_stages() NEX
+{
+    for (auto& r: resources) {
+        r.used = false;
+        r.first = r.last = 0;
+    }
+
+    // calculate write hazards between passes, a pass is placed one stage after every pass it depends on
+    u16 max_stage{};
+    for (u32 p1 = 0; p1 < passes.size(); ++p1) {
+        auto& dst = passes[p1];
+        dst.stage = 0;
+        if (dst.culled)
+            continue;
+
+        for (auto& u1: dst.uses) {
+            for (u32 p0 = 0; p0 < p1; ++p0) {
+                const auto& src = passes[p0];
+                if (src.culled)
+                    continue;
+                for (auto& u0: src.uses) {
+                    if (u0.resource != u1.resource)
+                        continue;
+                    // reads in different layouts can not happen at the same time either
+                    const bool layout_change = resources[u0.resource].is_image
+                            && usage(u0.usage, u0.write, src.type).layout != usage(u1.usage, u1.write, dst.type).layout;
+                    if (!u0.write && !u1.write && !layout_change)
+                        continue;
+
+                    write_hazard h{};
+                    h.resource = u1.resource;
+                    h.src = p0;
+                    h.dst = p1;
+                    if      (u0.write && u1.write) h.type = write_hazard::W_AFTER_W;
+                    else if (u0.write)             h.type = write_hazard::R_AFTER_W;
+                    else                           h.type = write_hazard::W_AFTER_R;
+                    if (tinystd::find_if(hazards.begin(), hazards.end(),
+                        [&h](auto& v){ return v.resource == h.resource && v.src == h.src && v.dst == h.dst; }) == hazards.end())
+                    {
+                        hazards.push_back(h);
+                    }
+                    dst.stage = tinystd::max(dst.stage, u16(src.stage + 1));
+                }
+            }
+        }
+        max_stage = tinystd::max(max_stage, dst.stage);
+    }
+
+    // record final stages per pass and the lifetime of every resource
+    if (tinystd::all_of(passes.begin(), passes.end(), [](auto& p){ return p.culled; }))
+        return;
+    stages.resize(max_stage + 1);
+    for (auto& s: stages)
+        s.clear();
+    for (u32 i = 0; i < passes.size(); ++i) {
+        const auto& p = passes[i];
+        if (p.culled)
+            continue;
+        stages[p.stage].push_back(i);
+        for (auto& u: p.uses) {
+            auto& r = resources[u.resource];
+            r.first = r.used ? tinystd::min(r.first, p.stage) : p.stage;
+            r.last = r.used ? tinystd::max(r.last, p.stage) : p.stage;
+            r.used = true;
+        }
+    }
+}
+
+
+void
+render_graph::calculate_barriers() NEX
+{
+    struct resource_state {
+        VkImageLayout           layout{};
+        barrier_access          write{};
+        pipeline_stage_flags    read_stages{};
+        pipeline_stage_flags    visible_stages{};
+    };
+
+    struct stage_use {
+        barrier_access          access{};
+        VkImageLayout           layout{};
+        bool                    write{};
+        bool                    used{};
+    };
+
+    fixed_vector<resource_state, MAX_RESOURCES> states{};
+    states.resize(resources.size());
+    for (u32 r = 0; r < resources.size(); ++r)
+        states[r] = {resources[r].initial_layout};
+
+    fixed_vector<stage_use, MAX_RESOURCES> uses{};
+    uses.resize(resources.size());
+    for (u16 stage = 0; stage < stages.size(); ++stage) {
+        // gather every use of every resource in this stage, passes in a stage do not conflict
+        for (auto& u: uses) u = {};
+        for (auto p: stages[stage]) {
+            for (auto& ru: passes[p].uses) {
+                const auto info = usage(ru.usage, ru.write, passes[p].type);
+                auto& u = uses[ru.resource];
+                tassert((!u.used || !resources[ru.resource].is_image || u.layout == info.layout)
+                        && "tinyvk::render_graph::compile - Resource is used with different layouts in one pass");
+                u.access.stage |= info.access.stage;
+                u.access.access |= info.access.access;
+                u.layout = info.layout;
+                u.write |= ru.write;
+                u.used = true;
+            }
+        }
+
+        for (u16 r = 0; r < resources.size(); ++r) {
+            const auto& u = uses[r];
+            if (!u.used)
+                continue;
+            auto& s = states[r];
+            const auto& res = resources[r];
+            const VkImageLayout layout = res.is_image ? u.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+            // the first use of a transient resource waits for everything that used its memory before
+            barrier_access src{s.write.stage | s.read_stages, s.write.access};
+            if (res.transient && res.first == stage) {
+                for (u32 a = 0; a < resources.size(); ++a) {
+                    if (!res.aliases.test(a)) continue;
+                    src.stage |= states[a].write.stage | states[a].read_stages;
+                    src.access |= states[a].write.access;
+                }
+            }
+
+            const bool layout_change = res.is_image && layout != s.layout;
+            const bool needs_barrier = layout_change
+                    || (u.write && src.stage)
+                    || (!u.write && s.write.stage && (u.access.stage & ~s.visible_stages));
+            if (needs_barrier) {
+                if (!layout_change && !u.write)
+                    src = s.write;
+                if (!src.stage)
+                    src.stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                tassert(barriers.size() < MAX_BARRIERS && "tinyvk::render_graph::compile - Too many barriers, increase MAX_BARRIERS");
+                barriers.push_back({stage, r, src, u.access, s.layout, layout});
+            }
+
+            if (u.write) {
+                s.write = u.access;
+                s.read_stages = 0;
+                s.visible_stages = 0;
+            }
+            else {
+                s.read_stages |= u.access.stage;
+                s.visible_stages = layout_change ? u.access.stage : s.visible_stages | (needs_barrier ? u.access.stage : 0);
+            }
+            s.layout = layout;
+        }
+    }
+
+    // transition imported images to their final layout after the last stage
+    for (u16 r = 0; r < resources.size(); ++r) {
+        const auto& res = resources[r];
+        const auto& s = states[r];
+        if (!res.is_image || res.transient || res.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || res.final_layout == s.layout)
+            continue;
+        barrier_access src{s.write.stage | s.read_stages, s.write.access};
+        if (!src.stage)
+            src.stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        barriers.push_back({u16(stages.size()), r, src,
+                            {VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT},
+                            s.layout, res.final_layout});
+    }
+}
+
+
+void
+render_graph::place_transients() NEX
+{
+    // largest first, every resource goes to the first heap of its kind (images or buffers) that supports its memory types
+    fixed_vector<resource_h, MAX_RESOURCES> order{};
+    for (u16 r = 0; r < resources.size(); ++r) {
+        auto& res = resources[r];
+        res.aliases.reset();
+        res.heap = 0;
+        res.memory_offset = 0;
+        if (!res.transient || !res.used)
+            continue;
+        u32 i = order.size();
+        order.push_back(r);
+        for (; i > 0 && resources[order[i - 1]].requirements.size < res.requirements.size; --i)
+            order[i] = order[i - 1];
+        order[i] = r;
+    }
+
+    for (auto r: order) {
+        auto& res = resources[r];
+        u32 heap = 0;
+        for (; heap < heaps.size(); ++heap)
+            if (heaps[heap].images == res.is_image && (heaps[heap].memory_type_bits & res.requirements.memoryTypeBits))
+                break;
+        if (heap == heaps.size()) {
+            tassert(heaps.size() < MAX_HEAPS && "tinyvk::render_graph::compile - Too many heaps, increase MAX_HEAPS");
+            heaps.push_back({0, 1, res.requirements.memoryTypeBits, bool(res.is_image)});
+        }
+        res.heap = u16(heap);
+        heaps[heap].memory_type_bits &= res.requirements.memoryTypeBits;
+    }
+
+    // resources of a heap whose lifetimes do not overlap share memory
+    fixed_vector<resource_h, MAX_RESOURCES> placed{};
+    fixed_vector<aliased_range, MAX_RESOURCES> ranges{};
+    VkDeviceSize offsets[MAX_RESOURCES]{};
+    for (u32 heap = 0; heap < heaps.size(); ++heap) {
+        placed.clear();
+        ranges.clear();
+        for (auto r: order) {
+            const auto& res = resources[r];
+            if (res.heap != heap)
+                continue;
+            placed.push_back(r);
+            ranges.push_back({res.requirements, res.first, res.last});
+        }
+        const VkMemoryRequirements total = place_aliased(ranges, {offsets, ranges.size()});
+        heaps[heap] = {total.size, total.alignment, total.memoryTypeBits, heaps[heap].images};
+
+        // resources sharing memory must be synchronized, the later one waits for the earlier one
+        for (u32 i = 0; i < placed.size(); ++i) {
+            auto& res = resources[placed[i]];
+            res.memory_offset = offsets[i];
+            for (u32 j = 0; j < i; ++j) {
+                auto& other = resources[placed[j]];
+                if (!overlaps_memory(ranges[i], offsets[i], ranges[j], offsets[j]))
+                    continue;
+                if (other.last < res.first) res.aliases.set(placed[j]);
+                else                        other.aliases.set(placed[i]);
+            }
+        }
+    }
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_RENDER_GRAPH_CPP
+
+#endif //TINYVK_IMPLEMENTATION
@@ -0,0 +1,494 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_RESOURCE_CACHE_H
+#define TINYVK_RESOURCE_CACHE_H
+
+#include "tinyvk_core.h"
+#ifdef TINYVK_USE_VMA
+#include "tinyvk_image.h"
+#endif
+
+namespace tinyvk {
+
+struct default_resource_cache_api_limits {
+    static constexpr size_t SAMPLER_CACHE_STACK_SIZE    = 16;
+    static constexpr size_t VIEW_CACHE_STACK_SIZE       = 64;
+};
+using resource_cache_api_limits = TINYVK_RESOURCE_CACHE_API_LIMITS;
+
+
+/// The full state of a sampler, max_anisotropy of 0 disables anisotropic filtering and compare_op is only used
+/// when compare is set
+struct sampler_desc {
+    VkFilter                mag_filter{VK_FILTER_LINEAR};
+    VkFilter                min_filter{VK_FILTER_LINEAR};
+    VkSamplerMipmapMode     mipmap_mode{VK_SAMPLER_MIPMAP_MODE_LINEAR};
+    VkSamplerAddressMode    address_u{VK_SAMPLER_ADDRESS_MODE_REPEAT};
+    VkSamplerAddressMode    address_v{VK_SAMPLER_ADDRESS_MODE_REPEAT};
+    VkSamplerAddressMode    address_w{VK_SAMPLER_ADDRESS_MODE_REPEAT};
+    float                   mip_lod_bias{};
+    float                   max_anisotropy{};
+    bool                    compare{};
+    VkCompareOp             compare_op{VK_COMPARE_OP_NEVER};
+    float                   min_lod{};
+    float                   max_lod{VK_LOD_CLAMP_NONE};
+    VkBorderColor           border_color{VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK};
+    bool                    unnormalized_coordinates{};
+
+    NDC u64                 hash_code() const NEX;
+
+    NDC bool                operator==(
+            const sampler_desc&         other) const NEX;
+
+    NDC VkSamplerCreateInfo create_info() const NEX;
+};
+
+
+struct sampler : type_wrapper<sampler, VkSampler> {
+
+    static sampler          create(
+            VkDevice                    device,
+            const sampler_desc&         desc,
+            vk_alloc                    alloc = {}) NEX;
+
+    void                    destroy(
+            VkDevice                    device,
+            vk_alloc                    alloc = {}) NEX;
+};
+
+
+/// Refcounted samplers keyed by their full state. Drivers limit the number of live samplers
+/// (maxSamplerAllocationCount, 4000 on many of them) and materials mostly share a handful of states, so create
+/// returns the existing sampler for a state it has seen and destroy only destroys it with its last reference
+struct sampler_cache {
+    static constexpr size_t N   = resource_cache_api_limits::SAMPLER_CACHE_STACK_SIZE;
+
+    small_vector<u64, N>            m_hashes{};
+    small_vector<sampler_desc, N>   m_descs{};
+    small_vector<sampler, N>        m_samplers{};
+    small_vector<u32, N>            m_ref_counts{};
+
+    sampler                 create(
+            VkDevice                    device,
+            const sampler_desc&         desc,
+            ibool*                      is_new = {},
+            vk_alloc                    alloc = {}) NEX;
+
+    /// Release one reference to s, the sampler is destroyed with its last reference
+    void                    destroy(
+            VkDevice                    device,
+            VkSampler                   s,
+            vk_alloc                    alloc = {}) NEX;
+
+    /// Destroy all samplers regardless of their references
+    void                    destroy(
+            VkDevice                    device,
+            vk_alloc                    alloc = {}) NEX;
+
+    NDC size_t              size() const NEX { return m_samplers.size(); }
+};
+
+
+/// Everything that identifies an image view (the pNext chain and flags of the create info are not part of it)
+struct image_view_key {
+    VkImage                 image{};
+    VkImageViewType         type{};
+    VkFormat                format{};
+    VkComponentMapping      components{};
+    VkImageSubresourceRange range{};
+
+    static image_view_key   from(
+            const VkImageViewCreateInfo& info) NEX;
+
+    NDC u64                 hash_code() const NEX;
+
+    NDC bool                operator==(
+            const image_view_key&       other) const NEX;
+};
+
+
+/// Refcounted image views keyed by the image and the view description, so materials that sample the same
+/// mips and layers of a texture share one view. destroy_image destroys every view of an image regardless of their
+/// references and must be called before the image itself is destroyed, since a new image can reuse the handle
+struct image_view_cache {
+    static constexpr size_t N   = resource_cache_api_limits::VIEW_CACHE_STACK_SIZE;
+
+    small_vector<u64, N>            m_hashes{};
+    small_vector<image_view_key, N> m_keys{};
+    small_vector<VkImageView, N>    m_views{};
+    small_vector<u32, N>            m_ref_counts{};
+
+    VkImageView             create(
+            VkDevice                    device,
+            const VkImageViewCreateInfo& info,
+            ibool*                      is_new = {},
+            vk_alloc                    alloc = {}) NEX;
+
+#ifdef TINYVK_USE_VMA
+    /// The cached equivalent of image_view::create
+    VkImageView             create(
+            VkDevice                    device,
+            VkImage                     image,
+            image_view_desc             desc,
+            const image_dimensions&     dim,
+            ibool*                      is_new = {},
+            vk_alloc                    alloc = {}) NEX;
+#endif
+
+    /// Release one reference to view, the view is destroyed with its last reference
+    void                    destroy(
+            VkDevice                    device,
+            VkImageView                 view,
+            vk_alloc                    alloc = {}) NEX;
+
+    /// Destroy all views of image regardless of their references
+    void                    destroy_image(
+            VkDevice                    device,
+            VkImage                     image,
+            vk_alloc                    alloc = {}) NEX;
+
+    /// Destroy all views regardless of their references
+    void                    destroy(
+            VkDevice                    device,
+            vk_alloc                    alloc = {}) NEX;
+
+    NDC size_t              size() const NEX { return m_views.size(); }
+
+private:
+    void                    remove(
+            VkDevice                    device,
+            u32                         i,
+            vk_alloc                    alloc) NEX;
+};
+
+}
+
+#endif //TINYVK_RESOURCE_CACHE_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_RESOURCE_CACHE_CPP
+#define TINYVK_RESOURCE_CACHE_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+static u32 resource_cache_float_bits(float f) NEX
+{
+    u32 v{};
+    tinystd::memcpy(&v, &f, sizeof(float));
+    return v;
+}
+
+//region sampler_desc
+
+u64
+sampler_desc::hash_code() const NEX
+{
+    size_t h{1};
+    tinystd::hash_combine(h, mag_filter);
+    tinystd::hash_combine(h, min_filter);
+    tinystd::hash_combine(h, mipmap_mode);
+    tinystd::hash_combine(h, address_u);
+    tinystd::hash_combine(h, address_v);
+    tinystd::hash_combine(h, address_w);
+    tinystd::hash_combine(h, resource_cache_float_bits(mip_lod_bias));
+    tinystd::hash_combine(h, resource_cache_float_bits(max_anisotropy));
+    tinystd::hash_combine(h, compare ? compare_op + 1 : 0);
+    tinystd::hash_combine(h, resource_cache_float_bits(min_lod));
+    tinystd::hash_combine(h, resource_cache_float_bits(max_lod));
+    tinystd::hash_combine(h, border_color);
+    tinystd::hash_combine(h, unnormalized_coordinates);
+    return h;
+}
+
+
+bool
+sampler_desc::operator==(
+        const sampler_desc& other) const NEX
+{
+    // floats are compared by their bits to agree with hash_code
+    return mag_filter == other.mag_filter && min_filter == other.min_filter && mipmap_mode == other.mipmap_mode
+        && address_u == other.address_u && address_v == other.address_v && address_w == other.address_w
+        && resource_cache_float_bits(mip_lod_bias) == resource_cache_float_bits(other.mip_lod_bias)
+        && resource_cache_float_bits(max_anisotropy) == resource_cache_float_bits(other.max_anisotropy)
+        && compare == other.compare && (!compare || compare_op == other.compare_op)
+        && resource_cache_float_bits(min_lod) == resource_cache_float_bits(other.min_lod)
+        && resource_cache_float_bits(max_lod) == resource_cache_float_bits(other.max_lod)
+        && border_color == other.border_color && unnormalized_coordinates == other.unnormalized_coordinates;
+}
+
+
+VkSamplerCreateInfo
+sampler_desc::create_info() const NEX
+{
+    VkSamplerCreateInfo info{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    info.magFilter = mag_filter;
+    info.minFilter = min_filter;
+    info.mipmapMode = mipmap_mode;
+    info.addressModeU = address_u;
+    info.addressModeV = address_v;
+    info.addressModeW = address_w;
+    info.mipLodBias = mip_lod_bias;
+    info.anisotropyEnable = max_anisotropy > 0.0f;
+    info.maxAnisotropy = max_anisotropy > 0.0f ? max_anisotropy : 1.0f;
+    info.compareEnable = compare;
+    info.compareOp = compare ? compare_op : VK_COMPARE_OP_NEVER;
+    info.minLod = min_lod;
+    info.maxLod = max_lod;
+    info.borderColor = border_color;
+    info.unnormalizedCoordinates = unnormalized_coordinates;
+    return info;
+}
+
+//endregion
+
+//region sampler
+
+sampler
+sampler::create(
+        VkDevice device,
+        const sampler_desc& desc,
+        vk_alloc alloc) NEX
+{
+    sampler s{};
+    const VkSamplerCreateInfo info = desc.create_info();
+    vk_validate(vkCreateSampler(device, &info, alloc, &s.vk),
+        "tinyvk::sampler::create - Failed to create sampler");
+    return s;
+}
+
+
+void
+sampler::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    vkDestroySampler(device, vk, alloc);
+    vk = {};
+}
+
+//endregion
+
+//region sampler_cache
+
+sampler
+sampler_cache::create(
+        VkDevice device,
+        const sampler_desc& desc,
+        ibool* is_new,
+        vk_alloc alloc) NEX
+{
+    const u64 h = desc.hash_code();
+    for (u32 i = 0; i < m_hashes.size(); ++i) {
+        if (m_hashes[i] == h && m_descs[i] == desc) {
+            if (is_new) *is_new = false;
+            ++m_ref_counts[i];
+            return m_samplers[i];
+        }
+    }
+
+    if (is_new) *is_new = true;
+    const sampler s = sampler::create(device, desc, alloc);
+    m_hashes.push_back(h);
+    m_descs.push_back(desc);
+    m_samplers.push_back(s);
+    m_ref_counts.push_back(1);
+    return s;
+}
+
+
+void
+sampler_cache::destroy(
+        VkDevice device,
+        VkSampler s,
+        vk_alloc alloc) NEX
+{
+    auto* it = tinystd::find_if(m_samplers.begin(), m_samplers.end(), [s](const sampler& v){ return v.vk == s; });
+    tassert(it != m_samplers.end() && "tinyvk::sampler_cache::destroy - Sampler is not in the cache");
+    if (it == m_samplers.end())
+        return;
+
+    const u32 i = it - m_samplers.begin();
+    if (--m_ref_counts[i] == 0) {
+        vkDestroySampler(device, s, alloc);
+        m_hashes[i] = m_hashes.pop_back();
+        m_descs[i] = m_descs.pop_back();
+        m_samplers[i] = m_samplers.pop_back();
+        m_ref_counts[i] = m_ref_counts.pop_back();
+    }
+}
+
+
+void
+sampler_cache::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    for (auto& s: m_samplers)
+        s.destroy(device, alloc);
+    m_hashes.clear();
+    m_descs.clear();
+    m_samplers.clear();
+    m_ref_counts.clear();
+}
+
+//endregion
+
+//region image_view_key
+
+image_view_key
+image_view_key::from(
+        const VkImageViewCreateInfo& info) NEX
+{
+    return {info.image, info.viewType, info.format, info.components, info.subresourceRange};
+}
+
+
+u64
+image_view_key::hash_code() const NEX
+{
+    size_t h{1};
+    tinystd::hash_combine(h, size_t(u64(image)));
+    tinystd::hash_combine(h, type);
+    tinystd::hash_combine(h, format);
+    tinystd::hash_combine(h, components.r | (components.g << 8) | (components.b << 16) | (components.a << 24));
+    tinystd::hash_combine(h, range.aspectMask);
+    tinystd::hash_combine(h, range.baseMipLevel);
+    tinystd::hash_combine(h, range.levelCount);
+    tinystd::hash_combine(h, range.baseArrayLayer);
+    tinystd::hash_combine(h, range.layerCount);
+    return h;
+}
+
+
+bool
+image_view_key::operator==(
+        const image_view_key& other) const NEX
+{
+    return image == other.image && type == other.type && format == other.format
+        && components.r == other.components.r && components.g == other.components.g
+        && components.b == other.components.b && components.a == other.components.a
+        && range.aspectMask == other.range.aspectMask
+        && range.baseMipLevel == other.range.baseMipLevel && range.levelCount == other.range.levelCount
+        && range.baseArrayLayer == other.range.baseArrayLayer && range.layerCount == other.range.layerCount;
+}
+
+//endregion
+
+//region image_view_cache
+
+VkImageView
+image_view_cache::create(
+        VkDevice device,
+        const VkImageViewCreateInfo& info,
+        ibool* is_new,
+        vk_alloc alloc) NEX
+{
+    tassert(!info.pNext && !info.flags && "tinyvk::image_view_cache::create - Views with pNext or flags can not be cached");
+    const image_view_key key = image_view_key::from(info);
+    const u64 h = key.hash_code();
+    for (u32 i = 0; i < m_hashes.size(); ++i) {
+        if (m_hashes[i] == h && m_keys[i] == key) {
+            if (is_new) *is_new = false;
+            ++m_ref_counts[i];
+            return m_views[i];
+        }
+    }
+
+    if (is_new) *is_new = true;
+    VkImageView view{};
+    vk_validate(vkCreateImageView(device, &info, alloc, &view),
+        "tinyvk::image_view_cache::create - Failed to create image view");
+    m_hashes.push_back(h);
+    m_keys.push_back(key);
+    m_views.push_back(view);
+    m_ref_counts.push_back(1);
+    return view;
+}
+
+
+#ifdef TINYVK_USE_VMA
+VkImageView
+image_view_cache::create(
+        VkDevice device,
+        VkImage image,
+        image_view_desc desc,
+        const image_dimensions& dim,
+        ibool* is_new,
+        vk_alloc alloc) NEX
+{
+    return create(device, image_view::create_info(desc, image, dim), is_new, alloc);
+}
+#endif
+
+
+void
+image_view_cache::destroy(
+        VkDevice device,
+        VkImageView view,
+        vk_alloc alloc) NEX
+{
+    auto* it = tinystd::find(m_views.begin(), m_views.end(), view);
+    tassert(it != m_views.end() && "tinyvk::image_view_cache::destroy - View is not in the cache");
+    if (it == m_views.end())
+        return;
+
+    const u32 i = it - m_views.begin();
+    if (--m_ref_counts[i] == 0)
+        remove(device, i, alloc);
+}
+
+
+void
+image_view_cache::destroy_image(
+        VkDevice device,
+        VkImage image,
+        vk_alloc alloc) NEX
+{
+    for (u32 i = 0; i < m_keys.size();) {
+        if (m_keys[i].image == image)
+            remove(device, i, alloc);
+        else
+            ++i;
+    }
+}
+
+
+void
+image_view_cache::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    for (auto view: m_views)
+        vkDestroyImageView(device, view, alloc);
+    m_hashes.clear();
+    m_keys.clear();
+    m_views.clear();
+    m_ref_counts.clear();
+}
+
+
+void
+image_view_cache::remove(
+        VkDevice device,
+        u32 i,
+        vk_alloc alloc) NEX
+{
+    vkDestroyImageView(device, m_views[i], alloc);
+    m_hashes[i] = m_hashes.pop_back();
+    m_keys[i] = m_keys.pop_back();
+    m_views[i] = m_views.pop_back();
+    m_ref_counts[i] = m_ref_counts.pop_back();
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_RESOURCE_CACHE_CPP
+
+#endif //TINYVK_IMPLEMENTATION
@@ -0,0 +1,546 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_RESOURCE_POOL_H
+#define TINYVK_RESOURCE_POOL_H
+
+#include "tinyvk_core.h"
+#ifdef TINYVK_USE_VMA
+#include "tinyvk_buffer.h"
+#include "tinyvk_image.h"
+#endif
+
+namespace tinyvk {
+
+/// 32 bit handle to a resource in a pool, the low INDEX_BITS are the slot and the rest is its generation.
+/// The generation of a slot changes when its resource is removed, so a stale handle never finds the resource that
+/// reuses the slot. 0 is never a valid handle
+template<typename T>
+struct resource_handle {
+    u32                 value{};
+
+    NDC explicit operator bool() const NEX { return value != 0; }
+    NDC bool            operator==(resource_handle other) const NEX { return value == other.value; }
+    NDC bool            operator!=(resource_handle other) const NEX { return value != other.value; }
+};
+
+using buffer_handle = resource_handle<buffer>;
+using image_handle  = resource_handle<image>;
+
+
+/// Maps generational handles to dense indices. Resources live in parallel arrays packed at [0, size()), insert
+/// appends one and remove returns the index the caller fills with the last element of every array
+/// (arr[i] = arr.pop_back(), as the caches do), so per frame passes iterate without holes
+struct handle_table {
+    static constexpr u32    INDEX_BITS      = 20;
+    static constexpr u32    INDEX_MASK      = (1u << INDEX_BITS) - 1;
+    static constexpr u32    GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+    static constexpr u32    INVALID         = -1u;
+    static constexpr size_t N               = 64;
+
+    small_vector<u32, N>    m_generations{};
+    small_vector<u32, N>    m_dense{};
+    small_vector<u32, N>    m_slots{};
+    u32                     m_free{INVALID};
+
+    /// Handle of a new element at index size() - 1
+    NDC u32             insert() NEX;
+
+    /// Index of the element of handle, to be swap removed by the caller, INVALID if the handle is stale
+    NDC u32             remove(
+            u32                         handle) NEX;
+
+    /// Index of the element of handle, INVALID if the handle is stale
+    NDC u32             find(
+            u32                         handle) const NEX;
+
+    /// Handle of the element at index
+    NDC u32             handle(
+            u32                         index) const NEX;
+
+    NDC u32             size() const NEX { return u32(m_slots.size()); }
+
+    void                clear() NEX;
+};
+
+
+/// The last use of a resource, what the next barrier waits for
+struct resource_state {
+    pipeline_stage_flags    stage{};
+    access_flags            access{};
+    VkImageLayout           layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    u32                     queue_family{VK_QUEUE_FAMILY_IGNORED};
+};
+
+
+/// Buffers with their size, mapping, state and allocation stored as structure of arrays. The arrays are dense
+/// (index i belongs to table.handle(i)), iterate them directly for barrier generation or residency checks.
+/// Buffers added with insert are owned by the caller and removed with erase, those from create are owned by the pool
+struct buffer_pool {
+    static constexpr size_t N   = handle_table::N;
+
+    handle_table                    table{};
+    small_vector<VkBuffer, N>       buffers{};
+    small_vector<u64, N>            sizes{};
+    small_vector<void*, N>          mapped{};
+    small_vector<resource_state, N> states{};
+#ifdef TINYVK_USE_VMA
+    small_vector<VmaAllocation, N>  allocations{};
+#endif
+
+    NDC buffer_handle   insert(
+            VkBuffer                        buffer,
+            u64                             size,
+            void*                           mapped_data = {}) NEX;
+
+    /// Remove a buffer added with insert without destroying it, returns false if the handle is stale
+    bool                erase(
+            buffer_handle                   h) NEX;
+
+    /// Forget all buffers without destroying them
+    void                clear() NEX;
+
+#ifdef TINYVK_USE_VMA
+    NDC buffer_handle   create(
+            VmaAllocator                    vma,
+            const buffer_desc&              desc) NEX;
+
+    /// Destroy a buffer created by the pool, returns false if the handle is stale
+    bool                destroy(
+            VmaAllocator                    vma,
+            buffer_handle                   h) NEX;
+
+    /// Destroy all buffers created by the pool and forget the inserted ones
+    void                destroy(
+            VmaAllocator                    vma) NEX;
+#endif
+
+    /// Index into the arrays, -1u if the handle is stale
+    NDC u32             index(buffer_handle h) const NEX { return table.find(h.value); }
+
+    NDC bool            valid(buffer_handle h) const NEX { return index(h) != handle_table::INVALID; }
+
+    /// The buffer of h, null if the handle is stale
+    NDC VkBuffer        get(
+            buffer_handle                   h) const NEX;
+
+    /// The state of h, null if the handle is stale
+    NDC resource_state* state(
+            buffer_handle                   h) NEX;
+
+    NDC buffer_handle   handle(u32 index) const NEX { return {table.handle(index)}; }
+
+    NDC u32             size() const NEX { return table.size(); }
+
+private:
+    void                erase_at(
+            u32                             index) NEX;
+};
+
+
+#ifdef TINYVK_USE_VMA
+
+/// Images with their dimensions, state and allocation stored as structure of arrays, see buffer_pool
+struct image_pool {
+    static constexpr size_t N   = handle_table::N;
+
+    handle_table                        table{};
+    small_vector<VkImage, N>            images{};
+    small_vector<image_dimensions, N>   dimensions{};
+    small_vector<resource_state, N>     states{};
+    small_vector<VmaAllocation, N>      allocations{};
+
+    NDC image_handle    insert(
+            VkImage                         image,
+            const image_dimensions&         dim,
+            VkImageLayout                   layout = VK_IMAGE_LAYOUT_UNDEFINED) NEX;
+
+    /// Remove an image added with insert without destroying it, returns false if the handle is stale
+    bool                erase(
+            image_handle                    h) NEX;
+
+    NDC image_handle    create(
+            VmaAllocator                    vma,
+            const image_desc&               desc,
+            vk_alloc                        alloc = {}) NEX;
+
+    /// Destroy an image created by the pool, returns false if the handle is stale
+    bool                destroy(
+            VmaAllocator                    vma,
+            image_handle                    h,
+            vk_alloc                        alloc = {}) NEX;
+
+    /// Destroy all images created by the pool and forget the inserted ones
+    void                destroy(
+            VmaAllocator                    vma,
+            vk_alloc                        alloc = {}) NEX;
+
+    NDC u32             index(image_handle h) const NEX { return table.find(h.value); }
+
+    NDC bool            valid(image_handle h) const NEX { return index(h) != handle_table::INVALID; }
+
+    NDC VkImage         get(
+            image_handle                    h) const NEX;
+
+    NDC const image_dimensions* dims(
+            image_handle                    h) const NEX;
+
+    NDC resource_state* state(
+            image_handle                    h) NEX;
+
+    NDC image_handle    handle(u32 index) const NEX { return {table.handle(index)}; }
+
+    NDC u32             size() const NEX { return table.size(); }
+
+private:
+    void                erase_at(
+            u32                             index) NEX;
+};
+
+#endif
+
+}
+
+#endif //TINYVK_RESOURCE_POOL_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_RESOURCE_POOL_CPP
+#define TINYVK_RESOURCE_POOL_CPP
+
+namespace tinyvk {
+
+//region handle_table
+
+u32
+handle_table::insert() NEX
+{
+    u32 slot = m_free;
+    if (slot != INVALID) {
+        m_free = m_dense[slot];
+    } else {
+        slot = u32(m_generations.size());
+        tassert(slot <= INDEX_MASK && "tinyvk::handle_table::insert - Too many slots");
+        m_generations.push_back(1);
+        m_dense.push_back(0);
+    }
+    m_dense[slot] = u32(m_slots.size());
+    m_slots.push_back(slot);
+    return slot | (m_generations[slot] << INDEX_BITS);
+}
+
+
+u32
+handle_table::remove(
+        u32 h) NEX
+{
+    const u32 index = find(h);
+    if (index == INVALID)
+        return INVALID;
+
+    const u32 slot = h & INDEX_MASK;
+    const u32 last = m_slots.pop_back();
+    if (last != slot) {
+        m_slots[index] = last;
+        m_dense[last] = index;
+    }
+    // generation 0 is skipped so that no handle is 0, a slot is reused after GENERATION_MASK removals
+    m_generations[slot] = m_generations[slot] == GENERATION_MASK ? 1 : m_generations[slot] + 1;
+    m_dense[slot] = m_free;
+    m_free = slot;
+    return index;
+}
+
+
+u32
+handle_table::find(
+        u32 h) const NEX
+{
+    const u32 slot = h & INDEX_MASK;
+    if (!h || slot >= m_generations.size() || m_generations[slot] != (h >> INDEX_BITS))
+        return INVALID;
+    const u32 index = m_dense[slot];
+    return index < m_slots.size() && m_slots[index] == slot ? index : INVALID;
+}
+
+
+u32
+handle_table::handle(
+        u32 index) const NEX
+{
+    tassert(index < m_slots.size() && "tinyvk::handle_table::handle - Index out of range");
+    const u32 slot = m_slots[index];
+    return slot | (m_generations[slot] << INDEX_BITS);
+}
+
+
+void
+handle_table::clear() NEX
+{
+    // bump the generations of the live slots so that handles from before the clear are stale
+    for (const u32 slot: m_slots)
+        m_generations[slot] = m_generations[slot] == GENERATION_MASK ? 1 : m_generations[slot] + 1;
+    m_free = INVALID;
+    for (u32 slot = u32(m_generations.size()); slot-- > 0;) {
+        m_dense[slot] = m_free;
+        m_free = slot;
+    }
+    m_slots.clear();
+}
+
+//endregion
+
+//region buffer_pool
+
+buffer_handle
+buffer_pool::insert(
+        VkBuffer buffer,
+        u64 size,
+        void* mapped_data) NEX
+{
+    const buffer_handle h{table.insert()};
+    buffers.push_back(buffer);
+    sizes.push_back(size);
+    mapped.push_back(mapped_data);
+    states.push_back({});
+#ifdef TINYVK_USE_VMA
+    allocations.push_back({});
+#endif
+    return h;
+}
+
+
+bool
+buffer_pool::erase(
+        buffer_handle h) NEX
+{
+    const u32 i = table.remove(h.value);
+    if (i == handle_table::INVALID)
+        return false;
+#ifdef TINYVK_USE_VMA
+    tassert(!allocations[i] && "tinyvk::buffer_pool::erase - Buffer is owned by the pool, destroy it instead");
+#endif
+    erase_at(i);
+    return true;
+}
+
+
+#ifdef TINYVK_USE_VMA
+buffer_handle
+buffer_pool::create(
+        VmaAllocator vma,
+        const buffer_desc& desc) NEX
+{
+    VmaAllocation allocation{};
+    void* mapped_data{};
+    const buffer b = buffer::create(vma, allocation, desc, &mapped_data);
+    const buffer_handle h = insert(b, desc.size, mapped_data);
+    allocations.back() = allocation;
+    return h;
+}
+
+
+bool
+buffer_pool::destroy(
+        VmaAllocator vma,
+        buffer_handle h) NEX
+{
+    const u32 i = table.remove(h.value);
+    if (i == handle_table::INVALID)
+        return false;
+    tassert(allocations[i] && "tinyvk::buffer_pool::destroy - Buffer is not owned by the pool, erase it instead");
+    buffer::from(buffers[i]).destroy(vma, allocations[i]);
+    erase_at(i);
+    return true;
+}
+
+
+void
+buffer_pool::destroy(
+        VmaAllocator vma) NEX
+{
+    for (u32 i = 0; i < buffers.size(); ++i) {
+        if (allocations[i])
+            buffer::from(buffers[i]).destroy(vma, allocations[i]);
+    }
+    clear();
+}
+#endif
+
+
+void
+buffer_pool::clear() NEX
+{
+    table.clear();
+    buffers.clear();
+    sizes.clear();
+    mapped.clear();
+    states.clear();
+#ifdef TINYVK_USE_VMA
+    allocations.clear();
+#endif
+}
+
+
+VkBuffer
+buffer_pool::get(
+        buffer_handle h) const NEX
+{
+    const u32 i = index(h);
+    return i != handle_table::INVALID ? buffers[i] : VkBuffer{};
+}
+
+
+resource_state*
+buffer_pool::state(
+        buffer_handle h) NEX
+{
+    const u32 i = index(h);
+    return i != handle_table::INVALID ? &states[i] : nullptr;
+}
+
+
+void
+buffer_pool::erase_at(
+        u32 i) NEX
+{
+    buffers[i] = buffers.pop_back();
+    sizes[i] = sizes.pop_back();
+    mapped[i] = mapped.pop_back();
+    states[i] = states.pop_back();
+#ifdef TINYVK_USE_VMA
+    allocations[i] = allocations.pop_back();
+#endif
+}
+
+//endregion
+
+#ifdef TINYVK_USE_VMA
+
+//region image_pool
+
+image_handle
+image_pool::insert(
+        VkImage image,
+        const image_dimensions& dim,
+        VkImageLayout layout) NEX
+{
+    const image_handle h{table.insert()};
+    images.push_back(image);
+    dimensions.push_back(dim);
+    resource_state s{};
+    s.layout = layout;
+    states.push_back(s);
+    allocations.push_back({});
+    return h;
+}
+
+
+bool
+image_pool::erase(
+        image_handle h) NEX
+{
+    const u32 i = table.remove(h.value);
+    if (i == handle_table::INVALID)
+        return false;
+    tassert(!allocations[i] && "tinyvk::image_pool::erase - Image is owned by the pool, destroy it instead");
+    erase_at(i);
+    return true;
+}
+
+
+image_handle
+image_pool::create(
+        VmaAllocator vma,
+        const image_desc& desc,
+        vk_alloc alloc) NEX
+{
+    VmaAllocation allocation{};
+    image_dimensions dim{};
+    const image im = image::create(vma, allocation, desc, &dim, {}, alloc);
+    const image_handle h = insert(im, dim);
+    allocations.back() = allocation;
+    return h;
+}
+
+
+bool
+image_pool::destroy(
+        VmaAllocator vma,
+        image_handle h,
+        vk_alloc alloc) NEX
+{
+    const u32 i = table.remove(h.value);
+    if (i == handle_table::INVALID)
+        return false;
+    tassert(allocations[i] && "tinyvk::image_pool::destroy - Image is not owned by the pool, erase it instead");
+    image::from(images[i]).destroy(vma, allocations[i], {}, alloc);
+    erase_at(i);
+    return true;
+}
+
+
+void
+image_pool::destroy(
+        VmaAllocator vma,
+        vk_alloc alloc) NEX
+{
+    for (u32 i = 0; i < images.size(); ++i) {
+        if (allocations[i])
+            image::from(images[i]).destroy(vma, allocations[i], {}, alloc);
+    }
+    table.clear();
+    images.clear();
+    dimensions.clear();
+    states.clear();
+    allocations.clear();
+}
+
+
+VkImage
+image_pool::get(
+        image_handle h) const NEX
+{
+    const u32 i = index(h);
+    return i != handle_table::INVALID ? images[i] : VkImage{};
+}
+
+
+const image_dimensions*
+image_pool::dims(
+        image_handle h) const NEX
+{
+    const u32 i = index(h);
+    return i != handle_table::INVALID ? &dimensions[i] : nullptr;
+}
+
+
+resource_state*
+image_pool::state(
+        image_handle h) NEX
+{
+    const u32 i = index(h);
+    return i != handle_table::INVALID ? &states[i] : nullptr;
+}
+
+
+void
+image_pool::erase_at(
+        u32 i) NEX
+{
+    images[i] = images.pop_back();
+    dimensions[i] = dimensions.pop_back();
+    states[i] = states.pop_back();
+    allocations[i] = allocations.pop_back();
+}
+
+//endregion
+
+#endif
+
+}
+
+#endif //TINYVK_RESOURCE_POOL_CPP
+
+#endif //TINYVK_IMPLEMENTATION
@@ -0,0 +1,720 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#ifndef TINYVK_UPLOAD_H
+#define TINYVK_UPLOAD_H
+
+#include "tinyvk_core.h"
+#include "tinyvk_queue.h"
+#include "tinyvk_command.h"
+#ifdef TINYVK_USE_VMA
+#include "tinyvk_buffer.h"
+#endif
+
+namespace tinyvk {
+
+/// Streams buffer and image data to the device through a persistently mapped staging ring buffer.
+///     - uploads copy their data into the ring right away and queue a copy, the ring is suballocated in order
+///     - flush records all queued copies into one command buffer on the transfer queue (the graphics queue
+///       without one): one vkCmdCopyBuffer per destination buffer and one vkCmdCopyBufferToImage per destination
+///       image, with adjacent buffer ranges coalesced into a single region
+///     - the ring space of a flush is reclaimed once its fence signalled (reclaim), when the ring is full
+///       uploads flush and wait for the oldest batch themselves
+/// Images are transitioned to TRANSFER_DST_OPTIMAL before and to their new layout after the copy.
+/// When the transfer queue family differs from the graphics family the destinations are released to the graphics
+/// family, record the matching acquire (barrier_batch with the same families) on the graphics queue and make it
+/// wait on a semaphore signalled by the flush. Destination ranges must not be in use by the device.
+/// File uploads read straight into the ring. With enable_host_import (VK_EXT_external_memory_host) they instead map
+/// the file and import the aligned range around the data as the copy source, so the data is never copied on the
+/// CPU. The mapping and the imported memory are released when the batch that copies them completed. Files that can
+/// not be imported fall back to reading into the ring. Not thread safe.
+struct upload_manager {
+    /// src is null for copies from the staging ring
+    struct buffer_copy_t {
+        VkBuffer                dst{};
+        VkBufferCopy            region{};
+        VkBuffer                src{};
+    };
+
+    struct image_copy_t {
+        VkImage                 dst{};
+        VkBufferImageCopy       region{};
+        VkImageLayout           old_layout{};
+        VkImageLayout           new_layout{};
+        VkBuffer                src{};
+    };
+
+    /// Imported file range, batch is the batch that copies from it (-1u until it is flushed)
+    struct import_t {
+        VkBuffer                buffer{};
+        VkDeviceMemory          memory{};
+        tinystd::mapped_file    file{};
+        u32                     batch{-1u};
+    };
+
+    struct batch_t {
+        VkCommandBuffer         cmd{};
+        VkFence                 fence{};
+        u64                     ring_end{};
+        bool                    pending{};
+    };
+
+    VkBuffer                    staging{};
+    u8*                         mapped{};
+    u64                         capacity{};
+    u64                         head{};
+    u64                         tail{};
+    VkQueue                     queue{};
+    u32                         transfer_family{};
+    u32                         dst_family{};
+    command_pool                pool{};
+    batch_t                     batches[MAX_UPLOAD_BATCHES]{};
+    u32                         next_batch{};
+    small_vector<buffer_copy_t, 64> buffer_copies{};
+    small_vector<image_copy_t, 16>  image_copies{};
+    small_vector<import_t, 8>   imports{};
+    PFN_vkGetMemoryHostPointerPropertiesEXT get_host_pointer_properties{};
+    u64                         import_alignment{};
+    vk_alloc                    callbacks{};
+#ifdef TINYVK_USE_VMA
+    VmaAllocation               allocation{};
+    memory_stats*               stats{};
+#endif
+
+    /// Stream through staging (mapped is its persistent mapping of size bytes)
+    static upload_manager create(
+            VkDevice                        device,
+            const queue_collection&         queues,
+            const queue_create_info&        info,
+            VkBuffer                        staging,
+            void*                           mapped,
+            u64                             size,
+            vk_alloc                        alloc = {}) NEX;
+
+#ifdef TINYVK_USE_VMA
+    /// Stream through a VMA_USAGE_CPU_ONLY staging buffer of size bytes owned by the upload manager,
+    /// stats (optional) tracks it as MEMORY_CATEGORY_STAGING until destroy
+    static upload_manager create(
+            VmaAllocator                    vma,
+            VkDevice                        device,
+            const queue_collection&         queues,
+            const queue_create_info&        info,
+            u64                             size,
+            memory_stats*                   stats = {},
+            vk_alloc                        alloc = {}) NEX;
+
+    /// Destroy an upload manager created with its own staging buffer
+    void                destroy(
+            VmaAllocator                    vma,
+            VkDevice                        device,
+            vk_alloc                        alloc = {}) NEX;
+#endif
+
+    /// Waits for all batches in flight
+    void                destroy(
+            VkDevice                        device,
+            vk_alloc                        alloc = {}) NEX;
+
+    /// Queue a copy of size bytes of data to dst at offset. False if size does not fit in the ring
+    NDC ibool           upload_buffer(
+            VkDevice                        device,
+            VkBuffer                        dst,
+            u64                             offset,
+            const void*                     data,
+            u64                             size) NEX;
+
+    /// Queue a copy of tightly packed texels to the region of subresource of dst. False if size does not fit in the ring
+    NDC ibool           upload_image(
+            VkDevice                        device,
+            VkImage                         dst,
+            const VkImageSubresourceLayers& subresource,
+            VkOffset3D                      offset,
+            VkExtent3D                      extent,
+            const void*                     data,
+            u64                             size,
+            VkImageLayout                   old_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+            VkImageLayout                   new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            u64                             alignment = 16) NEX;
+
+    /// Import file ranges instead of reading them into the ring, the device needs VK_EXT_external_memory_host.
+    /// False if the extension is not enabled, file uploads keep reading into the ring
+    ibool               enable_host_import(
+            VkDevice                        device,
+            VkPhysicalDevice                physical_device) NEX;
+
+    /// Queue a copy of size bytes at offset of the file at path to dst at dst_offset, without host import the data
+    /// is read into the ring in chunks. False if the file could not be read, chunks read before are still queued
+    NDC ibool           upload_file(
+            VkDevice                        device,
+            const char*                     path,
+            u64                             offset,
+            u64                             size,
+            VkBuffer                        dst,
+            u64                             dst_offset) NEX;
+
+    /// Queue a copy of size bytes of tightly packed texels at offset of the file at path to the region of subresource
+    /// of dst. False if the file could not be read or (without host import) the data does not fit in the ring
+    NDC ibool           upload_file(
+            VkDevice                        device,
+            const char*                     path,
+            u64                             offset,
+            u64                             size,
+            VkImage                         dst,
+            const VkImageSubresourceLayers& subresource,
+            VkOffset3D                      image_offset,
+            VkExtent3D                      extent,
+            VkImageLayout                   old_layout = VK_IMAGE_LAYOUT_UNDEFINED,
+            VkImageLayout                   new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) NEX;
+
+    /// Submit all queued copies to the transfer queue with one command buffer, signals are signalled when they complete
+    void                flush(
+            VkDevice                        device,
+            span<const semaphore_submit>    signals = {}) NEX;
+
+    /// Reclaim the ring space of the batches that completed, with wait it waits for the oldest batch in flight
+    void                reclaim(
+            VkDevice                        device,
+            bool                            wait = false) NEX;
+
+    NDC u64             used() const NEX { return head - tail; }
+
+    NDC u32             queued_count() const NEX { return u32(buffer_copies.size() + image_copies.size()); }
+
+private:
+    /// Offset of size bytes in the ring, flushes and waits for batches in flight until it fits
+    NDC ibool           allocate(
+            VkDevice                        device,
+            u64                             size,
+            u64                             alignment,
+            u64&                            offset) NEX;
+
+    /// Queue a buffer copy, merged into the previous one when both ranges continue it
+    void                push_copy(
+            const buffer_copy_t&            copy) NEX;
+
+    /// Map and import the range of the file at path, src and src_offset are where the range starts in the import
+    NDC ibool           import_file(
+            VkDevice                        device,
+            const char*                     path,
+            u64                             offset,
+            u64                             size,
+            VkBuffer&                       src,
+            u64&                            src_offset) NEX;
+
+    void                release_imports(
+            VkDevice                        device,
+            u32                             batch) NEX;
+};
+
+}
+
+#endif //TINYVK_UPLOAD_H
+
+#ifdef TINYVK_IMPLEMENTATION
+
+#ifndef TINYVK_UPLOAD_CPP
+#define TINYVK_UPLOAD_CPP
+
+#include "tinystd_algorithm.h"
+
+namespace tinyvk {
+
+//region upload_manager
+
+upload_manager
+upload_manager::create(
+        VkDevice device,
+        const queue_collection& queues,
+        const queue_create_info& info,
+        VkBuffer staging,
+        void* mapped,
+        u64 size,
+        vk_alloc alloc) NEX
+{
+    tassert(mapped && "tinyvk::upload_manager::create - Staging buffer must be persistently mapped");
+    tassert(queues.count[QUEUE_GRAPHICS] && "tinyvk::upload_manager::create - A graphics queue is required");
+
+    upload_manager m{};
+    m.staging = staging;
+    m.mapped = (u8*)mapped;
+    m.capacity = size;
+    m.callbacks = alloc;
+
+    const queue_type_t type = queues.count[QUEUE_TRANSFER] ? QUEUE_TRANSFER : QUEUE_GRAPHICS;
+    m.queue = queues.get(type);
+    m.transfer_family = info.queues[type][0].family;
+    m.dst_family = info.queues[QUEUE_GRAPHICS][0].family;
+    m.pool = command_pool::create(device, m.transfer_family, command_pool_flags_t(CMD_POOL_TRANSIENT | CMD_POOL_RESET_INDIVIDUAL), alloc);
+
+    VkFenceCreateInfo fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    for (auto& b: m.batches) {
+        m.pool.allocate(device, {&b.cmd, 1});
+        vk_validate(vkCreateFence(device, &fence_info, alloc, &b.fence),
+            "tinyvk::upload_manager::create - Failed to create fence");
+    }
+    return m;
+}
+
+
+#ifdef TINYVK_USE_VMA
+upload_manager
+upload_manager::create(
+        VmaAllocator vma,
+        VkDevice device,
+        const queue_collection& queues,
+        const queue_create_info& info,
+        u64 size,
+        memory_stats* stats,
+        vk_alloc alloc) NEX
+{
+    VmaAllocation allocation{};
+    void* mapped{};
+    const buffer staging = buffer::create(vma, allocation, {size, BUFFER_TRANSFER_SRC, VMA_USAGE_CPU_ONLY, VMA_CREATE_MAPPED},
+        &mapped, stats, MEMORY_CATEGORY_STAGING);
+    upload_manager m = create(device, queues, info, staging, mapped, size, alloc);
+    m.allocation = allocation;
+    m.stats = stats;
+    return m;
+}
+
+
+void
+upload_manager::destroy(
+        VmaAllocator vma,
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    buffer staging_buffer = buffer::from(staging);
+    destroy(device, alloc);
+    staging_buffer.destroy(vma, allocation, stats, MEMORY_CATEGORY_STAGING);
+    allocation = {};
+    stats = {};
+}
+#endif
+
+
+void
+upload_manager::destroy(
+        VkDevice device,
+        vk_alloc alloc) NEX
+{
+    for (auto& b: batches) {
+        if (b.pending)
+            vk_validate(vkWaitForFences(device, 1, &b.fence, VK_TRUE, DEFAULT_TIMEOUT_NANOS),
+                "tinyvk::upload_manager::destroy - Failed to wait for upload");
+        vkDestroyFence(device, b.fence, alloc);
+        b = {};
+    }
+    // imports that were never flushed are released with the rest
+    for (auto& im: imports)
+        im.batch = 0;
+    release_imports(device, 0);
+    // destroying the pool frees all of its command buffers
+    pool.destroy(device, alloc);
+    buffer_copies.clear();
+    image_copies.clear();
+    staging = {};
+    mapped = {};
+    capacity = head = tail = 0;
+}
+
+
+ibool
+upload_manager::upload_buffer(
+        VkDevice device,
+        VkBuffer dst,
+        u64 offset,
+        const void* data,
+        u64 size) NEX
+{
+    u64 src{};
+    if (!allocate(device, size, 4, src))
+        return false;
+    tinystd::memcpy(mapped + src, data, size);
+    push_copy({dst, {src, offset, size}});
+    return true;
+}
+
+
+ibool
+upload_manager::upload_image(
+        VkDevice device,
+        VkImage dst,
+        const VkImageSubresourceLayers& subresource,
+        VkOffset3D offset,
+        VkExtent3D extent,
+        const void* data,
+        u64 size,
+        VkImageLayout old_layout,
+        VkImageLayout new_layout,
+        u64 alignment) NEX
+{
+    u64 src{};
+    if (!allocate(device, size, alignment, src))
+        return false;
+    tinystd::memcpy(mapped + src, data, size);
+
+    image_copy_t c{};
+    c.dst = dst;
+    c.region.bufferOffset = src;
+    c.region.imageSubresource = subresource;
+    c.region.imageOffset = offset;
+    c.region.imageExtent = extent;
+    c.old_layout = old_layout;
+    c.new_layout = new_layout;
+    image_copies.push_back(c);
+    return true;
+}
+
+
+ibool
+upload_manager::enable_host_import(
+        VkDevice device,
+        VkPhysicalDevice physical_device) NEX
+{
+    get_host_pointer_properties = (PFN_vkGetMemoryHostPointerPropertiesEXT) vkGetDeviceProcAddr(device, "vkGetMemoryHostPointerPropertiesEXT");
+    if (!get_host_pointer_properties)
+        return false;
+
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT host{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT};
+    VkPhysicalDeviceProperties2 props{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    props.pNext = &host;
+    vkGetPhysicalDeviceProperties2(physical_device, &props);
+    import_alignment = tinystd::max(u64(host.minImportedHostPointerAlignment), u64(1));
+    return true;
+}
+
+
+ibool
+upload_manager::upload_file(
+        VkDevice device,
+        const char* path,
+        u64 offset,
+        u64 size,
+        VkBuffer dst,
+        u64 dst_offset) NEX
+{
+    VkBuffer src{};
+    u64 src_offset{};
+    if (import_file(device, path, offset, size, src, src_offset)) {
+        buffer_copies.push_back({dst, {src_offset, dst_offset, size}, src});
+        return true;
+    }
+
+    // read in chunks so files larger than the ring stream through it
+    const u64 chunk = tinystd::max(capacity / MAX_UPLOAD_BATCHES, u64(4));
+    for (u64 done = 0; done < size;) {
+        const u64 n = tinystd::min(size - done, chunk);
+        u64 ring{};
+        if (!allocate(device, n, 4, ring) || !tinystd::read_file(path, offset + done, mapped + ring, n))
+            return false;
+        push_copy({dst, {ring, dst_offset + done, n}});
+        done += n;
+    }
+    return true;
+}
+
+
+ibool
+upload_manager::upload_file(
+        VkDevice device,
+        const char* path,
+        u64 offset,
+        u64 size,
+        VkImage dst,
+        const VkImageSubresourceLayers& subresource,
+        VkOffset3D image_offset,
+        VkExtent3D extent,
+        VkImageLayout old_layout,
+        VkImageLayout new_layout) NEX
+{
+    image_copy_t c{};
+    c.dst = dst;
+    c.region.imageSubresource = subresource;
+    c.region.imageOffset = image_offset;
+    c.region.imageExtent = extent;
+    c.old_layout = old_layout;
+    c.new_layout = new_layout;
+
+    u64 src{};
+    if (!import_file(device, path, offset, size, c.src, src)) {
+        if (!allocate(device, size, 16, src) || !tinystd::read_file(path, offset, mapped + src, size))
+            return false;
+    }
+    c.region.bufferOffset = src;
+    image_copies.push_back(c);
+    return true;
+}
+
+
+void
+upload_manager::flush(
+        VkDevice device,
+        span<const semaphore_submit> signals) NEX
+{
+    if (buffer_copies.empty() && image_copies.empty())
+        return;
+
+    auto& b = batches[next_batch];
+    if (b.pending)
+        reclaim(device, true);
+    tassert(!b.pending && "tinyvk::upload_manager::flush - Batches must complete in order");
+    for (auto& im: imports) {
+        if (im.batch == -1u) im.batch = next_batch;
+    }
+    next_batch = (next_batch + 1) % MAX_UPLOAD_BATCHES;
+
+    VkCommandBufferBeginInfo begin_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vk_validate(vkBeginCommandBuffer(b.cmd, &begin_info),
+        "tinyvk::upload_manager::flush - Failed to begin command buffer");
+
+    const barrier_access transfer_write{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+    const barrier_access all_reads{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT};
+    const bool release = transfer_family != dst_family;
+    const u32 src_family = release ? transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    const u32 to_family = release ? dst_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier_batch barriers{};
+
+    // transition every destination image, subresources of the same image are merged by the batch
+    for (auto& c: image_copies) {
+        const auto& s = c.region.imageSubresource;
+        barriers.image(c.dst, {s.aspectMask, s.mipLevel, 1, s.baseArrayLayer, s.layerCount},
+            c.old_layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0}, transfer_write);
+    }
+    barriers.flush(b.cmd);
+
+    // one copy per source and destination, in the order they were first uploaded to
+    small_vector<VkBufferCopy, 64> buffer_regions{};
+    for (u32 i = 0; i < buffer_copies.size(); ++i) {
+        const VkBuffer dst = buffer_copies[i].dst;
+        const VkBuffer src = buffer_copies[i].src;
+        if (!dst)
+            continue;
+        buffer_regions.clear();
+        for (u32 j = i; j < buffer_copies.size(); ++j) {
+            if (buffer_copies[j].dst != dst || buffer_copies[j].src != src)
+                continue;
+            const auto& r = buffer_copies[j].region;
+            if (release)
+                barriers.buffer(dst, transfer_write, {}, r.dstOffset, r.size, src_family, to_family);
+            buffer_regions.push_back(r);
+            buffer_copies[j].dst = {};
+        }
+        vkCmdCopyBuffer(b.cmd, src ? src : staging, dst, u32(buffer_regions.size()), buffer_regions.data());
+    }
+
+    small_vector<VkBufferImageCopy, 16> image_regions{};
+    for (u32 i = 0; i < image_copies.size(); ++i) {
+        const VkImage dst = image_copies[i].dst;
+        const VkBuffer src = image_copies[i].src;
+        if (!dst)
+            continue;
+        image_regions.clear();
+        for (u32 j = i; j < image_copies.size(); ++j) {
+            if (image_copies[j].dst != dst || image_copies[j].src != src)
+                continue;
+            const auto& c = image_copies[j];
+            const auto& s = c.region.imageSubresource;
+            barriers.image(dst, {s.aspectMask, s.mipLevel, 1, s.baseArrayLayer, s.layerCount},
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, c.new_layout, transfer_write, release ? barrier_access{} : all_reads,
+                src_family, to_family);
+            image_regions.push_back(c.region);
+            image_copies[j].dst = {};
+        }
+        vkCmdCopyBufferToImage(b.cmd, src ? src : staging, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            u32(image_regions.size()), image_regions.data());
+    }
+
+    // without a queue family transfer buffers only need their writes made visible
+    if (!release && !buffer_copies.empty())
+        barriers.global(transfer_write, all_reads);
+    barriers.flush(b.cmd);
+
+    vk_validate(vkEndCommandBuffer(b.cmd),
+        "tinyvk::upload_manager::flush - Failed to end command buffer");
+
+    submit_batch submit{};
+    submit.add({&b.cmd, 1}, {}, signals);
+    submit.submit(queue, b.fence);
+    b.ring_end = head;
+    b.pending = true;
+    buffer_copies.clear();
+    image_copies.clear();
+}
+
+
+void
+upload_manager::reclaim(
+        VkDevice device,
+        bool wait) NEX
+{
+    // batches complete in submission order, the oldest one is the next one to be reused
+    for (u32 n = 0; n < MAX_UPLOAD_BATCHES; ++n) {
+        const u32 index = (next_batch + n) % MAX_UPLOAD_BATCHES;
+        auto& b = batches[index];
+        if (!b.pending)
+            continue;
+        const VkResult r = wait
+            ? vkWaitForFences(device, 1, &b.fence, VK_TRUE, DEFAULT_TIMEOUT_NANOS)
+            : vkGetFenceStatus(device, b.fence);
+        if (r == VK_TIMEOUT || r == VK_NOT_READY)
+            return;
+        vk_validate(r, "tinyvk::upload_manager::reclaim - Failed to wait for upload");
+        vk_validate(vkResetFences(device, 1, &b.fence),
+            "tinyvk::upload_manager::reclaim - Failed to reset fence");
+        tail = b.ring_end;
+        b.pending = false;
+        release_imports(device, index);
+        wait = false;
+    }
+}
+
+
+ibool
+upload_manager::allocate(
+        VkDevice device,
+        u64 size,
+        u64 alignment,
+        u64& offset) NEX
+{
+    if (size > capacity)
+        return false;
+
+    for (;;) {
+        // head and tail only grow, positions in the ring are head/tail modulo capacity
+        u64 begin = tinystd::round_up(head, alignment);
+        const u64 position = begin % capacity;
+        if (position + size > capacity)
+            begin += capacity - position;
+        if (begin + size - tail <= capacity) {
+            head = begin + size;
+            offset = begin % capacity;
+            return true;
+        }
+
+        bool in_flight = false;
+        for (auto& b: batches)
+            in_flight |= b.pending;
+        if (!buffer_copies.empty() || !image_copies.empty())
+            flush(device);
+        else if (!in_flight)
+            return false;
+        reclaim(device, true);
+    }
+}
+
+
+
+void
+upload_manager::push_copy(
+        const buffer_copy_t& copy) NEX
+{
+    // sequential uploads to the same buffer become a single region
+    if (!buffer_copies.empty()) {
+        auto& last = buffer_copies.back();
+        if (last.dst == copy.dst && last.src == copy.src && last.region.srcOffset + last.region.size == copy.region.srcOffset
+            && last.region.dstOffset + last.region.size == copy.region.dstOffset) {
+            last.region.size += copy.region.size;
+            return;
+        }
+    }
+    buffer_copies.push_back(copy);
+}
+
+
+ibool
+upload_manager::import_file(
+        VkDevice device,
+        const char* path,
+        u64 offset,
+        u64 size,
+        VkBuffer& src,
+        u64& src_offset) NEX
+{
+    if (!get_host_pointer_properties)
+        return false;
+
+    tinystd::mapped_file file = tinystd::map_file(path);
+    if (!file.data || offset + size > file.size) {
+        tinystd::unmap_file(file);
+        return false;
+    }
+
+    // the import covers whole aligned blocks around the range, which must not leave the pages of the mapping
+    const u64 base = u64(file.data);
+    const u64 begin = (base + offset) / import_alignment * import_alignment;
+    const u64 end = tinystd::round_up(base + offset + size, import_alignment);
+    VkMemoryHostPointerPropertiesEXT host{VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT};
+    if (begin < base || end > base + tinystd::round_up(u64(file.size), u64(tinystd::page_size()))
+        || get_host_pointer_properties(device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, (void*)begin, &host) != VK_SUCCESS) {
+        tinystd::unmap_file(file);
+        return false;
+    }
+
+    VkExternalMemoryBufferCreateInfo external{VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO};
+    external.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    VkBufferCreateInfo buffer_info{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.pNext = &external;
+    buffer_info.size = end - begin;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    import_t im{};
+    im.file = file;
+    vk_validate(vkCreateBuffer(device, &buffer_info, callbacks, &im.buffer),
+        "tinyvk::upload_manager::import_file - Failed to create import buffer");
+
+    VkMemoryRequirements requirements{};
+    vkGetBufferMemoryRequirements(device, im.buffer, &requirements);
+    const u32 types = requirements.memoryTypeBits & host.memoryTypeBits;
+    VkImportMemoryHostPointerInfoEXT import_info{VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT};
+    import_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    import_info.pHostPointer = (void*)begin;
+    VkMemoryAllocateInfo allocate_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocate_info.pNext = &import_info;
+    allocate_info.allocationSize = end - begin;
+    while (types && !(types & (1u << allocate_info.memoryTypeIndex)))
+        ++allocate_info.memoryTypeIndex;
+
+    // drivers may refuse some mappings (e.g. of files on certain file systems), those are read into the ring instead
+    if (!types || vkAllocateMemory(device, &allocate_info, callbacks, &im.memory) != VK_SUCCESS) {
+        vkDestroyBuffer(device, im.buffer, callbacks);
+        tinystd::unmap_file(im.file);
+        return false;
+    }
+    vk_validate(vkBindBufferMemory(device, im.buffer, im.memory, 0),
+        "tinyvk::upload_manager::import_file - Failed to bind imported memory");
+
+    imports.push_back(im);
+    src = im.buffer;
+    src_offset = base + offset - begin;
+    return true;
+}
+
+
+void
+upload_manager::release_imports(
+        VkDevice device,
+        u32 batch) NEX
+{
+    u32 kept = 0;
+    for (auto& im: imports) {
+        if (im.batch != batch) {
+            imports[kept++] = im;
+            continue;
+        }
+        vkDestroyBuffer(device, im.buffer, callbacks);
+        vkFreeMemory(device, im.memory, callbacks);
+        tinystd::unmap_file(im.file);
+    }
+    while (imports.size() > kept)
+        imports.pop_back();
+}
+
+//endregion
+
+}
+
+#endif //TINYVK_UPLOAD_CPP
+
+#endif //TINYVK_IMPLEMENTATION
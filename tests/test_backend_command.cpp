@@ -0,0 +1,341 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+#define TINYVK_IMPLEMENTATION
+#include "tinyvk_command.h"
+#include "tinyvk_render_graph.h"
+#include "tinyvk_queue_scheduler.h"
+#include "tinyvk_profiler.h"
+#include "tinyvk_command_stream.h"
+#include "tinyvk_upload.h"
+#include "tinyvk_frame_allocator.h"
+#include "tinyvk_geometry_buffer.h"
+#include "tinyvk_memory_stats.h"
+#include "tinyvk_resource_cache.h"
+#include "tinyvk_resource_pool.h"
+#include "tinyvk_destruction_queue.h"
+
+using namespace tinyvk;
+
+
+TEST_CASE("command_ring::allocate - one pool per frame, thread and queue family", "[tinyvk_test]")
+{
+    const VkDevice device = VkDevice(1);
+    const u32 families[]{0, 2};
+    auto ring = command_ring::create(device, families, 2, 2);
+    REQUIRE( 8 == ring.slots.size() );
+
+    const command a = ring.allocate(device, 0, 0, 0);
+    const command b = ring.allocate(device, 0, 0, 0);
+    const command c = ring.allocate(device, 0, 1, 2, true);
+    REQUIRE( a.vk != b.vk );
+    REQUIRE( a.vk != c.vk );
+    REQUIRE( 2 == ring.slot(0, 0, 0).used[0] );
+    REQUIRE( 1 == ring.slot(0, 1, 2).used[1] );
+    REQUIRE( 0 == ring.slot(1, 0, 0).used[0] );
+    REQUIRE( ring.slot(0, 0, 0).pool.vk != ring.slot(1, 0, 0).pool.vk );
+
+    ring.destroy(device);
+    REQUIRE( ring.slots.empty() );
+}
+
+
+TEST_CASE("command_ring::reset_frame - buffers are reused after reset", "[tinyvk_test]")
+{
+    const VkDevice device = VkDevice(1);
+    const u32 families[]{0};
+    auto ring = command_ring::create(device, families, 2, 1);
+
+    const command a = ring.allocate(device, 0, 0, 0);
+    const command b = ring.allocate(device, 0, 0, 0);
+    const command other = ring.allocate(device, 1, 0, 0);
+
+    REQUIRE( ring.reset_frame(device, 0, VkFence(1)) );
+    REQUIRE( 0 == ring.slot(0, 0, 0).used[0] );
+    REQUIRE( 1 == ring.slot(1, 0, 0).used[0] );
+
+    // the same command buffers are handed out again in the same order, nothing new is allocated
+    REQUIRE( a.vk == ring.allocate(device, 0, 0, 0).vk );
+    REQUIRE( b.vk == ring.allocate(device, 0, 0, 0).vk );
+    REQUIRE( 2 == ring.slot(0, 0, 0).allocated[0] );
+    REQUIRE( other.vk != a.vk );
+
+    ring.destroy(device);
+}
+
+
+TEST_CASE("command_ring::record_secondary - records every buffer in parallel", "[tinyvk_test]")
+{
+    const VkDevice device = VkDevice(1);
+    const u32 families[]{0};
+    auto jobs = tinystd::job_system::create({4, 16});
+    auto ring = command_ring::create(device, families, 1, 4);
+
+    VkCommandBufferInheritanceInfo inheritance{VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    VkCommandBuffer cmds[24]{};
+    u32 indices[24]{};
+    ring.record_secondary(jobs, device, 0, 0, inheritance, cmds, [](command cmd, u32 index, void* data) {
+        ((u32*)data)[index] = index + 1;
+    }, indices);
+
+    u32 recorded = 0, used = 0;
+    for (u32 i = 0; i < 24; ++i) recorded += cmds[i] != VK_NULL_HANDLE && indices[i] == i + 1;
+    for (u32 t = 0; t < 4; ++t) used += ring.slot(0, t, 0).used[1];
+    REQUIRE( 24 == recorded );
+    REQUIRE( 24 == used );
+
+    ring.destroy(device);
+    jobs.destroy();
+}
+
+
+TEST_CASE("command_bundle_cache::get - bundles are re-recorded only when what they reference changes", "[tinyvk_test]")
+{
+    const VkDevice device = VkDevice(1);
+    auto cache = command_bundle_cache::create(device, 0, 2);
+
+    VkCommandBufferInheritanceInfo inheritance{VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance.renderPass = VkRenderPass(1);
+    inheritance.framebuffer = VkFramebuffer(1);
+    const u64 references[]{u64(VkPipeline(1)), u64(VkDescriptorSet(2)), u64(VkBuffer(3))};
+    u32 calls = 0;
+    const auto record = [](command cmd, void* data) { ++*(u32*)data; };
+
+    const VkCommandBuffer a = cache.get(device, 1, references, inheritance, record, &calls);
+    REQUIRE( a != VK_NULL_HANDLE );
+    REQUIRE( a == cache.get(device, 1, references, inheritance, record, &calls) );
+    REQUIRE( 1 == calls );
+
+    // a different bundle that does not reference the descriptor set
+    const u64 other_references[]{u64(VkPipeline(1)), u64(VkBuffer(3))};
+    const VkCommandBuffer b = cache.get(device, 2, other_references, inheritance, record, &calls);
+    REQUIRE( a != b );
+    REQUIRE( 2 == calls );
+
+    // the descriptor set was written to, only the bundle referencing it is re-recorded
+    cache.invalidate(u64(VkDescriptorSet(2)));
+    const VkCommandBuffer a2 = cache.get(device, 1, references, inheritance, record, &calls);
+    REQUIRE( a2 != a );
+    REQUIRE( b == cache.get(device, 2, other_references, inheritance, record, &calls) );
+    REQUIRE( 3 == calls );
+
+    // a new framebuffer changes the inheritance info, a new pipeline the references
+    inheritance.framebuffer = VkFramebuffer(2);
+    const VkCommandBuffer a3 = cache.get(device, 1, references, inheritance, record, &calls);
+    const u64 new_references[]{u64(VkPipeline(4)), u64(VkBuffer(3))};
+    const VkCommandBuffer b2 = cache.get(device, 2, new_references, inheritance, record, &calls);
+    REQUIRE( a3 != a2 );
+    REQUIRE( b2 != b );
+    REQUIRE( 5 == calls );
+    REQUIRE( 5 == cache.recorded_count() );
+
+    // replaced command buffers may still be executing, they are freed once their frames are done
+    REQUIRE( 3 == cache.retired.size() );
+    cache.next_frame(device);
+    REQUIRE( 3 == cache.retired.size() );
+    cache.remove(1);
+    cache.next_frame(device);
+    REQUIRE( 1 == cache.retired.size() );
+    cache.next_frame(device);
+    REQUIRE( 0 == cache.retired.size() );
+    REQUIRE( 1 == cache.bundles.size() );
+
+    command::from(VkCommandBuffer(1)).execute_commands({&b2, 1});
+    cache.destroy(device);
+}
+
+
+TEST_CASE("command_recorder - redundant binds are dropped", "[tinyvk_test]")
+{
+    command_recorder rec{};
+    rec.begin(command::from(VkCommandBuffer(1)));
+
+    const auto pipeline = VkPipeline(1);
+    const auto layout = VkPipelineLayout(1);
+    rec.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    rec.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    rec.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    REQUIRE( 2 == rec.issued_count() );
+    REQUIRE( 1 == rec.dropped_count() );
+
+    const VkDescriptorSet sets[]{VkDescriptorSet(1), VkDescriptorSet(2)};
+    const VkDescriptorSet other[]{VkDescriptorSet(1), VkDescriptorSet(3)};
+    rec.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, sets);
+    rec.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, sets);
+    rec.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, other);
+    rec.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, sets);
+    // a different layout forgets what was bound
+    rec.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, VkPipelineLayout(2), 0, other);
+    REQUIRE( 6 == rec.issued_count() );
+    REQUIRE( 2 == rec.dropped_count() );
+    REQUIRE( VkDescriptorSet(3) == rec.bind_points[0].sets[1] );
+
+    const VkBuffer buffers[]{VkBuffer(1), VkBuffer(2)};
+    const VkDeviceSize offsets[]{0, 64};
+    rec.bind_vertex_buffers(0, buffers, offsets);
+    rec.bind_vertex_buffers(0, buffers, offsets);
+    rec.bind_index_buffer(VkBuffer(3), 0, VK_INDEX_TYPE_UINT16);
+    rec.bind_index_buffer(VkBuffer(3), 0, VK_INDEX_TYPE_UINT16);
+    rec.bind_index_buffer(VkBuffer(3), 0, VK_INDEX_TYPE_UINT32);
+    REQUIRE( 9 == rec.issued_count() );
+    REQUIRE( 4 == rec.dropped_count() );
+
+    const u32 push[4]{1, 2, 3, 4};
+    rec.push_constants(layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 16, push);
+    rec.push_constants(layout, VK_SHADER_STAGE_VERTEX_BIT, 4, 8, push + 1);
+    rec.push_constants(layout, VK_SHADER_STAGE_VERTEX_BIT, 4, 4, push);
+    REQUIRE( 11 == rec.issued_count() );
+    REQUIRE( 5 == rec.dropped_count() );
+
+    rec.invalidate();
+    rec.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    REQUIRE( 12 == rec.issued_count() );
+}
+
+
+TEST_CASE("command_recorder - dynamic state", "[tinyvk_test]")
+{
+    command_recorder rec{};
+    rec.begin(command::from(VkCommandBuffer(1)));
+
+    const VkViewport viewport{0, 0, 128, 128, 0, 1};
+    rec.set_viewport(viewport);
+    rec.set_viewport(viewport);
+    rec.set_line_width(1.0f);
+    rec.set_line_width(1.0f);
+    REQUIRE( 2 == rec.issued_count() );
+    REQUIRE( 2 == rec.dropped_count() );
+
+    rec.set_stencil_reference(VK_STENCIL_FACE_FRONT_BIT, 1);
+    rec.set_stencil_reference(VK_STENCIL_FACE_FRONT_AND_BACK, 1);
+    rec.set_stencil_reference(VK_STENCIL_FACE_FRONT_AND_BACK, 1);
+    REQUIRE( 4 == rec.issued_count() );
+    REQUIRE( 3 == rec.dropped_count() );
+
+    // pipelines with static state overwrite dynamic state
+    rec.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, VkPipeline(1));
+    rec.set_viewport(viewport);
+    rec.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, VkPipeline(2), true);
+    rec.set_viewport(viewport);
+    REQUIRE( 7 == rec.issued_count() );
+    REQUIRE( 4 == rec.dropped_count() );
+
+#ifdef VK_EXT_extended_dynamic_state
+    // extended dynamic state goes through the entry points loaded for the device
+    command::load_dynamic_state_ext(VkDevice(1));
+    rec.set_cull_mode(VK_CULL_MODE_BACK_BIT);
+    rec.set_cull_mode(VK_CULL_MODE_BACK_BIT);
+    rec.set_depth_test(true);
+    rec.set_primitive_restart(false);
+    REQUIRE( 10 == rec.issued_count() );
+    REQUIRE( 5 == rec.dropped_count() );
+#endif
+
+#ifdef VK_EXT_extended_dynamic_state2
+    // logic op and patch control points are extended dynamic state 2, loaded without extended dynamic state 3
+    const auto cmd = command::from(VkCommandBuffer(1));
+    cmd.set_logic_op(VK_LOGIC_OP_CLEAR);
+    cmd.set_patch_control_points(3);
+#endif
+}
+
+
+TEST_CASE("barrier_batch - compatible barriers are merged", "[tinyvk_test]")
+{
+    const barrier_access transfer_write{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+    const barrier_access shader_read{VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT};
+    const auto image = VkImage(1);
+
+    barrier_batch batch{};
+    REQUIRE( batch.empty() );
+    for (u32 mip = 0; mip < 4; ++mip) {
+        const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 6};
+        batch.image(image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transfer_write, shader_read);
+        batch.image(image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transfer_write, shader_read);
+    }
+    // different layout, not merged
+    batch.image(image, {VK_IMAGE_ASPECT_COLOR_BIT, 4, 1, 0, 6}, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transfer_write, shader_read);
+    REQUIRE( 2 == batch.images.size() );
+    REQUIRE( 0 == batch.images[0].subresourceRange.baseMipLevel );
+    REQUIRE( 4 == batch.images[0].subresourceRange.levelCount );
+
+    batch.buffer(VkBuffer(1), transfer_write, shader_read, 0, 256);
+    batch.buffer(VkBuffer(1), transfer_write, shader_read, 256, 256);
+    batch.buffer(VkBuffer(1), transfer_write, shader_read, 1024, 256);
+    batch.buffer(VkBuffer(2), transfer_write, shader_read);
+    REQUIRE( 3 == batch.buffers.size() );
+    REQUIRE( 512 == batch.buffers[0].size );
+
+    batch.global(transfer_write, shader_read);
+    batch.global({VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT}, shader_read);
+
+    backend::reset_command_stats();
+    batch.flush(VkCommandBuffer(1));
+    REQUIRE( batch.empty() );
+    REQUIRE( 1 == backend::get_command_stats().pipeline_barriers );
+    REQUIRE( 1 == backend::get_command_stats().memory_barriers );
+    REQUIRE( 3 == backend::get_command_stats().buffer_barriers );
+    REQUIRE( 2 == backend::get_command_stats().image_barriers );
+
+    // empty batches record nothing
+    batch.flush(VkCommandBuffer(1));
+    REQUIRE( 1 == backend::get_command_stats().pipeline_barriers );
+
+    // more barriers than the inline storage still go out in one call
+    for (u32 i = 0; i < 40; ++i)
+        batch.image(VkImage(uint64_t(i + 2)), {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, transfer_write, shader_read);
+#ifdef VK_VERSION_1_3
+    barrier_batch::load_synchronization2(VkDevice(1));
+    batch.flush2(VkCommandBuffer(1));
+#else
+    batch.flush(VkCommandBuffer(1));
+#endif
+    REQUIRE( 2 == backend::get_command_stats().pipeline_barriers );
+    REQUIRE( 42 == backend::get_command_stats().image_barriers );
+}
+
+
+#ifdef VK_VERSION_1_3
+TEST_CASE("barrier_batch - synchronization2 masks", "[tinyvk_test]")
+{
+    const barrier_access blit{VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT};
+    const barrier_access sampled{VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT};
+
+    barrier_batch batch{};
+    batch.image(VkImage(1), {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, blit, sampled);
+    // the legacy barrier gets the coarse access, the 64 bit masks are kept for vkCmdPipelineBarrier2
+    REQUIRE( VK_ACCESS_SHADER_READ_BIT == batch.images[0].dstAccessMask );
+    REQUIRE( VK_PIPELINE_STAGE_2_BLIT_BIT == batch.image_masks[0].src.stage );
+    REQUIRE( VK_ACCESS_2_SHADER_SAMPLED_READ_BIT == batch.image_masks[0].dst.access );
+
+    backend::reset_command_stats();
+    barrier_batch::load_synchronization2(VkDevice(1));
+    batch.flush2(VkCommandBuffer(1));
+    REQUIRE( 1 == backend::get_command_stats().pipeline_barriers );
+    REQUIRE( 1 == backend::get_command_stats().image_barriers );
+
+    // without synchronization2 empty batches still record nothing and flush falls back to the legacy barrier
+    barrier_batch::load_synchronization2({});
+    batch.flush2(VkCommandBuffer(1));
+    batch.flush(VkCommandBuffer(1));
+    REQUIRE( 1 == backend::get_command_stats().pipeline_barriers );
+    batch.image(VkImage(1), {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, blit, sampled);
+    batch.flush(VkCommandBuffer(1));
+    REQUIRE( batch.empty() );
+    REQUIRE( 2 == backend::get_command_stats().pipeline_barriers );
+    REQUIRE( 2 == backend::get_command_stats().image_barriers );
+}
+#endif
+
+
+TEST_CASE("command::generate_mipmaps - final transitions are batched", "[tinyvk_test]")
+{
+    backend::reset_command_stats();
+    command::from(VkCommandBuffer(1)).generate_mipmaps(VkImage(1), 256, 256);
+    // one barrier per blit source and a single barrier for the final transitions
+    REQUIRE( 8 == backend::get_command_stats().pipeline_barriers );
+    REQUIRE( 9 == backend::get_command_stats().image_barriers );
+}
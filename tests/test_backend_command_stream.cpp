@@ -0,0 +1,76 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_command_stream.h"
+
+using namespace tinyvk;
+
+
+TEST_CASE("command_stream - merged streams are sorted and replayed with batched barriers", "[tinyvk_test]")
+{
+    const barrier_access transfer_write{VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+    const barrier_access shader_read{VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT};
+    const auto layout = VkPipelineLayout(1);
+    const VkDescriptorSet sets[]{VkDescriptorSet(1), VkDescriptorSet(2)};
+    const u32 push[2]{1, 2};
+
+    // recorded on two threads
+    command_stream a{}, b{};
+    a.key(2);
+    a.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, VkPipeline(1));
+    a.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, sets);
+    a.draw(3);
+    a.key(1);
+    a.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, VkPipeline(2));
+    a.push_constants(layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 8, push);
+    a.draw_indexed(6);
+
+    b.key(3);
+    b.bind_pipeline(VK_PIPELINE_BIND_POINT_COMPUTE, VkPipeline(3));
+    b.dispatch(8, 8);
+    b.key(2);
+    b.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, VkPipeline(1));
+    b.bind_descriptor_sets(VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, sets);
+    b.draw(3);
+    b.key(1);
+    b.memory_barrier({VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT}, shader_read);
+    b.key(0);
+    b.image_barrier(VkImage(1), {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transfer_write, shader_read);
+    b.buffer_barrier(VkBuffer(1), transfer_write, shader_read, 0, 256);
+
+    const auto a_bytes = a.size_bytes();
+    a.merge(b);
+    REQUIRE( a_bytes + b.size_bytes() == a.size_bytes() );
+    REQUIRE( 6 == a.items.size() );
+
+    a.sort();
+    const u64 keys[]{0, 1, 1, 2, 2, 3};
+    for (u32 i = 0; i < 6; ++i)
+        REQUIRE( keys[i] == a.items[i].key );
+    // equal keys keep the order of recording, the items of b come after the items of a
+    REQUIRE( a.items[1].begin < a.items[2].begin );
+    REQUIRE( a.items[3].begin < a.items[4].begin );
+
+    backend::reset_command_stats();
+    command_recorder rec{};
+    rec.begin(command::from(VkCommandBuffer(1)));
+    a.replay(rec);
+    // the second bind of pipeline 1 and its descriptor sets are dropped
+    REQUIRE( 5 == rec.issued_count() );
+    REQUIRE( 2 == rec.dropped_count() );
+    REQUIRE( 3 == backend::get_command_stats().draws );
+    REQUIRE( 1 == backend::get_command_stats().dispatches );
+    // image and buffer barrier recorded together, the memory barrier after the indexed draw on its own
+    REQUIRE( 2 == backend::get_command_stats().pipeline_barriers );
+    REQUIRE( 1 == backend::get_command_stats().image_barriers );
+    REQUIRE( 1 == backend::get_command_stats().buffer_barriers );
+    REQUIRE( 1 == backend::get_command_stats().memory_barriers );
+
+    a.clear();
+    REQUIRE( a.empty() );
+    REQUIRE( 0 == a.items.size() );
+}
@@ -0,0 +1,109 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_destruction_queue.h"
+#include "tinyvk_queue.h"
+#include "tinyvk_command.h"
+#include "tinyvk_renderpass.h"
+#include "tinyvk_pipeline.h"
+#include "tinyvk_resource_cache.h"
+
+using namespace tinyvk;
+
+
+#ifdef VK_VERSION_1_2
+TEST_CASE("destruction_queue - objects are destroyed when their frame or retire point completes", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    const auto fence = VkFence(1);
+    auto q = destruction_queue::create(device, 2);
+    backend::reset_command_stats();
+
+    q.begin_frame(0);
+    q.push(DESTROY_SAMPLER, u64(VkSampler(0x10)));
+    q.push(DESTROY_IMAGE_VIEW, u64(VkImageView(0x20)));
+    q.begin_frame(1, fence);
+    q.push(DESTROY_PIPELINE, u64(VkPipeline(0x30)));
+    REQUIRE( 3 == q.pending() );
+    REQUIRE( 0 == backend::get_command_stats().destroyed_objects );
+
+    // frame 0 comes around again, its fence signaled
+    q.begin_frame(0, fence);
+    REQUIRE( 1 == q.pending() );
+    REQUIRE( 2 == backend::get_command_stats().destroyed_objects );
+    q.begin_frame(1, fence);
+    REQUIRE( 0 == q.pending() );
+    REQUIRE( 3 == backend::get_command_stats().destroyed_objects );
+
+    // objects used by async work wait for its timeline value
+    queue_collection queues{};
+    queues.physical.push_back(VkQueue(1));
+    auto tracker = submission_tracker::create(device, queues);
+    const VkCommandBuffer cmd = VkCommandBuffer(1);
+    submit_batch batch{};
+    batch.add({&cmd, 1});
+    const auto point = tracker.submit(queues, 0, batch);
+    q.push(point, DESTROY_BUFFER, u64(VkBuffer(0x40)));
+    q.push({0, point.value + 1}, DESTROY_IMAGE, u64(VkImage(0x50)));
+    q.collect(tracker);
+    REQUIRE( 2 == q.pending() );
+
+    backend::complete_semaphores();
+    q.collect(tracker);
+    REQUIRE( 1 == q.pending() );
+    REQUIRE( 4 == q.destroyed );
+    REQUIRE( 4 == backend::get_command_stats().destroyed_objects );
+
+    q.destroy();
+    REQUIRE( 0 == q.pending() );
+    REQUIRE( 5 == backend::get_command_stats().destroyed_objects );
+    tracker.destroy(device);
+}
+#endif
+
+
+TEST_CASE("destruction_queue - wrappers are retired into the current frame", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    const auto fence = VkFence(1);
+    auto q = destruction_queue::create(device, 2);
+    backend::reset_command_stats();
+
+    auto smp = sampler::from(VkSampler(0x10));
+    auto pipe = pipeline::from(VkPipeline(0x30));
+    auto layout = pipeline_layout::from(VkPipelineLayout(0x40));
+    auto rp = renderpass::from(VkRenderPass(0x50));
+    auto fb = framebuffer::from(VkFramebuffer(0x60));
+    auto pool = command_pool::from(VkCommandPool(0x70));
+
+    q.begin_frame(0);
+    retire(q, smp);
+    retire(q, pipe);
+    retire(q, layout);
+    retire(q, rp);
+    retire(q, fb);
+    retire(q, pool);
+    REQUIRE( !smp.vk );
+    REQUIRE( !pipe.vk );
+    REQUIRE( !layout.vk );
+    REQUIRE( !rp.vk );
+    REQUIRE( !fb.vk );
+    REQUIRE( !pool.vk );
+    REQUIRE( 6 == q.pending() );
+
+    q.begin_frame(1, fence);
+    REQUIRE( 6 == q.pending() );
+    REQUIRE( 0 == backend::get_command_stats().destroyed_objects );
+
+    q.begin_frame(0, fence);
+    REQUIRE( 0 == q.pending() );
+    REQUIRE( 6 == q.destroyed );
+    // the backend counts samplers and pipelines
+    REQUIRE( 2 == backend::get_command_stats().destroyed_objects );
+
+    q.destroy();
+}
@@ -0,0 +1,48 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_frame_allocator.h"
+
+using namespace tinyvk;
+
+
+TEST_CASE("frame_allocator - aligned dynamic offsets per frame and batched flushes", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    VkPhysicalDeviceLimits limits{};
+    limits.minUniformBufferOffsetAlignment = 256;
+    limits.minStorageBufferOffsetAlignment = 64;
+    limits.nonCoherentAtomSize = 128;
+    alignas(256) static u8 mapped[4096]{};
+
+    auto coherent = frame_allocator::create(VkBuffer(1), mapped, sizeof(mapped), 2, limits);
+    REQUIRE( 2048 == coherent.frame_size() );
+    backend::reset_command_stats();
+    coherent.begin_frame(device, 1);
+    const auto a = coherent.allocate(16);
+    const auto b = coherent.push(u32(42));
+    REQUIRE( 2048 == a.offset );
+    REQUIRE( 2304 == b.offset );
+    REQUIRE( 42 == *(u32*)(mapped + 2304) );
+    coherent.flush(device);
+    REQUIRE( 0 == backend::get_command_stats().flushed_ranges );
+
+    // the region of a frame is reused once its fence signalled
+    coherent.begin_frame(device, 1, VkFence(1));
+    REQUIRE( 0 == coherent.used() );
+    REQUIRE( 2048 == coherent.allocate(2048).offset );
+    REQUIRE( nullptr == coherent.allocate(4).data );
+
+    // allocations since the last flush go out as one range
+    auto non_coherent = frame_allocator::create(VkBuffer(1), mapped, sizeof(mapped), 2, limits, VkDeviceMemory(1), 1024);
+    non_coherent.begin_frame(device, 0);
+    for (u32 i = 0; i < 4; ++i)
+        REQUIRE( i * 256 == non_coherent.allocate(100).offset );
+    non_coherent.flush(device);
+    non_coherent.flush(device);
+    REQUIRE( 1 == backend::get_command_stats().flushed_ranges );
+}
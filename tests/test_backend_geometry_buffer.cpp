@@ -0,0 +1,73 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_geometry_buffer.h"
+
+using namespace tinyvk;
+
+
+TEST_CASE("tlsf_allocator - ranges are reused and merged when freed", "[tinyvk_test]")
+{
+    auto tlsf = tlsf_allocator::create(1024, 16);
+    const auto a = tlsf.allocate(100);
+    const auto b = tlsf.allocate(200);
+    const auto c = tlsf.allocate(50);
+    REQUIRE( 0 == a.offset );
+    REQUIRE( 112 == a.size );
+    REQUIRE( 112 == b.offset );
+    REQUIRE( 320 == c.offset );
+    REQUIRE( 384 == tlsf.used() );
+    REQUIRE( 640 == tlsf.largest_free() );
+
+    tlsf.free(b.block);
+    const auto d = tlsf.allocate(150);
+    REQUIRE( 112 == d.offset );
+    REQUIRE( tlsf_allocator::NONE == tlsf.allocate(2000).block );
+
+    tlsf.free(a.block);
+    tlsf.free(c.block);
+    tlsf.free(d.block);
+    REQUIRE( 0 == tlsf.used() );
+    REQUIRE( 1024 == tlsf.largest_free() );
+    REQUIRE( 1024 == tlsf.allocate(1024).size );
+}
+
+
+TEST_CASE("geometry_buffer - frees are deferred and compaction moves allocations down", "[tinyvk_test]")
+{
+    auto geometry = geometry_buffer::create(VkBuffer(1), 1024, 2);
+    const auto a = geometry.allocate(256);
+    const auto b = geometry.allocate(256);
+    const auto c = geometry.allocate(256);
+    REQUIRE( 256 == b.offset );
+    REQUIRE( 512 == c.offset );
+
+    // the device may still read a this frame and the next one
+    geometry.free(a);
+    const auto d = geometry.allocate(256);
+    REQUIRE( 768 == d.offset );
+    REQUIRE( tlsf_allocator::NONE == geometry.allocate(256).block );
+    geometry.next_frame();
+    REQUIRE( tlsf_allocator::NONE == geometry.allocate(256).block );
+    geometry.next_frame();
+    REQUIRE( 768 == geometry.allocator.used() );
+
+    // the highest allocation moves into the hole at the start with one copy
+    geometry_buffer::move_t moves[4]{};
+    backend::reset_command_stats();
+    REQUIRE( 1 == geometry.compact(VkCommandBuffer(1), 1024, moves) );
+    REQUIRE( d.block == moves[0].old_block );
+    REQUIRE( 0 == moves[0].allocation.offset );
+    REQUIRE( 1 == backend::get_command_stats().copies );
+    REQUIRE( 1 == backend::get_command_stats().copy_regions );
+
+    // the old range is freed like any other, nothing left to move
+    geometry.next_frame();
+    geometry.next_frame();
+    REQUIRE( 256 == geometry.allocator.largest_free() );
+    REQUIRE( 0 == geometry.compact(VkCommandBuffer(1), 1024, moves) );
+}
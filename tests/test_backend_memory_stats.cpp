@@ -0,0 +1,68 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_memory_stats.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace tinyvk;
+
+
+TEST_CASE("memory_stats - categories, heap high-water marks and json dump", "[tinyvk_test]")
+{
+    memory_stats stats{};
+    stats.track(MEMORY_CATEGORY_BUFFER, 1024);
+    stats.track(MEMORY_CATEGORY_BUFFER, 2048);
+    stats.track(MEMORY_CATEGORY_STAGING, 4096);
+    stats.release(MEMORY_CATEGORY_BUFFER, 2048);
+
+    memory_stats::heap_t heaps[2]{};
+    heaps[0] = {1000, 600, 512, 400, 0, true};
+    heaps[1] = {4000, 100, 0, 0, 0, false};
+    const auto first = stats.snapshot(heaps);
+    REQUIRE( 0 == first.frame );
+    REQUIRE( 2 == first.heap_count );
+    REQUIRE( 1 == first.categories[MEMORY_CATEGORY_BUFFER].count );
+    REQUIRE( 1024 == first.categories[MEMORY_CATEGORY_BUFFER].bytes );
+    REQUIRE( 3072 == first.categories[MEMORY_CATEGORY_BUFFER].peak_bytes );
+    REQUIRE( 4096 == first.categories[MEMORY_CATEGORY_STAGING].bytes );
+    REQUIRE( 0 == first.categories[MEMORY_CATEGORY_IMAGE].count );
+    REQUIRE( 600 == first.heaps[0].peak_usage );
+    REQUIRE( 400 == first.device_local_available() );
+    REQUIRE( !first.over_budget() );
+    REQUIRE( first.over_budget(0.5f) );
+
+    // usage dropped, the peak stays
+    heaps[0].usage = 1200;
+    heaps[1].usage = 50;
+    const auto second = stats.snapshot(heaps);
+    REQUIRE( 1 == second.frame );
+    REQUIRE( 1200 == second.heaps[0].peak_usage );
+    REQUIRE( 100 == second.heaps[1].peak_usage );
+    REQUIRE( 0 == second.device_local_available() );
+    REQUIRE( second.over_budget() );
+
+    // truncated output is still terminated and reports the full length
+    char small[16]{};
+    const auto length = second.format_json(small, sizeof(small));
+    REQUIRE( length > sizeof(small) );
+    REQUIRE( sizeof(small) - 1 == strlen(small) );
+
+    const char* path = "tinyvk_memory_stats.json";
+    REQUIRE( second.write_json(path) );
+    FILE* file = fopen(path, "rb");
+    REQUIRE( file );
+    char json[1024]{};
+    const auto size = fread(json, 1, sizeof(json) - 1, file);
+    fclose(file);
+    remove(path);
+    REQUIRE( length == size );
+    REQUIRE( strstr(json, "{\"frame\":1,\"heaps\":[{\"budget\":1000,\"usage\":1200,") );
+    REQUIRE( strstr(json, "\"peak_usage\":100,\"device_local\":false}") );
+    REQUIRE( strstr(json, "\"buffer\":{\"count\":1,\"bytes\":1024,\"peak_bytes\":3072}") );
+}
@@ -0,0 +1,145 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+#include "tinyvk_renderpass.h"
+#define TINYVK_IMPLEMENTATION
+#include "tinyvk_pipeline.h"
+#include "tinyvk_downsampler.h"
+
+using namespace tinyvk;
+
+
+static pipeline::graphics_desc make_desc(pipeline::desc_storage& storage)
+{
+    pipeline::graphics_desc desc{storage, VkPipelineLayout(1), VkRenderPass(1), 0, 2, 1, 1, TOPOLOGY_TRIANGLE_LIST};
+    desc.add_stage(VkShaderModule(1), SHADER_VERTEX);
+    desc.add_stage(VkShaderModule(2), SHADER_FRAGMENT);
+    desc.add_vertex_binding(16);
+    desc.add_vertex_attribute(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0);
+    desc.add_dynamic_state(VK_DYNAMIC_STATE_VIEWPORT);
+    desc.add_dynamic_state(VK_DYNAMIC_STATE_SCISSOR);
+    return desc;
+}
+
+
+TEST_CASE("pipeline::graphics_desc - dynamic states", "[tinyvk_test]")
+{
+    pipeline::desc_storage storage{};
+    auto desc = make_desc(storage);
+
+    REQUIRE( 2 == desc.pDynamicState->dynamicStateCount );
+    REQUIRE( desc.is_dynamic(DYNAMIC_VIEWPORT) );
+    REQUIRE( !desc.is_dynamic(DYNAMIC_CULL_MODE) );
+
+    const dynamic_state_t states[]{
+        DYNAMIC_VIEWPORT, DYNAMIC_LINE_WIDTH, DYNAMIC_DEPTH_BIAS, DYNAMIC_BLEND_CONSTANTS, DYNAMIC_DEPTH_BOUNDS,
+        DYNAMIC_STENCIL_COMPARE_MASK, DYNAMIC_STENCIL_WRITE_MASK, DYNAMIC_STENCIL_REFERENCE,
+        DYNAMIC_CULL_MODE, DYNAMIC_FRONT_FACE, DYNAMIC_PRIMITIVE_TOPOLOGY, DYNAMIC_DEPTH_TEST_ENABLE,
+        DYNAMIC_DEPTH_WRITE_ENABLE, DYNAMIC_DEPTH_COMPARE_OP, DYNAMIC_DEPTH_BOUNDS_TEST_ENABLE,
+        DYNAMIC_STENCIL_TEST_ENABLE, DYNAMIC_STENCIL_OP, DYNAMIC_RASTERIZER_DISCARD_ENABLE,
+        DYNAMIC_DEPTH_BIAS_ENABLE, DYNAMIC_PRIMITIVE_RESTART_ENABLE, DYNAMIC_POLYGON_MODE,
+        DYNAMIC_COLOR_BLEND_ENABLE, DYNAMIC_COLOR_BLEND_EQUATION, DYNAMIC_COLOR_WRITE_MASK,
+    };
+    desc.add_dynamic_states(states);
+
+    // duplicates are ignored, more than the previous limit of 16 can be added
+    REQUIRE( 25 == desc.pDynamicState->dynamicStateCount );
+    REQUIRE( desc.is_dynamic(DYNAMIC_COLOR_WRITE_MASK) );
+}
+
+
+TEST_CASE("pipeline::graphics_desc - hash ignores dynamic state", "[tinyvk_test]")
+{
+    pipeline::desc_storage storage_a{}, storage_b{};
+    auto a = make_desc(storage_a);
+    auto b = make_desc(storage_b);
+    REQUIRE( a.hash_code() == b.hash_code() );
+
+    a.rasterizer(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT);
+    b.rasterizer(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE);
+    REQUIRE( a.hash_code() != b.hash_code() );
+
+    a.add_dynamic_state(VK_DYNAMIC_STATE_CULL_MODE);
+    REQUIRE( a.hash_code() != b.hash_code() );
+    b.add_dynamic_state(VK_DYNAMIC_STATE_CULL_MODE);
+    REQUIRE( a.hash_code() == b.hash_code() );
+
+    a.depth(storage_a, pipeline::depth_stencil::READ | pipeline::depth_stencil::WRITE, VK_COMPARE_OP_LESS);
+    b.depth(storage_b, pipeline::depth_stencil::READ, VK_COMPARE_OP_ALWAYS);
+    REQUIRE( a.hash_code() != b.hash_code() );
+
+    const dynamic_state_t depth_states[]{DYNAMIC_DEPTH_WRITE_ENABLE, DYNAMIC_DEPTH_COMPARE_OP, DYNAMIC_STENCIL_OP};
+    a.add_dynamic_states(depth_states);
+    b.add_dynamic_states(depth_states);
+    REQUIRE( a.hash_code() == b.hash_code() );
+}
+
+
+TEST_CASE("pipeline::graphics_desc - hash dynamic topology", "[tinyvk_test]")
+{
+    pipeline::desc_storage storage_a{}, storage_b{}, storage_c{};
+    auto a = make_desc(storage_a);
+    auto b = make_desc(storage_b);
+    auto c = make_desc(storage_c);
+    const_cast<VkPipelineInputAssemblyStateCreateInfo*>(b.pInputAssemblyState)->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    const_cast<VkPipelineInputAssemblyStateCreateInfo*>(c.pInputAssemblyState)->topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    REQUIRE( a.hash_code() != b.hash_code() );
+
+    // dynamic topology only needs to match the topology class
+    for (auto* d: {&a, &b, &c}) d->add_dynamic_state(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY);
+    REQUIRE( a.hash_code() == b.hash_code() );
+    REQUIRE( a.hash_code() != c.hash_code() );
+}
+
+
+TEST_CASE("downsampler - single dispatch for every level and layer", "[tinyvk_test]")
+{
+    REQUIRE( 13 == downsampler::mip_count(4096, 4096) );
+    REQUIRE( 9 == downsampler::mip_count(256, 100) );
+    REQUIRE( 1 == downsampler::mip_count(1, 1) );
+
+    const auto groups = downsampler::dispatch_size(1000, 64, 6);
+    REQUIRE( 16 == groups.width );
+    REQUIRE( 1 == groups.height );
+    REQUIRE( 6 == groups.depth );
+    REQUIRE( downsampler::SCRATCH_ALIGNMENT + 16 * 6 * 16 == downsampler::scratch_size(1000, 64, 6) );
+
+    // the embedded SPIR-V is used without the shader compiler
+    const auto spirv = downsampler::spirv();
+    REQUIRE( downsampler::source().size() > 0 );
+    REQUIRE( spirv.size() > 5 );
+    REQUIRE( 0x07230203 == spirv[0] );
+    REQUIRE( 0x00010000 == spirv[1] );
+    const VkDevice device = VkDevice(1);
+    auto d = downsampler::create(device);
+
+    // one 64x64 tile per workgroup, one layer per z
+    backend::reset_command_stats();
+    d.record(VkCommandBuffer(1), VkDescriptorSet(1), 1024, 1024, 6);
+    d.record(VkCommandBuffer(1), VkDescriptorSet(1), 1, 1, 1);
+    REQUIRE( 1 == backend::get_command_stats().dispatches );
+    REQUIRE( 16 * 16 * 6 == backend::get_command_stats().dispatched_groups );
+    REQUIRE( 0 == backend::get_command_stats().pipeline_barriers );
+
+    backend::reset_command_stats();
+    d.record(VkCommandBuffer(1), VkDescriptorSet(1), 1000, 64, 6);
+    REQUIRE( 16 * 1 * 6 == backend::get_command_stats().dispatched_groups );
+
+    // a 1024x1024 image has 10 levels after mip 0, the levels that are not written repeat the last view
+    VkImageView mips[10]{};
+    for (u32 i = 0; i < 10; ++i) mips[i] = VkImageView(u64(100 + i));
+    backend::reset_command_stats();
+    d.write_descriptors(device, VkDescriptorSet(1), VkImageView(99), mips, VkBuffer(1), 0, 1024, 1024, 6);
+    REQUIRE( 4 == backend::get_command_stats().descriptor_writes );
+    REQUIRE( 1 + downsampler::MAX_MIPS + 2 == backend::get_command_stats().written_descriptors );
+    const auto views = backend::get_written_image_views();
+    REQUIRE( 1 + downsampler::MAX_MIPS == views.size() );
+    REQUIRE( VkImageView(99) == views[0] );
+    for (u32 i = 0; i < downsampler::MAX_MIPS; ++i)
+        REQUIRE( mips[i < 10 ? i : 9] == views[1 + i] );
+
+    d.destroy(device);
+}
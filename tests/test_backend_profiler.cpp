@@ -0,0 +1,70 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_profiler.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace tinyvk;
+
+
+TEST_CASE("profiler - zones are resolved frames in flight later and written as a chrome trace", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    const auto cmd = command::from(VkCommandBuffer(1));
+    auto p = profiler::create(device, 2.0f, 2);
+
+    backend::reset_command_stats();
+    for (u32 frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+        p.begin_frame(device, cmd);
+        cpu_scope frame_zone{p, 0, "frame"};
+        {
+            gpu_scope shadows{p, cmd, "shadows"};
+            gpu_scope cascade{p, cmd, "cascade \"0\""};
+        }
+        gpu_scope post{p, cmd, "post"};
+        p.begin_cpu(1, "record");
+        p.end_cpu(1);
+    }
+    REQUIRE( 6 * MAX_FRAMES_IN_FLIGHT == backend::get_command_stats().timestamps );
+    // only cpu zones of the earlier frames are resolved, the first frame's pool is not reused yet
+    REQUIRE( 2 * (MAX_FRAMES_IN_FLIGHT - 1) == p.event_count() );
+
+    p.begin_frame(device, cmd);
+    REQUIRE( 2 * MAX_FRAMES_IN_FLIGHT + 3 == p.event_count() );
+    // gpu zones of the first frame, then the cpu zones of the last one
+    const auto& shadows = p.event(p.event_count() - 5);
+    const auto& cascade = p.event(p.event_count() - 4);
+    REQUIRE( 2 == p.event(p.event_count() - 1).track );
+    REQUIRE( profiler::GPU_TRACK == shadows.track );
+    REQUIRE( 0 == shadows.depth );
+    REQUIRE( 1 == cascade.depth );
+    // the stub timestamp of query i is (i + 1) * 1000 ticks, 2ns per tick
+    REQUIRE( 4000 == cascade.begin - shadows.begin );
+    REQUIRE( 2000 == shadows.end - shadows.begin );
+
+    // zones beyond the limit are dropped, their ends ignored
+    for (u32 i = 0; i < profiler_api_limits::MAX_GPU_ZONES; ++i) p.end_gpu(cmd, p.begin_gpu(cmd, "zone"));
+    REQUIRE( -1u == p.begin_gpu(cmd, "dropped") );
+
+    const char* path = "tinyvk_profiler_trace.json";
+    REQUIRE( p.write_chrome_trace(path) );
+    FILE* file = fopen(path, "rb");
+    REQUIRE( file );
+    char json[4096]{};
+    const auto size = fread(json, 1, sizeof(json) - 1, file);
+    fclose(file);
+    remove(path);
+    REQUIRE( size > 0 );
+    REQUIRE( strstr(json, "\"traceEvents\"") );
+    REQUIRE( strstr(json, "\"args\":{\"name\":\"CPU 1\"}") );
+    REQUIRE( strstr(json, "\"name\":\"cascade \\\"0\\\"\",\"ph\":\"X\",\"pid\":0,\"tid\":0") );
+
+    p.destroy(device);
+    REQUIRE( nullptr == p.events );
+}
@@ -0,0 +1,169 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_queue.h"
+
+using namespace tinyvk;
+
+
+TEST_CASE("submit_batch::submit - all submits go out with one call", "[tinyvk_test]")
+{
+    const auto queue = VkQueue(1);
+    const VkCommandBuffer cmds[]{VkCommandBuffer(1), VkCommandBuffer(2), VkCommandBuffer(3)};
+    const semaphore_submit acquire{VkSemaphore(1), 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    const semaphore_submit timeline{VkSemaphore(2), 42, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+
+    submit_batch batch{};
+    REQUIRE( batch.empty() );
+    batch.add({cmds, 1});
+    batch.add({cmds + 1, 2}, {&acquire, 1}, {&timeline, 1});
+    batch.add({}, {&timeline, 1});
+    REQUIRE( 3 == batch.submits.size() );
+    REQUIRE( 1 == batch.submits[2].wait_begin );
+    REQUIRE( 2 == batch.waits.size() );
+
+    backend::reset_command_stats();
+    batch.submit(queue, VkFence(1));
+    REQUIRE( batch.empty() );
+    REQUIRE( 1 == backend::get_command_stats().queue_submits );
+    REQUIRE( 3 == backend::get_command_stats().submit_infos );
+    REQUIRE( 3 == backend::get_command_stats().submitted_command_buffers );
+
+    // nothing to submit and no fence to signal
+    batch.submit(queue);
+    REQUIRE( 1 == backend::get_command_stats().queue_submits );
+
+#ifdef VK_VERSION_1_3
+    submit_batch::load_synchronization2(VkDevice(1));
+    batch.add({cmds, 3}, {&acquire, 1});
+    batch.submit2(queue);
+    REQUIRE( 2 == backend::get_command_stats().queue_submits );
+    REQUIRE( 6 == backend::get_command_stats().submitted_command_buffers );
+
+    // without synchronization2 submit falls back to vkQueueSubmit
+    submit_batch::load_synchronization2({});
+    batch.submit2(queue);
+    batch.add({cmds, 3}, {&acquire, 1});
+    batch.submit(queue);
+    REQUIRE( batch.empty() );
+    REQUIRE( 3 == backend::get_command_stats().queue_submits );
+    REQUIRE( 9 == backend::get_command_stats().submitted_command_buffers );
+#endif
+}
+
+
+#ifdef VK_VERSION_1_3
+TEST_CASE("legacy_stages - synchronization2 stages map to the legacy stages containing them", "[tinyvk_test]")
+{
+    REQUIRE( VK_PIPELINE_STAGE_TRANSFER_BIT == legacy_stages(VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_COPY_BIT) );
+    REQUIRE( VK_PIPELINE_STAGE_VERTEX_INPUT_BIT == legacy_stages(VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT) );
+    REQUIRE( VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT == legacy_stages(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT) );
+    REQUIRE( (legacy_stages(VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT) & VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT) );
+    REQUIRE( VK_ACCESS_SHADER_READ_BIT == legacy_access(VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT) );
+    REQUIRE( VK_ACCESS_SHADER_WRITE_BIT == legacy_access(VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT) );
+}
+#endif
+
+
+#ifdef VK_VERSION_1_2
+TEST_CASE("submission_tracker - submits advance their queue timeline and retire in order", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    queue_collection queues{};
+    queues.physical.push_back(VkQueue(1));
+    queues.physical.push_back(VkQueue(2));
+    queues.physical_index[QUEUE_COMPUTE][0] = 1;
+
+    auto tracker = submission_tracker::create(device, queues);
+    REQUIRE( 2 == tracker.timelines.size() );
+    const u32 graphics = submission_tracker::queue_index(queues, QUEUE_GRAPHICS);
+    const u32 compute = submission_tracker::queue_index(queues, QUEUE_COMPUTE);
+    REQUIRE( 0 == graphics );
+    REQUIRE( 1 == compute );
+
+    const VkCommandBuffer cmd = VkCommandBuffer(1);
+    submit_batch batch{};
+    batch.add({&cmd, 1});
+    const auto first = tracker.submit(queues, graphics, batch);
+    batch.add({&cmd, 1});
+    const auto second = tracker.submit(queues, graphics, batch);
+    REQUIRE( 1 == first.value );
+    REQUIRE( 2 == second.value );
+    REQUIRE( 2 == tracker.last_submitted(graphics).value );
+
+    // compute waits for the second graphics submit
+    const auto wait = tracker.wait_for(second, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    batch.add({&cmd, 1}, {&wait, 1});
+    const auto async = tracker.submit(queues, compute, batch);
+    REQUIRE( 1 == async.value );
+    REQUIRE( 0 == tracker.last_submitted(graphics).queue );
+
+    // the signal goes into an empty submit when the batch has none
+    const auto empty = tracker.signal(graphics, batch);
+    REQUIRE( 1 == batch.submits.size() );
+    REQUIRE( 1 == batch.signals.size() );
+    REQUIRE( 3 == empty.value );
+    batch.submit(queues.physical[graphics]);
+
+    REQUIRE_FALSE( tracker.completed(device, first) );
+    REQUIRE( tracker.wait(device, first) );
+    REQUIRE( tracker.completed(device, first) );
+    REQUIRE_FALSE( tracker.completed(device, async) );
+
+    // everything pending completes, completed() only queries the semaphore while the cached value is behind
+    backend::complete_semaphores();
+    tracker.poll(device);
+    REQUIRE( 3 == tracker.timelines[graphics].completed );
+    REQUIRE( tracker.completed(device, second) );
+    REQUIRE( tracker.completed(device, async) );
+    REQUIRE( tracker.wait_idle(device) );
+
+    // never submitted, can not complete
+    REQUIRE_FALSE( tracker.wait(device, {graphics, 10}, 0) );
+
+    tracker.destroy(device);
+    REQUIRE( tracker.timelines.empty() );
+}
+#endif
+
+
+#ifndef TINYVK_NO_JOBS
+TEST_CASE("submit_thread - packets from many threads are batched into few submits", "[tinyvk_test]")
+{
+    enum { PRODUCERS = 4, PACKETS = 200 };
+    queue_collection queues{};
+    queues.physical.push_back(VkQueue(1));
+    queues.physical.push_back(VkQueue(2));
+
+    static submit_thread submitter{};
+    submitter.start(queues, 16);
+    backend::reset_command_stats();
+
+    auto jobs = tinystd::job_system::create({PRODUCERS, 8});
+    jobs.parallel_for(PRODUCERS, 1, [](void*, u32 begin, u32, u32) {
+        submit_packet p{};
+        p.cmds[0] = VkCommandBuffer(begin + 1);
+        p.cmds[1] = VkCommandBuffer(begin + 2);
+        p.cmd_count = 2;
+        for (u32 i = 0; i < PACKETS; ++i) {
+            p.fence = i + 1 == PACKETS ? VkFence(begin + 1) : VkFence{};
+            submitter.push(begin % 2, p);
+        }
+    }, nullptr);
+    submitter.flush();
+    jobs.destroy();
+
+    const auto& stats = backend::get_command_stats();
+    REQUIRE( PRODUCERS * PACKETS == stats.submit_infos );
+    REQUIRE( 2 * PRODUCERS * PACKETS == stats.submitted_command_buffers );
+    REQUIRE( stats.queue_submits <= stats.submit_infos );
+    REQUIRE( stats.queue_submits >= PRODUCERS );
+
+    submitter.stop();
+    REQUIRE( submitter.packets.empty() );
+}
+#endif
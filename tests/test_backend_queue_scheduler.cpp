@@ -0,0 +1,109 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_queue_scheduler.h"
+
+using namespace tinyvk;
+
+
+#ifdef VK_VERSION_1_2
+TEST_CASE("queue_scheduler - async work overlaps on dedicated queues and is serialized on shared ones", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    const VkCommandBuffer cmds[]{VkCommandBuffer(1), VkCommandBuffer(2), VkCommandBuffer(3)};
+    const queue_request requests[]{{QUEUE_GRAPHICS, 0, 1}, {QUEUE_COMPUTE, 0, 1}, {QUEUE_TRANSFER, 0, 1}};
+    queue_family_properties props{};
+    VkQueueFamilyProperties p{};
+    p.queueCount = 1;
+    p.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    props.push_back(p);
+
+    SECTION("Dedicated")
+    {
+        p.queueFlags = VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+        props.push_back(p);
+        p.queueFlags = VK_QUEUE_TRANSFER_BIT;
+        props.push_back(p);
+        queue_availability av{requests, props};
+        queue_create_info info{requests, props, av};
+        queue_collection queues{device, requests, info};
+        auto s = queue_scheduler::create(device, queues, info);
+
+        REQUIRE_FALSE( s.route(QUEUE_COMPUTE).serialized );
+        REQUIRE_FALSE( s.route(QUEUE_TRANSFER).serialized );
+        REQUIRE( s.route(QUEUE_GRAPHICS).physical != s.route(QUEUE_COMPUTE).physical );
+        REQUIRE( s.route(QUEUE_GRAPHICS).family != s.route(QUEUE_COMPUTE).family );
+
+        // upload -> post processing on async compute -> graphics
+        const auto upload = s.submit(QUEUE_TRANSFER, {cmds, 1});
+        const auto scene = s.submit(QUEUE_GRAPHICS, {cmds + 1, 1});
+        const retire_point post_after[]{upload, scene};
+        const auto post = s.submit(QUEUE_COMPUTE, {cmds + 2, 1}, post_after, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        const retire_point present_after[]{post, scene};
+        s.submit(QUEUE_GRAPHICS, {cmds, 1}, present_after, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        const auto& compute = s.batches[s.route(QUEUE_COMPUTE).batch];
+        REQUIRE( 2 == compute.waits.size() );
+        REQUIRE( s.tracker.timelines[upload.queue].semaphore == compute.waits[0].semaphore );
+        REQUIRE( 1 == compute.signals.size() );
+        // the dependency on the earlier graphics work needs no semaphore, only a barrier in the command buffer
+        const auto& graphics = s.batches[s.route(QUEUE_GRAPHICS).batch];
+        REQUIRE( 1 == graphics.waits.size() );
+        REQUIRE( post.value == graphics.waits[0].value );
+        REQUIRE( 2 == graphics.signals.size() );
+
+        backend::reset_command_stats();
+        s.flush(queues);
+        REQUIRE( 3 == backend::get_command_stats().queue_submits );
+
+        barrier_batch release{}, acquire{};
+        const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        s.transfer_image(release, acquire, QUEUE_COMPUTE, QUEUE_GRAPHICS, VkImage(1), range,
+            VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT},
+            {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT});
+        REQUIRE( 1 == release.images.size() );
+        REQUIRE( 1 == acquire.images.size() );
+        REQUIRE( s.route(QUEUE_COMPUTE).family == release.images[0].srcQueueFamilyIndex );
+        REQUIRE( s.route(QUEUE_GRAPHICS).family == acquire.images[0].dstQueueFamilyIndex );
+        REQUIRE( 0 == release.image_masks[0].dst.stage );
+        REQUIRE( 0 == acquire.image_masks[0].src.stage );
+        s.destroy(device);
+    }
+
+    SECTION("Shared")
+    {
+        queue_availability av{requests, props};
+        queue_create_info info{requests, props, av};
+        queue_collection queues{device, requests, info};
+        auto s = queue_scheduler::create(device, queues, info);
+
+        REQUIRE( s.route(QUEUE_COMPUTE).serialized );
+        REQUIRE( s.route(QUEUE_TRANSFER).serialized );
+        REQUIRE( s.route(QUEUE_GRAPHICS).batch == s.route(QUEUE_COMPUTE).batch );
+
+        const auto upload = s.submit(QUEUE_TRANSFER, {cmds, 1});
+        const auto post = s.submit(QUEUE_COMPUTE, {cmds + 1, 1}, {&upload, 1});
+        s.submit(QUEUE_GRAPHICS, {cmds + 2, 1}, {&post, 1});
+        REQUIRE( s.batches[0].waits.empty() );
+        REQUIRE( 3 == s.batches[0].submits.size() );
+
+        backend::reset_command_stats();
+        s.flush(queues);
+        REQUIRE( 1 == backend::get_command_stats().queue_submits );
+
+        barrier_batch release{}, acquire{};
+        s.transfer_buffer(release, acquire, QUEUE_TRANSFER, QUEUE_GRAPHICS, VkBuffer(1),
+            {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT},
+            {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT});
+        REQUIRE( release.empty() );
+        REQUIRE( 1 == acquire.buffers.size() );
+        REQUIRE( VK_QUEUE_FAMILY_IGNORED == acquire.buffers[0].srcQueueFamilyIndex );
+        s.destroy(device);
+    }
+}
+#endif
@@ -0,0 +1,151 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_render_graph.h"
+#include "tinystd_algorithm.h"
+
+using namespace tinyvk;
+
+
+TEST_CASE("render_graph::compile - passes are culled, scheduled and transients aliased", "[tinyvk_test]")
+{
+    using rg = render_graph;
+    const auto record = [](command cmd, void* data) { ++*(u32*)data; };
+    u32 recorded = 0;
+
+    rg graph{};
+    const auto swap   = graph.import_image(VkImage(1), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    const auto shadow = graph.transient_image({2048, 256, 0x3}, {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1});
+    const auto albedo = graph.transient_image({1024, 256, 0x3});
+    const auto ao     = graph.transient_image({1024, 256, 0x3});
+    const auto blur   = graph.transient_image({1024, 256, 0x1});
+    const auto debug  = graph.transient_image({1024, 256, 0x3});
+
+    const auto gbuffer = graph.pass("gbuffer", record, &recorded);
+    graph.write(gbuffer, albedo, rg::USAGE_COLOR_ATTACHMENT);
+    const auto shadows = graph.pass("shadows", record, &recorded);
+    graph.write(shadows, shadow, rg::USAGE_DEPTH_ATTACHMENT);
+    const auto ssao = graph.pass("ssao", record, &recorded, PIPELINE_COMPUTE);
+    graph.read(ssao, albedo, rg::USAGE_SAMPLED);
+    graph.write(ssao, ao, rg::USAGE_STORAGE);
+    const auto unused = graph.pass("debug", record, &recorded);
+    graph.write(unused, debug, rg::USAGE_COLOR_ATTACHMENT);
+    const auto filter = graph.pass("blur", record, &recorded, PIPELINE_COMPUTE);
+    graph.read(filter, ao, rg::USAGE_SAMPLED);
+    graph.write(filter, blur, rg::USAGE_STORAGE);
+    const auto lighting = graph.pass("lighting", record, &recorded);
+    graph.read(lighting, blur, rg::USAGE_SAMPLED);
+    graph.read(lighting, shadow, rg::USAGE_SAMPLED);
+    graph.write(lighting, swap, rg::USAGE_COLOR_ATTACHMENT);
+    graph.compile();
+
+    REQUIRE( graph.culled(unused) );
+    REQUIRE( !graph.culled(gbuffer) );
+    REQUIRE( 4 == graph.stage_count() );
+    REQUIRE( 0 == graph.stage(gbuffer) );
+    REQUIRE( 0 == graph.stage(shadows) );
+    REQUIRE( 1 == graph.stage(ssao) );
+    REQUIRE( 2 == graph.stage(filter) );
+    REQUIRE( 3 == graph.stage(lighting) );
+
+    // shadow lives for the whole frame, blur reuses the memory of albedo once ssao is done with it
+    REQUIRE( 1 == graph.heaps.size() );
+    REQUIRE( 4096 == graph.heaps[0].size );
+    REQUIRE( 0x1 == graph.heaps[0].memory_type_bits );
+    REQUIRE( 0 == graph.memory_offset(shadow) );
+    REQUIRE( 2048 == graph.memory_offset(albedo) );
+    REQUIRE( 3072 == graph.memory_offset(ao) );
+    REQUIRE( 2048 == graph.memory_offset(blur) );
+    REQUIRE( graph.resources[blur].aliases.test(albedo) );
+
+    const auto& first_blur = *tinystd::find_if(graph.barriers.begin(), graph.barriers.end(),
+        [&](auto& b){ return b.resource == blur; });
+    REQUIRE( VK_IMAGE_LAYOUT_UNDEFINED == first_blur.old_layout );
+    REQUIRE( (first_blur.src.stage & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT) );
+    REQUIRE( (first_blur.src.stage & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) );
+
+    for (auto r: {shadow, albedo, ao, blur})
+        graph.set_image(r, VkImage(uint64_t(r + 10)));
+    backend::reset_command_stats();
+    graph.execute(VkCommandBuffer(1));
+    REQUIRE( 5 == recorded );
+    REQUIRE( 5 == backend::get_command_stats().pipeline_barriers );
+    REQUIRE( 10 == backend::get_command_stats().image_barriers );
+    REQUIRE( VK_IMAGE_LAYOUT_PRESENT_SRC_KHR == graph.barriers.back().new_layout );
+}
+
+
+TEST_CASE("render_graph::compile - transient buffers and images never share a heap", "[tinyvk_test]")
+{
+    using rg = render_graph;
+    const auto record = [](command, void*) {};
+
+    // same memory types, alive at the same time, the buffer would fit right after the image without granularity
+    rg graph{};
+    const auto target = graph.import_image(VkImage(1), VK_IMAGE_LAYOUT_UNDEFINED);
+    graph.output(target);
+    const auto image = graph.transient_image({1024, 256, 0x3});
+    const auto args = graph.transient_buffer({256, 16, 0x3});
+    const auto scratch = graph.transient_buffer({512, 16, 0x3});
+
+    const auto cull = graph.pass("cull", record, {}, PIPELINE_COMPUTE);
+    graph.write(cull, args, rg::USAGE_STORAGE);
+    graph.write(cull, image, rg::USAGE_STORAGE);
+    graph.write(cull, scratch, rg::USAGE_STORAGE);
+    const auto draw = graph.pass("draw", record);
+    graph.read(draw, args, rg::USAGE_INDIRECT);
+    graph.read(draw, image, rg::USAGE_SAMPLED);
+    graph.read(draw, scratch, rg::USAGE_STORAGE);
+    graph.write(draw, target, rg::USAGE_COLOR_ATTACHMENT);
+    graph.compile();
+
+    REQUIRE( 2 == graph.heaps.size() );
+    REQUIRE( graph.heaps[graph.heap_index(image)].images );
+    REQUIRE( !graph.heaps[graph.heap_index(args)].images );
+    REQUIRE( graph.heap_index(args) == graph.heap_index(scratch) );
+    REQUIRE( 1024 == graph.heaps[graph.heap_index(image)].size );
+    REQUIRE( 768 == graph.heaps[graph.heap_index(args)].size );
+    REQUIRE( 0 == graph.memory_offset(image) );
+    REQUIRE( 0 == graph.memory_offset(scratch) );
+    REQUIRE( 512 == graph.memory_offset(args) );
+}
+
+
+TEST_CASE("render_graph::compile - reads only wait for writes they have not seen", "[tinyvk_test]")
+{
+    using rg = render_graph;
+    const auto record = [](command, void*) {};
+
+    rg graph{};
+    const auto args = graph.import_buffer(VkBuffer(1));
+    const auto target = graph.import_image(VkImage(1), VK_IMAGE_LAYOUT_UNDEFINED);
+    graph.output(target);
+
+    const auto cull = graph.pass("cull", record, {}, PIPELINE_COMPUTE);
+    graph.write(cull, args, rg::USAGE_STORAGE);
+    const auto opaque = graph.pass("opaque", record);
+    graph.read(opaque, args, rg::USAGE_INDIRECT);
+    graph.write(opaque, target, rg::USAGE_COLOR_ATTACHMENT);
+    const auto transparent = graph.pass("transparent", record);
+    graph.read(transparent, args, rg::USAGE_INDIRECT);
+    graph.write(transparent, target, rg::USAGE_COLOR_ATTACHMENT);
+    graph.compile();
+
+    REQUIRE( 3 == graph.stage_count() );
+    REQUIRE( 3 == graph.barriers.size() );
+    // cull -> opaque: indirect read after storage write
+    REQUIRE( args == graph.barriers[0].resource );
+    REQUIRE( VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT == graph.barriers[0].src.stage );
+    REQUIRE( VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT == graph.barriers[0].dst.stage );
+    // first use of the target
+    REQUIRE( target == graph.barriers[1].resource );
+    REQUIRE( VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL == graph.barriers[1].new_layout );
+    // opaque -> transparent: write after write on the target, args are already visible to indirect reads
+    REQUIRE( target == graph.barriers[2].resource );
+    REQUIRE( 2 == graph.barriers[2].stage );
+    REQUIRE( VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT == graph.barriers[2].src.stage );
+}
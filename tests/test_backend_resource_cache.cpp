@@ -0,0 +1,101 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_resource_cache.h"
+
+using namespace tinyvk;
+
+
+TEST_CASE("sampler_cache - samplers are shared by state and destroyed with their last reference", "[tinyvk_test]")
+{
+    const VkDevice device = VkDevice(1);
+    sampler_cache cache{};
+
+    sampler_desc linear{};
+    sampler_desc shadow{};
+    shadow.address_u = shadow.address_v = shadow.address_w = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    shadow.compare = true;
+    shadow.compare_op = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+    ibool is_new{};
+    const sampler a = cache.create(device, linear, &is_new);
+    REQUIRE( is_new );
+    const sampler b = cache.create(device, sampler_desc{}, &is_new);
+    REQUIRE( !is_new );
+    REQUIRE( a.vk == b.vk );
+    const sampler c = cache.create(device, shadow, &is_new);
+    REQUIRE( is_new );
+    REQUIRE( a.vk != c.vk );
+    REQUIRE( 2 == cache.size() );
+
+    // compare_op is not part of the state without compare
+    sampler_desc op_only{};
+    op_only.compare_op = VK_COMPARE_OP_ALWAYS;
+    REQUIRE( op_only == linear );
+    REQUIRE( op_only.hash_code() == linear.hash_code() );
+    sampler_desc biased{};
+    biased.mip_lod_bias = -0.5f;
+    REQUIRE( !(biased == linear) );
+
+    cache.destroy(device, a);
+    REQUIRE( 2 == cache.size() );
+    cache.destroy(device, b);
+    REQUIRE( 1 == cache.size() );
+    REQUIRE( cache.create(device, linear, &is_new).vk != a.vk );
+    REQUIRE( is_new );
+
+    cache.destroy(device);
+    REQUIRE( 0 == cache.size() );
+}
+
+
+TEST_CASE("image_view_cache - views are shared per image and destroyed with the image", "[tinyvk_test]")
+{
+    const VkDevice device = VkDevice(1);
+    image_view_cache cache{};
+
+    VkImageViewCreateInfo info{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    info.image = VkImage(0x10);
+    info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+
+    ibool is_new{};
+    const VkImageView full = cache.create(device, info, &is_new);
+    REQUIRE( is_new );
+    REQUIRE( full == cache.create(device, info, &is_new) );
+    REQUIRE( !is_new );
+
+    auto mip = info;
+    mip.subresourceRange.baseMipLevel = 1;
+    mip.subresourceRange.levelCount = 1;
+    const VkImageView first_mip = cache.create(device, mip, &is_new);
+    REQUIRE( is_new );
+    REQUIRE( first_mip != full );
+
+    auto other = info;
+    other.image = VkImage(0x20);
+    const VkImageView other_full = cache.create(device, other, &is_new);
+    REQUIRE( is_new );
+    REQUIRE( other_full != full );
+    REQUIRE( 3 == cache.size() );
+
+    cache.destroy(device, full);
+    REQUIRE( 3 == cache.size() );
+    cache.destroy(device, full);
+    REQUIRE( 2 == cache.size() );
+
+    // every view of the image goes regardless of its references
+    (void)cache.create(device, mip);
+    cache.destroy_image(device, info.image);
+    REQUIRE( 1 == cache.size() );
+    REQUIRE( other_full == cache.create(device, other, &is_new) );
+    REQUIRE( !is_new );
+
+    cache.destroy(device);
+    REQUIRE( 0 == cache.size() );
+}
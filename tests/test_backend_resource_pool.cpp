@@ -0,0 +1,57 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_resource_pool.h"
+
+using namespace tinyvk;
+
+
+TEST_CASE("buffer_pool - dense arrays, stale handles and slot reuse", "[tinyvk_test]")
+{
+    buffer_pool pool{};
+    const buffer_handle a = pool.insert(VkBuffer(0x10), 256);
+    const buffer_handle b = pool.insert(VkBuffer(0x20), 512);
+    const buffer_handle c = pool.insert(VkBuffer(0x30), 1024);
+    REQUIRE( a );
+    REQUIRE( a != b );
+    REQUIRE( 3 == pool.size() );
+    REQUIRE( VkBuffer(0x20) == pool.get(b) );
+    REQUIRE( !pool.get(buffer_handle{}) );
+
+    pool.state(c)->access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+    // the last element fills the hole and keeps its handle
+    REQUIRE( pool.erase(a) );
+    REQUIRE( !pool.erase(a) );
+    REQUIRE( 2 == pool.size() );
+    REQUIRE( !pool.valid(a) );
+    REQUIRE( !pool.get(a) );
+    REQUIRE( 0 == pool.index(c) );
+    REQUIRE( VkBuffer(0x30) == pool.buffers[0] );
+    REQUIRE( 1024 == pool.sizes[0] );
+    REQUIRE( VK_ACCESS_2_TRANSFER_WRITE_BIT == pool.states[0].access );
+    REQUIRE( c == pool.handle(0) );
+    REQUIRE( b == pool.handle(1) );
+
+    // the slot of a is reused with a new generation
+    const buffer_handle d = pool.insert(VkBuffer(0x40), 128);
+    REQUIRE( (d.value & handle_table::INDEX_MASK) == (a.value & handle_table::INDEX_MASK) );
+    REQUIRE( d != a );
+    REQUIRE( !pool.get(a) );
+    REQUIRE( VkBuffer(0x40) == pool.get(d) );
+
+    u64 total = 0;
+    for (u32 i = 0; i < pool.size(); ++i)
+        total += pool.sizes[i];
+    REQUIRE( 512 + 1024 + 128 == total );
+
+    pool.clear();
+    REQUIRE( 0 == pool.size() );
+    REQUIRE( pool.buffers.empty() );
+    REQUIRE( !pool.valid(b) );
+    REQUIRE( !pool.valid(d) );
+}
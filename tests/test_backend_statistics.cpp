@@ -0,0 +1,53 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// built into its own executable with TINYVK_PIPELINE_STATISTICS, which changes the layout of the profiler
+#define TINYVK_IMPLEMENTATION
+#include "tinyvk_command.h"
+#include "tinyvk_profiler.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace tinyvk;
+
+
+TEST_CASE("profiler - pipeline statistics are resolved with the timestamps of their zone", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    const auto cmd = command::from(VkCommandBuffer(1));
+    auto p = profiler::create(device, 1.0f);
+
+    for (u32 frame = 0; frame <= MAX_FRAMES_IN_FLIGHT; ++frame) {
+        p.begin_frame(device, cmd);
+        if (frame) continue;
+        gpu_scope opaque{p, cmd, "opaque", true};
+        // statistics queries can not overlap, the nested zone only gets timestamps
+        gpu_scope nested{p, cmd, "nested", true};
+    }
+    REQUIRE( 2 == p.event_count() );
+    const auto* opaque = p.event_statistics(0);
+    REQUIRE( opaque );
+    REQUIRE( nullptr == p.event_statistics(1) );
+    // the stub writes (query + 1) * (statistic + 1)
+    REQUIRE( 2 == opaque->vertex_invocations );
+    REQUIRE( 5 == opaque->fragment_invocations );
+    REQUIRE( 6 == opaque->compute_invocations );
+
+    const char* path = "tinyvk_profiler_statistics.json";
+    REQUIRE( p.write_chrome_trace(path) );
+    FILE* file = fopen(path, "rb");
+    REQUIRE( file );
+    char json[4096]{};
+    const auto size = fread(json, 1, sizeof(json) - 1, file);
+    fclose(file);
+    remove(path);
+    REQUIRE( size > 0 );
+    REQUIRE( strstr(json, "\"args\":{\"input_vertices\":1,\"vertex_invocations\":2,") );
+    REQUIRE( strstr(json, "\"fragment_invocations\":5,\"compute_invocations\":6}}") );
+
+    p.destroy(device);
+}
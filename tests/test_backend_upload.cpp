@@ -0,0 +1,136 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// the implementation is compiled with the command tests
+#include "tinyvk_upload.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace tinyvk;
+
+
+TEST_CASE("upload_manager - copies are coalesced per destination and ring space is reclaimed by fence", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    const queue_request requests[]{{QUEUE_GRAPHICS, 0, 1}, {QUEUE_TRANSFER, 0, 1}};
+    queue_family_properties props{};
+    VkQueueFamilyProperties p{};
+    p.queueCount = 1;
+    p.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    props.push_back(p);
+    p.queueFlags = VK_QUEUE_TRANSFER_BIT;
+    props.push_back(p);
+    queue_availability av{requests, props};
+    queue_create_info info{requests, props, av};
+    queue_collection queues{device, requests, info};
+
+    u8 ring[256]{};
+    u8 data[200]{};
+    for (u32 i = 0; i < 200; ++i) data[i] = u8(i);
+    auto uploads = upload_manager::create(device, queues, info, VkBuffer(100), ring, sizeof(ring));
+    REQUIRE( uploads.queue == queues.get(QUEUE_TRANSFER) );
+    REQUIRE( uploads.transfer_family != uploads.dst_family );
+
+    // sequential ranges of a buffer become one region
+    REQUIRE( uploads.upload_buffer(device, VkBuffer(1), 0, data, 64) );
+    REQUIRE( uploads.upload_buffer(device, VkBuffer(1), 64, data + 64, 64) );
+    REQUIRE( uploads.upload_buffer(device, VkBuffer(2), 0, data, 16) );
+    REQUIRE( uploads.upload_buffer(device, VkBuffer(1), 512, data, 16) );
+    REQUIRE( 0 == memcmp(ring, data, 128) );
+    REQUIRE( 128 == uploads.buffer_copies[0].region.size );
+
+    const VkImageSubresourceLayers mip0{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, mip1{VK_IMAGE_ASPECT_COLOR_BIT, 1, 0, 1};
+    REQUIRE( uploads.upload_image(device, VkImage(1), mip0, {}, {4, 2, 1}, data, 32) );
+    REQUIRE( uploads.upload_image(device, VkImage(1), mip1, {}, {2, 1, 1}, data, 8) );
+    REQUIRE( 5 == uploads.queued_count() );
+    REQUIRE( 0 == uploads.image_copies[0].region.bufferOffset % 16 );
+
+    backend::reset_command_stats();
+    uploads.flush(device);
+    REQUIRE( 0 == uploads.queued_count() );
+    REQUIRE( 1 == backend::get_command_stats().queue_submits );
+    // one copy per destination buffer and image
+    REQUIRE( 3 == backend::get_command_stats().copies );
+    REQUIRE( 5 == backend::get_command_stats().copy_regions );
+    // mips are transitioned together before the copies, everything is released to the graphics family after them
+    REQUIRE( 2 == backend::get_command_stats().pipeline_barriers );
+    REQUIRE( 2 == backend::get_command_stats().image_barriers );
+    REQUIRE( 3 == backend::get_command_stats().buffer_barriers );
+
+    REQUIRE( uploads.used() > 0 );
+    uploads.reclaim(device);
+    REQUIRE( 0 == uploads.used() );
+
+    // a full ring flushes the queued copies and waits for them
+    REQUIRE( uploads.upload_buffer(device, VkBuffer(1), 0, data, 200) );
+    REQUIRE( uploads.upload_buffer(device, VkBuffer(2), 0, data, 100) );
+    REQUIRE( 2 == backend::get_command_stats().queue_submits );
+    REQUIRE( 1 == uploads.queued_count() );
+    // it does not fit behind the first one and wraps around to the start of the ring
+    REQUIRE( 0 == uploads.buffer_copies[0].region.srcOffset );
+    REQUIRE_FALSE( uploads.upload_buffer(device, VkBuffer(2), 0, data, 300) );
+
+    uploads.destroy(device);
+}
+
+
+TEST_CASE("upload_manager::upload_file - files are read into the ring or imported as the copy source", "[tinyvk_test]")
+{
+    const auto device = VkDevice(1);
+    const queue_request requests[]{{QUEUE_GRAPHICS, 0, 1}};
+    queue_family_properties props{};
+    VkQueueFamilyProperties p{};
+    p.queueCount = 1;
+    p.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    props.push_back(p);
+    queue_availability av{requests, props};
+    queue_create_info info{requests, props, av};
+    queue_collection queues{device, requests, info};
+
+    u8 data[200]{};
+    for (u32 i = 0; i < 200; ++i) data[i] = u8(i);
+    const char* path = "tinyvk_upload_file.bin";
+    FILE* file = fopen(path, "wb");
+    REQUIRE( file );
+    fwrite(data, 1, sizeof(data), file);
+    fclose(file);
+
+    u8 ring[256]{};
+    auto uploads = upload_manager::create(device, queues, info, VkBuffer(100), ring, sizeof(ring));
+
+    // without host import the file streams through the ring in chunks that merge into one region
+    REQUIRE( uploads.upload_file(device, path, 8, 192, VkBuffer(1), 0) );
+    REQUIRE( 1 == uploads.queued_count() );
+    REQUIRE( 192 == uploads.buffer_copies[0].region.size );
+    REQUIRE( 0 == memcmp(ring, data + 8, 192) );
+    REQUIRE_FALSE( uploads.upload_file(device, path, 100, 101, VkBuffer(1), 0) );
+    REQUIRE_FALSE( uploads.upload_file(device, "tinyvk_missing_file.bin", 0, 4, VkBuffer(1), 0) );
+    uploads.flush(device);
+    uploads.reclaim(device);
+
+    // imported ranges are copied straight from the mapping, the ring is not used
+    REQUIRE( uploads.enable_host_import(device, VkPhysicalDevice(1)) );
+    REQUIRE( 4096 == uploads.import_alignment );
+    const u64 used = uploads.used();
+    REQUIRE( uploads.upload_file(device, path, 10, 30, VkBuffer(2), 64) );
+    const VkImageSubresourceLayers mip0{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    REQUIRE( uploads.upload_file(device, path, 0, 32, VkImage(1), mip0, {}, {4, 2, 1}) );
+    REQUIRE( used == uploads.used() );
+    REQUIRE( 2 == uploads.imports.size() );
+    REQUIRE( 10 == uploads.buffer_copies[0].region.srcOffset );
+    REQUIRE( 64 == uploads.buffer_copies[0].region.dstOffset );
+    REQUIRE( 0 == uploads.image_copies[0].region.bufferOffset );
+
+    // imports are released once the batch that copies them completed
+    uploads.flush(device);
+    REQUIRE( 1 == uploads.imports[0].batch );
+    uploads.reclaim(device);
+    REQUIRE( uploads.imports.empty() );
+
+    uploads.destroy(device);
+    remove(path);
+}
@@ -0,0 +1,482 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+// built into its own executable with TINYVK_USE_VMA, the backend provides the memory VMA allocates from
+#define TINYVK_IMPLEMENTATION
+#include "tinyvk_device.h"
+#include "tinyvk_queue.h"
+#include "tinyvk_command.h"
+#include "tinyvk_buffer.h"
+#include "tinyvk_image.h"
+#include "tinyvk_defragmenter.h"
+#include "tinyvk_memory_stats.h"
+#include "tinyvk_upload.h"
+#include "tinyvk_frame_allocator.h"
+#include "tinyvk_destruction_queue.h"
+#include "tinyvk_resource_pool.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace tinyvk;
+
+
+struct TestDevice {
+    tinyvk::instance instance{};
+    VkPhysicalDevice physical_device{};
+    tinyvk::device device{};
+    VmaAllocator vma{};
+
+    explicit TestDevice(span<const char* const> device_extensions = {}) {
+        auto ext = tinyvk::extensions{};
+        ext.device = device_extensions;
+        instance = tinyvk::instance::create(tinyvk::application_info{}, ext);
+        physical_device = tinyvk::physical_devices{instance}.pick_best(ext, true);
+        auto queue_info = tinyvk::queue_create_info{{}, physical_device};
+        device = tinyvk::device::create(instance, physical_device, queue_info, ext, {}, &vma);
+    }
+
+    ~TestDevice() {
+        device.destroy(&vma);
+        instance.destroy();
+    }
+};
+
+
+static queue_create_info graphics_and_transfer_queues(queue_collection& queues, VkDevice device)
+{
+    const queue_request requests[]{{QUEUE_GRAPHICS, 0, 1}, {QUEUE_TRANSFER, 0, 1}};
+    queue_family_properties props{};
+    VkQueueFamilyProperties p{};
+    p.queueCount = 1;
+    p.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    props.push_back(p);
+    p.queueFlags = VK_QUEUE_TRANSFER_BIT;
+    props.push_back(p);
+    queue_availability av{requests, props};
+    queue_create_info info{requests, props, av};
+    queues = queue_collection{device, requests, info};
+    return info;
+}
+
+
+TEST_CASE("defragmenter - moves are planned, copied in one pass and retired frames in flight later", "[tinyvk_test]")
+{
+    TestDevice d{};
+    queue_collection queues{};
+    const auto info = graphics_and_transfer_queues(queues, d.device);
+    const u32 families[]{0, 1};
+
+    struct rebound_t { u32 count; } rebound{};
+    auto defrag = defragmenter::create(d.device, queues, info, 2,
+        [](void* data, const defragmenter::move_t&) { ++((rebound_t*)data)->count; }, &rebound);
+
+    // the first memory block (4MB) is filled with buffers, the tracked buffer and image land in a second one,
+    // freeing two of the first buffers leaves the hole they are moved into
+    buffer_desc buffer_info{1u << 20, buffer_usage_t(BUFFER_STORAGE | BUFFER_TRANSFER_SRC | BUFFER_TRANSFER_DST), VMA_USAGE_GPU_ONLY};
+    buffer_info.queue_families = {families, 2};
+    image_desc image_info{{256, 256}, VK_FORMAT_R8G8B8A8_UNORM, image_usage_t(IMAGE_SAMPLED | IMAGE_TRANSFER_SRC | IMAGE_TRANSFER_DST)};
+    image_info.queue_families = {families, 2};
+    VmaAllocation allocations[6]{};
+    buffer buffers[5]{};
+    for (u32 i = 0; i < 5; ++i)
+        buffers[i] = buffer::create(d.vma, allocations[i], buffer_info);
+    image im = image::create(d.vma, allocations[5], image_info);
+    buffers[0].destroy(d.vma, allocations[0]);
+    buffers[1].destroy(d.vma, allocations[1]);
+    defrag.track(d.vma, allocations[4], buffers[4], buffer_info);
+    defrag.track(d.vma, allocations[5], im, image_info);
+
+    VmaAllocationInfo first_block{}, before[2]{};
+    vmaGetAllocationInfo(d.vma, allocations[2], &first_block);
+    vmaGetAllocationInfo(d.vma, allocations[4], &before[0]);
+    vmaGetAllocationInfo(d.vma, allocations[5], &before[1]);
+    REQUIRE( first_block.deviceMemory != before[0].deviceMemory );
+    REQUIRE( first_block.deviceMemory != before[1].deviceMemory );
+
+    // the first step records the copies of the pass and submits them on the transfer queue
+    backend::reset_command_stats();
+    defrag.begin(d.vma);
+    REQUIRE( defrag.running() );
+    REQUIRE( defrag.step(d.vma, d.device, -1ull).empty() );
+    REQUIRE( defragmenter::COPYING == defrag.state );
+    REQUIRE( 2 == defrag.moves.size() );
+    REQUIRE( 2 == backend::get_command_stats().copies );
+    REQUIRE( 1 == backend::get_command_stats().queue_submits );
+    REQUIRE( 2 == backend::get_command_stats().pipeline_barriers );
+    // the old and the new image are transitioned for the copy (after all earlier work) and back to the kept layout
+    REQUIRE( 4 == backend::get_command_stats().image_barriers );
+    REQUIRE( 2 == backend::get_command_stats().memory_barriers );
+
+    // the fence signaled, the resources switch to the new handles
+    const auto moved = defrag.step(d.vma, d.device, -1ull);
+    REQUIRE( 2 == moved.size() );
+    REQUIRE( 2 == rebound.count );
+    const auto buffer_move = moved[0].new_buffer ? moved[0] : moved[1];
+    const auto image_move = moved[0].new_image ? moved[0] : moved[1];
+    REQUIRE( buffers[4].vk == buffer_move.old_buffer );
+    REQUIRE( buffer_move.new_buffer );
+    REQUIRE( im.vk == image_move.old_image );
+    REQUIRE( image_move.new_image );
+    REQUIRE( defragmenter::RETIRING == defrag.state );
+
+    // the old handles are destroyed once the frames in flight that may use them completed
+    const u64 destroyed = backend::get_command_stats().destroyed_objects;
+    REQUIRE( defrag.step(d.vma, d.device, -1ull).empty() );
+    REQUIRE( destroyed == backend::get_command_stats().destroyed_objects );
+    REQUIRE( defrag.step(d.vma, d.device, -1ull).empty() );
+    REQUIRE( destroyed + 2 == backend::get_command_stats().destroyed_objects );
+    REQUIRE( !defrag.running() );
+
+    VmaAllocationInfo after[2]{};
+    vmaGetAllocationInfo(d.vma, allocations[4], &after[0]);
+    vmaGetAllocationInfo(d.vma, allocations[5], &after[1]);
+    REQUIRE( first_block.deviceMemory == after[0].deviceMemory );
+    REQUIRE( first_block.deviceMemory == after[1].deviceMemory );
+    REQUIRE( 2 == defrag.allocations_moved );
+    REQUIRE( before[0].size + before[1].size == defrag.bytes_moved );
+
+    defrag.destroy(d.vma, d.device);
+    vmaDestroyBuffer(d.vma, buffer_move.new_buffer, allocations[4]);
+    vmaDestroyImage(d.vma, image_move.new_image, allocations[5]);
+    for (u32 i = 2; i < 4; ++i)
+        buffers[i].destroy(d.vma, allocations[i]);
+}
+
+
+TEST_CASE("memory_stats - resources created with the stats are tracked until destroyed, snapshot reads the VMA budget", "[tinyvk_test]")
+{
+    TestDevice d{};
+    queue_collection queues{};
+    const auto info = graphics_and_transfer_queues(queues, d.device);
+    VkPhysicalDeviceLimits limits{};
+    limits.minUniformBufferOffsetAlignment = 256;
+    limits.minStorageBufferOffsetAlignment = 64;
+    limits.nonCoherentAtomSize = 128;
+
+    memory_stats stats{};
+    VmaAllocation allocations[2]{};
+    buffer b = buffer::create(d.vma, allocations[0], {1u << 20, BUFFER_STORAGE, VMA_USAGE_GPU_ONLY}, {}, &stats);
+    image im = image::create(d.vma, allocations[1], {{256, 256}, VK_FORMAT_R8G8B8A8_UNORM, IMAGE_SAMPLED}, {}, &stats);
+    auto uploads = upload_manager::create(d.vma, d.device, queues, info, 1u << 20, &stats);
+    auto frames = frame_allocator::create(d.vma, 1u << 16, 2, limits, &stats);
+
+    VmaAllocationInfo sizes[4]{};
+    vmaGetAllocationInfo(d.vma, allocations[0], &sizes[0]);
+    vmaGetAllocationInfo(d.vma, allocations[1], &sizes[1]);
+    vmaGetAllocationInfo(d.vma, uploads.allocation, &sizes[2]);
+    vmaGetAllocationInfo(d.vma, frames.allocation, &sizes[3]);
+    REQUIRE( 2 == stats.categories[MEMORY_CATEGORY_BUFFER].count );
+    REQUIRE( sizes[0].size + sizes[3].size == stats.categories[MEMORY_CATEGORY_BUFFER].bytes );
+    REQUIRE( 1 == stats.categories[MEMORY_CATEGORY_IMAGE].count );
+    REQUIRE( sizes[1].size == stats.categories[MEMORY_CATEGORY_IMAGE].bytes );
+    REQUIRE( 1 == stats.categories[MEMORY_CATEGORY_STAGING].count );
+    REQUIRE( sizes[2].size == stats.categories[MEMORY_CATEGORY_STAGING].bytes );
+
+    // without VK_EXT_memory_budget VMA estimates the budget as 80% of the heap and the usage as its blocks
+    const auto s = stats.snapshot(d.vma);
+    REQUIRE( 0 == s.frame );
+    REQUIRE( 2 == s.heap_count );
+    REQUIRE( s.heaps[0].device_local );
+    REQUIRE( !s.heaps[1].device_local );
+    for (u32 h = 0; h < 2; ++h) {
+        REQUIRE( (256ull << 20) * 8 / 10 == s.heaps[h].budget );
+        REQUIRE( s.heaps[h].block_bytes == s.heaps[h].usage );
+        REQUIRE( s.heaps[h].usage == s.heaps[h].peak_usage );
+    }
+    REQUIRE( sizes[0].size + sizes[1].size == s.heaps[0].allocation_bytes );
+    REQUIRE( sizes[2].size + sizes[3].size == s.heaps[1].allocation_bytes );
+    REQUIRE( s.heaps[0].usage >= s.heaps[0].allocation_bytes );
+    REQUIRE( !s.over_budget() );
+    REQUIRE( s.heaps[0].budget - s.heaps[0].usage == s.device_local_available() );
+
+    frames.destroy(d.vma);
+    uploads.destroy(d.vma, d.device);
+    im.destroy(d.vma, allocations[1], &stats);
+    b.destroy(d.vma, allocations[0], &stats);
+    for (const auto& c: stats.categories) {
+        REQUIRE( 0 == c.count );
+        REQUIRE( 0 == c.bytes );
+    }
+    REQUIRE( sizes[0].size + sizes[3].size == stats.categories[MEMORY_CATEGORY_BUFFER].peak_bytes );
+    REQUIRE( sizes[2].size == stats.categories[MEMORY_CATEGORY_STAGING].peak_bytes );
+
+    // the high-water mark of the heaps outlives the allocations
+    const auto after = stats.snapshot(d.vma);
+    REQUIRE( 1 == after.frame );
+    REQUIRE( 0 == after.heaps[0].allocation_bytes );
+    REQUIRE( s.heaps[0].peak_usage == after.heaps[0].peak_usage );
+}
+
+
+TEST_CASE("destruction_queue - buffers and images retired with their allocation are freed with their frame", "[tinyvk_test]")
+{
+    TestDevice d{};
+    const auto fence = VkFence(1);
+    auto q = destruction_queue::create(d.device, d.vma, 2);
+    backend::reset_command_stats();
+
+    memory_stats stats{};
+    VmaAllocation allocations[2]{};
+    image_dimensions dim{};
+    buffer b = buffer::create(d.vma, allocations[0], {1u << 20, BUFFER_STORAGE, VMA_USAGE_GPU_ONLY}, {}, &stats);
+    image im = image::create(d.vma, allocations[1], {{256, 256}, VK_FORMAT_R8G8B8A8_UNORM, IMAGE_SAMPLED}, &dim, &stats);
+    image_view view = im.create_view(d.device, {}, dim);
+    REQUIRE( view.vk );
+
+    // the stats are released right away, the objects and their memory live until the frame comes around again
+    q.begin_frame(0);
+    retire(q, view);
+    retire(q, im, allocations[1], &stats);
+    retire(q, b, allocations[0], &stats);
+    REQUIRE( !view.vk );
+    REQUIRE( !im.vk );
+    REQUIRE( !b.vk );
+    REQUIRE( 3 == q.pending() );
+    for (const auto& c: stats.categories)
+        REQUIRE( 0 == c.count );
+    REQUIRE( 0 < stats.snapshot(d.vma).heaps[0].allocation_bytes );
+
+    q.begin_frame(1, fence);
+    REQUIRE( 3 == q.pending() );
+    REQUIRE( 0 == backend::get_command_stats().destroyed_objects );
+
+    q.begin_frame(0, fence);
+    REQUIRE( 0 == q.pending() );
+    REQUIRE( 3 == q.destroyed );
+    REQUIRE( 3 == backend::get_command_stats().destroyed_objects );
+    REQUIRE( 0 == stats.snapshot(d.vma).heaps[0].allocation_bytes );
+
+    // memory shared by aliased images is freed on its own once the images are gone
+    const image_alias_desc descs[]{
+        {{{128, 128}, VK_FORMAT_R8G8B8A8_UNORM, IMAGE_SAMPLED}, 0, 0},
+        {{{128, 128}, VK_FORMAT_R8G8B8A8_UNORM, IMAGE_SAMPLED}, 1, 1},
+    };
+    image images[2]{};
+    VkDeviceSize offsets[2]{};
+    VmaAllocation shared{};
+    image::create_aliased(d.vma, d.device, shared, descs, images, offsets);
+    q.push(DESTROY_IMAGE, u64(images[0].vk));
+    q.push(DESTROY_IMAGE, u64(images[1].vk));
+    q.push(DESTROY_ALLOCATION, 0, shared);
+    REQUIRE( 0 < stats.snapshot(d.vma).heaps[0].allocation_bytes );
+    q.destroy();
+    REQUIRE( 0 == q.pending() );
+    REQUIRE( 6 == q.destroyed );
+    REQUIRE( 5 == backend::get_command_stats().destroyed_objects );
+    REQUIRE( 0 == stats.snapshot(d.vma).heaps[0].allocation_bytes );
+}
+
+
+TEST_CASE("image_pool - created images are owned by the pool, inserted ones are only tracked", "[tinyvk_test]")
+{
+    TestDevice d{};
+    memory_stats stats{};
+    backend::reset_command_stats();
+
+    image_pool pool{};
+    const image_handle a = pool.create(d.vma, {{256, 256}, VK_FORMAT_R8G8B8A8_UNORM, IMAGE_SAMPLED});
+    const image_handle b = pool.create(d.vma, {{128, 64}, VK_FORMAT_R8G8B8A8_UNORM, IMAGE_SAMPLED});
+    const image_handle swap = pool.insert(VkImage(0x10), {640, 480, 1, 1, 0, 1, VK_FORMAT_R8G8B8A8_SRGB}, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    REQUIRE( 3 == pool.size() );
+    REQUIRE( pool.get(a) );
+    REQUIRE( pool.get(a) != pool.get(b) );
+    REQUIRE( VkImage(0x10) == pool.get(swap) );
+    REQUIRE( 128 == pool.dims(b)->width );
+    REQUIRE( 64 == pool.dims(b)->height );
+    REQUIRE( VK_FORMAT_R8G8B8A8_UNORM == pool.dims(b)->format );
+    REQUIRE( VK_IMAGE_LAYOUT_UNDEFINED == pool.state(a)->layout );
+    REQUIRE( VK_IMAGE_LAYOUT_PRESENT_SRC_KHR == pool.state(swap)->layout );
+    REQUIRE( pool.allocations[pool.index(a)] );
+    REQUIRE( !pool.allocations[pool.index(swap)] );
+    REQUIRE( 0 < stats.snapshot(d.vma).heaps[0].allocation_bytes );
+
+    // the last image fills the hole and keeps its handle, state and allocation
+    pool.state(swap)->layout = VK_IMAGE_LAYOUT_GENERAL;
+    REQUIRE( pool.destroy(d.vma, a) );
+    REQUIRE( !pool.destroy(d.vma, a) );
+    REQUIRE( 1 == backend::get_command_stats().destroyed_objects );
+    REQUIRE( !pool.valid(a) );
+    REQUIRE( !pool.get(a) );
+    REQUIRE( !pool.dims(a) );
+    REQUIRE( 0 == pool.index(swap) );
+    REQUIRE( VK_IMAGE_LAYOUT_GENERAL == pool.states[0].layout );
+    REQUIRE( !pool.allocations[0] );
+    REQUIRE( 640 == pool.dims(swap)->width );
+
+    // inserted images are forgotten, never destroyed
+    REQUIRE( pool.erase(swap) );
+    REQUIRE( !pool.erase(swap) );
+    REQUIRE( 1 == pool.size() );
+    REQUIRE( 1 == backend::get_command_stats().destroyed_objects );
+
+    const image_handle c = pool.insert(VkImage(0x20), {});
+    pool.destroy(d.vma);
+    REQUIRE( 0 == pool.size() );
+    REQUIRE( pool.images.empty() );
+    REQUIRE( !pool.valid(b) );
+    REQUIRE( !pool.valid(c) );
+    REQUIRE( 2 == backend::get_command_stats().destroyed_objects );
+    REQUIRE( 0 == stats.snapshot(d.vma).heaps[0].allocation_bytes );
+}
+
+
+TEST_CASE("image - aliased images share memory of the types every image supports", "[tinyvk_test]")
+{
+    TestDevice d{};
+    const auto transient = image_usage_t(IMAGE_COLOR | IMAGE_TRANSIENT);
+
+    // 256KB alive in passes 0-1, two 64KB in 2-3 and 1-2, 16KB sampled (not transient) alive in all of them
+    const image_alias_desc descs[]{
+        {{{256, 256}, VK_FORMAT_R8G8B8A8_UNORM, transient}, 0, 1},
+        {{{128, 128}, VK_FORMAT_R8G8B8A8_UNORM, transient}, 2, 3},
+        {{{128, 128}, VK_FORMAT_R8G8B8A8_UNORM, transient}, 1, 2},
+        {{{64, 64}, VK_FORMAT_R8G8B8A8_UNORM, IMAGE_SAMPLED}, 0, 3},
+    };
+    image images[4]{};
+    VkDeviceSize offsets[4]{};
+    VmaAllocation allocation{};
+    image::create_aliased(d.vma, d.device, allocation, descs, images, offsets);
+    REQUIRE( 0 == offsets[0] );
+    REQUIRE( 0 == offsets[1] );
+    REQUIRE( (256u << 10) == offsets[2] );
+    REQUIRE( (320u << 10) == offsets[3] );
+
+    // the sampled image has no lazily allocated type, all of them go to device local memory
+    VmaAllocationInfo info{};
+    vmaGetAllocationInfo(d.vma, allocation, &info);
+    REQUIRE( (336u << 10) <= info.size );
+    REQUIRE( 0 == info.memoryType );
+    image::destroy_aliased(d.vma, d.device, allocation, images);
+    for (const auto& im: images)
+        REQUIRE( !im.vk );
+
+    // only transient images can live in lazily allocated memory
+    VmaAllocation lazy{};
+    image::create_aliased(d.vma, d.device, lazy, {descs, 3}, images, offsets);
+    vmaGetAllocationInfo(d.vma, lazy, &info);
+    REQUIRE( 3 == info.memoryType );
+    REQUIRE( 0 == offsets[0] );
+    REQUIRE( 0 == offsets[1] );
+    REQUIRE( (256u << 10) == offsets[2] );
+    image::destroy_aliased(d.vma, d.device, lazy, {images, 3});
+
+    VmaAllocation single{};
+    image im = image::create(d.vma, single, descs[0].desc);
+    vmaGetAllocationInfo(d.vma, single, &info);
+    REQUIRE( 3 == info.memoryType );
+    im.destroy(d.vma, single);
+}
+
+
+TEST_CASE("image - transient images fall back to device local memory without lazily allocated memory", "[tinyvk_test]")
+{
+    backend::set_lazily_allocated_memory(false);
+    {
+        TestDevice d{};
+        const image_alias_desc descs[]{
+            {{{256, 256}, VK_FORMAT_R8G8B8A8_UNORM, image_usage_t(IMAGE_COLOR | IMAGE_TRANSIENT)}, 0, 0},
+            {{{256, 256}, VK_FORMAT_D32_SFLOAT, image_usage_t(IMAGE_DEPTH_STENCIL | IMAGE_TRANSIENT)}, 1, 1},
+        };
+        VmaAllocationInfo info{};
+
+        VmaAllocation single{};
+        image im = image::create(d.vma, single, descs[0].desc);
+        REQUIRE( im.vk );
+        vmaGetAllocationInfo(d.vma, single, &info);
+        REQUIRE( 0 == info.memoryType );
+        im.destroy(d.vma, single);
+
+        image images[2]{};
+        VkDeviceSize offsets[2]{};
+        VmaAllocation allocation{};
+        image::create_aliased(d.vma, d.device, allocation, descs, images, offsets);
+        vmaGetAllocationInfo(d.vma, allocation, &info);
+        REQUIRE( 0 == info.memoryType );
+        REQUIRE( 0 == offsets[0] );
+        REQUIRE( 0 == offsets[1] );
+        image::destroy_aliased(d.vma, d.device, allocation, images);
+    }
+    backend::set_lazily_allocated_memory(true);
+}
+
+
+TEST_CASE("upload_manager - created with VMA, streams through its own mapped host coherent ring", "[tinyvk_test]")
+{
+    TestDevice d{};
+    queue_collection queues{};
+    const auto info = graphics_and_transfer_queues(queues, d.device);
+
+    auto uploads = upload_manager::create(d.vma, d.device, queues, info, 1u << 16);
+    REQUIRE( uploads.staging );
+    REQUIRE( uploads.allocation );
+    REQUIRE( (1u << 16) == uploads.capacity );
+    VmaAllocationInfo staging{};
+    vmaGetAllocationInfo(d.vma, uploads.allocation, &staging);
+    REQUIRE( uploads.mapped == staging.pMappedData );
+    VkMemoryPropertyFlags flags{};
+    vmaGetMemoryTypeProperties(d.vma, staging.memoryType, &flags);
+    REQUIRE( (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) );
+    REQUIRE( (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) );
+
+    VmaAllocation allocation{};
+    buffer dst = buffer::create(d.vma, allocation, {1024, buffer_usage_t(BUFFER_VERTEX | BUFFER_TRANSFER_DST), VMA_USAGE_GPU_ONLY});
+    u8 data[256]{};
+    for (u32 i = 0; i < 256; ++i) data[i] = u8(i);
+    REQUIRE( uploads.upload_buffer(d.device, dst, 0, data, 128) );
+    REQUIRE( uploads.upload_buffer(d.device, dst, 128, data + 128, 128) );
+    REQUIRE( 0 == memcmp(uploads.mapped, data, 256) );
+
+    backend::reset_command_stats();
+    uploads.flush(d.device);
+    REQUIRE( 1 == backend::get_command_stats().queue_submits );
+    REQUIRE( 1 == backend::get_command_stats().copies );
+    REQUIRE( 1 == backend::get_command_stats().copy_regions );
+    uploads.reclaim(d.device, true);
+    REQUIRE( 0 == uploads.used() );
+
+    const u64 destroyed = backend::get_command_stats().destroyed_objects;
+    uploads.destroy(d.vma, d.device);
+    REQUIRE( !uploads.allocation );
+    REQUIRE( destroyed < backend::get_command_stats().destroyed_objects );
+    dst.destroy(d.vma, allocation);
+}
+
+
+TEST_CASE("frame_allocator - created with VMA, only non coherent memory is flushed", "[tinyvk_test]")
+{
+    for (const bool coherent: {true, false}) {
+        backend::set_host_coherent_memory(coherent);
+        TestDevice d{};
+        VkPhysicalDeviceProperties props{};
+        vkGetPhysicalDeviceProperties(d.physical_device, &props);
+
+        auto frames = frame_allocator::create(d.vma, 4096, 2, props.limits);
+        REQUIRE( frames.buffer );
+        VmaAllocationInfo info{};
+        vmaGetAllocationInfo(d.vma, frames.allocation, &info);
+        REQUIRE( frames.mapped == info.pMappedData );
+        REQUIRE( 2048 == frames.frame_size() );
+        // the range of a non coherent allocation is flushed through its memory block
+        REQUIRE( (coherent ? VkDeviceMemory{} : info.deviceMemory) == frames.memory );
+        REQUIRE( (coherent ? 0 : info.offset) == frames.memory_offset );
+
+        backend::reset_command_stats();
+        frames.begin_frame(d.device, 1);
+        const auto a = frames.push(u32(42));
+        const auto b = frames.allocate(100);
+        REQUIRE( 2048 == a.offset );
+        REQUIRE( 2304 == b.offset );
+        REQUIRE( 42 == *(u32*)(frames.mapped + 2048) );
+        frames.flush(d.device);
+        REQUIRE( (coherent ? 0 : 1) == backend::get_command_stats().flushed_ranges );
+
+        frames.destroy(d.vma);
+        REQUIRE( !frames.buffer );
+        REQUIRE( !frames.allocation );
+    }
+    backend::set_host_coherent_memory(true);
+}
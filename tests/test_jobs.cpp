@@ -0,0 +1,175 @@
+//
+// Created by jayjay on 19/10/26.
+//
+
+#include "catch.hpp"
+
+#include "tinystd_jobs.h"
+#include "tinystd_stdlib.h"
+
+#include <atomic>
+
+using namespace tinystd;
+
+
+TEST_CASE("job_system::parallel_for - every index runs exactly once", "[tinyvk_test]")
+{
+    auto jobs = job_system::create({4, 64});
+    REQUIRE( 4 == jobs.worker_count() );
+    REQUIRE( 0 == jobs.current_worker() );
+
+    static std::atomic<u32> hits[1000]{};
+    static std::atomic<u32> bad_worker{};
+    jobs.parallel_for(1000, 7, [](void* data, u32 begin, u32 end, u32 worker) {
+        if (worker >= ((job_system*)data)->worker_count()) ++bad_worker;
+        for (u32 i = begin; i < end; ++i) ++hits[i];
+    }, &jobs);
+
+    u32 wrong = 0;
+    for (auto& h: hits) wrong += h != 1;
+    REQUIRE( 0 == wrong );
+    REQUIRE( 0 == bad_worker );
+
+    jobs.destroy();
+}
+
+
+TEST_CASE("job_system::run - counters and dependencies", "[tinyvk_test]")
+{
+    struct state_t {
+        std::atomic<u32> first{};
+        std::atomic<u32> second_early{};
+    } state{};
+
+    u32 allocations = 0;
+    job_system_desc desc{3, 8};
+    desc.alloc.user = &allocations;
+    desc.alloc.allocate = [](void* user, tinystd::size_t size, tinystd::size_t) -> void* { ++*(u32*)user; return tinystd::malloc(size); };
+    desc.alloc.free = [](void* user, void* ptr) { --*(u32*)user; tinystd::free(ptr); };
+    auto jobs = job_system::create(desc);
+    REQUIRE( 0 != allocations );
+
+    // more jobs than fit in the deque, the rest run inline
+    job first[32]{}, second[32]{};
+    for (auto& j: first) j = {[](void* d, u32, u32, u32) { ++((state_t*)d)->first; }, &state, 0, 1};
+    for (auto& j: second) j = {[](void* d, u32, u32, u32) { if (((state_t*)d)->first != 32) ++((state_t*)d)->second_early; }, &state, 0, 1};
+
+    job_counter a{}, b{};
+    jobs.run(first, &a);
+    jobs.run(second, &b, &a);
+    jobs.wait(b);
+    REQUIRE( a.done() );
+    REQUIRE( 32 == state.first );
+    REQUIRE( 0 == state.second_early );
+
+    jobs.destroy();
+    REQUIRE( 0 == allocations );
+}
+
+
+TEST_CASE("job_system::run - jobs taken before their dependency is done are parked on it", "[tinyvk_test]")
+{
+    struct state_t {
+        job_counter         gate{};
+        std::atomic<u32>    ran{};
+        std::atomic<u32>    busy{};
+    } state{};
+
+    auto jobs = job_system::create({4, 64});
+    state.gate.add(1);
+    job gated[48]{};
+    for (auto& j: gated) j = {[](void* d, u32, u32, u32) { ++((state_t*)d)->ran; }, &state, 0, 1};
+    job_counter done{};
+    jobs.run(gated, &done, &state.gate);
+
+    // the other workers take the gated jobs while worker 0 keeps busy
+    jobs.parallel_for(4000, 1, [](void* d, u32, u32, u32) { ++((state_t*)d)->busy; }, &state);
+    REQUIRE( 4000 == state.busy );
+    REQUIRE( 0 == state.ran );
+    REQUIRE_FALSE( done.done() );
+
+    // released by a thread that is not a worker, the parked jobs go through the shared queue
+    auto release = job_thread::create([](void* d) {
+        auto& s = *(state_t*)d;
+        if (!s.gate.done()) s.gate.add(-1);
+        return false;
+    }, &state);
+    jobs.wait(done);
+    release.destroy();
+    REQUIRE( 48 == state.ran );
+
+    // and by a worker, on its own deque
+    state.gate.add(1);
+    jobs.run(gated, &done, &state.gate);
+    job open{[](void* d, u32, u32, u32) { ((state_t*)d)->gate.add(-1); }, &state, 0, 1};
+    jobs.run({&open, 1});
+    jobs.wait(done);
+    REQUIRE( 96 == state.ran );
+
+    jobs.destroy();
+}
+
+
+TEST_CASE("mpsc_queue - entries from every producer arrive once and in producer order", "[tinyvk_test]")
+{
+    struct entry { u32 producer, index; };
+    enum { PRODUCERS = 4, ENTRIES = 10000 };
+
+    auto queue = mpsc_queue::create(60, sizeof(entry));
+    entry e{};
+    REQUIRE_FALSE( queue.try_pop(&e) );
+    for (u32 i = 0; i < 64; ++i) REQUIRE( queue.try_push(&e) );
+    REQUIRE_FALSE( queue.try_push(&e) );
+    for (u32 i = 0; i < 64; ++i) REQUIRE( queue.try_pop(&e) );
+
+    auto produce = [](void* data, u32 begin, u32, u32) {
+        auto& q = *(mpsc_queue*)data;
+        for (u32 i = 0; i < ENTRIES; ++i) {
+            const entry v{begin, i};
+            while (!q.try_push(&v)) yield_thread();
+        }
+    };
+    auto jobs = job_system::create({PRODUCERS + 1, 8});
+    job producers[PRODUCERS]{};
+    for (u32 p = 0; p < PRODUCERS; ++p) producers[p] = {produce, &queue, p, p + 1};
+    job_counter done{};
+    jobs.run(producers, &done);
+
+    // worker 0 only consumes, the other workers produce
+    u32 next[PRODUCERS]{}, out_of_order = 0, received = 0;
+    while (received < PRODUCERS * ENTRIES) {
+        if (!queue.try_pop(&e)) continue;
+        out_of_order += e.index != next[e.producer]++;
+        ++received;
+    }
+    while (!done.done()) yield_thread();
+    REQUIRE( 0 == out_of_order );
+    REQUIRE_FALSE( queue.try_pop(&e) );
+
+    jobs.destroy();
+    queue.destroy();
+}
+
+
+TEST_CASE("job_thread - runs until destroyed and sleeps without work", "[tinyvk_test]")
+{
+    struct state_t {
+        job_counter         work{};
+        std::atomic<u32>    done{};
+    } state{};
+
+    auto thread = job_thread::create([](void* data) {
+        auto& s = *(state_t*)data;
+        if (s.work.done()) return false;
+        ++s.done;
+        s.work.add(-1);
+        return true;
+    }, &state);
+
+    state.work.add(3);
+    thread.wake();
+    while (!state.work.done()) yield_thread();
+    REQUIRE( 3 == state.done );
+    thread.destroy();
+    REQUIRE( nullptr == thread.m_impl );
+}